@@ -0,0 +1,222 @@
+/*********************************************************************************************************************
+ *
+ * aobaker.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "aobaker.h"
+#include "parallel.h"
+#include "sampling.h"
+
+#include "GLtools.h"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+#include <chrono>
+
+
+
+static const char AO_CACHE_MAGIC[8] = { 'R', 'T', 'A', 'O', '0', '0', '0', '2' };
+// number of vertices per work item
+static const unsigned int AO_CHUNK_SIZE = 256;
+
+
+namespace
+{
+    // FNV-1a hash of the vertex positions and indices, so the cache is rebaked when the mesh changes
+    uint64_t hashMesh(const std::vector<glm::vec3>& _vertices, const std::vector<uint32_t>& _indices)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        auto addBytes = [&](const void* _data, size_t _size)
+        {
+            const unsigned char* bytes = (const unsigned char*)_data;
+            for(size_t i = 0; i < _size; i++)
+                hash = (hash ^ bytes[i]) * 1099511628211ull;
+        };
+        addBytes(_vertices.data(), _vertices.size() * sizeof(glm::vec3));
+        addBytes(_indices.data(), _indices.size() * sizeof(uint32_t));
+        return hash;
+    }
+
+    // Van der Corput radical inverse, for Hammersley low-discrepancy sequence
+    float radicalInverse(unsigned int _bits)
+    {
+        _bits = (_bits << 16u) | (_bits >> 16u);
+        _bits = ((_bits & 0x55555555u) << 1u) | ((_bits & 0xAAAAAAAAu) >> 1u);
+        _bits = ((_bits & 0x33333333u) << 2u) | ((_bits & 0xCCCCCCCCu) >> 2u);
+        _bits = ((_bits & 0x0F0F0F0Fu) << 4u) | ((_bits & 0xF0F0F0F0u) >> 4u);
+        _bits = ((_bits & 0x00FF00FFu) << 8u) | ((_bits & 0xFF00FF00u) >> 8u);
+        return (float)_bits * 2.3283064365386963e-10f;
+    }
+
+    // Seed of the sample pattern of a vertex: from its position, so the vertices duplicated along UV seams
+    // get the same occlusion
+    unsigned int positionSeed(const glm::vec3& _pos)
+    {
+        unsigned int bits[3];
+        std::memcpy(bits, &_pos[0], sizeof(bits));
+        return hash32(bits[0] ^ hash32(bits[1] ^ hash32(bits[2])));
+    }
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                        CONSTRUCTORS / DESTRUCTORS                                           |
++-------------------------------------------------------------------------------------------------------------*/
+
+AOBaker::AOBaker(int _numRays, float _maxDistance)
+{
+    m_numRays = std::max(1, _numRays);
+    m_maxDistance = _maxDistance;
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               OTHER METHODS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+bool AOBaker::bake(TriMesh& _triMesh, const std::string& _filename)
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+    _triMesh.getVertices(vertices);
+    _triMesh.getIndices(indices);
+    if(vertices.empty() || indices.empty())
+    {
+        errorLog() << "AOBaker::bake(): empty mesh";
+        return false;
+    }
+    int numVertices = (int)vertices.size();
+    int numIndices = (int)indices.size();
+
+    std::string cacheFile = _filename + ".ao";
+    uint64_t meshHash = hashMesh(vertices, indices);
+    if(readCache(cacheFile, numVertices, numIndices, meshHash))
+    {
+        infoLog() << "AOBaker::bake(): AO read from " << cacheFile;
+    }
+    else
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        computeAO(_triMesh);
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        infoLog() << "AOBaker::bake(): AO of " << numVertices << " vertices (" << m_numRays << " rays each) baked in "
+                  << time << " s (" << getNumThreads() << " threads)";
+        writeCache(cacheFile, numVertices, numIndices, meshHash);
+    }
+
+    std::vector<glm::vec3> colors(numVertices);
+    for(int v = 0; v < numVertices; v++)
+        colors[v] = glm::vec3(m_vertexAO[v]);
+    _triMesh.setColors(colors);
+
+    return true;
+}
+
+
+void AOBaker::computeAO(TriMesh& _triMesh)
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    _triMesh.getVertices(vertices);
+    _triMesh.getNormals(normals);
+    const BVH& bvh = _triMesh.getBVH();
+
+    // ray lengths and offsets scale with the mesh
+    float diagonal = glm::length(bvh.getBBoxMax() - bvh.getBBoxMin());
+    float maxDistance = m_maxDistance * diagonal;
+    float offset = 1e-4f * diagonal;
+
+    // Hammersley points, mapped on the cosine-weighted hemisphere per vertex
+    std::vector<glm::vec2> points(m_numRays);
+    for(int i = 0; i < m_numRays; i++)
+        points[i] = glm::vec2(((float)i + 0.5f) / (float)m_numRays, radicalInverse(i));
+
+    size_t numVertices = vertices.size();
+    m_vertexAO.assign(numVertices, 1.0f);
+    unsigned int numChunks = (unsigned int)((numVertices + AO_CHUNK_SIZE - 1) / AO_CHUNK_SIZE);
+    parallelFor(numChunks, [&](unsigned int _chunk, unsigned int)
+    {
+        size_t end = std::min(numVertices, (size_t)(_chunk + 1) * AO_CHUNK_SIZE);
+        for(size_t v = (size_t)_chunk * AO_CHUNK_SIZE; v < end; v++)
+        {
+            if(v >= normals.size() || glm::dot(normals[v], normals[v]) == 0.0f)
+                continue;
+
+            glm::vec3 N = glm::normalize(normals[v]);
+            glm::vec3 T, B;
+            orthonormalBasis(N, T, B);
+
+            // random rotation of the point set (Cranley-Patterson)
+            unsigned int seed = positionSeed(vertices[v]);
+            glm::vec2 rotation((float)(seed & 0xffffu) / 65536.0f, (float)(seed >> 16u) / 65536.0f);
+
+            glm::vec3 origin = vertices[v] + N * offset;
+            int numUnoccluded = 0;
+            for(int i = 0; i < m_numRays; i++)
+            {
+                glm::vec2 u = points[i] + rotation;
+                u.x -= (u.x >= 1.0f) ? 1.0f : 0.0f;
+                u.y -= (u.y >= 1.0f) ? 1.0f : 0.0f;
+                float r = std::sqrt(u.x);
+                float phi = 2.0f * PI * u.y;
+                glm::vec3 dir = T * (r * std::cos(phi)) + B * (r * std::sin(phi)) + N * std::sqrt(std::max(0.0f, 1.0f - u.x));
+                if(!bvh.isOccluded(origin, dir, 0.0f, maxDistance))
+                    numUnoccluded++;
+            }
+            m_vertexAO[v] = (float)numUnoccluded / (float)m_numRays;
+        }
+    });
+}
+
+
+bool AOBaker::readCache(const std::string& _filename, int _numVertices, int _numIndices, uint64_t _meshHash)
+{
+    std::ifstream file(_filename, std::ios::binary);
+    if(!file.is_open())
+        return false;
+
+    char magic[8];
+    int header[3];
+    float maxDistance;
+    uint64_t meshHash;
+    file.read(magic, 8);
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&maxDistance, sizeof(maxDistance));
+    file.read((char*)&meshHash, sizeof(meshHash));
+    if(!file || std::memcmp(magic, AO_CACHE_MAGIC, 8) != 0 || header[0] != _numVertices || header[1] != _numIndices
+       || header[2] != m_numRays || maxDistance != m_maxDistance || meshHash != _meshHash)
+    {
+        warningLog() << "AOBaker::readCache(): outdated cache " << _filename;
+        return false;
+    }
+
+    m_vertexAO.resize(_numVertices);
+    file.read((char*)m_vertexAO.data(), m_vertexAO.size() * sizeof(float));
+
+    return (bool)file;
+}
+
+
+void AOBaker::writeCache(const std::string& _filename, int _numVertices, int _numIndices, uint64_t _meshHash)
+{
+    std::ofstream file(_filename, std::ios::binary);
+    if(!file.is_open())
+    {
+        warningLog() << "AOBaker::writeCache(): cannot write " << _filename;
+        return;
+    }
+
+    int header[3] = { _numVertices, _numIndices, m_numRays };
+    file.write(AO_CACHE_MAGIC, 8);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)&m_maxDistance, sizeof(m_maxDistance));
+    file.write((const char*)&_meshHash, sizeof(_meshHash));
+    file.write((const char*)m_vertexAO.data(), m_vertexAO.size() * sizeof(float));
+}
@@ -0,0 +1,119 @@
+/*********************************************************************************************************************
+ *
+ * aobaker.h
+ *
+ * CPU pre-computation of per-vertex ambient occlusion of a static mesh
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef AOBAKER_H
+#define AOBAKER_H
+
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "trimesh.h"
+
+
+
+/*!
+* \class AOBaker
+* \brief Bake the ambient occlusion of a rigid mesh at its vertices (on multiple CPU threads): for each vertex, rays
+*        are cast on the cosine-weighted hemisphere around the normal (Hammersley points, randomly rotated per
+*        vertex position), and the AO is the ratio of rays that do not hit the mesh (see TriMesh::getBVH()) within
+*        a maximum distance.
+*        The AO is written in all channels of the vertex colors of the mesh, which DrawableMesh uploads in the
+*        COLOR attribute (see DrawableMesh::setVertexAOFlag()).
+*        Results are cached in a binary file next to the mesh file, so the baking is only done once per mesh.
+*/
+class AOBaker
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn AOBaker
+        * \brief Constructor of AOBaker
+        * \param _numRays : number of rays per vertex
+        * \param _maxDistance : distance beyond which a hit does not occlude, relative to the bounding box diagonal
+        */
+        AOBaker(int _numRays = 256, float _maxDistance = 0.2f);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getVertexAO */
+        inline const std::vector<float>& getVertexAO() { return m_vertexAO; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn bake
+        * \brief Compute (or read from cache) the AO of the vertices of a mesh, and write it in the mesh colors
+        * \param _triMesh : mesh (its BVH is built if needed)
+        * \param _filename : file the mesh was read from (the cache file is _filename + ".ao")
+        * \return true if the AO is available
+        */
+        bool bake(TriMesh& _triMesh, const std::string& _filename);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        int m_numRays;                          /*!< number of rays per vertex */
+        float m_maxDistance;                    /*!< maximum occluder distance, relative to the bounding box diagonal */
+        std::vector<float> m_vertexAO;          /*!< AO of each vertex (1: not occluded) */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn computeAO
+        * \brief Cast the rays of all vertices
+        * \param _triMesh : mesh
+        */
+        void computeAO(TriMesh& _triMesh);
+
+        /*!
+        * \fn readCache
+        * \brief Read baked AO from a cache file
+        * \param _filename : cache file name
+        * \param _numVertices, _numIndices : size of the mesh (to detect outdated caches)
+        * \param _meshHash : hash of the vertex positions and indices (to detect outdated caches)
+        * \return true if cache is valid
+        */
+        bool readCache(const std::string& _filename, int _numVertices, int _numIndices, uint64_t _meshHash);
+
+        /*!
+        * \fn writeCache
+        * \brief Write baked AO into a cache file
+        * \param _filename : cache file name
+        * \param _numVertices, _numIndices : size of the mesh
+        * \param _meshHash : hash of the vertex positions and indices
+        */
+        void writeCache(const std::string& _filename, int _numVertices, int _numIndices, uint64_t _meshHash);
+};
+
+#endif // AOBAKER_H
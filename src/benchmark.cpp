@@ -0,0 +1,480 @@
+/*********************************************************************************************************************
+ *
+ * benchmark.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "benchmark.h"
+
+#include "GLtools.h"
+
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+#include <map>
+#include <cctype>
+#include <cstdlib>
+
+
+namespace
+{
+    /*!
+    * \struct JsonValue
+    * \brief Minimal JSON document tree (enough to read back benchmark reports)
+    */
+    struct JsonValue
+    {
+        enum Type { NUL, BOOL, NUMBER, STRING, ARRAY, OBJECT } type = NUL;
+        double number = 0.0;
+        std::string str;
+        std::vector<JsonValue> items;
+        std::vector<std::pair<std::string, JsonValue> > members;
+
+        const JsonValue* get(const std::string& _key) const
+        {
+            for(const std::pair<std::string, JsonValue>& m : members)
+                if(m.first == _key)
+                    return &m.second;
+            return nullptr;
+        }
+    };
+
+    /*!
+    * \class JsonParser
+    * \brief Minimal recursive-descent JSON parser (no unicode escapes)
+    */
+    class JsonParser
+    {
+        public:
+            JsonParser(const std::string& _text) : m_text(_text), m_pos(0) {}
+
+            bool parse(JsonValue& _value)
+            {
+                return parseValue(_value) && (skipSpaces(), m_pos == m_text.size());
+            }
+
+        protected:
+            const std::string& m_text;
+            size_t m_pos;
+
+            void skipSpaces()
+            {
+                while(m_pos < m_text.size() && std::isspace((unsigned char)m_text[m_pos]))
+                    m_pos++;
+            }
+
+            bool parseString(std::string& _str)
+            {
+                if(m_text[m_pos] != '"')
+                    return false;
+                m_pos++;
+                while(m_pos < m_text.size() && m_text[m_pos] != '"')
+                {
+                    if(m_text[m_pos] == '\\' && m_pos + 1 < m_text.size())
+                        m_pos++;
+                    _str += m_text[m_pos++];
+                }
+                if(m_pos >= m_text.size())
+                    return false;
+                m_pos++;
+                return true;
+            }
+
+            bool parseValue(JsonValue& _value)
+            {
+                skipSpaces();
+                if(m_pos >= m_text.size())
+                    return false;
+
+                char c = m_text[m_pos];
+                if(c == '{')
+                {
+                    _value.type = JsonValue::OBJECT;
+                    m_pos++;
+                    skipSpaces();
+                    if(m_pos < m_text.size() && m_text[m_pos] == '}')
+                        return (m_pos++, true);
+                    while(true)
+                    {
+                        std::pair<std::string, JsonValue> member;
+                        skipSpaces();
+                        if(m_pos >= m_text.size() || !parseString(member.first))
+                            return false;
+                        skipSpaces();
+                        if(m_pos >= m_text.size() || m_text[m_pos++] != ':')
+                            return false;
+                        if(!parseValue(member.second))
+                            return false;
+                        _value.members.push_back(member);
+                        skipSpaces();
+                        if(m_pos >= m_text.size())
+                            return false;
+                        if(m_text[m_pos] == ',')
+                            m_pos++;
+                        else if(m_text[m_pos] == '}')
+                            return (m_pos++, true);
+                        else
+                            return false;
+                    }
+                }
+                else if(c == '[')
+                {
+                    _value.type = JsonValue::ARRAY;
+                    m_pos++;
+                    skipSpaces();
+                    if(m_pos < m_text.size() && m_text[m_pos] == ']')
+                        return (m_pos++, true);
+                    while(true)
+                    {
+                        JsonValue item;
+                        if(!parseValue(item))
+                            return false;
+                        _value.items.push_back(item);
+                        skipSpaces();
+                        if(m_pos >= m_text.size())
+                            return false;
+                        if(m_text[m_pos] == ',')
+                            m_pos++;
+                        else if(m_text[m_pos] == ']')
+                            return (m_pos++, true);
+                        else
+                            return false;
+                    }
+                }
+                else if(c == '"')
+                {
+                    _value.type = JsonValue::STRING;
+                    return parseString(_value.str);
+                }
+                else if(m_text.compare(m_pos, 4, "true") == 0 || m_text.compare(m_pos, 5, "false") == 0)
+                {
+                    _value.type = JsonValue::BOOL;
+                    _value.number = (c == 't') ? 1.0 : 0.0;
+                    m_pos += (c == 't') ? 4 : 5;
+                    return true;
+                }
+                else if(m_text.compare(m_pos, 4, "null") == 0)
+                {
+                    m_pos += 4;
+                    return true;
+                }
+                else
+                {
+                    const char* start = m_text.c_str() + m_pos;
+                    char* end = nullptr;
+                    _value.type = JsonValue::NUMBER;
+                    _value.number = std::strtod(start, &end);
+                    if(end == start)
+                        return false;
+                    m_pos += end - start;
+                    return true;
+                }
+            }
+    };
+
+    // value of the nearest-rank percentile _p (in [0,1]) of sorted values
+    float percentile(const std::vector<float>& _sorted, float _p)
+    {
+        if(_sorted.empty())
+            return 0.0f;
+        size_t rank = (size_t)std::ceil(_p * (double)_sorted.size());
+        return _sorted[std::min(std::max<size_t>(rank, 1), _sorted.size()) - 1];
+    }
+
+    // metrics of a configuration that are compared to the baseline: frame mean/p99, and mean time of each pass
+    std::map<std::string, double> collectMetrics(const JsonValue& _config)
+    {
+        std::map<std::string, double> metrics;
+        const JsonValue* frame = _config.get("frame_ms");
+        if(frame)
+        {
+            if(const JsonValue* v = frame->get("mean")) metrics["frame mean"] = v->number;
+            if(const JsonValue* v = frame->get("p99")) metrics["frame p99"] = v->number;
+        }
+        const JsonValue* passes = _config.get("passes");
+        if(passes)
+        {
+            for(const std::pair<std::string, JsonValue>& pass : passes->members)
+            {
+                // GPU time if available, CPU time otherwise
+                const JsonValue* gpu = pass.second.get("gpu_mean");
+                const JsonValue* cpu = pass.second.get("cpu_mean");
+                if(gpu && gpu->type == JsonValue::NUMBER)
+                    metrics[pass.first + " gpu mean"] = gpu->number;
+                else if(cpu && cpu->type == JsonValue::NUMBER)
+                    metrics[pass.first + " cpu mean"] = cpu->number;
+            }
+        }
+        return metrics;
+    }
+
+    // same metrics, computed from measured results
+    std::map<std::string, double> collectMetrics(const BenchmarkResult& _result)
+    {
+        std::map<std::string, double> metrics;
+        std::vector<float> sorted = _result.frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for(float t : sorted)
+            sum += t;
+        if(!sorted.empty())
+        {
+            metrics["frame mean"] = sum / (double)sorted.size();
+            metrics["frame p99"] = percentile(sorted, 0.99f);
+        }
+        for(size_t p = 0; p < _result.passNames.size(); p++)
+        {
+            if(_result.passStats[p].gpuMean >= 0.0f)
+                metrics[_result.passNames[p] + " gpu mean"] = _result.passStats[p].gpuMean;
+            else
+                metrics[_result.passNames[p] + " cpu mean"] = _result.passStats[p].cpuMean;
+        }
+        return metrics;
+    }
+
+    bool readJsonFile(const std::string& _filename, JsonValue& _value)
+    {
+        std::ifstream file(_filename);
+        if(!file.is_open())
+            return false;
+        std::stringstream buffer;
+        buffer << file.rdbuf();
+        std::string text = buffer.str();
+        return JsonParser(text).parse(_value);
+    }
+}
+
+
+
+    /*------------------------------------------------------------------------------------------------------------+
+    |                                                 CAMERA PATH                                                 |
+    +-------------------------------------------------------------------------------------------------------------*/
+
+void CameraPath::addKey(const PathKey& _key)
+{
+    if(!m_keys.empty() && _key.time < m_keys.back().time)
+    {
+        warningLog() << "CameraPath::addKey(): key time is not increasing, key ignored";
+        return;
+    }
+    m_keys.push_back(_key);
+}
+
+
+void CameraPath::buildOrbit(float _duration)
+{
+    const int numKeys = 17;
+    const float twoPi = 6.28318530718f;
+
+    m_keys.clear();
+    for(int k = 0; k < numKeys; k++)
+    {
+        float t = (float)k / (float)(numKeys - 1);
+
+        PathKey key;
+        key.time = t * _duration;
+        // one turn around the vertical axis, with a tilt going up and down twice
+        float yaw = twoPi * t;
+        float pitch = 0.35f * std::sin(2.0f * twoPi * t);
+        key.rotation = glm::angleAxis(pitch, glm::vec3(1.0f, 0.0f, 0.0f)) * glm::angleAxis(yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+        // zoom in and out
+        key.zoom = 1.0f - 0.4f * std::sin(twoPi * t);
+        // light turns around the scene in the opposite direction, at the initial distance
+        key.lightSpherePos = glm::vec3(0.5f * 3.14159265359f - twoPi * t, 0.2f + 1.0f * (0.5f + 0.5f * std::sin(twoPi * t)), 6.0f);
+
+        m_keys.push_back(key);
+    }
+}
+
+
+PathKey CameraPath::evaluate(float _time)
+{
+    if(m_keys.empty())
+    {
+        PathKey key;
+        key.time = 0.0f;
+        key.rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        key.zoom = 1.0f;
+        key.lightSpherePos = glm::vec3(0.5f * 3.14159265359f, 0.0f, 6.0f);
+        return key;
+    }
+
+    if(_time <= m_keys.front().time)
+        return m_keys.front();
+    if(_time >= m_keys.back().time)
+        return m_keys.back();
+
+    // find surrounding keys
+    size_t k = 1;
+    while(m_keys[k].time < _time)
+        k++;
+    const PathKey& k0 = m_keys[k - 1];
+    const PathKey& k1 = m_keys[k];
+    float a = (k1.time > k0.time) ? (_time - k0.time) / (k1.time - k0.time) : 0.0f;
+
+    PathKey key;
+    key.time = _time;
+    key.rotation = glm::slerp(k0.rotation, k1.rotation, a);
+    key.zoom = glm::mix(k0.zoom, k1.zoom, a);
+    key.lightSpherePos = glm::mix(k0.lightSpherePos, k1.lightSpherePos, a);
+    return key;
+}
+
+
+bool CameraPath::load(const std::string& _filename)
+{
+    std::ifstream file(_filename);
+    if(!file.is_open())
+    {
+        errorLog() << "CameraPath::load(): cannot read " << _filename;
+        return false;
+    }
+
+    m_keys.clear();
+    std::string line;
+    while(std::getline(file, line))
+    {
+        if(line.empty() || line[0] == '#')
+            continue;
+        std::istringstream iss(line);
+        PathKey key;
+        if(iss >> key.time >> key.rotation.w >> key.rotation.x >> key.rotation.y >> key.rotation.z
+               >> key.zoom >> key.lightSpherePos.x >> key.lightSpherePos.y >> key.lightSpherePos.z)
+            addKey(key);
+        else
+            warningLog() << "CameraPath::load(): invalid line \"" << line << "\"";
+    }
+
+    return !m_keys.empty();
+}
+
+
+bool CameraPath::save(const std::string& _filename)
+{
+    std::ofstream file(_filename);
+    if(!file.is_open())
+    {
+        errorLog() << "CameraPath::save(): cannot write " << _filename;
+        return false;
+    }
+
+    file << "# time qw qx qy qz zoom light_zenith light_azimuth light_radius\n";
+    file << std::setprecision(7);
+    for(const PathKey& key : m_keys)
+        file << key.time << " " << key.rotation.w << " " << key.rotation.x << " " << key.rotation.y << " " << key.rotation.z << " "
+             << key.zoom << " " << key.lightSpherePos.x << " " << key.lightSpherePos.y << " " << key.lightSpherePos.z << "\n";
+
+    infoLog() << "CameraPath::save(): " << m_keys.size() << " keys written to " << _filename;
+    return true;
+}
+
+
+
+    /*------------------------------------------------------------------------------------------------------------+
+    |                                                   REPORT                                                    |
+    +-------------------------------------------------------------------------------------------------------------*/
+
+bool BenchmarkReport::write(const std::string& _filename, const std::string& _renderer)
+{
+    std::ofstream file(_filename);
+    if(!file.is_open())
+    {
+        errorLog() << "BenchmarkReport::write(): cannot write " << _filename;
+        return false;
+    }
+
+    file << std::fixed << std::setprecision(4);
+    file << "{\n  \"renderer\": \"" << _renderer << "\",\n  \"configurations\": [";
+    for(size_t r = 0; r < m_results.size(); r++)
+    {
+        const BenchmarkResult& res = m_results[r];
+
+        std::vector<float> sorted = res.frameTimes;
+        std::sort(sorted.begin(), sorted.end());
+        double sum = 0.0;
+        for(float t : sorted)
+            sum += t;
+        float mean = sorted.empty() ? 0.0f : (float)(sum / (double)sorted.size());
+
+        file << (r ? ",\n" : "\n") << "    {\n      \"name\": \"" << res.name << "\",\n      \"frames\": " << sorted.size() << ",\n";
+        file << "      \"frame_ms\": { \"min\": " << percentile(sorted, 0.0f) << ", \"mean\": " << mean
+             << ", \"p50\": " << percentile(sorted, 0.5f) << ", \"p95\": " << percentile(sorted, 0.95f)
+             << ", \"p99\": " << percentile(sorted, 0.99f) << ", \"max\": " << (sorted.empty() ? 0.0f : sorted.back()) << " },\n";
+
+        file << "      \"passes\": {";
+        for(size_t p = 0; p < res.passNames.size(); p++)
+        {
+            const PassStats& s = res.passStats[p];
+            file << (p ? ",\n" : "\n") << "        \"" << res.passNames[p] << "\": { \"cpu_min\": " << s.cpuMin
+                 << ", \"cpu_mean\": " << s.cpuMean << ", \"cpu_p99\": " << s.cpuP99;
+            if(s.gpuMean >= 0.0f)
+                file << ", \"gpu_min\": " << s.gpuMin << ", \"gpu_mean\": " << s.gpuMean << ", \"gpu_p99\": " << s.gpuP99;
+            file << " }";
+        }
+        file << (res.passNames.empty() ? "}\n" : "\n      }\n") << "    }";
+    }
+    file << "\n  ]\n}\n";
+
+    infoLog() << "BenchmarkReport::write(): report written to " << _filename;
+    return true;
+}
+
+
+int BenchmarkReport::compare(const std::string& _baselineFile, float _tolerance, std::ostream& _out)
+{
+    // absolute margin (ms) under which differences are considered as noise
+    const double absMargin = 0.05;
+
+    JsonValue baseline;
+    if(!readJsonFile(_baselineFile, baseline) || !baseline.get("configurations"))
+    {
+        errorLog() << "BenchmarkReport::compare(): cannot read baseline " << _baselineFile;
+        return -1;
+    }
+
+    // keep the format of the caller's stream
+    std::ios_base::fmtflags flags = _out.flags();
+    std::streamsize precision = _out.precision();
+
+    int numRegressions = 0;
+    _out << std::fixed << std::setprecision(3);
+    for(const BenchmarkResult& result : m_results)
+    {
+        const JsonValue* baseConfig = nullptr;
+        for(const JsonValue& b : baseline.get("configurations")->items)
+            if(b.get("name") && b.get("name")->str == result.name)
+                baseConfig = &b;
+        if(!baseConfig)
+        {
+            _out << "[new]        " << result.name << std::endl;
+            continue;
+        }
+
+        std::map<std::string, double> cur = collectMetrics(result);
+        std::map<std::string, double> ref = collectMetrics(*baseConfig);
+        for(const std::pair<const std::string, double>& m : cur)
+        {
+            std::map<std::string, double>::iterator it = ref.find(m.first);
+            if(it == ref.end())
+                continue;
+            double limit = it->second * (1.0 + _tolerance) + absMargin;
+            if(m.second > limit)
+            {
+                numRegressions++;
+                _out << "[REGRESSION] " << result.name << " / " << m.first << ": " << m.second << " ms (baseline "
+                     << it->second << " ms, +" << 100.0 * (m.second / std::max(it->second, 1e-6) - 1.0) << "%)" << std::endl;
+            }
+        }
+    }
+
+    _out << numRegressions << " regression(s) against " << _baselineFile << " (tolerance " << _tolerance * 100.0f << "%)" << std::endl;
+
+    _out.flags(flags);
+    _out.precision(precision);
+    return numRegressions;
+}
@@ -0,0 +1,184 @@
+/*********************************************************************************************************************
+ *
+ * benchmark.h
+ *
+ * Deterministic camera/light path replay and benchmark reports
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <ostream>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include "profiler.h"
+
+
+
+/*!
+* \struct PathKey
+* \brief State of the scene controls at a given time of a path
+*/
+struct PathKey
+{
+    float time;                 /*!< time of the key, in seconds */
+    glm::quat rotation;         /*!< trackball rotation */
+    float zoom;                 /*!< camera zoom factor */
+    glm::vec3 lightSpherePos;   /*!< light position in spherical coords (zenith, azimuth, radius relative to scene radius) */
+};
+
+
+
+/*!
+* \class CameraPath
+* \brief Keyframed path of trackball rotation, camera zoom and light position.
+*        Keys are interpolated linearly (spherical interpolation for rotations), so a replay is fully deterministic.
+*        Light radius is stored relative to the scene radius, so the same path can be replayed on any model.
+*/
+class CameraPath
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn CameraPath
+        * \brief Default constructor of CameraPath (empty path)
+        */
+        CameraPath() {}
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumKeys */
+        inline int getNumKeys() { return (int)m_keys.size(); }
+        /*! \fn getDuration */
+        inline float getDuration() { return m_keys.empty() ? 0.0f : m_keys.back().time; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn clear
+        * \brief Remove all keys
+        */
+        inline void clear() { m_keys.clear(); }
+
+        /*!
+        * \fn addKey
+        * \brief Append a key (keys must be added with increasing times)
+        * \param _key : key to add
+        */
+        void addKey(const PathKey& _key);
+
+        /*!
+        * \fn buildOrbit
+        * \brief Build the default benchmark path: one turn around the model with tilt and zoom variations, while the light rotates
+        * \param _duration : path duration, in seconds
+        */
+        void buildOrbit(float _duration);
+
+        /*!
+        * \fn evaluate
+        * \brief Interpolate the path at a given time (clamped to path duration)
+        * \param _time : time, in seconds
+        * \return interpolated key
+        */
+        PathKey evaluate(float _time);
+
+        /*!
+        * \fn load
+        * \brief Read a path from a text file (one key per line: time qw qx qy qz zoom zenith azimuth radius)
+        * \param _filename : file name
+        * \return true if at least one key was read
+        */
+        bool load(const std::string& _filename);
+
+        /*!
+        * \fn save
+        * \brief Write a path to a text file
+        * \param _filename : file name
+        * \return true if file was written
+        */
+        bool save(const std::string& _filename);
+
+
+    protected:
+
+        std::vector<PathKey> m_keys;    /*!< keys, sorted by time */
+};
+
+
+
+/*!
+* \struct BenchmarkResult
+* \brief Timings measured for one configuration (model + feature toggles)
+*/
+struct BenchmarkResult
+{
+    std::string name;                       /*!< configuration name */
+    std::vector<float> frameTimes;          /*!< time of each frame, in ms */
+    std::vector<std::string> passNames;     /*!< names of the profiled passes */
+    std::vector<PassStats> passStats;       /*!< statistics of the profiled passes */
+};
+
+
+
+/*!
+* \class BenchmarkReport
+* \brief Collect benchmark results, write them as JSON, and compare them to a baseline report
+*/
+class BenchmarkReport
+{
+    public:
+
+        /*!
+        * \fn addResult
+        * \brief Add the results of a configuration
+        * \param _result : configuration results
+        */
+        inline void addResult(const BenchmarkResult& _result) { m_results.push_back(_result); }
+
+        /*!
+        * \fn write
+        * \brief Write the frame-time distribution and pass statistics of each configuration in a JSON file
+        * \param _filename : output file name
+        * \param _renderer : description of the GL renderer
+        * \return true if file was written
+        */
+        bool write(const std::string& _filename, const std::string& _renderer);
+
+        /*!
+        * \fn compare
+        * \brief Compare results against a baseline JSON report.
+        *        A metric regresses if it is slower than the baseline by more than the tolerance (relative) plus a small
+        *        absolute margin (to ignore noise on very short passes).
+        * \param _baselineFile : baseline report (written by write())
+        * \param _tolerance : relative tolerance (e.g. 0.1 for 10%)
+        * \param _out : stream to print the comparison
+        * \return number of regressions, or -1 if the baseline cannot be read
+        */
+        int compare(const std::string& _baselineFile, float _tolerance, std::ostream& _out);
+
+
+    protected:
+
+        std::vector<BenchmarkResult> m_results;     /*!< results of each configuration */
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,644 @@
+/*********************************************************************************************************************
+ *
+ * bvh.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "bvh.h"
+#include "parallel.h"
+#include "simd.h"
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+
+// number of bins of the SAH evaluation, per axis
+static const int NUM_BINS = 16;
+// maximum number of triangles of a leaf of the binary tree (2 packets)
+static const uint32_t MAX_LEAF_SIZE = 8;
+// cost of a node traversal, relatively to the intersection of a triangle packet
+static const float TRAVERSAL_COST = 1.0f;
+// nodes with more triangles are binned on all threads
+static const uint32_t PARALLEL_BINNING_SIZE = 65536;
+// number of triangles per work item of the parallel loops
+static const uint32_t CHUNK_SIZE = 16384;
+// maximum depth of the traversal stack
+static const int STACK_SIZE = 256;
+// triangle index of the unused lanes of a packet
+static const uint32_t INVALID_TRIANGLE = 0xffffffffu;
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               BINARY SAH BUILD                                              |
++-------------------------------------------------------------------------------------------------------------*/
+
+// node of the binary tree built with the SAH, before collapsing
+struct BuildNode
+{
+    glm::vec3 bBoxMin, bBoxMax;     // bounds of the triangles
+    uint32_t first, count;          // range of the triangles in the sorted triangle indices
+    uint32_t left;                  // index of the first child (the second one follows), 0 for a leaf
+};
+
+// triangle bounds, and triangle indices sorted by the build
+struct BuildData
+{
+    std::vector<glm::vec3> triMin, triMax, centroids;
+    std::vector<uint32_t> triangles;
+};
+
+// triangle bounds and number of triangles of a bin
+struct Bin
+{
+    glm::vec3 bBoxMin = glm::vec3(std::numeric_limits<float>::max());
+    glm::vec3 bBoxMax = glm::vec3(-std::numeric_limits<float>::max());
+    uint32_t count = 0;
+
+    void grow(const glm::vec3& _min, const glm::vec3& _max) { bBoxMin = glm::min(bBoxMin, _min); bBoxMax = glm::max(bBoxMax, _max); }
+    void grow(const Bin& _bin) { grow(_bin.bBoxMin, _bin.bBoxMax); count += _bin.count; }
+};
+
+
+static float halfArea(const glm::vec3& _min, const glm::vec3& _max)
+{
+    glm::vec3 e = glm::max(_max - _min, glm::vec3(0.0f));
+    return e.x * e.y + e.y * e.z + e.z * e.x;
+}
+
+
+static float numPackets(uint32_t _count)
+{
+    return (float)((_count + 3) / 4);
+}
+
+
+// run _func(begin, end, chunk) over chunks of [_first, _first + _count), on all threads or on the calling thread
+template<typename Func>
+static void forChunks(uint32_t _first, uint32_t _count, bool _isParallel, Func _func)
+{
+    uint32_t numChunks = (_count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    auto chunk = [&](unsigned int _chunk, unsigned int)
+    {
+        uint32_t begin = _first + _chunk * CHUNK_SIZE;
+        _func(begin, std::min(begin + CHUNK_SIZE, _first + _count), _chunk);
+    };
+    if(_isParallel)
+        parallelFor(numChunks, chunk);
+    else
+        for(uint32_t c = 0; c < numChunks; c++)
+            chunk(c, 0);
+}
+
+
+// split a node with the binned SAH, and append its 2 children (return false if the node stays a leaf)
+static bool splitNode(BuildData& _data, std::vector<BuildNode>& _nodes, uint32_t _node, bool _isParallel)
+{
+    BuildNode node = _nodes[_node];
+    if(node.count <= 1)
+        return false;
+    _isParallel = _isParallel && node.count >= PARALLEL_BINNING_SIZE;
+    uint32_t numChunks = (node.count + CHUNK_SIZE - 1) / CHUNK_SIZE;
+
+    // bounds of the centroids
+    std::vector<Bin> chunkCentroids(numChunks);
+    forChunks(node.first, node.count, _isParallel, [&](uint32_t _begin, uint32_t _end, uint32_t _chunk)
+    {
+        for(uint32_t i = _begin; i < _end; i++)
+        {
+            const glm::vec3& c = _data.centroids[_data.triangles[i]];
+            chunkCentroids[_chunk].grow(c, c);
+        }
+    });
+    Bin centroidBounds;
+    for(const Bin& bin : chunkCentroids)
+        centroidBounds.grow(bin);
+    glm::vec3 extent = centroidBounds.bBoxMax - centroidBounds.bBoxMin;
+    glm::vec3 binScale;
+    for(int axis = 0; axis < 3; axis++)
+        binScale[axis] = extent[axis] > 0.0f ? (float)NUM_BINS / extent[axis] : 0.0f;
+
+    auto binIndex = [&](uint32_t _triangle, int _axis)
+    {
+        float b = (_data.centroids[_triangle][_axis] - centroidBounds.bBoxMin[_axis]) * binScale[_axis];
+        return std::min(NUM_BINS - 1, (int)b);
+    };
+
+    // bin the triangles along the 3 axes
+    std::vector<Bin> chunkBins(numChunks * 3 * NUM_BINS);
+    forChunks(node.first, node.count, _isParallel, [&](uint32_t _begin, uint32_t _end, uint32_t _chunk)
+    {
+        Bin* bins = &chunkBins[_chunk * 3 * NUM_BINS];
+        for(uint32_t i = _begin; i < _end; i++)
+        {
+            uint32_t t = _data.triangles[i];
+            for(int axis = 0; axis < 3; axis++)
+            {
+                Bin& bin = bins[axis * NUM_BINS + binIndex(t, axis)];
+                bin.grow(_data.triMin[t], _data.triMax[t]);
+                bin.count++;
+            }
+        }
+    });
+    Bin bins[3][NUM_BINS];
+    for(uint32_t c = 0; c < numChunks; c++)
+        for(int axis = 0; axis < 3; axis++)
+            for(int b = 0; b < NUM_BINS; b++)
+                bins[axis][b].grow(chunkBins[(c * 3 + axis) * NUM_BINS + b]);
+
+    // evaluate the SAH between each pair of consecutive bins
+    float nodeArea = std::max(halfArea(node.bBoxMin, node.bBoxMax), 1e-20f);
+    float bestCost = std::numeric_limits<float>::max();
+    int bestAxis = -1, bestSplit = 0;
+    Bin bestLeft, bestRight;
+    for(int axis = 0; axis < 3; axis++)
+    {
+        if(binScale[axis] == 0.0f)
+            continue;
+
+        Bin right[NUM_BINS];
+        Bin accum;
+        for(int b = NUM_BINS - 1; b > 0; b--)
+        {
+            accum.grow(bins[axis][b]);
+            right[b] = accum;
+        }
+        Bin left;
+        for(int b = 1; b < NUM_BINS; b++)
+        {
+            left.grow(bins[axis][b - 1]);
+            if(left.count == 0 || right[b].count == 0)
+                continue;
+            float cost = TRAVERSAL_COST + (halfArea(left.bBoxMin, left.bBoxMax) * numPackets(left.count) +
+                                           halfArea(right[b].bBoxMin, right[b].bBoxMax) * numPackets(right[b].count)) / nodeArea;
+            if(cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestSplit = b;
+                bestLeft = left;
+                bestRight = right[b];
+            }
+        }
+    }
+
+    uint32_t mid;
+    if(bestAxis >= 0)
+    {
+        // keep a small leaf if splitting does not pay off
+        if(node.count <= MAX_LEAF_SIZE && bestCost >= numPackets(node.count))
+            return false;
+
+        auto begin = _data.triangles.begin() + node.first;
+        mid = (uint32_t)(std::partition(begin, begin + node.count, [&](uint32_t _t) { return binIndex(_t, bestAxis) < bestSplit; })
+                         - _data.triangles.begin());
+    }
+    else
+    {
+        // same centroid for all the triangles: split in the middle, if the leaf is too large
+        if(node.count <= MAX_LEAF_SIZE)
+            return false;
+
+        mid = node.first + node.count / 2;
+        bestLeft = Bin();
+        bestRight = Bin();
+        for(uint32_t i = node.first; i < node.first + node.count; i++)
+            (i < mid ? bestLeft : bestRight).grow(_data.triMin[_data.triangles[i]], _data.triMax[_data.triangles[i]]);
+    }
+
+    _nodes[_node].left = (uint32_t)_nodes.size();
+    _nodes.push_back({ bestLeft.bBoxMin, bestLeft.bBoxMax, node.first, mid - node.first, 0 });
+    _nodes.push_back({ bestRight.bBoxMin, bestRight.bBoxMax, mid, node.first + node.count - mid, 0 });
+    return true;
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                        CONSTRUCTORS / DESTRUCTORS                                           |
++-------------------------------------------------------------------------------------------------------------*/
+
+BVH::BVH()
+{
+    m_bBoxMin = glm::vec3(0.0f);
+    m_bBoxMax = glm::vec3(0.0f);
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               OTHER METHODS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+void BVH::build(const std::vector<glm::vec3>& _vertices, const std::vector<uint32_t>& _indices)
+{
+    m_nodes.clear();
+    m_packets.clear();
+    m_indices.assign(_indices.begin(), _indices.begin() + (_indices.size() - _indices.size() % 3));
+    m_bBoxMin = glm::vec3(0.0f);
+    m_bBoxMax = glm::vec3(0.0f);
+
+    uint32_t numTriangles = (uint32_t)(m_indices.size() / 3);
+    if(numTriangles == 0)
+        return;
+
+    // 1- Triangle bounds -------------------------------------------------------------------------------------
+
+    BuildData data;
+    data.triMin.resize(numTriangles);
+    data.triMax.resize(numTriangles);
+    data.centroids.resize(numTriangles);
+    data.triangles.resize(numTriangles);
+    std::vector<Bin> chunkBounds((numTriangles + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    forChunks(0, numTriangles, true, [&](uint32_t _begin, uint32_t _end, uint32_t _chunk)
+    {
+        for(uint32_t t = _begin; t < _end; t++)
+        {
+            const glm::vec3& a = _vertices[m_indices[3 * t]];
+            const glm::vec3& b = _vertices[m_indices[3 * t + 1]];
+            const glm::vec3& c = _vertices[m_indices[3 * t + 2]];
+            data.triMin[t] = glm::min(a, glm::min(b, c));
+            data.triMax[t] = glm::max(a, glm::max(b, c));
+            data.centroids[t] = (data.triMin[t] + data.triMax[t]) * 0.5f;
+            data.triangles[t] = t;
+            chunkBounds[_chunk].grow(data.triMin[t], data.triMax[t]);
+        }
+    });
+    Bin bounds;
+    for(const Bin& chunk : chunkBounds)
+        bounds.grow(chunk);
+
+
+    // 2- Binary tree: top levels split with parallel binning, then subtrees built in parallel ----------------
+
+    std::vector<BuildNode> nodes;
+    nodes.reserve(numTriangles);
+    nodes.push_back({ bounds.bBoxMin, bounds.bBoxMax, 0, numTriangles, 0 });
+
+    uint32_t taskSize = std::max(CHUNK_SIZE / 4, numTriangles / (getNumThreads() * 8));
+    std::vector<uint32_t> stack = { 0 }, tasks;
+    while(!stack.empty())
+    {
+        uint32_t n = stack.back();
+        stack.pop_back();
+        if(nodes[n].count <= taskSize)
+            tasks.push_back(n);
+        else if(splitNode(data, nodes, n, true))
+        {
+            stack.push_back(nodes[n].left);
+            stack.push_back(nodes[n].left + 1);
+        }
+    }
+
+    // the triangle ranges of the tasks are disjoint
+    std::vector<std::vector<BuildNode> > subtrees(tasks.size());
+    parallelFor((unsigned int)tasks.size(), [&](unsigned int _task, unsigned int)
+    {
+        std::vector<BuildNode>& subtree = subtrees[_task];
+        subtree.push_back(nodes[tasks[_task]]);
+        std::vector<uint32_t> subStack = { 0 };
+        while(!subStack.empty())
+        {
+            uint32_t n = subStack.back();
+            subStack.pop_back();
+            if(splitNode(data, subtree, n, false))
+            {
+                subStack.push_back(subtree[n].left);
+                subStack.push_back(subtree[n].left + 1);
+            }
+        }
+    });
+
+    // splice the subtrees: the root replaces the task node, the other nodes are appended
+    for(size_t t = 0; t < tasks.size(); t++)
+    {
+        std::vector<BuildNode>& subtree = subtrees[t];
+        uint32_t offset = (uint32_t)nodes.size() - 1;
+        for(BuildNode& node : subtree)
+            if(node.left != 0)
+                node.left += offset;
+        nodes[tasks[t]] = subtree[0];
+        nodes.insert(nodes.end(), subtree.begin() + 1, subtree.end());
+        std::vector<BuildNode>().swap(subtree);
+    }
+
+
+    // 3- Collapse into a 4-wide tree (parents before children) ------------------------------------------------
+
+    struct CollapseTask
+    {
+        uint32_t buildNode;     // node of the binary tree
+        int32_t parent;         // 4-wide parent node (-1 for the root)
+        int slot;               // slot of the parent
+    };
+    std::vector<CollapseTask> collapseStack = { { 0, -1, 0 } };
+    while(!collapseStack.empty())
+    {
+        CollapseTask task = collapseStack.back();
+        collapseStack.pop_back();
+        const BuildNode& node = nodes[task.buildNode];
+
+        if(node.left == 0 && task.parent >= 0)
+        {
+            // leaf: packets of 4 triangles
+            Node& parent = m_nodes[task.parent];
+            parent.child[task.slot] = ~(int32_t)m_packets.size();
+            parent.numPackets[task.slot] = (uint32_t)numPackets(node.count);
+            for(uint32_t i = 0; i < node.count; i += 4)
+            {
+                TrianglePacket packet;
+                for(uint32_t lane = 0; lane < 4; lane++)
+                    packet.triangle[lane] = (i + lane < node.count) ? data.triangles[node.first + i + lane] : INVALID_TRIANGLE;
+                fillPacket(packet, _vertices);
+                m_packets.push_back(packet);
+            }
+            continue;
+        }
+
+        // open the children with the largest area, up to 4 children (a root leaf gets a single child)
+        std::vector<uint32_t> children;
+        if(node.left == 0)
+            children.push_back(task.buildNode);
+        else
+            children = { node.left, node.left + 1 };
+        while(children.size() < 4)
+        {
+            int largest = -1;
+            float largestArea = -1.0f;
+            for(int c = 0; c < (int)children.size(); c++)
+            {
+                const BuildNode& child = nodes[children[c]];
+                float area = halfArea(child.bBoxMin, child.bBoxMax);
+                if(child.left != 0 && area > largestArea)
+                {
+                    largest = c;
+                    largestArea = area;
+                }
+            }
+            if(largest < 0)
+                break;
+            uint32_t opened = children[largest];
+            children[largest] = nodes[opened].left;
+            children.push_back(nodes[opened].left + 1);
+        }
+
+        // empty slots have inverted bounds, so that no ray hits them
+        Node node4;
+        for(int slot = 0; slot < 4; slot++)
+        {
+            for(int axis = 0; axis < 3; axis++)
+            {
+                node4.bounds[2 * axis][slot] = std::numeric_limits<float>::infinity();
+                node4.bounds[2 * axis + 1][slot] = -std::numeric_limits<float>::infinity();
+            }
+            node4.child[slot] = 0;
+            node4.numPackets[slot] = 0;
+        }
+        for(int slot = 0; slot < (int)children.size(); slot++)
+        {
+            const BuildNode& child = nodes[children[slot]];
+            for(int axis = 0; axis < 3; axis++)
+            {
+                node4.bounds[2 * axis][slot] = child.bBoxMin[axis];
+                node4.bounds[2 * axis + 1][slot] = child.bBoxMax[axis];
+            }
+        }
+
+        int32_t index = (int32_t)m_nodes.size();
+        m_nodes.push_back(node4);
+        if(task.parent >= 0)
+            m_nodes[task.parent].child[task.slot] = index;
+        for(int slot = (int)children.size() - 1; slot >= 0; slot--)
+            collapseStack.push_back({ children[slot], index, slot });
+    }
+
+    m_bBoxMin = bounds.bBoxMin;
+    m_bBoxMax = bounds.bBoxMax;
+}
+
+
+void BVH::refit(const std::vector<glm::vec3>& _vertices)
+{
+    if(m_nodes.empty())
+        return;
+
+    parallelFor((unsigned int)m_packets.size(), [&](unsigned int _packet, unsigned int)
+    {
+        fillPacket(m_packets[_packet], _vertices);
+    });
+
+    // children are stored after their parent
+    for(size_t n = m_nodes.size(); n-- > 0; )
+    {
+        Node& node = m_nodes[n];
+        for(int slot = 0; slot < 4; slot++)
+        {
+            glm::vec3 bBoxMin(std::numeric_limits<float>::infinity());
+            glm::vec3 bBoxMax(-std::numeric_limits<float>::infinity());
+            if(node.numPackets[slot] > 0)
+            {
+                int32_t first = ~node.child[slot];
+                for(uint32_t p = 0; p < node.numPackets[slot]; p++)
+                {
+                    for(int lane = 0; lane < 4; lane++)
+                    {
+                        uint32_t t = m_packets[first + p].triangle[lane];
+                        if(t == INVALID_TRIANGLE)
+                            continue;
+                        for(int v = 0; v < 3; v++)
+                        {
+                            bBoxMin = glm::min(bBoxMin, _vertices[m_indices[3 * t + v]]);
+                            bBoxMax = glm::max(bBoxMax, _vertices[m_indices[3 * t + v]]);
+                        }
+                    }
+                }
+            }
+            else if(node.child[slot] > 0)
+            {
+                // empty slots of the child have inverted bounds, which do not contribute
+                const Node& child = m_nodes[node.child[slot]];
+                for(int axis = 0; axis < 3; axis++)
+                    for(int s = 0; s < 4; s++)
+                    {
+                        bBoxMin[axis] = std::min(bBoxMin[axis], child.bounds[2 * axis][s]);
+                        bBoxMax[axis] = std::max(bBoxMax[axis], child.bounds[2 * axis + 1][s]);
+                    }
+            }
+            else
+                continue;
+
+            for(int axis = 0; axis < 3; axis++)
+            {
+                node.bounds[2 * axis][slot] = bBoxMin[axis];
+                node.bounds[2 * axis + 1][slot] = bBoxMax[axis];
+            }
+        }
+    }
+
+    const Node& root = m_nodes[0];
+    for(int axis = 0; axis < 3; axis++)
+    {
+        m_bBoxMin[axis] = *std::min_element(root.bounds[2 * axis], root.bounds[2 * axis] + 4);
+        m_bBoxMax[axis] = *std::max_element(root.bounds[2 * axis + 1], root.bounds[2 * axis + 1] + 4);
+    }
+}
+
+
+bool BVH::intersect(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax, Hit& _hit) const
+{
+    return traverse(_origin, _dir, _tMin, _tMax, false, _hit);
+}
+
+
+bool BVH::isOccluded(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax) const
+{
+    Hit hit;
+    return traverse(_origin, _dir, _tMin, _tMax, true, hit);
+}
+
+
+void BVH::fillPacket(TrianglePacket& _packet, const std::vector<glm::vec3>& _vertices)
+{
+    for(int lane = 0; lane < 4; lane++)
+    {
+        uint32_t t = _packet.triangle[lane];
+        glm::vec3 v0(0.0f), e1(0.0f), e2(0.0f);
+        // unused lanes are degenerate triangles (null determinant)
+        if(t != INVALID_TRIANGLE)
+        {
+            v0 = _vertices[m_indices[3 * t]];
+            e1 = _vertices[m_indices[3 * t + 1]] - v0;
+            e2 = _vertices[m_indices[3 * t + 2]] - v0;
+        }
+        for(int axis = 0; axis < 3; axis++)
+        {
+            _packet.v0[axis][lane] = v0[axis];
+            _packet.e1[axis][lane] = e1[axis];
+            _packet.e2[axis][lane] = e2[axis];
+        }
+    }
+}
+
+
+bool BVH::traverse(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax, bool _isAnyHit, Hit& _hit) const
+{
+    if(m_nodes.empty())
+        return false;
+
+    // ray broadcast to the 4 lanes (null direction components are replaced by tiny ones, to avoid NaNs in the slab test)
+    Vec3x4 origin = { Float4(_origin.x), Float4(_origin.y), Float4(_origin.z) };
+    Vec3x4 dir = { Float4(_dir.x), Float4(_dir.y), Float4(_dir.z) };
+    Float4 invDir[3];
+    int nearBound[3];
+    for(int axis = 0; axis < 3; axis++)
+    {
+        float d = std::abs(_dir[axis]) > 1e-20f ? _dir[axis] : std::copysign(1e-20f, _dir[axis]);
+        invDir[axis] = Float4(1.0f / d);
+        nearBound[axis] = d >= 0.0f ? 0 : 1;
+    }
+    Float4 originAxis[3] = { origin.x, origin.y, origin.z };
+    Float4 tMin(_tMin);
+
+    float tClosest = _tMax;
+    bool isHit = false;
+
+    int32_t stack[STACK_SIZE];
+    int stackSize = 0;
+    stack[stackSize++] = 0;
+    while(stackSize > 0)
+    {
+        const Node& node = m_nodes[stack[--stackSize]];
+
+        // slab test of the 4 children
+        Float4 tNear = tMin, tFar(tClosest);
+        for(int axis = 0; axis < 3; axis++)
+        {
+            Float4 t0 = (Float4::load(node.bounds[2 * axis + nearBound[axis]]) - originAxis[axis]) * invDir[axis];
+            Float4 t1 = (Float4::load(node.bounds[2 * axis + 1 - nearBound[axis]]) - originAxis[axis]) * invDir[axis];
+            tNear = max4(tNear, t0);
+            tFar = min4(tFar, t1);
+        }
+        int hitBits = (tNear <= tFar).bits();
+        if(hitBits == 0)
+            continue;
+
+        // visit the hit children from the closest to the farthest (leaves now, nodes through the stack)
+        alignas(16) float entry[4];
+        tNear.store(entry);
+        int order[4];
+        int numHit = 0;
+        for(int slot = 0; slot < 4; slot++)
+        {
+            if(!(hitBits & (1 << slot)))
+                continue;
+            int i = numHit++;
+            while(i > 0 && entry[order[i - 1]] > entry[slot])
+            {
+                order[i] = order[i - 1];
+                i--;
+            }
+            order[i] = slot;
+        }
+
+        for(int i = 0; i < numHit; i++)
+        {
+            int slot = order[i];
+            if(node.numPackets[slot] == 0)
+                continue;
+            if(entry[slot] > tClosest)
+                break;
+
+            int32_t first = ~node.child[slot];
+            for(uint32_t p = 0; p < node.numPackets[slot]; p++)
+            {
+                // Moller-Trumbore intersection of 4 triangles
+                const TrianglePacket& packet = m_packets[first + p];
+                Vec3x4 v0 = load3(packet.v0), e1 = load3(packet.e1), e2 = load3(packet.e2);
+                Vec3x4 pvec = cross(dir, e2);
+                Float4 det = dot(e1, pvec);
+                Float4 invDet = Float4(1.0f) / det;
+                Vec3x4 tvec = origin - v0;
+                Float4 u = dot(tvec, pvec) * invDet;
+                Vec3x4 qvec = cross(tvec, e1);
+                Float4 v = dot(dir, qvec) * invDet;
+                Float4 t = dot(e2, qvec) * invDet;
+                Mask4 isValid = (det != Float4(0.0f)) & (u >= Float4(0.0f)) & (v >= Float4(0.0f)) & (u + v <= Float4(1.0f)) &
+                                (t > tMin) & (t < Float4(tClosest));
+                int bits = isValid.bits();
+                if(bits == 0)
+                    continue;
+
+                alignas(16) float ts[4], us[4], vs[4];
+                t.store(ts);
+                u.store(us);
+                v.store(vs);
+                for(int lane = 0; lane < 4; lane++)
+                {
+                    if(!(bits & (1 << lane)) || ts[lane] >= tClosest)
+                        continue;
+                    tClosest = ts[lane];
+                    _hit.t = ts[lane];
+                    _hit.triangle = packet.triangle[lane];
+                    _hit.bary = glm::vec2(us[lane], vs[lane]);
+                    isHit = true;
+                }
+                if(_isAnyHit)
+                    return true;
+            }
+        }
+
+        // push the nodes from the farthest, so that the closest is visited first
+        for(int i = numHit - 1; i >= 0; i--)
+        {
+            int slot = order[i];
+            if(node.numPackets[slot] == 0 && stackSize < STACK_SIZE)
+                stack[stackSize++] = node.child[slot];
+        }
+    }
+
+    return isHit;
+}
@@ -0,0 +1,183 @@
+/*********************************************************************************************************************
+ *
+ * bvh.h
+ *
+ * Bounding volume hierarchy of a triangle soup, for CPU ray queries
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+
+/*!
+* \class BVH
+* \brief Bounding volume hierarchy of the triangles of a mesh, to cast rays on the CPU (picking, baking, ray tracing).
+*        The hierarchy is built with the surface area heuristic (SAH), evaluated on 16 bins of the triangle
+*        centroids per axis: the top levels are split with the binning spread over all threads, then the subtrees
+*        are built in parallel. The binary tree is then collapsed into a 4-wide tree:
+*        - a node stores the boxes of its 4 children in SoA layout (one cache line per 2 coords), so a ray is tested
+*          against the 4 boxes at once
+*        - leaves reference packets of 4 triangles in SoA layout (first vertex and 2 edges), so a ray is tested
+*          against 4 triangles at once (Moller-Trumbore)
+*        The topology only depends on the indices: when the vertices move, refit() updates the boxes and the
+*        triangles without rebuilding the tree.
+*        Based on:
+*        I. Wald, "On fast Construction of SAH-based Bounding Volume Hierarchies", IEEE Symposium on Interactive Ray Tracing 2007.
+*        H. Dammertz, J. Hanika and A. Keller, "Shallow Bounding Volume Hierarchies for Fast SIMD Ray Tracing of Incoherent Rays", EGSR 2008.
+*/
+class BVH
+{
+    public:
+
+        /*!
+        * \struct Hit
+        * \brief Closest intersection of a ray
+        */
+        struct Hit
+        {
+            float t;                /*!< distance along the ray (in units of the ray direction) */
+            uint32_t triangle;      /*!< index of the triangle (in the mesh indices, divided by 3) */
+            glm::vec2 bary;         /*!< barycentric coords of the 2nd and 3rd vertices of the triangle */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn BVH
+        * \brief Default constructor of BVH (empty hierarchy)
+        */
+        BVH();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn isEmpty */
+        inline bool isEmpty() const { return m_nodes.empty(); }
+        /*! \fn getNumNodes */
+        inline size_t getNumNodes() const { return m_nodes.size(); }
+        /*! \fn getNumTriangles */
+        inline size_t getNumTriangles() const { return m_indices.size() / 3; }
+        /*! \fn getBBoxMin */
+        inline glm::vec3 getBBoxMin() const { return m_bBoxMin; }
+        /*! \fn getBBoxMax */
+        inline glm::vec3 getBBoxMax() const { return m_bBoxMax; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn build
+        * \brief Build the hierarchy of the triangles of a mesh
+        * \param _vertices : vertex positions
+        * \param _indices : 3 vertex indices per triangle
+        */
+        void build(const std::vector<glm::vec3>& _vertices, const std::vector<uint32_t>& _indices);
+
+        /*!
+        * \fn refit
+        * \brief Update the boxes and the triangles after the vertices moved (same indices as build())
+        * \param _vertices : new vertex positions
+        */
+        void refit(const std::vector<glm::vec3>& _vertices);
+
+        /*!
+        * \fn intersect
+        * \brief Find the closest intersection of a ray in ]_tMin, _tMax[
+        * \param _origin : origin of the ray
+        * \param _dir : direction of the ray (not necessarily normalized)
+        * \param _tMin, _tMax : interval of the ray
+        * \param _hit : closest intersection, if any
+        * \return true if the ray hits a triangle
+        */
+        bool intersect(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax, Hit& _hit) const;
+
+        /*!
+        * \fn isOccluded
+        * \brief Check if a ray hits any triangle in ]_tMin, _tMax[ (stops at the first intersection found)
+        * \param _origin : origin of the ray
+        * \param _dir : direction of the ray
+        * \param _tMin, _tMax : interval of the ray
+        * \return true if the ray hits a triangle
+        */
+        bool isOccluded(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax) const;
+
+
+    protected:
+
+        /*!
+        * \struct Node
+        * \brief Node of the 4-wide tree (128 bytes)
+        */
+        struct alignas(16) Node
+        {
+            float bounds[6][4];     /*!< min x, max x, min y, max y, min z, max z of the 4 children */
+            int32_t child[4];       /*!< index of the child node, or ~(index of the first packet) for a leaf */
+            uint32_t numPackets[4]; /*!< number of triangle packets of a leaf (0 for a node or an empty slot) */
+        };
+
+        /*!
+        * \struct TrianglePacket
+        * \brief 4 triangles (SoA), unused lanes are degenerate
+        */
+        struct alignas(16) TrianglePacket
+        {
+            float v0[3][4];         /*!< first vertex */
+            float e1[3][4];         /*!< edge from the first to the second vertex */
+            float e2[3][4];         /*!< edge from the first to the third vertex */
+            uint32_t triangle[4];   /*!< triangle index */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        std::vector<Node> m_nodes;                  /*!< nodes, the root first (children after their parent) */
+        std::vector<TrianglePacket> m_packets;      /*!< triangles of the leaves */
+        std::vector<uint32_t> m_indices;            /*!< vertex indices of the mesh (used by refit) */
+        glm::vec3 m_bBoxMin;                        /*!< min corner of the bounding box of all triangles */
+        glm::vec3 m_bBoxMax;                        /*!< max corner of the bounding box of all triangles */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn fillPacket
+        * \brief Set the vertices of the triangles of a packet
+        * \param _packet : triangle packet (triangle indices already set)
+        * \param _vertices : vertex positions
+        */
+        void fillPacket(TrianglePacket& _packet, const std::vector<glm::vec3>& _vertices);
+
+        /*!
+        * \fn traverse
+        * \brief Closest hit or any hit traversal
+        * \param _origin, _dir, _tMin, _tMax : ray
+        * \param _isAnyHit : stop at the first intersection
+        * \param _hit : closest intersection
+        * \return true if the ray hits a triangle
+        */
+        bool traverse(const glm::vec3& _origin, const glm::vec3& _dir, float _tMin, float _tMax, bool _isAnyHit, Hit& _hit) const;
+};
+
+#endif // BVH_H
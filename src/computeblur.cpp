@@ -0,0 +1,98 @@
+/*********************************************************************************************************************
+ *
+ * computeblur.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "computeblur.h"
+
+#include "GLtools.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// uniform buffer binding point of the weights
+static const GLuint WEIGHTS_BINDING = 0;
+// weights of the taps 0..MAX_RADIUS, rounded up to a whole number of vec4 (std140 layout of blur.comp)
+static const int NUM_WEIGHTS = ((ComputeBlur::MAX_RADIUS + 4) / 4) * 4;
+
+
+ComputeBlur::ComputeBlur(GLuint _program)
+{
+    m_program = _program;
+    m_radius = -1;
+
+    glGenBuffers(1, &m_weightsUBO);
+    glBindBuffer(GL_UNIFORM_BUFFER, m_weightsUBO);
+    glBufferData(GL_UNIFORM_BUFFER, NUM_WEIGHTS * sizeof(float), nullptr, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    GLuint blockIndex = glGetUniformBlockIndex(m_program, "BlurWeights");
+    if(blockIndex == GL_INVALID_INDEX)
+        errorLog() << "ComputeBlur::ComputeBlur(): uniform block BlurWeights not found";
+    else
+        glUniformBlockBinding(m_program, blockIndex, WEIGHTS_BINDING);
+}
+
+
+ComputeBlur::~ComputeBlur()
+{
+    glDeleteBuffers(1, &m_weightsUBO);
+}
+
+
+bool ComputeBlur::isSupported()
+{
+    return GLEW_VERSION_4_3;
+}
+
+
+void ComputeBlur::blur(GLuint _srcTex, GLuint _dstTex, int _width, int _height, bool _isHorizontal, int _filterWidth, bool _isMasked)
+{
+    int radius = std::clamp(_filterWidth, 0, MAX_RADIUS);
+
+    // Gaussian weights (sigma = m / 1.96 to cover 96% of the Gaussian), only recomputed when the width changes
+    if(radius != m_radius)
+    {
+        float weights[NUM_WEIGHTS] = { 0.0f };
+        float sigma = std::max((float)radius, 1.0f) / 1.96f;
+        for(int i = 0; i <= radius; i++)
+            weights[i] = std::exp(-0.5f * (float)(i * i) / (sigma * sigma));
+
+        glBindBuffer(GL_UNIFORM_BUFFER, m_weightsUBO);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(weights), weights);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_radius = radius;
+    }
+
+    glUseProgram(m_program);
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _srcTex);
+    glUniform1i(glGetUniformLocation(m_program, "u_srcTex"), 0);
+
+    glBindImageTexture(0, _dstTex, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glUniform1i(glGetUniformLocation(m_program, "u_dstImage"), 0);
+
+    glBindBufferBase(GL_UNIFORM_BUFFER, WEIGHTS_BINDING, m_weightsUBO);
+
+    glUniform2i(glGetUniformLocation(m_program, "u_direction"), _isHorizontal ? 1 : 0, _isHorizontal ? 0 : 1);
+    glUniform1i(glGetUniformLocation(m_program, "u_radius"), radius);
+    glUniform1i(glGetUniformLocation(m_program, "u_isMasked"), _isMasked ? 1 : 0);
+
+    // one workgroup per segment of TILE_SIZE texels of each line (rows if horizontal, columns if vertical)
+    int lineLength = _isHorizontal ? _width : _height;
+    int numLines = _isHorizontal ? _height : _width;
+    glDispatchCompute((lineLength + TILE_SIZE - 1) / TILE_SIZE, numLines, 1);
+
+    // the result is read by the next passes through samplers
+    glMemoryBarrier(GL_TEXTURE_FETCH_BARRIER_BIT);
+
+    glBindImageTexture(0, 0, 0, GL_FALSE, 0, GL_WRITE_ONLY, GL_RGBA16F);
+    glBindBufferBase(GL_UNIFORM_BUFFER, WEIGHTS_BINDING, 0);
+    glUseProgram(0);
+}
@@ -0,0 +1,90 @@
+/*********************************************************************************************************************
+ *
+ * computeblur.h
+ *
+ * Separable Gaussian blur in a compute shader
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef COMPUTEBLUR_H
+#define COMPUTEBLUR_H
+
+#include <GL/glew.h>
+
+
+
+/*!
+* \class ComputeBlur
+* \brief One direction of a separable Gaussian blur, computed by the compute shader blur.comp (GL 4.3).
+*        Texels are loaded in shared memory by tiles (with an apron of filter width texels), and the Gaussian
+*        weights are computed once per filter width and stored in a uniform buffer.
+*        Gives the same result as the blur of quadTex.frag, which is used when compute shaders are not supported.
+*/
+class ComputeBlur
+{
+    public:
+
+        static const int TILE_SIZE = 128;       /*!< number of texels blurred per workgroup (as in blur.comp) */
+        static const int MAX_RADIUS = 32;       /*!< maximum filter half-width (as in blur.comp) */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn ComputeBlur
+        * \brief Constructor of ComputeBlur: creates the uniform buffer of the weights
+        * \param _program : compute shader program (blur.comp)
+        */
+        ComputeBlur(GLuint _program);
+
+        /*!
+        * \fn ~ComputeBlur
+        * \brief Destructor of ComputeBlur: deletes the uniform buffer (the program is owned by the caller)
+        */
+        ~ComputeBlur();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn isSupported : compute shaders and image load/store are available (GL 4.3 context) */
+        static bool isSupported();
+        /*! \fn isFormatSupported : the blurred targets can be written by the shader (rgba16f image) */
+        static inline bool isFormatSupported(GLenum _colorFormat) { return _colorFormat == GL_RGBA16F; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn blur
+        * \brief Blur a texture in one direction and write the result in another texture of the same size
+        * \param _srcTex : texture to blur
+        * \param _dstTex : result (GL_RGBA16F texture)
+        * \param _width, _height : size of both textures
+        * \param _isHorizontal : true for horizontal blur, false for vertical blur
+        * \param _filterWidth : filter half-width, in texels (clamped to MAX_RADIUS)
+        * \param _isMasked : true to ignore texels with null alpha (TSD)
+        */
+        void blur(GLuint _srcTex, GLuint _dstTex, int _width, int _height, bool _isHorizontal, int _filterWidth, bool _isMasked);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        GLuint m_program;               /*!< compute shader program */
+        GLuint m_weightsUBO;            /*!< uniform buffer of the Gaussian weights */
+        int m_radius;                   /*!< filter half-width of the weights in the uniform buffer (-1 if none) */
+};
+
+#endif // COMPUTEBLUR_H
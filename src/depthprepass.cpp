@@ -0,0 +1,170 @@
+/*********************************************************************************************************************
+ *
+ * depthprepass.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "depthprepass.h"
+
+
+// weight of the last frame in the moving average of the overdraw
+static const float SMOOTHING = 0.2f;
+// number of frames to wait after a decision change (query results are read back with 1-2 frames of latency)
+static const int SETTLE_FRAMES = 8;
+// without pre-pass, the visible pixels are measured again by a pre-pass every PROBE_FRAMES frames
+static const int PROBE_FRAMES = 30;
+// the adaptive pre-pass is disabled below (min overdraw * HYSTERESIS)
+static const float HYSTERESIS = 0.9f;
+
+
+DepthPrepass::DepthPrepass(float _minOverdraw)
+{
+    m_mode = ADAPTIVE;
+    m_minOverdraw = _minOverdraw;
+    m_frame = 0;
+    m_isActive = false;
+    for(int slot = 0; slot < 2; slot++)
+    {
+        m_queries[slot][0] = m_queries[slot][1] = 0;
+        m_isPending[slot][0] = m_isPending[slot][1] = false;
+    }
+    reset();
+}
+
+
+DepthPrepass::~DepthPrepass()
+{
+    if(m_queries[0][0] != 0)
+        glDeleteQueries(4, &m_queries[0][0]);
+}
+
+
+void DepthPrepass::reset()
+{
+    m_overdraw = -1.0f;
+    m_visibleSamples = 0.0;
+    m_isOn = false;
+    m_numFrames = 0;
+    m_numFramesSinceProbe = 0;
+}
+
+
+bool DepthPrepass::begin()
+{
+    m_frame++;
+
+    // queries are created with the first frame (a GL context is current)
+    if(m_queries[0][0] == 0)
+        glGenQueries(4, &m_queries[0][0]);
+
+    // collect every result already available (queries issued during the previous frames)
+    for(int slot = 0; slot < 2; slot++)
+        collectQueries(slot);
+
+    // queries still pending after 2 frames: their results are dropped rather than stalling the pipeline
+    int slot = (int)(m_frame & 1);
+    m_isPending[slot][0] = m_isPending[slot][1] = false;
+
+    if(m_mode == OFF)
+        m_isActive = false;
+    else if(m_mode == ALWAYS)
+        m_isActive = true;
+    else
+    {
+        m_numFrames++;
+        m_numFramesSinceProbe++;
+        if(m_overdraw >= 0.0f && m_numFrames >= SETTLE_FRAMES)
+        {
+            bool isChanged = m_isOn ? (m_overdraw < m_minOverdraw * HYSTERESIS) : (m_overdraw > m_minOverdraw);
+            if(isChanged)
+            {
+                m_isOn = !m_isOn;
+                m_numFrames = 0;
+            }
+        }
+        // without pre-pass, the overdraw is estimated from the visible pixels of the last pre-pass
+        m_isActive = m_isOn || m_visibleSamples <= 0.0 || m_numFramesSinceProbe >= PROBE_FRAMES;
+    }
+
+    if(m_isActive)
+    {
+        m_numFramesSinceProbe = 0;
+
+        // depth only: the fragment shader output is discarded
+        glColorMask(GL_FALSE, GL_FALSE, GL_FALSE, GL_FALSE);
+        glBeginQuery(GL_SAMPLES_PASSED, m_queries[slot][0]);
+    }
+
+    return m_isActive;
+}
+
+
+void DepthPrepass::beginShading()
+{
+    int slot = (int)(m_frame & 1);
+
+    if(m_isActive)
+    {
+        glEndQuery(GL_SAMPLES_PASSED);
+        m_isPending[slot][0] = true;
+
+        // only the closest fragment of each pixel passes, and the depth buffer is already complete
+        glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+        glDepthFunc(GL_EQUAL);
+        glDepthMask(GL_FALSE);
+    }
+
+    glBeginQuery(GL_SAMPLES_PASSED, m_queries[slot][1]);
+}
+
+
+void DepthPrepass::end()
+{
+    glEndQuery(GL_SAMPLES_PASSED);
+    m_isPending[m_frame & 1][1] = true;
+
+    if(m_isActive)
+    {
+        glDepthFunc(GL_LESS);
+        glDepthMask(GL_TRUE);
+    }
+}
+
+
+void DepthPrepass::collectQueries(int _slot)
+{
+    if(!m_isPending[_slot][1])
+        return;
+
+    // the depth draws are submitted before the shading draws: their result is available first
+    GLint available = 0;
+    glGetQueryObjectiv(m_queries[_slot][1], GL_QUERY_RESULT_AVAILABLE, &available);
+    if(!available)
+        return;
+
+    GLuint64 shadingSamples = 0;
+    glGetQueryObjectui64v(m_queries[_slot][1], GL_QUERY_RESULT, &shadingSamples);
+
+    // fragments which pass the depth test in draw order, i.e. shaded without pre-pass
+    double fragments = (double)shadingSamples;
+    if(m_isPending[_slot][0])
+    {
+        GLuint64 depthSamples = 0;
+        glGetQueryObjectui64v(m_queries[_slot][0], GL_QUERY_RESULT, &depthSamples);
+        fragments = (double)depthSamples;
+        m_visibleSamples = (double)shadingSamples;
+    }
+    m_isPending[_slot][0] = m_isPending[_slot][1] = false;
+
+    if(fragments <= 0.0 || m_visibleSamples <= 0.0)
+        return;
+
+    float overdraw = (float)(fragments / m_visibleSamples);
+    if(m_overdraw < 0.0f)
+        m_overdraw = overdraw;
+    else
+        m_overdraw += SMOOTHING * (overdraw - m_overdraw);
+}
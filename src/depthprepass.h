@@ -0,0 +1,146 @@
+/*********************************************************************************************************************
+ *
+ * depthprepass.h
+ *
+ * Depth-only pre-pass of a geometry pass, enabled when the measured overdraw makes it pay off
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef DEPTHPREPASS_H
+#define DEPTHPREPASS_H
+
+#include <GL/glew.h>
+
+
+
+/*!
+* \class DepthPrepass
+* \brief Optional depth-only pre-pass of a pass drawing the meshes (e.g. forward lighting, G-buffer).
+*        With the pre-pass, the depth buffer is filled first with a trivial shader, then the shading draws test
+*        depth with GL_EQUAL and without depth writes: the shading fragment shader runs once per pixel, whatever the
+*        overdraw. The pre-pass costs a second vertex pass and a depth-only rasterization, so it only pays off if the
+*        overdraw is high enough.
+*        The overdraw (shaded fragments / visible pixels) is measured with GL_SAMPLES_PASSED queries: without the
+*        pre-pass, the shading draws count the shaded fragments; with the pre-pass, the depth draws count them and the
+*        shading draws count the visible pixels. The number of visible pixels is refreshed by running the pre-pass
+*        every few frames. Queries are double-buffered (results read one or two frames later, as in Profiler).
+*        The color passes must compute the same clip space positions as the pre-pass (invariant gl_Position, same
+*        model-view-projection matrix), otherwise GL_EQUAL rejects some of the visible fragments.
+*/
+class DepthPrepass
+{
+    public:
+
+        /*!
+        * \enum Mode
+        * \brief When the pre-pass is drawn
+        */
+        enum Mode
+        {
+            OFF = 0,        /*!< never */
+            ADAPTIVE = 1,   /*!< when the measured overdraw is above the threshold */
+            ALWAYS = 2      /*!< every frame */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn DepthPrepass
+        * \brief Constructor of DepthPrepass
+        * \param _minOverdraw : overdraw above which the adaptive pre-pass is enabled
+        */
+        DepthPrepass(float _minOverdraw = 1.5f);
+
+        /*!
+        * \fn ~DepthPrepass
+        * \brief Destructor of DepthPrepass: deletes GL queries
+        */
+        ~DepthPrepass();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getMode */
+        inline int getMode() { return m_mode; }
+        /*! \fn getMinOverdraw */
+        inline float getMinOverdraw() { return m_minOverdraw; }
+        /*! \fn getOverdraw : smoothed overdraw of the shading draws without pre-pass (negative if not measured yet) */
+        inline float getOverdraw() { return m_overdraw; }
+        /*! \fn isActive : true if the pre-pass was drawn in the last frame */
+        inline bool isActive() { return m_isActive; }
+
+        /*! \fn setMode */
+        inline void setMode(int _mode) { m_mode = _mode; }
+        /*! \fn setMinOverdraw */
+        inline void setMinOverdraw(float _minOverdraw) { m_minOverdraw = _minOverdraw; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn begin
+        * \brief Collect the available query results, and decide if the pre-pass is drawn in this frame. If so, color
+        *        writes are disabled and the depth draws can be issued (until beginShading())
+        * \return true if the depth draws of the pre-pass must be issued
+        */
+        bool begin();
+
+        /*!
+        * \fn beginShading
+        * \brief End the depth draws (if any) and start the shading draws: depth test GL_EQUAL without depth writes
+        *        after a pre-pass, default depth test otherwise
+        */
+        void beginShading();
+
+        /*!
+        * \fn end
+        * \brief End the shading draws and restore the default depth test (GL_LESS, depth writes)
+        */
+        void end();
+
+        /*!
+        * \fn reset
+        * \brief Forget the measured overdraw (e.g. after a scene change)
+        */
+        void reset();
+
+
+    protected:
+
+        /*!
+        * \fn collectQueries
+        * \brief Read the results of the queries of a slot, if available, and update the overdraw
+        * \param _slot : query slot (frame parity)
+        */
+        void collectQueries(int _slot);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        int m_mode;                     /*!< pre-pass mode (see Mode) */
+        float m_minOverdraw;            /*!< overdraw above which the adaptive pre-pass is enabled */
+        float m_overdraw;               /*!< exponential moving average of the overdraw (negative if not measured yet) */
+        double m_visibleSamples;        /*!< visible pixels, measured by the last pre-pass (0 if none) */
+        bool m_isOn;                    /*!< adaptive decision (the pre-pass can still run to refresh the measures) */
+        bool m_isActive;                /*!< the pre-pass is drawn in the current frame */
+        int m_numFrames;                /*!< number of frames since the last decision change */
+        int m_numFramesSinceProbe;      /*!< number of frames since the last pre-pass */
+
+        long long m_frame;              /*!< current frame index */
+        GLuint m_queries[2][2];         /*!< double-buffered GL_SAMPLES_PASSED queries of the depth and shading draws */
+        bool m_isPending[2][2];         /*!< queries issued and not read yet */
+};
+
+#endif // DEPTHPREPASS_H
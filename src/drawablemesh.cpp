@@ -13,6 +13,14 @@
 #include <stb_image.h>
 
 
+// model-view-projection matrix given to the vertex shaders (computed once on the CPU, so that the depth pre-pass and the
+// shading passes get exactly the same clip space positions)
+static glm::mat4 modelViewProjection(const glm::mat4& _modelMat, const glm::mat4& _viewMat, const glm::mat4& _projMat)
+{
+    return _projMat * _viewMat * _modelMat;
+}
+
+
 DrawableMesh::DrawableMesh()
 {
     /* TODO */
@@ -41,6 +49,7 @@ DrawableMesh::DrawableMesh()
     m_vertexProvided = false;
     m_normalProvided = false;
     m_colorProvided = false;
+    m_useVertexAO = false;
     m_tangentProvided = false;
     m_bitangentProvided = false;
     m_uvProvided = false;
@@ -48,6 +57,22 @@ DrawableMesh::DrawableMesh()
 
     m_shadedRenderOn = true;
 
+    m_ormMap = 0;
+    m_cascadeMaps = 0;
+    m_momentMap = 0;
+    m_shadowMethod = 0;
+    m_lightDataTex = 0;
+    m_clustersTex = 0;
+    m_lightIndicesTex = 0;
+    m_numLocalLights = 0;
+    m_clusterGrid = glm::ivec3(1);
+    m_clusterDepthParams = glm::vec2(0.0f);
+    m_gBufferInvViewProj = glm::mat4(1.0f);
+
+    m_iblSpecularMap = 0;
+    m_iblBrdfLUT = 0;
+    m_iblNumLevels = 1;
+    setIBLFlag(false);
 }
 
 
@@ -71,26 +96,24 @@ void DrawableMesh::createMeshVAO(TriMesh& _triMesh)
 }
 
 
-void DrawableMesh::createQuadVAO(int _type, float _y, glm::vec3 _centerCoords, float _radScene)
+void DrawableMesh::quadGeometry(int _type, float _y, glm::vec3 _centerCoords, float _radScene,
+                                std::vector<glm::vec3>& _vertices, std::vector<glm::vec3>& _normals)
 {
-    std::vector<glm::vec3> vertices;
-    std::vector<glm::vec3> normals;
-
     if( _type == 1)
     {
         // SCREEN
         if(_radScene != 0.0f)
-            warningLog() << "DrawableMesh::createQuadVAO(): Create screen quad: radius of the scene is not null";
+            warningLog() << "DrawableMesh::quadGeometry(): Create screen quad: radius of the scene is not null";
 
         // generate a quad in front of the camera
-        vertices = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f) };
-        normals = { glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f) };
+        _vertices = { glm::vec3(-1.0f, -1.0f, 0.0f), glm::vec3(1.0f, -1.0f, 0.0f), glm::vec3(1.0f, 1.0f, 0.0f), glm::vec3(-1.0f, 1.0f, 0.0f) };
+        _normals = { glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f), glm::vec3(1.0f, 1.0f,  1.0f) };
     }
     else
     {
         // FLOOR
         if(_radScene == 0.0f)
-            warningLog() << "DrawableMesh::createQuadVAO(): Create floor quad: radius of the scene is null";
+            warningLog() << "DrawableMesh::quadGeometry(): Create floor quad: radius of the scene is null";
 
         // generate a quad on the XZ axis, centered on the scene center.
         // Dimension adapted to the size of the scene.
@@ -101,9 +124,17 @@ void DrawableMesh::createQuadVAO(int _type, float _y, glm::vec3 _centerCoords, f
         float zMax = _centerCoords.z + halfEdgeSize;
         // small offset on the y coord so the floor is below the mesh
         float y = _y - _radScene*0.1f;
-        vertices = { glm::vec3(xMin, y, zMax), glm::vec3(xMax, y, zMax), glm::vec3(xMax, y, zMin), glm::vec3(xMin, y, zMin) };
-        normals = { glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f) };
+        _vertices = { glm::vec3(xMin, y, zMax), glm::vec3(xMax, y, zMax), glm::vec3(xMax, y, zMin), glm::vec3(xMin, y, zMin) };
+        _normals = { glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f), glm::vec3(0.0f, 1.0f,  0.0f) };
     }
+}
+
+
+void DrawableMesh::createQuadVAO(int _type, float _y, glm::vec3 _centerCoords, float _radScene)
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<glm::vec3> normals;
+    quadGeometry(_type, _y, _centerCoords, _radScene, vertices, normals);
 
     // add UV coords so we can map textures on the creen quad
     std::vector<glm::vec2> texcoords{ glm::vec2(0.0f, 0.0f), glm::vec2(1.0f, 0.0f), glm::vec2(1.0f, 1.0f), glm::vec2(0.0f, 1.0f) };
@@ -254,6 +285,9 @@ void DrawableMesh::fillVAO(TriMesh& _triMesh, bool _create)
     tangents.size() ?  m_tangentProvided = true :  m_tangentProvided = false;
     bitangents.size() ?  m_bitangentProvided = true :  m_bitangentProvided = false;
 
+    // baked ambient occlusion is stored in the colors
+    m_useVertexAO = m_useVertexAO && m_colorProvided;
+
     if(!m_vertexProvided)
         warningLog() << "DrawableMesh::createVAO(): No vertex provided";
     if(!m_normalProvided)
@@ -400,145 +434,248 @@ void DrawableMesh::draw(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewM
         // Activate program
         glUseProgram(_program);
 
-        // Bind textures
-        if(m_useAlbedoTex)
-        {
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, m_albedoTex);
-        }
-        if(m_useNormalMap)
-        {
-            glActiveTexture(GL_TEXTURE1);
-            glBindTexture(GL_TEXTURE_2D, m_normalMap);
-        }
-        if(m_usePBR)
-        {
-            glActiveTexture(GL_TEXTURE2);
-            glBindTexture(GL_TEXTURE_2D, m_metalMap);
-            glActiveTexture(GL_TEXTURE3);
-            glBindTexture(GL_TEXTURE_2D, m_glossMap);
-        }
-        if(m_useAmbMap)
-        {
-            glActiveTexture(GL_TEXTURE4);
-            glBindTexture(GL_TEXTURE_2D, m_ambientMap);
-        }
-        if(m_useEnvMapReflec || m_useEnvMapRefrac)
-        {
-            glActiveTexture(GL_TEXTURE5);
-            glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMap);
-        }
-        if(m_useShadowMap || m_useSimTransmit)
-        {
-            glActiveTexture(GL_TEXTURE6);
-            glBindTexture(GL_TEXTURE_2D, m_shadowMap);
-        }
+        // textures and uniforms of the lighting
+        setLightingState(_program, _modelMat, _viewMat, _projMat, _lightPos, _camPos, _lightCol, _lightMat, _distLightMax);
 
-        // ...
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
 
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
 
-        // Pass uniforms
-        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matM"), 1, GL_FALSE, &_modelMat[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matV"), 1, GL_FALSE, &_viewMat[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
-        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matPV_light"), 1, GL_FALSE, &_lightMat[0][0]);
-        glUniform3fv(glGetUniformLocation(_program, "u_lightPos"), 1, &_lightPos[0]);
-        glUniform3fv(glGetUniformLocation(_program, "u_camPos"), 1, &_camPos[0]);
+        glBindVertexArray(m_defaultVAO);
 
-        glUniform3fv(glGetUniformLocation(_program, "u_lightColor"), 1, &_lightCol[0]);
+    }
 
-        glUniform3fv(glGetUniformLocation(_program, "u_ambientColor"), 1, &m_ambientColor[0]);
-        glUniform3fv(glGetUniformLocation(_program, "u_diffuseColor"), 1, &m_diffuseColor[0]);
-        glUniform3fv(glGetUniformLocation(_program, "u_specularColor"), 1, &m_specularColor[0]);
-        glUniform1f(glGetUniformLocation(_program, "u_specularPower"), m_specPow);
- 
-        glUniform1i(glGetUniformLocation(_program, "u_albedoTex"), 0);
-        glUniform1i(glGetUniformLocation(_program, "u_normalMap"), 1);
-        glUniform1i(glGetUniformLocation(_program, "u_metalMap"), 2);
-        glUniform1i(glGetUniformLocation(_program, "u_glossMap"), 3);
-        glUniform1i(glGetUniformLocation(_program, "u_ambientMap"), 4);
-        glUniform1i(glGetUniformLocation(_program, "u_cubemap"), 5);
-        glUniform1i(glGetUniformLocation(_program, "u_shadowMap"), 6);
-        glUniform1f(glGetUniformLocation(_program, "u_distLightMax"), _distLightMax);
+    glUseProgram(0);
+}
 
 
+void DrawableMesh::drawDeferredLighting(GLuint _program, GLuint _gDepth, GLuint _gNormal, GLuint _gColor, GLuint _gSpecular,
+                                        glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
+                                        glm::vec3& _lightPos, glm::vec3& _camPos, glm::vec3& _lightCol, glm::mat4& _lightMat, float _distLightMax)
+{
+    // Activate program
+    glUseProgram(_program);
 
-    
+    // shadow maps, IBL and local lights (the material textures are replaced by the G-buffer)
+    setLightingState(_program, _modelMat, _viewMat, _projMat, _lightPos, _camPos, _lightCol, _lightMat, _distLightMax);
 
-        if(m_useAmbient)
-            glUniform1i(glGetUniformLocation(_program, "u_useAmbient"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useAmbient"), 0);
-        if(m_useDiffuse)
-            glUniform1i(glGetUniformLocation(_program, "u_useDiffuse"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useDiffuse"), 0);
-        if(m_useSpecular)
-            glUniform1i(glGetUniformLocation(_program, "u_useSpecular"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useSpecular"), 0);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, _gDepth);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, _gNormal);
+    glActiveTexture(GL_TEXTURE2);
+    glBindTexture(GL_TEXTURE_2D, _gColor);
+    glActiveTexture(GL_TEXTURE12);
+    glBindTexture(GL_TEXTURE_2D, _gSpecular);
 
-        if(m_useAlbedoTex)
-            glUniform1i(glGetUniformLocation(_program, "u_useAlbedoTex"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useAlbedoTex"), 0);
-        if(m_useNormalMap)
-            glUniform1i(glGetUniformLocation(_program, "u_useNormalMap"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useNormalMap"), 0);
-        if(m_usePBR)
-            glUniform1i(glGetUniformLocation(_program, "u_usePBR"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_usePBR"), 0);
-        if(m_useAmbMap)
-            glUniform1i(glGetUniformLocation(_program, "u_useAmbMap"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useAmbMap"), 0);
-        if(m_useEnvMapReflec)
-            glUniform1i(glGetUniformLocation(_program, "u_useEnvMapReflec"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useEnvMapReflec"), 0);
-        if(m_useEnvMapRefrac)
-            glUniform1i(glGetUniformLocation(_program, "u_useEnvMapRefrac"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useEnvMapRefrac"), 0);
-        if(m_useShadowMap)
-            glUniform1i(glGetUniformLocation(_program, "u_useShadowMap"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useShadowMap"), 0);
+    glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 0);
+    glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 1);
+    glUniform1i(glGetUniformLocation(_program, "u_colorTex"), 2);
+    glUniform1i(glGetUniformLocation(_program, "u_specularTex"), 12);
 
-        if(m_useGammaCorrec)
-            glUniform1i(glGetUniformLocation(_program, "u_useGammaCorrec"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useGammaCorrec"), 0);
+    // G-buffer positions are decoded from depth in world space, shadow maps are in model space
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+    glm::mat4 modelInv = glm::inverse(_modelMat);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matMInv"), 1, GL_FALSE, &modelInv[0][0]);
 
-        if(m_isLightDir)
-            glUniform1i(glGetUniformLocation(_program, "u_isLightDir"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_isLightDir"), 0);
+    // Draw!
+    glBindVertexArray(m_meshVAO);                       // bind the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
 
-        if(m_useSimTransmit)
-            glUniform1i(glGetUniformLocation(_program, "u_useSimTransmit"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useSimTransmit"), 0);
+    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
 
-        if(m_useTSD)
-            glUniform1i(glGetUniformLocation(_program, "u_useTSD"), 1);
-        else
-            glUniform1i(glGetUniformLocation(_program, "u_useTSD"), 0);
-        // ...
+    glBindVertexArray(m_defaultVAO);
 
-        // Draw!
-        glBindVertexArray(m_meshVAO);                       // bind the VAO
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+    glActiveTexture(GL_TEXTURE0);
+    glUseProgram(0);
+}
 
-        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
 
-        glBindVertexArray(m_defaultVAO);
+void DrawableMesh::setLightingState(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
+                                    glm::vec3& _lightPos,  glm::vec3& _camPos,  glm::vec3& _lightCol, glm::mat4& _lightMat, float _distLightMax)
+{
+    // Bind textures
+    if(m_useAlbedoTex)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_albedoTex);
+    }
+    if(m_useNormalMap)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_normalMap);
+    }
+    if(m_usePBR || m_useAmbMap)
+    {
+        // occlusion, roughness and metalness share the same packed texture
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, m_ormMap);
+    }
+    if(m_useEnvMapReflec || m_useEnvMapRefrac)
+    {
+        glActiveTexture(GL_TEXTURE5);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_cubeMap);
+    }
+    if(m_useShadowMap || m_useSimTransmit)
+    {
+        glActiveTexture(GL_TEXTURE6);
+        glBindTexture(GL_TEXTURE_2D, m_shadowMap);
+    }
+    if(m_useShadowMap && !m_cascadeMatrices.empty())
+    {
+        glActiveTexture(GL_TEXTURE7);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, m_cascadeMaps);
+    }
+    if(m_useShadowMap && m_shadowMethod > 0)
+    {
+        glActiveTexture(GL_TEXTURE8);
+        glBindTexture(GL_TEXTURE_2D, m_momentMap);
+    }
+    if(m_numLocalLights > 0)
+    {
+        glActiveTexture(GL_TEXTURE9);
+        glBindTexture(GL_TEXTURE_BUFFER, m_lightDataTex);
+        glActiveTexture(GL_TEXTURE10);
+        glBindTexture(GL_TEXTURE_BUFFER, m_clustersTex);
+        glActiveTexture(GL_TEXTURE11);
+        glBindTexture(GL_TEXTURE_BUFFER, m_lightIndicesTex);
+    }
+    if(m_useIBL)
+    {
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_CUBE_MAP, m_iblSpecularMap);
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, m_iblBrdfLUT);
+    }
+
+    // ...
+
+
+    // Pass uniforms
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matM"), 1, GL_FALSE, &_modelMat[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matV"), 1, GL_FALSE, &_viewMat[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
+    glm::mat4 mvp = modelViewProjection(_modelMat, _viewMat, _projMat);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matMVP"), 1, GL_FALSE, &mvp[0][0]);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matPV_light"), 1, GL_FALSE, &_lightMat[0][0]);
+    glUniform3fv(glGetUniformLocation(_program, "u_lightPos"), 1, &_lightPos[0]);
+    glUniform3fv(glGetUniformLocation(_program, "u_camPos"), 1, &_camPos[0]);
+
+    glUniform3fv(glGetUniformLocation(_program, "u_lightColor"), 1, &_lightCol[0]);
+
+    glUniform3fv(glGetUniformLocation(_program, "u_ambientColor"), 1, &m_ambientColor[0]);
+    glUniform3fv(glGetUniformLocation(_program, "u_diffuseColor"), 1, &m_diffuseColor[0]);
+    glUniform3fv(glGetUniformLocation(_program, "u_specularColor"), 1, &m_specularColor[0]);
+    glUniform1f(glGetUniformLocation(_program, "u_specularPower"), m_specPow);
+ 
+    glUniform1i(glGetUniformLocation(_program, "u_albedoTex"), 0);
+    glUniform1i(glGetUniformLocation(_program, "u_normalMap"), 1);
+    glUniform1i(glGetUniformLocation(_program, "u_ormMap"), 2);
+    glUniform1i(glGetUniformLocation(_program, "u_prefilteredMap"), 3);
+    glUniform1i(glGetUniformLocation(_program, "u_brdfLUT"), 4);
+    glUniform1i(glGetUniformLocation(_program, "u_cubemap"), 5);
+    glUniform1i(glGetUniformLocation(_program, "u_shadowMap"), 6);
+    glUniform1i(glGetUniformLocation(_program, "u_cascadeMaps"), 7);
+    glUniform1i(glGetUniformLocation(_program, "u_momentMap"), 8);
+    glUniform1i(glGetUniformLocation(_program, "u_lightData"), 9);
+    glUniform1i(glGetUniformLocation(_program, "u_clusters"), 10);
+    glUniform1i(glGetUniformLocation(_program, "u_lightIndices"), 11);
+    glUniform1f(glGetUniformLocation(_program, "u_distLightMax"), _distLightMax);
 
+    glUniform1i(glGetUniformLocation(_program, "u_numLocalLights"), m_numLocalLights);
+    glUniform3iv(glGetUniformLocation(_program, "u_clusterGrid"), 1, &m_clusterGrid[0]);
+    glUniform2fv(glGetUniformLocation(_program, "u_clusterDepthParams"), 1, &m_clusterDepthParams[0]);
+
+
+
+
+
+    if(m_useAmbient)
+        glUniform1i(glGetUniformLocation(_program, "u_useAmbient"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useAmbient"), 0);
+    if(m_useDiffuse)
+        glUniform1i(glGetUniformLocation(_program, "u_useDiffuse"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useDiffuse"), 0);
+    if(m_useSpecular)
+        glUniform1i(glGetUniformLocation(_program, "u_useSpecular"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useSpecular"), 0);
+
+    if(m_useAlbedoTex)
+        glUniform1i(glGetUniformLocation(_program, "u_useAlbedoTex"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useAlbedoTex"), 0);
+    if(m_useNormalMap)
+        glUniform1i(glGetUniformLocation(_program, "u_useNormalMap"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useNormalMap"), 0);
+    if(m_usePBR)
+        glUniform1i(glGetUniformLocation(_program, "u_usePBR"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_usePBR"), 0);
+    if(m_useAmbMap)
+        glUniform1i(glGetUniformLocation(_program, "u_useAmbMap"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useAmbMap"), 0);
+    if(m_useVertexAO)
+        glUniform1i(glGetUniformLocation(_program, "u_useVertexAO"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useVertexAO"), 0);
+    if(m_useEnvMapReflec)
+        glUniform1i(glGetUniformLocation(_program, "u_useEnvMapReflec"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useEnvMapReflec"), 0);
+    if(m_useEnvMapRefrac)
+        glUniform1i(glGetUniformLocation(_program, "u_useEnvMapRefrac"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useEnvMapRefrac"), 0);
+    if(m_useShadowMap)
+        glUniform1i(glGetUniformLocation(_program, "u_useShadowMap"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useShadowMap"), 0);
+
+    glUniform1i(glGetUniformLocation(_program, "u_shadowMethod"), m_useShadowMap ? m_shadowMethod : 0);
+
+    int numCascades = m_useShadowMap ? (int)m_cascadeMatrices.size() : 0;
+    glUniform1i(glGetUniformLocation(_program, "u_numCascades"), numCascades);
+    if(numCascades > 0)
+    {
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matCascades"), numCascades, GL_FALSE, &m_cascadeMatrices[0][0][0]);
+        glUniform1fv(glGetUniformLocation(_program, "u_cascadeSplits"), numCascades, m_cascadeSplits.data());
     }
 
-    glUseProgram(0);
+    if(m_useGammaCorrec)
+        glUniform1i(glGetUniformLocation(_program, "u_useGammaCorrec"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useGammaCorrec"), 0);
+
+    if(m_isLightDir)
+        glUniform1i(glGetUniformLocation(_program, "u_isLightDir"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_isLightDir"), 0);
+
+    if(m_useSimTransmit)
+        glUniform1i(glGetUniformLocation(_program, "u_useSimTransmit"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useSimTransmit"), 0);
+
+    if(m_useTSD)
+        glUniform1i(glGetUniformLocation(_program, "u_useTSD"), 1);
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useTSD"), 0);
+
+    if(m_useIBL)
+    {
+        glUniform1i(glGetUniformLocation(_program, "u_useIBL"), 1);
+        glUniform3fv(glGetUniformLocation(_program, "u_shCoeffs"), 9, &m_iblSHCoeffs[0][0]);
+        glUniform1f(glGetUniformLocation(_program, "u_prefilteredMaxLevel"), (float)(m_iblNumLevels - 1));
+    }
+    else
+        glUniform1i(glGetUniformLocation(_program, "u_useIBL"), 0);
 }
 
 
@@ -579,7 +716,7 @@ void DrawableMesh::drawSkyBox(GLuint _program, glm::mat4& _viewMat, glm::mat4& _
 
 
 
-void DrawableMesh::drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn, bool _isGaussH, int _filterWidth)
+void DrawableMesh::drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn, bool _isGaussH, int _filterWidth, bool _isMasked)
 {
 
         // Activate program
@@ -601,6 +738,7 @@ void DrawableMesh::drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn,
             glUniform1i(glGetUniformLocation(_program, "isFilterH"), 0);
 
         glUniform1i(glGetUniformLocation(_program, "filterSize"), _filterWidth);
+        glUniform1i(glGetUniformLocation(_program, "isMasked"), _isMasked ? 1 : 0);
 
 
         GLint ShadowMapUniform = glGetUniformLocation(_program, "u_screenTex");
@@ -625,7 +763,8 @@ void DrawableMesh::drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn,
 
 
 
-void DrawableMesh::drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLuint _posTex, GLuint _normalTex, float _radius, float _screenWidth, float _screenHeight)
+void DrawableMesh::drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLuint _depthTex, GLuint _normalTex, float _radius, float _screenWidth, float _screenHeight,
+                                      int _kernelSize, int _kernelOffset, float _noiseAngle)
 {
         // Activate program
         glUseProgram(_program);
@@ -635,7 +774,7 @@ void DrawableMesh::drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLui
         glBindTexture(GL_TEXTURE_2D, m_noiseTex);
 
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, _posTex);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, _normalTex);
@@ -651,11 +790,15 @@ void DrawableMesh::drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLui
         }     
  
         glUniform1i(glGetUniformLocation(_program, "u_noiseTex"), 0);
-        glUniform1i(glGetUniformLocation(_program, "u_posTex"), 1);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 1);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
         glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 2);
         glUniform1f(glGetUniformLocation(_program, "u_radius"), _radius);
         glUniform1f(glGetUniformLocation(_program, "u_screenWidth"), _screenWidth);
         glUniform1f(glGetUniformLocation(_program, "u_screenHeight"), _screenHeight);
+        glUniform1i(glGetUniformLocation(_program, "u_kernelSize"), _kernelSize);
+        glUniform1i(glGetUniformLocation(_program, "u_kernelOffset"), _kernelOffset);
+        glUniform1f(glGetUniformLocation(_program, "u_noiseAngle"), _noiseAngle);
         glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
 
 
@@ -673,8 +816,76 @@ void DrawableMesh::drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLui
 
 
 
+void DrawableMesh::drawScreenQuadHiZ(GLuint _program, GLuint _srcTex, bool _isFirstLevel)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind texture
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _srcTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_srcTex"), 0);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniform1i(glGetUniformLocation(_program, "u_isFirstLevel"), _isFirstLevel ? 1 : 0);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
+void DrawableMesh::drawScreenQuadGTAO(GLuint _program, glm::mat4& _projMat, GLuint _hiZTex, GLuint _depthTex, GLuint _normalTex, float _radius, int _numLevels,
+                                      int _numDirections, int _frameIndex)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _hiZTex);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, _normalTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_hiZTex"), 0);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 1);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 2);
+        glUniform1f(glGetUniformLocation(_program, "u_radius"), _radius);
+        glUniform1i(glGetUniformLocation(_program, "u_numLevels"), _numLevels);
+        glUniform1i(glGetUniformLocation(_program, "u_numDirections"), _numDirections);
+        glUniform1i(glGetUniformLocation(_program, "u_frameIndex"), _frameIndex);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
 void DrawableMesh::drawScreenQuadSSLR(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
-                                      GLuint _posTex, GLuint _normalTex, GLuint _screenTex, float _radius, float _screenWidth, float _screenHeight)
+                                      GLuint _depthTex, GLuint _normalTex, GLuint _screenTex, float _radius, float _screenWidth, float _screenHeight,
+                                      int _kernelSize, int _kernelOffset, float _noiseAngle)
 {
         // Activate program
         glUseProgram(_program);
@@ -684,7 +895,7 @@ void DrawableMesh::drawScreenQuadSSLR(GLuint _program, glm::mat4& _modelMat, glm
         glBindTexture(GL_TEXTURE_2D, m_noiseTex);
 
         glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, _posTex);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
 
         glActiveTexture(GL_TEXTURE2);
         glBindTexture(GL_TEXTURE_2D, _normalTex);
@@ -706,17 +917,23 @@ void DrawableMesh::drawScreenQuadSSLR(GLuint _program, glm::mat4& _modelMat, glm
         }     
  
         glUniform1i(glGetUniformLocation(_program, "u_noiseTex"), 0);
-        glUniform1i(glGetUniformLocation(_program, "u_posTex"), 1);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 1);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
         glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 2);
         glUniform1i(glGetUniformLocation(_program, "u_cubemap"), 3);
         glUniform1i(glGetUniformLocation(_program, "u_screenTex"), 4);
 
-        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matV"), 1, GL_FALSE, &_viewMat[0][0]);
+        // inverse view matrix computed once, not per fragment and sample
+        glm::mat4 invViewMat = glm::inverse(_viewMat);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvV"), 1, GL_FALSE, &invViewMat[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
 
         glUniform1f(glGetUniformLocation(_program, "u_radius"), _radius);
         glUniform1f(glGetUniformLocation(_program, "u_screenWidth"), _screenWidth);
         glUniform1f(glGetUniformLocation(_program, "u_screenHeight"), _screenHeight);
+        glUniform1i(glGetUniformLocation(_program, "u_kernelSize"), _kernelSize);
+        glUniform1i(glGetUniformLocation(_program, "u_kernelOffset"), _kernelOffset);
+        glUniform1f(glGetUniformLocation(_program, "u_noiseAngle"), _noiseAngle);
 
 
         // Draw!
@@ -732,8 +949,56 @@ void DrawableMesh::drawScreenQuadSSLR(GLuint _program, glm::mat4& _modelMat, glm
 }
 
 
+void DrawableMesh::drawScreenQuadSSR(GLuint _program, glm::mat4& _projMat, GLuint _hiZTex, GLuint _depthTex, GLuint _normalTex, GLuint _colorTex, GLuint _screenTex,
+                                     float _maxDistance, int _numLevels, int _numScreenLevels)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _hiZTex);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, _normalTex);
+
+        glActiveTexture(GL_TEXTURE3);
+        glBindTexture(GL_TEXTURE_2D, _screenTex);
+
+        glActiveTexture(GL_TEXTURE4);
+        glBindTexture(GL_TEXTURE_2D, _colorTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_hiZTex"), 0);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 1);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 2);
+        glUniform1i(glGetUniformLocation(_program, "u_screenTex"), 3);
+        glUniform1i(glGetUniformLocation(_program, "u_colorTex"), 4);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
+        glUniform1f(glGetUniformLocation(_program, "u_maxDistance"), _maxDistance);
+        glUniform1i(glGetUniformLocation(_program, "u_numLevels"), _numLevels);
+        glUniform1i(glGetUniformLocation(_program, "u_numScreenLevels"), _numScreenLevels);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
 void DrawableMesh::drawScreenQuadFinal(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
-                                       GLuint _ssaotex, GLuint _screenTex, int _occType)
+                                       GLuint _ssaotex, GLuint _screenTex, int _occType,
+                                       GLuint _depthTex, GLuint _normalTex, GLuint _lowDepthTex, GLuint _lowNormalTex)
 {
         // Activate program
         glUseProgram(_program);
@@ -769,6 +1034,130 @@ void DrawableMesh::drawScreenQuadFinal(GLuint _program, glm::mat4& _modelMat, gl
 
         glUniform1i(glGetUniformLocation(_program, "u_occlusion_type"), _occType); 
 
+        // joint bilateral upsampling of reduced resolution SSAO
+        bool isUpsampleOn = (_lowDepthTex != 0);
+        if(isUpsampleOn)
+        {
+            GLuint geomTex[4] = { _depthTex, _normalTex, _lowDepthTex, _lowNormalTex };
+            for(int t = 0; t < 4; t++)
+            {
+                glActiveTexture(GL_TEXTURE2 + t);
+                glBindTexture(GL_TEXTURE_2D, geomTex[t]);
+            }
+        }
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 2);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 3);
+        glUniform1i(glGetUniformLocation(_program, "u_lowDepthTex"), 4);
+        glUniform1i(glGetUniformLocation(_program, "u_lowNormalTex"), 5);
+        glUniform1i(glGetUniformLocation(_program, "u_isUpsampleOn"), isUpsampleOn ? 1 : 0);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
+void DrawableMesh::drawScreenQuadDownsample(GLuint _program, GLuint _depthTex, GLuint _normalTex, int _factor)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, _normalTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 0);
+        glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 1);
+        glUniform1i(glGetUniformLocation(_program, "u_factor"), _factor);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
+void DrawableMesh::drawScreenQuadBilateral(GLuint _program, GLuint _aoTex, GLuint _depthTex, GLuint _normalTex, bool _isGaussH, int _filterWidth)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _aoTex);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, _normalTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_aoTex"), 0);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 1);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniform1i(glGetUniformLocation(_program, "u_normalTex"), 2);
+        glUniform1i(glGetUniformLocation(_program, "isFilterH"), _isGaussH ? 1 : 0);
+        glUniform1i(glGetUniformLocation(_program, "filterSize"), _filterWidth);
+
+        // Draw!
+        glBindVertexArray(m_meshVAO);                       // bind the VAO
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+        glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+        glBindVertexArray(m_defaultVAO);
+
+
+        glUseProgram(0);
+}
+
+
+void DrawableMesh::drawScreenQuadTemporal(GLuint _program, GLuint _currentTex, GLuint _historyTex, GLuint _depthTex, glm::mat4& _reprojMat, glm::mat4& _viewProjMat, glm::mat4& _prevViewProjMat,
+                                          float _blendFactor, bool _isHistoryValid)
+{
+        // Activate program
+        glUseProgram(_program);
+
+        // bind textures
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, _currentTex);
+
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, _historyTex);
+
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, _depthTex);
+
+        // Pass uniforms
+        glUniform1i(glGetUniformLocation(_program, "u_currentTex"), 0);
+        glUniform1i(glGetUniformLocation(_program, "u_historyTex"), 1);
+        glUniform1i(glGetUniformLocation(_program, "u_depthTex"), 2);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matInvVP"), 1, GL_FALSE, &m_gBufferInvViewProj[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matReproj"), 1, GL_FALSE, &_reprojMat[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matVP"), 1, GL_FALSE, &_viewProjMat[0][0]);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matPrevVP"), 1, GL_FALSE, &_prevViewProjMat[0][0]);
+        glUniform1f(glGetUniformLocation(_program, "u_blendFactor"), _blendFactor);
+        glUniform1i(glGetUniformLocation(_program, "u_isHistoryValid"), _isHistoryValid ? 1 : 0);
+
         // Draw!
         glBindVertexArray(m_meshVAO);                       // bind the VAO
         glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
@@ -796,6 +1185,8 @@ void DrawableMesh::drawTex(GLuint _program, glm::mat4& _modelMat, glm::mat4& _vi
         glUniformMatrix4fv(glGetUniformLocation(_program, "u_matM"), 1, GL_FALSE, &_modelMat[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(_program, "u_matV"), 1, GL_FALSE, &_viewMat[0][0]);
         glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
+        glm::mat4 mvp = modelViewProjection(_modelMat, _viewMat, _projMat);
+        glUniformMatrix4fv(glGetUniformLocation(_program, "u_matMVP"), 1, GL_FALSE, &mvp[0][0]);
 
  
        // glUniform1i(glGetUniformLocation(m_program, "u_albedoTex"), 0);
@@ -841,6 +1232,35 @@ void DrawableMesh::drawShadow(GLuint _program, glm::mat4& _lvp)
 }
 
 
+void DrawableMesh::drawDepth(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat)
+{
+    // same vertex transformation as the shadow map, from the camera
+    glm::mat4 mvp = modelViewProjection(_modelMat, _viewMat, _projMat);
+    drawShadow(_program, mvp);
+}
+
+
+void DrawableMesh::drawShadowMoments(GLuint _program, glm::mat4& _lvp, int _method)
+{
+    // Activate program
+    glUseProgram(_program);
+
+    // Pass uniforms
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_lvp"), 1, GL_FALSE, &_lvp[0][0]);
+    glUniform1i(glGetUniformLocation(_program, "u_shadowMethod"), _method);
+
+    // Draw!
+    glBindVertexArray(m_meshVAO);                       // bind the VAO
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, m_indexVBO);  // do not forget to bind the index buffer AFTER !
+
+    glDrawElements(GL_TRIANGLES, m_numIndices, GL_UNSIGNED_INT, 0);
+
+    glBindVertexArray(m_defaultVAO);
+
+    glUseProgram(0);
+}
+
+
 void DrawableMesh::drawGbuffer(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat, bool _isFloor)
 {
     // Activate program
@@ -850,6 +1270,36 @@ void DrawableMesh::drawGbuffer(GLuint _program, glm::mat4& _modelMat, glm::mat4&
     glUniformMatrix4fv(glGetUniformLocation(_program, "u_matM"), 1, GL_FALSE, &_modelMat[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(_program, "u_matV"), 1, GL_FALSE, &_viewMat[0][0]);
     glUniformMatrix4fv(glGetUniformLocation(_program, "u_matP"), 1, GL_FALSE, &_projMat[0][0]);
+    glm::mat4 mvp = modelViewProjection(_modelMat, _viewMat, _projMat);
+    glUniformMatrix4fv(glGetUniformLocation(_program, "u_matMVP"), 1, GL_FALSE, &mvp[0][0]);
+
+    // material textures, on the same units as in draw()
+    if(m_useAlbedoTex)
+    {
+        glActiveTexture(GL_TEXTURE0);
+        glBindTexture(GL_TEXTURE_2D, m_albedoTex);
+    }
+    if(m_useNormalMap)
+    {
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_normalMap);
+    }
+    if(m_usePBR || m_useAmbMap)
+    {
+        glActiveTexture(GL_TEXTURE2);
+        glBindTexture(GL_TEXTURE_2D, m_ormMap);
+    }
+    glUniform1i(glGetUniformLocation(_program, "u_albedoTex"), 0);
+    glUniform1i(glGetUniformLocation(_program, "u_normalMap"), 1);
+    glUniform1i(glGetUniformLocation(_program, "u_ormMap"), 2);
+    glUniform1i(glGetUniformLocation(_program, "u_useAlbedoTex"), m_useAlbedoTex ? 1 : 0);
+    glUniform1i(glGetUniformLocation(_program, "u_useNormalMap"), m_useNormalMap ? 1 : 0);
+    glUniform1i(glGetUniformLocation(_program, "u_usePBR"), m_usePBR ? 1 : 0);
+    glUniform1i(glGetUniformLocation(_program, "u_useAmbMap"), m_useAmbMap ? 1 : 0);
+    glUniform1i(glGetUniformLocation(_program, "u_useVertexAO"), m_useVertexAO ? 1 : 0);
+    glUniform3fv(glGetUniformLocation(_program, "u_diffuseColor"), 1, &m_diffuseColor[0]);
+    glUniform3fv(glGetUniformLocation(_program, "u_specularColor"), 1, &m_specularColor[0]);
+    glUniform1f(glGetUniformLocation(_program, "u_specularPower"), m_specPow);
 
     if(_isFloor)
         glUniform1i(glGetUniformLocation(_program, "isFloor"), 1);
@@ -900,6 +1350,91 @@ GLuint DrawableMesh::load2DTexture(const std::string& _filename, bool _repeat)
 }
 
 
+void DrawableMesh::loadMaterial(const PBRMaterial& _material, const std::string& _dirname)
+{
+    if(!_material.albedoMap.empty())
+        loadAlbedoTex(_dirname + _material.albedoMap);
+    if(!_material.normalMap.empty())
+        loadNormalMap(_dirname + _material.normalMap);
+
+    // pack the grayscale maps into a single texture
+    m_ormMap = loadORMTexture( _material.ambientMap.empty() ? "" : _dirname + _material.ambientMap, 
+                               _material.roughnessMap.empty() ? "" : _dirname + _material.roughnessMap, 
+                               _material.metalMap.empty() ? "" : _dirname + _material.metalMap );
+}
+
+
+GLuint DrawableMesh::loadORMTexture(const std::string& _aoFilename, const std::string& _roughFilename, const std::string& _metalFilename)
+{
+    const std::string filenames[3] = { _aoFilename, _roughFilename, _metalFilename };
+    const stbi_uc defaultValues[3] = { 255, 255, 0 };   // no occlusion, fully rough, not metallic
+
+    // load each map as a single channel image
+    stbi_uc* data[3] = { nullptr, nullptr, nullptr };
+    int widths[3] = { 0, 0, 0 }, heights[3] = { 0, 0, 0 };
+    int width = 0, height = 0;
+    for (unsigned int i = 0; i < 3; ++i) 
+    {
+        if(filenames[i].empty())
+            continue;
+
+        int nbChannels;
+        data[i] = stbi_load(filenames[i].c_str(), &widths[i], &heights[i], &nbChannels, STBI_grey);
+        if (!data[i]) 
+        {
+            errorLog() << "DrawableMesh::loadORMTexture(): failed to load texture image " << filenames[i];
+            continue;
+        }
+        // the first available map defines the size of the packed texture
+        if(width == 0)
+        {
+            width = widths[i];
+            height = heights[i];
+        }
+    }
+
+    if(width == 0)
+        return 0;
+
+    // interleave maps into RGB texels (resample with nearest neighbor if sizes do not match)
+    std::vector<stbi_uc> packed(width * height * 3);
+    for (unsigned int i = 0; i < 3; ++i) 
+    {
+        for (int y = 0; y < height; ++y) 
+        {
+            for (int x = 0; x < width; ++x) 
+            {
+                stbi_uc value = defaultValues[i];
+                if(data[i])
+                {
+                    int srcX = (x * widths[i]) / width;
+                    int srcY = (y * heights[i]) / height;
+                    value = data[i][srcY * widths[i] + srcX];
+                }
+                packed[(y * width + x) * 3 + i] = value;
+            }
+        }
+        if(data[i])
+            stbi_image_free(data[i]);
+    }
+
+    GLuint texture;
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT );  
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT ); 
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    // RGB rows are not necessarily 4-bytes aligned
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB8, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, packed.data());
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    return texture;
+}
+
+
 GLuint DrawableMesh::loadCubemap(const std::string& _dirname)
 {
     bool isValid = true;
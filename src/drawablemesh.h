@@ -31,6 +31,24 @@ enum AttributeLocation
 
 
 
+/*!
+* \struct PBRMaterial
+* \brief Material descriptor of a PBR model: file names of its texture maps (relative to a texture directory).
+* Roughness, metalness and ambient occlusion maps are grayscale: they are packed together into
+* a single ORM texture (R = occlusion, G = roughness, B = metalness) when the material is loaded.
+* An empty file name means the map is not provided.
+*/
+struct PBRMaterial
+{
+    std::string albedoMap;      /*!< albedo (base color) map */
+    std::string normalMap;      /*!< tangent-space normal map */
+    std::string roughnessMap;   /*!< roughness (gloss) map */
+    std::string metalMap;       /*!< metalness map */
+    std::string ambientMap;     /*!< ambient occlusion map */
+};
+
+
+
 /*!
 * \class DrawableMesh
 * \brief Drawable mesh
@@ -73,13 +91,49 @@ class DrawableMesh
         /*! \fn setAmbientColor */
         inline void setSpecularColor(int _r, int _g, int _b) { m_specularColor = glm::vec3( (float)_r/255.0f, (float)_g/255.0f, (float)_b/255.0f ); }
 
+        /*! \fn getSpecularPower */
+        inline float getSpecularPower() { return m_specPow; }
+        /*! \fn getDiffuseColor */
+        inline glm::vec3 getDiffuseColor() { return m_diffuseColor; }
+        /*! \fn getSpecularColor */
+        inline glm::vec3 getSpecularColor() { return m_specularColor; }
+
 
         /*! \fn setShadowMap */
         inline void setShadowMap(GLuint _shadowMap) { m_shadowMap = _shadowMap; }
+        /*! \fn setShadowMoments : filtered moment map used instead of the shadow map (none if _method is 0: PCF) */
+        inline void setShadowMoments(GLuint _momentMap, int _method) { m_momentMap = _momentMap; m_shadowMethod = _method; }
+        /*! \fn setLightClusters : local lights culled per cluster, read from texture buffers (none if _numLights is 0) */
+        inline void setLightClusters(GLuint _lightData, GLuint _clusters, GLuint _lightIndices, int _numLights, const glm::ivec3& _grid, const glm::vec2& _depthParams)
+        {
+            m_lightDataTex = _lightData;
+            m_clustersTex = _clusters;
+            m_lightIndicesTex = _lightIndices;
+            m_numLocalLights = _numLights;
+            m_clusterGrid = _grid;
+            m_clusterDepthParams = _depthParams;
+        }
+        /*! \fn setShadowCascades : cascaded shadow maps used instead of the shadow map (none if _numCascades is 0) */
+        inline void setShadowCascades(GLuint _cascadeMaps, int _numCascades, const glm::mat4* _matrices, const float* _splits)
+        {
+            m_cascadeMaps = _cascadeMaps;
+            m_cascadeMatrices.assign(_matrices, _matrices + _numCascades);
+            m_cascadeSplits.assign(_splits, _splits + _numCascades);
+        }
         /*! \fn setSSAOKernel */
         inline void setSSAOKernel(std::vector<glm::vec3> _ssaoKernel) { m_ssaoKernel = _ssaoKernel; }
         /*! \fn setNoiseTex */
         inline void setNoiseTex(GLuint _noiseTex) { m_noiseTex = _noiseTex; }
+        /*! \fn setGBufferViewProj : view-projection matrix the G-buffer was rendered with (positions are decoded from depth) */
+        inline void setGBufferViewProj(const glm::mat4& _viewProjMat) { m_gBufferInvViewProj = glm::inverse(_viewProjMat); }
+        /*! \fn setIBL */
+        inline void setIBL(GLuint _specularMap, GLuint _brdfLUT, const std::vector<glm::vec3>& _shCoeffs, int _numLevels)
+        {
+            m_iblSpecularMap = _specularMap;
+            m_iblBrdfLUT = _brdfLUT;
+            m_iblSHCoeffs = _shCoeffs;
+            m_iblNumLevels = _numLevels;
+        }
 
 
 
@@ -128,6 +182,13 @@ class DrawableMesh
                 warningLog() << "DrawableMesh::setAmbMapFlag(): No UV coords available";
             m_useAmbMap = _useAmbMap; 
         }
+        /*! \fn setVertexAOFlag */
+        inline void setVertexAOFlag(bool _useVertexAO) 
+        { 
+            if(!m_colorProvided && _useVertexAO)
+                warningLog() << "DrawableMesh::setVertexAOFlag(): No vertex colors available";
+            m_useVertexAO = _useVertexAO && m_colorProvided; 
+        }
         /*! \fn setShadowMapFlag */
         inline void setShadowMapFlag(bool _useShadowMap) { m_useShadowMap = _useShadowMap; }
         /*! \fn setUseGammaCorrecFlag */
@@ -138,6 +199,13 @@ class DrawableMesh
         inline void setSimTransmitFlag(bool _useSimTransmit) { m_useSimTransmit = _useSimTransmit; }
         /*! \fn setTSDFlag */
         inline void setTSDFlag(bool _useTSD) { m_useTSD = _useTSD; }
+        /*! \fn setIBLFlag */
+        inline void setIBLFlag(bool _useIBL) 
+        { 
+            m_useIBL = _useIBL && (m_iblSpecularMap != 0); 
+            if(_useIBL && m_iblSpecularMap == 0)
+                warningLog() << "DrawableMesh::setIBLFlag(): No IBL data available";
+        }
 
         /*! \fn getAmbientFlag */
         inline bool getAmbientFlag() { return m_useAmbient; }
@@ -157,6 +225,8 @@ class DrawableMesh
         inline bool getPBRFlag() { return m_usePBR; }
         /*! \fn getAmbMapFlag */
         inline bool getAmbMapFlag() { return m_useAmbMap; }
+        /*! \fn getVertexAOFlag */
+        inline bool getVertexAOFlag() { return m_useVertexAO; }
         /*! \fn getShadowMapFlag */
         inline bool getShadowMapFlag() { return m_useShadowMap; }
         /*! \fn getUseGammaCorrecFlag */
@@ -167,6 +237,8 @@ class DrawableMesh
         inline bool getSimTransmitFlag() { return m_useSimTransmit; }
         /*! \fn getTSDFlag */
         inline bool getTSDFlag() { return m_useTSD; }
+        /*! \fn getIBLFlag */
+        inline bool getIBLFlag() { return m_useIBL; }
 
 
         /*------------------------------------------------------------------------------------------------------------+
@@ -190,6 +262,20 @@ class DrawableMesh
         */
         void createQuadVAO(int _type, float _y = 0.0f, glm::vec3 _centerCoords = glm::vec3(0.0f), float _radScene = 0.0f);
 
+        /*!
+        * \fn quadGeometry
+        * \brief Vertices and normals of a quad (for floor or screen quad), as drawn by createQuadVAO() with indices
+        *        {0, 1, 2, 2, 3, 0}. Also used by the CPU reference renderer.
+        * \param _type : defines if the quad to build is a screen quad (=1) of a floor quad (=2)
+        * \param _y : Y coords of quad to build (for floor quad only) 
+        * \param _centerCoords : center of the scene (for floor quad only) 
+        * \param _radScene : Radius of the scene (for floor quad only) 
+        * \param _vertices : output vertex positions
+        * \param _normals : output vertex normals
+        */
+        static void quadGeometry(int _type, float _y, glm::vec3 _centerCoords, float _radScene,
+                                 std::vector<glm::vec3>& _vertices, std::vector<glm::vec3>& _normals);
+
         /*!
         * \fn createCubeVAO
         * \brief Create cube VAO and VBOs (for skybox).
@@ -227,6 +313,21 @@ class DrawableMesh
         void draw(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
                   glm::vec3& _lightPos, glm::vec3& _camPos, glm::vec3& _lightCol, glm::mat4& _lightMat, float _distLightMax);
 
+        /*!
+        * \fn drawDeferredLighting
+        * \brief Draw the screen quad, shading the surfaces stored in a G-buffer (deferred shading)
+        *        with the shadow maps, IBL and local lights of the mesh
+        * \param _program : shader program
+        * \param _gDepth : G-buffer depth texture (world positions are decoded from it, see setGBufferViewProj())
+        * \param _gNormal : G-buffer texture of the world normals (octahedral encoding)
+        * \param _gColor : G-buffer texture of the diffuse color (rgb) and roughness (a)
+        * \param _gSpecular : G-buffer texture of the base reflectivity F0 (rgb) and ambient occlusion (a)
+        * \param _modelMat, _viewMat, _projMat, _lightPos, _camPos, _lightCol, _lightMat, _distLightMax : see draw()
+        */
+        void drawDeferredLighting(GLuint _program, GLuint _gDepth, GLuint _gNormal, GLuint _gColor, GLuint _gSpecular,
+                                  glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
+                                  glm::vec3& _lightPos, glm::vec3& _camPos, glm::vec3& _lightCol, glm::mat4& _lightMat, float _distLightMax);
+
         /*!
         * \fn draw
         * \brief Draw a sky box with cube map for environment mapping
@@ -245,36 +346,85 @@ class DrawableMesh
         * \param _isBlurOn : true to activate Gaussian blur
         * \param _isGaussH : true for horizontal blur, false for vertical blur
         * \param _filterWidth : Guassian fildter width
+        * \param _isMasked : true to ignore texels with null alpha in the blur (TSD)
         */
-        void drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn, bool _isGaussH = true, int _filterWidth = 0 );
+        void drawScreenQuad(GLuint _program, GLuint _tex, bool _isBlurOn, bool _isGaussH = true, int _filterWidth = 0, bool _isMasked = true );
 
         /*!
         * \fn drawScreenQuadSSAO
-        * \brief Draw the screen quad, mapped with G-buffer (position and normal textures), and compute screen-space ambient occlusion
+        * \brief Draw the screen quad, mapped with G-buffer (depth and normal textures), and compute screen-space ambient occlusion
         * \param _program : shader program
         * \param _projMat :camera projection matrix
-        * \param _posTex : G-buffer position texture
+        * \param _depthTex : G-buffer depth texture
         * \param _normalTex : G-buffer normal texture
         * \param _radius : neighborhood radius for SSAO computation
         * \param _screenWidth, _screenHeight : window dimensions
+        * \param _kernelSize : number of kernel samples per fragment
+        * \param _kernelOffset : index of the first kernel sample (the kernel is used as a circular list of 64 samples)
+        * \param _noiseAngle : rotation of the noise pattern around the normal, in radians
+        */
+        void drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLuint _depthTex, GLuint _normalTex, float _radius, float _screenWidth, float _screenHeight,
+                                int _kernelSize = 40, int _kernelOffset = 0, float _noiseAngle = 0.0f);
+
+        /*!
+        * \fn drawScreenQuadHiZ
+        * \brief Draw the screen quad, writing one level of the hierarchical depth buffer
+        * \param _program : shader program
+        * \param _srcTex : G-buffer depth texture (first level), or Hi-Z texture restricted to the previous level
+        * \param _isFirstLevel : true to convert the G-buffer depth to linear depth, false to downsample the previous level (min depth)
+        */
+        void drawScreenQuadHiZ(GLuint _program, GLuint _srcTex, bool _isFirstLevel);
+
+        /*!
+        * \fn drawScreenQuadGTAO
+        * \brief Draw the screen quad, and compute horizon-based ambient occlusion (GTAO) by marching the Hi-Z buffer
+        * \param _program : shader program
+        * \param _projMat : camera projection matrix
+        * \param _hiZTex : hierarchical depth texture (linear depth, min of each block)
+        * \param _depthTex : G-buffer depth texture (same resolution as Hi-Z level 0)
+        * \param _normalTex : G-buffer normal texture
+        * \param _radius : occlusion radius, in view space
+        * \param _numLevels : number of Hi-Z levels
+        * \param _numDirections : number of slices per fragment
+        * \param _frameIndex : offset of the noise pattern (rotates the slices every frame), 0 for a fixed pattern
         */
-        void drawScreenQuadSSAO(GLuint _program, glm::mat4& _projMat, GLuint _posTex, GLuint _normalTex, float _radius, float _screenWidth, float _screenHeight);
+        void drawScreenQuadGTAO(GLuint _program, glm::mat4& _projMat, GLuint _hiZTex, GLuint _depthTex, GLuint _normalTex, float _radius, int _numLevels,
+                                int _numDirections = 4, int _frameIndex = 0);
 
         /*!
         * \fn drawScreenQuadSSLR
-        * \brief Draw the screen quad, mapped with G-buffer (position and normal textures), and compute screen-space light reflection
+        * \brief Draw the screen quad, mapped with G-buffer (depth and normal textures), and compute screen-space light reflection
         * \param _program : shader program
         * \param _modelMat : model matrix
         * \param _viewMat :camera view matrix
         * \param _projMat :camera projection matrix
-        * \param _posTex : G-buffer position texture
+        * \param _depthTex : G-buffer depth texture
         * \param _normalTex : G-buffer normal texture
         * \param _screenTex : screen-space scene rendering texture
         * \param _radius : neighborhood radius for SSLR computation
         * \param _screenWidth, _screenHeight : window dimensions
+        * \param _kernelSize, _kernelOffset, _noiseAngle : sample subset and noise rotation (see drawScreenQuadSSAO)
         */
         void drawScreenQuadSSLR(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
-                                GLuint _posTex, GLuint _normalTex, GLuint _screenTex, float _radius, float _screenWidth, float _screenHeight);
+                                GLuint _depthTex, GLuint _normalTex, GLuint _screenTex, float _radius, float _screenWidth, float _screenHeight,
+                                int _kernelSize = 40, int _kernelOffset = 0, float _noiseAngle = 0.0f);
+
+        /*!
+        * \fn drawScreenQuadSSR
+        * \brief Draw the screen quad, and compute screen-space reflections by ray marching the Hi-Z buffer
+        * \param _program : shader program
+        * \param _projMat : camera projection matrix
+        * \param _hiZTex : hierarchical depth texture (linear depth, min of each block)
+        * \param _depthTex : G-buffer depth texture (same resolution as Hi-Z level 0)
+        * \param _normalTex : G-buffer normal texture
+        * \param _colorTex : G-buffer diffuse color (rgb) and roughness (a) texture
+        * \param _screenTex : screen-space scene rendering texture, with mip levels (cone-filtered reflections)
+        * \param _maxDistance : maximum length of the reflected rays, in view space
+        * \param _numLevels : number of Hi-Z levels
+        * \param _numScreenLevels : number of mip levels of _screenTex
+        */
+        void drawScreenQuadSSR(GLuint _program, glm::mat4& _projMat, GLuint _hiZTex, GLuint _depthTex, GLuint _normalTex, GLuint _colorTex, GLuint _screenTex,
+                               float _maxDistance, int _numLevels, int _numScreenLevels);
 
         /*!
         * \fn drawScreenQuadFinal
@@ -286,9 +436,52 @@ class DrawableMesh
         * \param _ssaotex : SSAO or SSLR texture
         * \param _screenTex : screen-space scene rendering texture
         * \param _occType : 1 for SSAO, 2 for SSLR
+        * \param _depthTex, _normalTex : G-buffer depth and normal textures (reduced resolution SSAO only)
+        * \param _lowDepthTex, _lowNormalTex : downsampled depth and normal textures of the SSAO map, used for
+        *        joint bilateral upsampling (0 if SSAO is computed at full resolution)
         */
         void drawScreenQuadFinal(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
-                                 GLuint _ssaotex, GLuint _screenTex, int _occType );
+                                 GLuint _ssaotex, GLuint _screenTex, int _occType,
+                                 GLuint _depthTex = 0, GLuint _normalTex = 0, GLuint _lowDepthTex = 0, GLuint _lowNormalTex = 0 );
+
+        /*!
+        * \fn drawScreenQuadDownsample
+        * \brief Draw the screen quad, downsampling G-buffer depth and normal textures (closest fragment of each block).
+        *        The depth is written to the depth buffer of the target: the depth test must be enabled.
+        * \param _program : shader program
+        * \param _depthTex : G-buffer depth texture
+        * \param _normalTex : G-buffer normal texture
+        * \param _factor : downsampling factor (2 = half resolution, 4 = quarter resolution)
+        */
+        void drawScreenQuadDownsample(GLuint _program, GLuint _depthTex, GLuint _normalTex, int _factor);
+
+        /*!
+        * \fn drawScreenQuadBilateral
+        * \brief Draw the screen quad, with a depth and normal aware blur of the SSAO map
+        * \param _program : shader program
+        * \param _aoTex : SSAO texture to blur
+        * \param _depthTex : G-buffer depth texture (same resolution as _aoTex)
+        * \param _normalTex : normal texture (same resolution as _aoTex)
+        * \param _isGaussH : true for horizontal blur, false for vertical blur
+        * \param _filterWidth : filter half width, in texels
+        */
+        void drawScreenQuadBilateral(GLuint _program, GLuint _aoTex, GLuint _depthTex, GLuint _normalTex, bool _isGaussH, int _filterWidth);
+
+        /*!
+        * \fn drawScreenQuadTemporal
+        * \brief Draw the screen quad, blending a screen-space effect with its reprojected history (temporal accumulation)
+        * \param _program : shader program
+        * \param _currentTex : result of the current frame
+        * \param _historyTex : accumulated result of the previous frame (view depth in alpha)
+        * \param _depthTex : G-buffer depth texture (same resolution as _currentTex)
+        * \param _reprojMat : transformation from current to previous G-buffer positions (model matrices of both frames)
+        * \param _viewProjMat : view-projection matrix
+        * \param _prevViewProjMat : view-projection matrix of the previous frame
+        * \param _blendFactor : weight of the current frame
+        * \param _isHistoryValid : false to ignore the history (first frame, resize)
+        */
+        void drawScreenQuadTemporal(GLuint _program, GLuint _currentTex, GLuint _historyTex, GLuint _depthTex, glm::mat4& _reprojMat, glm::mat4& _viewProjMat, glm::mat4& _prevViewProjMat,
+                                    float _blendFactor, bool _isHistoryValid);
 
         /*!
         * \fn drawTex
@@ -309,9 +502,29 @@ class DrawableMesh
         */
         void drawShadow(GLuint _program, glm::mat4& _lvp);
 
+        /*!
+        * \fn drawDepth
+        * \brief Draw the content of the mesh VAO in the depth buffer only (depth pre-pass, with the shadow map shaders).
+        *        The clip space positions are the same as in draw(), drawGbuffer() and drawTex()
+        * \param _program : shader program
+        * \param _modelMat : model matrix
+        * \param _viewMat : camera view matrix
+        * \param _projMat : camera projection matrix
+        */
+        void drawDepth(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat);
+
+        /*!
+        * \fn drawShadowMoments
+        * \brief Draw the content of the mesh VAO into a moment shadow map (shadowMoments.frag)
+        * \param _program : shader program
+        * \param _lvp : light view-projection matrix
+        * \param _method : moments written (1: VSM, 2: EVSM, 3: MSM)
+        */
+        void drawShadowMoments(GLuint _program, glm::mat4& _lvp, int _method);
+
         /*!
         * \fn drawGbuffer
-        * \brief Draw the content of the mesh VAO for G-buffer generation
+        * \brief Draw the content of the mesh VAO for G-buffer generation (with the material parameters of deferred shading)
         * \param _program : shader program
         * \param _modelMat : model matrix
         * \param _viewMat :camera view matrix
@@ -333,23 +546,12 @@ class DrawableMesh
         */
         inline void loadNormalMap(const std::string& _filename) { m_normalMap = load2DTexture(_filename, true); }
         /*!
-        * \fn loadMetalMap
-        * \brief load the metal map (PBR) texture from a file
-        * \param _filename : name of texture image
-        */
-        inline void loadMetalMap(const std::string& _filename) { m_metalMap = load2DTexture(_filename, true); }
-        /*!
-        * \fn loadGlossMap
-        * \brief load the gloss mao (PBR) texture from a file
-        * \param _filename : name of texture image
-        */
-        inline void loadGlossMap(const std::string& _filename) { m_glossMap = load2DTexture(_filename, true); }
-        /*!
-        * \fn loadAmbientMap
-        * \brief load the ambient map texture from a file
-        * \param _filename : name of texture image
+        * \fn loadMaterial
+        * \brief load all the texture maps of a PBR material, packing roughness, metalness and AO into one ORM texture
+        * \param _material : material descriptor
+        * \param _dirname : directory of the texture images
         */
-        inline void loadAmbientMap(const std::string& _filename) { m_ambientMap = load2DTexture(_filename, true); }
+        void loadMaterial(const PBRMaterial& _material, const std::string& _dirname);
         /*!
         * \fn loadCubeMap
         * \brief load a set of cube maps (for environment mapping) from a directory
@@ -386,14 +588,29 @@ class DrawableMesh
 
         GLuint m_albedoTex;         /*!< index of albedo map texture */
         GLuint m_normalMap;         /*!< index of normal map texture */
-        GLuint m_metalMap;          /*!< index of metal map texture */
-        GLuint m_glossMap;          /*!< index of gloss map texture */
-        GLuint m_ambientMap;        /*!< index of ambient map texture */
+        GLuint m_ormMap;            /*!< index of packed occlusion (R) / roughness (G) / metalness (B) texture */
         GLuint m_cubeMap;           /*!< index of cube map texture */
         GLuint m_shadowMap;         /*!< index of shadow  map texture */
+        GLuint m_cascadeMaps;       /*!< index of cascaded shadow maps texture array */
+        GLuint m_momentMap;         /*!< index of filtered moment shadow map texture */
+        int m_shadowMethod;         /*!< shadow filtering: PCF on the shadow map = 0, VSM = 1, EVSM = 2, MSM = 3 */
+        GLuint m_lightDataTex;      /*!< index of local lights buffer texture */
+        GLuint m_clustersTex;       /*!< index of buffer texture of the offset and number of lights of each cluster */
+        GLuint m_lightIndicesTex;   /*!< index of buffer texture of the lights of all clusters */
+        int m_numLocalLights;       /*!< number of local lights (0 if off) */
+        glm::ivec3 m_clusterGrid;   /*!< number of clusters along x, y and depth */
+        glm::vec2 m_clusterDepthParams; /*!< log(depth) to depth slice scale and bias */
+        std::vector<glm::mat4> m_cascadeMatrices;   /*!< light view-projection matrix of each cascade (empty if no cascades) */
+        std::vector<float> m_cascadeSplits;         /*!< view depth of the far end of each cascade */
         GLuint m_noiseTex;          /*!< index of noise texture */
+        glm::mat4 m_gBufferInvViewProj; /*!< inverse view-projection matrix of the G-buffer (depth to position) */
         std::vector<glm::vec3> m_ssaoKernel;
 
+        GLuint m_iblSpecularMap;    /*!< index of IBL pre-filtered specular cube map texture */
+        GLuint m_iblBrdfLUT;        /*!< index of IBL BRDF look-up table texture */
+        std::vector<glm::vec3> m_iblSHCoeffs;   /*!< IBL diffuse irradiance SH coefficients */
+        int m_iblNumLevels;         /*!< number of mip levels (i.e. roughness values) of the pre-filtered cube map */
+
         float m_specPow;            /*!< specular power */
 
         glm::vec3 m_ambientColor;   /*!< ambient color */
@@ -408,6 +625,7 @@ class DrawableMesh
         bool m_useNormalMap;        /*!< flag to use normal mapping or not */
         bool m_usePBR;              /*!< flag to use PBR textures or not */
         bool m_useAmbMap;           /*!< flag to use ambient map or not */
+        bool m_useVertexAO;         /*!< flag to use ambient occlusion baked in the vertex colors (red channel) or not */
         bool m_useEnvMapReflec;     /*!< flag to use environment mapping reflection or not */
         bool m_useEnvMapRefrac;     /*!< flag to use environment mapping refraction or not */
         bool m_useShadowMap;        /*!< flag to use shadow mapping or not */
@@ -425,6 +643,7 @@ class DrawableMesh
 
         bool m_useSimTransmit;      /*!< flag to indicate if simulate light transmission is on */
         bool m_useTSD;              /*!< flag to indicate if texture space diffusion is on */
+        bool m_useIBL;              /*!< flag to use image-based ambient lighting or not */
 
         bool m_isLightDir;          /*!< flag to indicate if the light source is directional (true) or point (false) */
 
@@ -432,6 +651,15 @@ class DrawableMesh
         |                                               OTHER METHODS                                                 |
         +-------------------------------------------------------------------------------------------------------------*/
 
+        /*!
+        * \fn setLightingState
+        * \brief Bind the textures and set the uniforms of the lighting (shared by forward and deferred shading)
+        * \param _program : shader program (already in use)
+        * \param _modelMat, _viewMat, _projMat, _lightPos, _camPos, _lightCol, _lightMat, _distLightMax : see draw()
+        */
+        void setLightingState(GLuint _program, glm::mat4& _modelMat, glm::mat4& _viewMat, glm::mat4& _projMat,
+                              glm::vec3& _lightPos, glm::vec3& _camPos, glm::vec3& _lightCol, glm::mat4& _lightMat, float _distLightMax);
+
         /*!
         * \fn load2DTexture
         * \brief load a 2D image to be used as texture
@@ -447,5 +675,17 @@ class DrawableMesh
         */
         GLuint loadCubemap(const std::string& _dirname);
 
+        /*!
+        * \fn loadORMTexture
+        * \brief load grayscale occlusion, roughness and metalness images and pack them into the channels of a single texture.
+        *        Missing maps are replaced by a constant default value (AO = 1, roughness = 1, metalness = 0),
+        *        maps with a different size are resampled (nearest) to the size of the first available map.
+        * \param _aoFilename : name of ambient occlusion image (or empty string)
+        * \param _roughFilename : name of roughness image (or empty string)
+        * \param _metalFilename : name of metalness image (or empty string)
+        * \return texture index, 0 if no map could be loaded
+        */
+        GLuint loadORMTexture(const std::string& _aoFilename, const std::string& _roughFilename, const std::string& _metalFilename);
+
 };
 #endif // DRAWABLEMESH_H
\ No newline at end of file
@@ -0,0 +1,95 @@
+/*********************************************************************************************************************
+ *
+ * dynamicresolution.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "dynamicresolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// weight of the last frame in the moving average of frame times
+static const float SMOOTHING = 0.1f;
+// number of frames to wait after a scale change (timings are read back with 1-2 frames of latency, then smoothed)
+static const int SETTLE_FRAMES = 16;
+// the scale changes by multiples of this step
+static const float SCALE_STEP = 0.05f;
+// the scale is decreased above (budget * OVER_BUDGET), increased below (budget * UNDER_BUDGET), and aims at (budget * TARGET)
+static const float OVER_BUDGET = 1.05f;
+static const float UNDER_BUDGET = 0.8f;
+static const float TARGET = 0.9f;
+
+
+DynamicResolution::DynamicResolution(float _budget, float _minScale, float _maxScale)
+{
+    m_budget = _budget;
+    m_minScale = 0.1f;
+    m_maxScale = 1.0f;
+    m_scale = 1.0f;
+    setScaleRange(_minScale, _maxScale);
+    reset();
+}
+
+
+void DynamicResolution::setScaleRange(float _minScale, float _maxScale)
+{
+    m_minScale = std::clamp(_minScale, SCALE_STEP, 1.0f);
+    m_maxScale = std::clamp(_maxScale, m_minScale, 1.0f);
+    m_scale = std::clamp(m_scale, m_minScale, m_maxScale);
+}
+
+
+void DynamicResolution::setScale(float _scale)
+{
+    m_scale = std::clamp(_scale, m_minScale, m_maxScale);
+    reset();
+}
+
+
+void DynamicResolution::reset()
+{
+    m_smoothedTime = -1.0f;
+    m_numFrames = 0;
+}
+
+
+bool DynamicResolution::update(float _frameTime)
+{
+    if(_frameTime < 0.0f)
+        return false;
+
+    if(m_smoothedTime < 0.0f)
+        m_smoothedTime = _frameTime;
+    else
+        m_smoothedTime += SMOOTHING * (_frameTime - m_smoothedTime);
+
+    m_numFrames++;
+    if(m_numFrames < SETTLE_FRAMES || m_smoothedTime <= 0.0f)
+        return false;
+
+    bool isOverBudget = m_smoothedTime > m_budget * OVER_BUDGET && m_scale > m_minScale;
+    bool isUnderBudget = m_smoothedTime < m_budget * UNDER_BUDGET && m_scale < m_maxScale;
+    if(!isOverBudget && !isUnderBudget)
+        return false;
+
+    // pixel count (i.e. scale^2) proportional to the frame time. Rounding down keeps the predicted time under the
+    // target, so an increase is not followed by a decrease
+    float newScale = m_scale * std::sqrt(m_budget * TARGET / m_smoothedTime);
+    newScale = std::floor(newScale / SCALE_STEP + 0.01f) * SCALE_STEP;
+    // decrease by at least one step
+    if(isOverBudget)
+        newScale = std::min(newScale, m_scale - SCALE_STEP);
+    newScale = std::clamp(newScale, m_minScale, m_maxScale);
+
+    if(std::abs(newScale - m_scale) < 0.5f * SCALE_STEP || (isUnderBudget && newScale < m_scale))
+        return false;
+
+    m_scale = newScale;
+    reset();
+    return true;
+}
@@ -0,0 +1,111 @@
+/*********************************************************************************************************************
+ *
+ * dynamicresolution.h
+ *
+ * Internal resolution scale controller
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+
+
+/*!
+* \class DynamicResolution
+* \brief Adjust the internal resolution scale (ratio between render target size and window size) to keep the frame time
+*        under a budget. Frame times are smoothed, and the scale only changes by discrete steps after a few frames,
+*        so render targets are not reallocated every frame.
+*        Since the shading cost is mostly proportional to the number of pixels, the new scale is estimated as
+*        scale * sqrt(budget / frame time).
+*/
+class DynamicResolution
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn DynamicResolution
+        * \brief Constructor of DynamicResolution
+        * \param _budget : frame time budget, in ms
+        * \param _minScale : lowest resolution scale
+        * \param _maxScale : highest resolution scale
+        */
+        DynamicResolution(float _budget = 16.0f, float _minScale = 0.5f, float _maxScale = 1.0f);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getScale */
+        inline float getScale() { return m_scale; }
+        /*! \fn getBudget */
+        inline float getBudget() { return m_budget; }
+        /*! \fn getMinScale */
+        inline float getMinScale() { return m_minScale; }
+        /*! \fn getMaxScale */
+        inline float getMaxScale() { return m_maxScale; }
+        /*! \fn getSmoothedTime */
+        inline float getSmoothedTime() { return m_smoothedTime; }
+
+        /*! \fn setBudget */
+        inline void setBudget(float _budget) { m_budget = _budget; reset(); }
+
+        /*!
+        * \fn setScaleRange
+        * \brief Set the lowest and highest resolution scale (the current scale is clamped)
+        * \param _minScale : lowest scale, in ]0,1]
+        * \param _maxScale : highest scale, in [_minScale,1]
+        */
+        void setScaleRange(float _minScale, float _maxScale);
+
+        /*!
+        * \fn setScale
+        * \brief Force the resolution scale (e.g. fixed scale when the controller is off)
+        * \param _scale : resolution scale (clamped to the scale range)
+        */
+        void setScale(float _scale);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn update
+        * \brief Add the time of the last frame, and adapt the resolution scale if the budget is not met
+        *        (or if there is enough headroom to increase resolution)
+        * \param _frameTime : time of the last frame, in ms (ignored if negative)
+        * \return true if the scale has changed (render targets must be resized)
+        */
+        bool update(float _frameTime);
+
+        /*!
+        * \fn reset
+        * \brief Restart frame time smoothing (e.g. after a scene or settings change)
+        */
+        void reset();
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        float m_scale;              /*!< current resolution scale */
+        float m_budget;             /*!< frame time budget, in ms */
+        float m_minScale;           /*!< lowest resolution scale */
+        float m_maxScale;           /*!< highest resolution scale */
+        float m_smoothedTime;       /*!< exponential moving average of frame times, in ms (negative if no sample yet) */
+        int m_numFrames;            /*!< number of frames since the last scale change */
+};
+
+#endif // DYNAMICRESOLUTION_H
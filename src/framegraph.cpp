@@ -0,0 +1,373 @@
+/*********************************************************************************************************************
+ *
+ * framegraph.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "framegraph.h"
+
+#include "GLtools.h"
+
+#include <algorithm>
+
+
+FrameGraph::FrameGraph(RenderTargetPool& _pool) : m_pool(_pool)
+{
+}
+
+
+int FrameGraph::getNumCulledPasses()
+{
+    int count = 0;
+    for(Pass& pass : m_passes)
+        if(pass.isCulled)
+            count++;
+    return count;
+}
+
+
+GLuint FrameGraph::getTexture(int _resource, int _index)
+{
+    RenderTarget* target = m_resources[_resource].target;
+    if(target == nullptr || _index < 0 || _index >= target->desc.numColorTex)
+    {
+        errorLog() << "FrameGraph::getTexture(): target " << m_resources[_resource].name << " is not allocated";
+        return 0;
+    }
+    return target->colorTex[_index];
+}
+
+
+GLuint FrameGraph::getDepthTexture(int _resource)
+{
+    RenderTarget* target = m_resources[_resource].target;
+    if(target == nullptr || !target->desc.isDepthTexture)
+    {
+        errorLog() << "FrameGraph::getDepthTexture(): target " << m_resources[_resource].name << " has no depth texture";
+        return 0;
+    }
+    return target->depth;
+}
+
+
+void FrameGraph::reset()
+{
+    // targets still allocated (e.g. execute() not called) go back to the pool
+    for(Resource& resource : m_resources)
+        if(!resource.isImported)
+            m_pool.release(resource.target);
+
+    m_resources.clear();
+    m_passes.clear();
+    m_order.clear();
+}
+
+
+int FrameGraph::createTarget(const std::string& _name, const RenderTargetDesc& _desc)
+{
+    Resource resource;
+    resource.name = _name;
+    resource.desc = _desc;
+    resource.isImported = false;
+    resource.importedFBO = 0;
+    resource.target = nullptr;
+    resource.writer = -1;
+    resource.lastUse = -1;
+    m_resources.push_back(resource);
+    return (int)m_resources.size() - 1;
+}
+
+
+int FrameGraph::importTarget(const std::string& _name, GLuint _fbo, int _width, int _height, bool _hasDepth)
+{
+    RenderTargetDesc desc = { _width, _height, GL_RGBA8, 1, (GLenum)(_hasDepth ? GL_DEPTH_COMPONENT24 : GL_NONE), false, GL_LINEAR };
+    int resource = createTarget(_name, desc);
+    m_resources[resource].isImported = true;
+    m_resources[resource].importedFBO = _fbo;
+    return resource;
+}
+
+
+int FrameGraph::importTarget(const std::string& _name, RenderTarget* _target)
+{
+    int resource = createTarget(_name, _target->desc);
+    m_resources[resource].isImported = true;
+    m_resources[resource].importedFBO = _target->fbo;
+    m_resources[resource].target = _target;
+    return resource;
+}
+
+
+int FrameGraph::addPass(const std::string& _name, std::function<void()> _execute, bool _isFullscreen)
+{
+    Pass pass;
+    pass.name = _name;
+    pass.execute = _execute;
+    pass.output = -1;
+    pass.clearMask = 0;
+    pass.clearColor = glm::vec4(0.0f);
+    pass.isFullscreen = _isFullscreen;
+    pass.copySource = -1;
+    pass.isCulled = false;
+    m_passes.push_back(pass);
+    return (int)m_passes.size() - 1;
+}
+
+
+int FrameGraph::addCopyPass(const std::string& _name, int _src, int _dst, std::function<void()> _execute)
+{
+    int pass = addPass(_name, _execute, true);
+    m_passes[pass].copySource = _src;
+    read(pass, _src);
+    write(pass, _dst);
+    return pass;
+}
+
+
+void FrameGraph::read(int _pass, int _resource)
+{
+    std::vector<int>& reads = m_passes[_pass].reads;
+    if(std::find(reads.begin(), reads.end(), _resource) != reads.end())
+        return;
+
+    reads.push_back(_resource);
+    m_resources[_resource].readers.push_back(_pass);
+}
+
+
+void FrameGraph::write(int _pass, int _resource, GLbitfield _clearMask, const glm::vec4& _clearColor)
+{
+    Resource& resource = m_resources[_resource];
+    if(resource.writer != -1)
+    {
+        errorLog() << "FrameGraph::write(): target " << resource.name << " is already written by " << m_passes[resource.writer].name;
+        return;
+    }
+    if(m_passes[_pass].output != -1)
+    {
+        errorLog() << "FrameGraph::write(): pass " << m_passes[_pass].name << " already writes " << m_resources[m_passes[_pass].output].name;
+        return;
+    }
+
+    resource.writer = _pass;
+    m_passes[_pass].output = _resource;
+    m_passes[_pass].clearMask = _clearMask;
+    m_passes[_pass].clearColor = _clearColor;
+}
+
+
+void FrameGraph::elideCopies()
+{
+    for(int p = 0; p < (int)m_passes.size(); p++)
+    {
+        Pass& copy = m_passes[p];
+        if(copy.copySource == -1 || copy.output == -1)
+            continue;
+
+        Resource& src = m_resources[copy.copySource];
+        Resource& dst = m_resources[copy.output];
+        if(src.isImported || src.writer == -1 || src.readers.size() != 1)
+            continue;
+
+        // the producer must render at the destination size, with the buffers it needs
+        Pass& producer = m_passes[src.writer];
+        bool isSameSize = src.desc.width == dst.desc.width && src.desc.height == dst.desc.height;
+        bool needsDepth = src.desc.depthFormat != GL_NONE && !producer.isFullscreen;
+        if(!producer.isFullscreen && !isSameSize)
+            continue;
+        if(needsDepth && dst.desc.depthFormat == GL_NONE)
+            continue;
+        if(std::find(producer.reads.begin(), producer.reads.end(), copy.output) != producer.reads.end())
+            continue;
+
+        // producer writes the destination directly, source and copy are removed
+        producer.output = copy.output;
+        dst.writer = src.writer;
+        src.writer = -1;
+        src.readers.clear();
+        copy.reads.clear();
+        copy.output = -1;
+        copy.isCulled = true;
+    }
+}
+
+
+void FrameGraph::cullPasses()
+{
+    // passes writing imported targets are needed, as well as (recursively) the writers of the targets they read
+    std::vector<bool> isNeeded(m_passes.size(), false);
+    std::vector<int> stack;
+    for(int p = 0; p < (int)m_passes.size(); p++)
+        if(!m_passes[p].isCulled && m_passes[p].output != -1 && m_resources[m_passes[p].output].isImported)
+        {
+            isNeeded[p] = true;
+            stack.push_back(p);
+        }
+
+    while(!stack.empty())
+    {
+        int p = stack.back();
+        stack.pop_back();
+        for(int r : m_passes[p].reads)
+        {
+            int writer = m_resources[r].writer;
+            if(writer != -1 && !isNeeded[writer])
+            {
+                isNeeded[writer] = true;
+                stack.push_back(writer);
+            }
+        }
+    }
+
+    for(int p = 0; p < (int)m_passes.size(); p++)
+        if(!isNeeded[p])
+            m_passes[p].isCulled = true;
+}
+
+
+bool FrameGraph::compile()
+{
+    m_order.clear();
+
+    elideCopies();
+    cullPasses();
+
+    // topological sort (a pass runs after the writers of the targets it reads), declaration order among ready passes
+    int numPasses = (int)m_passes.size();
+    std::vector<int> numDependencies(numPasses, 0);
+    for(int p = 0; p < numPasses; p++)
+    {
+        if(m_passes[p].isCulled)
+            continue;
+        for(int r : m_passes[p].reads)
+        {
+            int writer = m_resources[r].writer;
+            // imported targets can be read without being written this frame (content kept from previous frames)
+            if(writer == -1 && !m_resources[r].isImported)
+                warningLog() << "FrameGraph::compile(): pass " << m_passes[p].name << " reads " << m_resources[r].name << " which is never written";
+            else if(writer != p)
+                numDependencies[p]++;
+        }
+    }
+
+    std::vector<bool> isScheduled(numPasses, false);
+    int numActive = numPasses - getNumCulledPasses();
+    while((int)m_order.size() < numActive)
+    {
+        int next = -1;
+        for(int p = 0; p < numPasses && next == -1; p++)
+            if(!m_passes[p].isCulled && !isScheduled[p] && numDependencies[p] == 0)
+                next = p;
+
+        if(next == -1)
+        {
+            errorLog() << "FrameGraph::compile(): cycle between render passes";
+            m_order.clear();
+            return false;
+        }
+
+        isScheduled[next] = true;
+        m_order.push_back(next);
+
+        // readers of the output become ready once all their inputs are written
+        int output = m_passes[next].output;
+        if(output != -1)
+            for(int reader : m_resources[output].readers)
+                if(reader != next && !m_passes[reader].isCulled)
+                    numDependencies[reader]--;
+    }
+
+    // lifetime of the targets: from their writer to their last reader
+    for(Resource& resource : m_resources)
+        resource.lastUse = -1;
+    for(int i = 0; i < (int)m_order.size(); i++)
+    {
+        Pass& pass = m_passes[m_order[i]];
+        for(int r : pass.reads)
+            m_resources[r].lastUse = i;
+        if(pass.output != -1)
+            m_resources[pass.output].lastUse = std::max(m_resources[pass.output].lastUse, i);
+    }
+
+    return true;
+}
+
+
+void FrameGraph::execute(Profiler* _profiler)
+{
+    GLfloat prevClearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, prevClearColor);
+
+    for(int i = 0; i < (int)m_order.size(); i++)
+    {
+        Pass& pass = m_passes[m_order[i]];
+
+        if(pass.output != -1)
+        {
+            Resource& output = m_resources[pass.output];
+            if(!output.isImported && output.target == nullptr)
+                output.target = m_pool.acquire(output.desc);
+
+            glBindFramebuffer(GL_FRAMEBUFFER, output.isImported ? output.importedFBO : output.target->fbo);
+            glViewport(0, 0, output.desc.width, output.desc.height);
+
+            // the content of a recycled target is undefined: clear it only if the pass does not overwrite every pixel
+            if(pass.clearMask != 0)
+            {
+                glClearColor(pass.clearColor.x, pass.clearColor.y, pass.clearColor.z, pass.clearColor.w);
+                glClear(pass.clearMask);
+            }
+        }
+
+        if(pass.isFullscreen)
+            glDisable(GL_DEPTH_TEST);
+
+        if(_profiler)
+        {
+            ScopedPassTimer timer(*_profiler, pass.name);
+            pass.execute();
+        }
+        else
+            pass.execute();
+
+        if(pass.isFullscreen)
+            glEnable(GL_DEPTH_TEST);
+
+        // targets which are not read anymore go back to the pool (their memory can be used by the next passes)
+        for(Resource& resource : m_resources)
+            if(!resource.isImported && resource.target != nullptr && resource.lastUse <= i)
+                m_pool.release(resource.target);
+    }
+
+    glClearColor(prevClearColor[0], prevClearColor[1], prevClearColor[2], prevClearColor[3]);
+
+    // back to the final target
+    for(Resource& resource : m_resources)
+        if(resource.isImported)
+        {
+            glBindFramebuffer(GL_FRAMEBUFFER, resource.importedFBO);
+            glViewport(0, 0, resource.desc.width, resource.desc.height);
+            break;
+        }
+}
+
+
+void FrameGraph::writeSummary(std::ostream& _out)
+{
+    _out << "frame graph: " << m_order.size() << " passes (" << getNumCulledPasses() << " culled)" << std::endl;
+    for(int p : m_order)
+    {
+        Pass& pass = m_passes[p];
+        _out << "  " << pass.name << ":";
+        for(int r : pass.reads)
+            _out << " " << m_resources[r].name;
+        if(pass.output != -1)
+            _out << " -> " << m_resources[pass.output].name;
+        if(pass.clearMask != 0)
+            _out << " (clear)";
+        _out << std::endl;
+    }
+}
@@ -0,0 +1,256 @@
+/*********************************************************************************************************************
+ *
+ * framegraph.h
+ *
+ * Declarative scheduling of render passes and of their render targets
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef FRAMEGRAPH_H
+#define FRAMEGRAPH_H
+
+#include <GL/glew.h>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <ostream>
+
+#include "rendertargetpool.h"
+#include "profiler.h"
+
+
+
+/*!
+* \class FrameGraph
+* \brief Graph of the render passes of a frame.
+*        The graph is rebuilt every frame: each pass declares the targets it reads and the (single) target it writes,
+*        then compile() removes useless copies, culls the passes which do not contribute to an imported target (i.e.
+*        the final image), orders the remaining passes, and computes the lifetime of every transient target.
+*        execute() allocates transient targets from a RenderTargetPool just before their writer, binds and clears
+*        them only if the writer asks for it, and releases them after their last reader (so that targets whose
+*        lifetimes do not overlap share memory).
+*/
+class FrameGraph
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn FrameGraph
+        * \brief Constructor of FrameGraph
+        * \param _pool : pool providing the transient targets
+        */
+        FrameGraph(RenderTargetPool& _pool);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumPasses */
+        inline int getNumPasses() { return (int)m_passes.size(); }
+        /*! \fn getPassName */
+        inline const std::string& getPassName(int _pass) { return m_passes[_pass].name; }
+        /*! \fn isPassCulled */
+        inline bool isPassCulled(int _pass) { return m_passes[_pass].isCulled; }
+        /*! \fn getNumCulledPasses */
+        int getNumCulledPasses();
+
+        /*!
+        * \fn getTexture
+        * \brief Color texture of a target (valid while the passes are executed)
+        * \param _resource : target handle
+        * \param _index : index of the color texture
+        */
+        GLuint getTexture(int _resource, int _index = 0);
+
+        /*!
+        * \fn getDepthTexture
+        * \brief Depth texture of a target created with a depth texture (valid while the passes are executed)
+        * \param _resource : target handle
+        */
+        GLuint getDepthTexture(int _resource);
+
+        /*! \fn getDesc */
+        inline const RenderTargetDesc& getDesc(int _resource) { return m_resources[_resource].desc; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn reset
+        * \brief Remove all passes and targets (before declaring the passes of a new frame)
+        */
+        void reset();
+
+        /*!
+        * \fn createTarget
+        * \brief Declare a transient target, allocated from the pool only if a pass using it is executed
+        * \param _name : target name (for debugging)
+        * \param _desc : format and size
+        * \return target handle
+        */
+        int createTarget(const std::string& _name, const RenderTargetDesc& _desc);
+
+        /*!
+        * \fn importTarget
+        * \brief Declare an external target (e.g. default framebuffer). Passes writing imported targets are never culled.
+        * \param _name : target name (for debugging)
+        * \param _fbo : FBO id
+        * \param _width : width, in pixels
+        * \param _height : height, in pixels
+        * \param _hasDepth : the FBO has a depth buffer
+        * \return target handle
+        */
+        int importTarget(const std::string& _name, GLuint _fbo, int _width, int _height, bool _hasDepth);
+
+        /*!
+        * \fn importTarget
+        * \brief Declare a target kept across frames (e.g. history buffer), owned by the caller.
+        *        Passes writing it are never culled, and its textures can be read by the passes.
+        * \param _name : target name (for debugging)
+        * \param _target : target acquired from the pool by the caller
+        * \return target handle
+        */
+        int importTarget(const std::string& _name, RenderTarget* _target);
+
+        /*!
+        * \fn addPass
+        * \brief Declare a render pass
+        * \param _name : pass name (also used for timings)
+        * \param _execute : render function, called with the output target bound and the viewport set to its size
+        * \param _isFullscreen : the pass only draws screen quads: it is resolution independent, does not need depth
+        *                        testing, and overwrites all pixels (no clear needed)
+        * \return pass handle
+        */
+        int addPass(const std::string& _name, std::function<void()> _execute, bool _isFullscreen = false);
+
+        /*!
+        * \fn addCopyPass
+        * \brief Declare a pass copying (and rescaling) a target into another one.
+        *        The copy is removed if the producer of the source can directly write the destination.
+        * \param _name : pass name
+        * \param _src : source target
+        * \param _dst : destination target
+        * \param _execute : copy function (draws _src on a screen quad)
+        * \return pass handle
+        */
+        int addCopyPass(const std::string& _name, int _src, int _dst, std::function<void()> _execute);
+
+        /*!
+        * \fn read
+        * \brief Declare that a pass samples a target
+        * \param _pass : pass handle
+        * \param _resource : target handle
+        */
+        void read(int _pass, int _resource);
+
+        /*!
+        * \fn write
+        * \brief Declare the target rendered by a pass (a target has a single writer)
+        * \param _pass : pass handle
+        * \param _resource : target handle
+        * \param _clearMask : buffers to clear before the pass (0 if the pass overwrites every pixel)
+        * \param _clearColor : clear color
+        */
+        void write(int _pass, int _resource, GLbitfield _clearMask = 0, const glm::vec4& _clearColor = glm::vec4(0.0f));
+
+        /*!
+        * \fn compile
+        * \brief Remove useless copies, cull passes, order them and compute target lifetimes
+        * \return false if the graph is invalid (cycle)
+        */
+        bool compile();
+
+        /*!
+        * \fn execute
+        * \brief Execute the compiled passes. The first imported target is bound at the end.
+        * \param _profiler : profiler timing every pass (can be nullptr)
+        */
+        void execute(Profiler* _profiler);
+
+        /*!
+        * \fn writeSummary
+        * \brief Write the compiled passes, in execution order, with their inputs and output
+        * \param _out : output stream
+        */
+        void writeSummary(std::ostream& _out);
+
+
+    protected:
+
+        /*!
+        * \struct Resource
+        * \brief Target declared in the graph
+        */
+        struct Resource
+        {
+            std::string name;               /*!< target name */
+            RenderTargetDesc desc;          /*!< format and size (only size is used for imported targets) */
+            bool isImported;                /*!< external target, not allocated by the graph */
+            GLuint importedFBO;             /*!< FBO of the imported target */
+            RenderTarget* target;           /*!< target allocated from the pool (nullptr if not allocated, or imported FBO) */
+            int writer;                     /*!< pass writing the target (-1 if none) */
+            std::vector<int> readers;       /*!< passes reading the target */
+            int lastUse;                    /*!< position of the last pass using the target in the execution order */
+        };
+
+        /*!
+        * \struct Pass
+        * \brief Render pass declared in the graph
+        */
+        struct Pass
+        {
+            std::string name;                   /*!< pass name */
+            std::function<void()> execute;      /*!< render function */
+            std::vector<int> reads;             /*!< targets sampled by the pass */
+            int output;                         /*!< target written by the pass (-1 if none) */
+            GLbitfield clearMask;               /*!< buffers to clear before the pass */
+            glm::vec4 clearColor;               /*!< clear color */
+            bool isFullscreen;                  /*!< screen quad pass (resolution independent, no depth test) */
+            int copySource;                     /*!< source target if the pass is a copy (-1 otherwise) */
+            bool isCulled;                      /*!< pass removed by compile() */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        RenderTargetPool& m_pool;               /*!< pool providing the transient targets */
+        std::vector<Resource> m_resources;      /*!< declared targets */
+        std::vector<Pass> m_passes;             /*!< declared passes */
+        std::vector<int> m_order;               /*!< compiled execution order (indices of non-culled passes) */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn elideCopies
+        * \brief Redirect the producer of a copied target to the copy destination, when the copy is its only reader
+        *        and the producer can render at the destination size
+        */
+        void elideCopies();
+
+        /*!
+        * \fn cullPasses
+        * \brief Cull the passes that do not contribute to an imported target
+        */
+        void cullPasses();
+};
+
+#endif // FRAMEGRAPH_H
@@ -0,0 +1,522 @@
+/*********************************************************************************************************************
+ *
+ * iblbaker.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "iblbaker.h"
+#include "parallel.h"
+
+#include "GLtools.h"
+
+#include <fstream>
+#include <cstring>
+#include <cmath>
+
+#include <stb_image.h>
+
+
+
+static const float IBL_PI = 3.14159265359f;
+static const char IBL_CACHE_MAGIC[8] = { 'R', 'T', 'I', 'B', 'L', '0', '0', '2' };
+static const char* IBL_FACE_FILES[6] = { "posx.png", "negx.png", "posy.png", "negy.png", "posz.png", "negz.png" };
+
+
+namespace
+{
+    // FNV-1a hash of the content of the 6 face files of a cube map (0 if a face cannot be read), so the cache
+    // is rebaked when the images change, even with the same size
+    uint64_t hashFaceFiles(const std::string& _dirname)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        std::vector<char> buffer(1 << 16);
+        for(int f = 0; f < 6; f++)
+        {
+            std::ifstream file(_dirname + "/" + IBL_FACE_FILES[f], std::ios::binary);
+            if(!file.is_open())
+                return 0;
+            while(file.read(buffer.data(), buffer.size()) || file.gcount() > 0)
+            {
+                for(std::streamsize i = 0; i < file.gcount(); i++)
+                    hash = (hash ^ (unsigned char)buffer[i]) * 1099511628211ull;
+            }
+        }
+        return hash;
+    }
+
+    typedef std::vector<std::vector<std::vector<glm::vec3> > > CubeMipChain;   // [level][face][texel]
+
+    // Direction (not normalized) of the center of texel (_x, _y) of a cube map face, following GL conventions
+    glm::vec3 texelDirection(int _face, float _x, float _y, int _size)
+    {
+        float sc = 2.0f * (_x + 0.5f) / (float)_size - 1.0f;
+        float tc = 2.0f * (_y + 0.5f) / (float)_size - 1.0f;
+        switch(_face)
+        {
+            case 0:  return glm::vec3( 1.0f, -tc, -sc);   // +X
+            case 1:  return glm::vec3(-1.0f, -tc,  sc);   // -X
+            case 2:  return glm::vec3(  sc, 1.0f,  tc);   // +Y
+            case 3:  return glm::vec3(  sc,-1.0f, -tc);   // -Y
+            case 4:  return glm::vec3(  sc, -tc, 1.0f);   // +Z
+            default: return glm::vec3( -sc, -tc,-1.0f);   // -Z
+        }
+    }
+
+    // Face index and [0,1] face coordinates of a direction, following GL conventions
+    int directionToFace(const glm::vec3& _dir, float& _s, float& _t)
+    {
+        glm::vec3 a(std::abs(_dir.x), std::abs(_dir.y), std::abs(_dir.z));
+        int face;
+        float sc, tc, ma;
+        if(a.x >= a.y && a.x >= a.z)
+        {
+            ma = a.x;
+            face = _dir.x > 0.0f ? 0 : 1;
+            sc = _dir.x > 0.0f ? -_dir.z : _dir.z;
+            tc = -_dir.y;
+        }
+        else if(a.y >= a.z)
+        {
+            ma = a.y;
+            face = _dir.y > 0.0f ? 2 : 3;
+            sc = _dir.x;
+            tc = _dir.y > 0.0f ? _dir.z : -_dir.z;
+        }
+        else
+        {
+            ma = a.z;
+            face = _dir.z > 0.0f ? 4 : 5;
+            sc = _dir.z > 0.0f ? _dir.x : -_dir.x;
+            tc = -_dir.y;
+        }
+        _s = 0.5f * (sc / ma + 1.0f);
+        _t = 0.5f * (tc / ma + 1.0f);
+        return face;
+    }
+
+    // Bilinear lookup in one level of the cube map (clamped at face edges)
+    glm::vec3 sampleLevel(const CubeMipChain& _faces, int _level, int _size, const glm::vec3& _dir)
+    {
+        float s, t;
+        int face = directionToFace(_dir, s, t);
+        int size = std::max(1, _size >> _level);
+        float x = glm::clamp(s * size - 0.5f, 0.0f, (float)(size - 1));
+        float y = glm::clamp(t * size - 0.5f, 0.0f, (float)(size - 1));
+        int x0 = (int)x, y0 = (int)y;
+        int x1 = std::min(x0 + 1, size - 1), y1 = std::min(y0 + 1, size - 1);
+        float fx = x - x0, fy = y - y0;
+        const std::vector<glm::vec3>& tex = _faces[_level][face];
+        glm::vec3 top = glm::mix(tex[y0 * size + x0], tex[y0 * size + x1], fx);
+        glm::vec3 bottom = glm::mix(tex[y1 * size + x0], tex[y1 * size + x1], fx);
+        return glm::mix(top, bottom, fy);
+    }
+
+    // Trilinear lookup in the cube map mip chain
+    glm::vec3 sampleCube(const CubeMipChain& _faces, int _size, const glm::vec3& _dir, float _lod)
+    {
+        _lod = glm::clamp(_lod, 0.0f, (float)(_faces.size() - 1));
+        int l0 = (int)_lod;
+        int l1 = std::min(l0 + 1, (int)_faces.size() - 1);
+        return glm::mix(sampleLevel(_faces, l0, _size, _dir), sampleLevel(_faces, l1, _size, _dir), _lod - l0);
+    }
+
+    // Van der Corput radical inverse, for Hammersley low-discrepancy sequence
+    float radicalInverse(unsigned int _bits)
+    {
+        _bits = (_bits << 16u) | (_bits >> 16u);
+        _bits = ((_bits & 0x55555555u) << 1u) | ((_bits & 0xAAAAAAAAu) >> 1u);
+        _bits = ((_bits & 0x33333333u) << 2u) | ((_bits & 0xCCCCCCCCu) >> 2u);
+        _bits = ((_bits & 0x0F0F0F0Fu) << 4u) | ((_bits & 0xF0F0F0F0u) >> 4u);
+        _bits = ((_bits & 0x00FF00FFu) << 8u) | ((_bits & 0xFF00FF00u) >> 8u);
+        return (float)_bits * 2.3283064365386963e-10f;
+    }
+
+    // GGX importance sampling of the half vector around _N (roughness convention of header.frag: alpha = roughness)
+    glm::vec3 importanceSampleGGX(float _u, float _v, const glm::vec3& _N, float _a)
+    {
+        float phi = 2.0f * IBL_PI * _u;
+        float cosTheta = std::sqrt((1.0f - _v) / (1.0f + (_a * _a - 1.0f) * _v));
+        float sinTheta = std::sqrt(1.0f - cosTheta * cosTheta);
+        glm::vec3 H(std::cos(phi) * sinTheta, std::sin(phi) * sinTheta, cosTheta);
+
+        glm::vec3 up = std::abs(_N.z) < 0.999f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+        glm::vec3 tangent = glm::normalize(glm::cross(up, _N));
+        glm::vec3 bitangent = glm::cross(_N, tangent);
+        return glm::normalize(tangent * H.x + bitangent * H.y + _N * H.z);
+    }
+
+    float distributionGGX(float _NdotH, float _a)
+    {
+        float a2 = _a * _a;
+        float denom = _NdotH * _NdotH * (a2 - 1.0f) + 1.0f;
+        return a2 / (IBL_PI * denom * denom);
+    }
+
+    float geometrySchlickGGX(float _NdotV, float _k)
+    {
+        return _NdotV / (_NdotV * (1.0f - _k) + _k);
+    }
+
+    // Load the 6 faces of a cube map, convert them to linear RGB and build a box-filtered mip chain
+    bool loadCubeMipChain(const std::string& _dirname, CubeMipChain& _faces, int& _size)
+    {
+        // sRGB to linear conversion table (the GL cube map uses an sRGB internal format)
+        float toLinear[256];
+        for(int i = 0; i < 256; i++)
+            toLinear[i] = std::pow((float)i / 255.0f, 2.2f);
+
+        _faces.assign(1, std::vector<std::vector<glm::vec3> >(6));
+        _size = 0;
+        for (unsigned int f = 0; f < 6; ++f)
+        {
+            std::string filename = _dirname + "/" + IBL_FACE_FILES[f];
+            int width, height, nbChannels;
+            stbi_uc* data = stbi_load(filename.c_str(), &width, &height, &nbChannels, STBI_rgb);
+            if (!data || width != height || (_size != 0 && width != _size))
+            {
+                errorLog() << "IBLBaker::bake(): failed to load cube map face " << filename;
+                if(data)
+                    stbi_image_free(data);
+                return false;
+            }
+            _size = width;
+            std::vector<glm::vec3>& face = _faces[0][f];
+            face.resize(width * height);
+            for(int i = 0; i < width * height; i++)
+                face[i] = glm::vec3(toLinear[data[i*3]], toLinear[data[i*3+1]], toLinear[data[i*3+2]]);
+            stbi_image_free(data);
+        }
+
+        // 2x2 box filter down to 1x1
+        for(int size = _size / 2; size >= 1; size /= 2)
+        {
+            const std::vector<std::vector<glm::vec3> >& prev = _faces.back();
+            std::vector<std::vector<glm::vec3> > level(6, std::vector<glm::vec3>(size * size));
+            for (unsigned int f = 0; f < 6; ++f)
+            {
+                for(int y = 0; y < size; y++)
+                {
+                    for(int x = 0; x < size; x++)
+                    {
+                        int p = size * 2;
+                        level[f][y * size + x] = ( prev[f][(2*y) * p + 2*x]     + prev[f][(2*y) * p + 2*x + 1]
+                                                 + prev[f][(2*y + 1) * p + 2*x] + prev[f][(2*y + 1) * p + 2*x + 1] ) * 0.25f;
+                    }
+                }
+            }
+            _faces.push_back(level);
+        }
+        return true;
+    }
+}
+
+
+IBLBaker::IBLBaker()
+{
+    m_isValid = false;
+    m_specularSize = 128;
+    m_numLevels = 6;
+    m_lutSize = 64;
+    m_specularMap = 0;
+    m_brdfLUT = 0;
+}
+
+
+IBLBaker::~IBLBaker()
+{
+    if(m_specularMap)
+        glDeleteTextures(1, &m_specularMap);
+    if(m_brdfLUT)
+        glDeleteTextures(1, &m_brdfLUT);
+}
+
+
+bool IBLBaker::bake(const std::string& _dirname)
+{
+    m_isValid = false;
+
+    // check source size without decoding the whole cube map
+    int srcSize, srcHeight, nbChannels;
+    std::string firstFace = _dirname + "/posx.png";
+    if(!stbi_info(firstFace.c_str(), &srcSize, &srcHeight, &nbChannels))
+    {
+        errorLog() << "IBLBaker::bake(): cannot read " << firstFace;
+        return false;
+    }
+
+    std::string cacheFile = _dirname + "/ibl_cache.bin";
+    uint64_t srcHash = hashFaceFiles(_dirname);
+    if(readCache(cacheFile, srcSize, srcHash))
+    {
+        infoLog() << "IBLBaker::bake(): IBL data read from " << cacheFile;
+    }
+    else
+    {
+        infoLog() << "IBLBaker::bake(): baking IBL data for " << _dirname << " (" << getNumThreads() << " threads)";
+
+        CubeMipChain faces;
+        int size;
+        if(!loadCubeMipChain(_dirname, faces, size))
+            return false;
+
+        computeSH(faces, size);
+        computeSpecular(faces, size);
+        computeBRDFLut();
+        writeCache(cacheFile, srcSize, srcHash);
+    }
+
+    uploadTextures();
+    m_isValid = true;
+    return true;
+}
+
+
+void IBLBaker::computeSH(const std::vector<std::vector<std::vector<glm::vec3> > >& _faces, int _size)
+{
+    // project radiance on real SH basis (per source row, then reduce)
+    int numRows = 6 * _size;
+    std::vector<std::vector<glm::vec3> > rowCoeffs(numRows, std::vector<glm::vec3>(9, glm::vec3(0.0f)));
+
+    parallelFor(numRows, [&](unsigned int _row, unsigned int)
+    {
+        int face = _row / _size;
+        int y = _row % _size;
+        std::vector<glm::vec3>& c = rowCoeffs[_row];
+        for(int x = 0; x < _size; x++)
+        {
+            glm::vec3 d = texelDirection(face, (float)x, (float)y, _size);
+            // solid angle of the texel
+            float d2 = glm::dot(d, d);
+            float dOmega = (4.0f / ((float)_size * (float)_size)) / (d2 * std::sqrt(d2));
+            d = d / std::sqrt(d2);
+
+            glm::vec3 L = _faces[0][face][y * _size + x] * dOmega;
+            c[0] += L * 0.282095f;
+            c[1] += L * (0.488603f * d.y);
+            c[2] += L * (0.488603f * d.z);
+            c[3] += L * (0.488603f * d.x);
+            c[4] += L * (1.092548f * d.x * d.y);
+            c[5] += L * (1.092548f * d.y * d.z);
+            c[6] += L * (0.315392f * (3.0f * d.z * d.z - 1.0f));
+            c[7] += L * (1.092548f * d.x * d.z);
+            c[8] += L * (0.546274f * (d.x * d.x - d.y * d.y));
+        }
+    });
+
+    m_shCoeffs.assign(9, glm::vec3(0.0f));
+    for(int r = 0; r < numRows; r++)
+        for(int i = 0; i < 9; i++)
+            m_shCoeffs[i] += rowCoeffs[r][i];
+
+    // convolution with clamped cosine lobe (A0 = PI, A1 = 2PI/3, A2 = PI/4), divided by PI for Lambertian radiance
+    const float bandFactor[3] = { 1.0f, 2.0f / 3.0f, 0.25f };
+    for(int i = 0; i < 9; i++)
+        m_shCoeffs[i] *= bandFactor[i == 0 ? 0 : (i < 4 ? 1 : 2)];
+}
+
+
+void IBLBaker::computeSpecular(const std::vector<std::vector<std::vector<glm::vec3> > >& _faces, int _size)
+{
+    const unsigned int numSamples = 128;
+    m_specularData.assign(m_numLevels, std::vector<float>());
+
+    // solid angle of a texel of the first source level
+    float texelSolidAngle = 4.0f * IBL_PI / (6.0f * (float)_size * (float)_size);
+
+    for(int level = 0; level < m_numLevels; level++)
+    {
+        int size = std::max(1, m_specularSize >> level);
+        float roughness = (float)level / (float)(m_numLevels - 1);
+        std::vector<float>& data = m_specularData[level];
+        data.resize(6 * size * size * 3);
+
+        parallelFor(6 * size, [&](unsigned int _row, unsigned int)
+        {
+            int face = _row / size;
+            int y = _row % size;
+            for(int x = 0; x < size; x++)
+            {
+                // isotropic assumption: N = V = R
+                glm::vec3 N = glm::normalize(texelDirection(face, (float)x, (float)y, size));
+                glm::vec3 color(0.0f);
+
+                if(level == 0)
+                {
+                    // mirror reflection: resample source at the matching resolution
+                    color = sampleCube(_faces, _size, N, std::log2((float)_size / (float)size));
+                }
+                else
+                {
+                    float totalWeight = 0.0f;
+                    for(unsigned int i = 0; i < numSamples; i++)
+                    {
+                        glm::vec3 H = importanceSampleGGX((float)i / (float)numSamples, radicalInverse(i), N, roughness);
+                        glm::vec3 L = 2.0f * glm::dot(N, H) * H - N;
+                        float NdotL = glm::dot(N, L);
+                        if(NdotL > 0.0f)
+                        {
+                            // filtered importance sampling: pick source level from the sample solid angle
+                            float NdotH = std::max(glm::dot(N, H), 0.0f);
+                            float pdf = distributionGGX(NdotH, roughness) * 0.25f + 0.0001f;
+                            float sampleSolidAngle = 1.0f / ((float)numSamples * pdf);
+                            float lod = 0.5f * std::log2(sampleSolidAngle / texelSolidAngle) + 1.0f;
+
+                            color += sampleCube(_faces, _size, L, lod) * NdotL;
+                            totalWeight += NdotL;
+                        }
+                    }
+                    color /= std::max(totalWeight, 0.0001f);
+                }
+
+                int idx = ((face * size + y) * size + x) * 3;
+                data[idx] = color.x;
+                data[idx + 1] = color.y;
+                data[idx + 2] = color.z;
+            }
+        });
+    }
+}
+
+
+void IBLBaker::computeBRDFLut()
+{
+    const unsigned int numSamples = 256;
+    m_lutData.resize(m_lutSize * m_lutSize * 2);
+
+    parallelFor(m_lutSize, [&](unsigned int _row, unsigned int)
+    {
+        // rows: roughness, columns: N.V
+        float roughness = ((float)_row + 0.5f) / (float)m_lutSize;
+        float k = roughness * roughness * 0.5f;
+        for(int x = 0; x < m_lutSize; x++)
+        {
+            float NdotV = ((float)x + 0.5f) / (float)m_lutSize;
+            glm::vec3 V(std::sqrt(1.0f - NdotV * NdotV), 0.0f, NdotV);
+            glm::vec3 N(0.0f, 0.0f, 1.0f);
+
+            float A = 0.0f, B = 0.0f;
+            for(unsigned int i = 0; i < numSamples; i++)
+            {
+                glm::vec3 H = importanceSampleGGX((float)i / (float)numSamples, radicalInverse(i), N, roughness);
+                glm::vec3 L = 2.0f * glm::dot(V, H) * H - V;
+                float NdotL = std::max(L.z, 0.0f);
+                float NdotH = std::max(H.z, 0.0f);
+                float VdotH = std::max(glm::dot(V, H), 0.0f);
+                if(NdotL > 0.0f)
+                {
+                    float G = geometrySchlickGGX(NdotV, k) * geometrySchlickGGX(NdotL, k);
+                    float G_Vis = (G * VdotH) / (NdotH * NdotV);
+                    float Fc = std::pow(1.0f - VdotH, 5.0f);
+                    A += (1.0f - Fc) * G_Vis;
+                    B += Fc * G_Vis;
+                }
+            }
+            m_lutData[(_row * m_lutSize + x) * 2] = A / (float)numSamples;
+            m_lutData[(_row * m_lutSize + x) * 2 + 1] = B / (float)numSamples;
+        }
+    });
+}
+
+
+bool IBLBaker::readCache(const std::string& _filename, int _srcSize, uint64_t _srcHash)
+{
+    std::ifstream file(_filename, std::ios::binary);
+    if(!file.is_open())
+        return false;
+
+    char magic[8];
+    int header[4];
+    uint64_t srcHash;
+    file.read(magic, 8);
+    file.read((char*)header, sizeof(header));
+    file.read((char*)&srcHash, sizeof(srcHash));
+    if(!file || std::memcmp(magic, IBL_CACHE_MAGIC, 8) != 0 || header[0] != _srcSize || header[1] != m_specularSize
+       || header[2] != m_numLevels || header[3] != m_lutSize || srcHash != _srcHash)
+    {
+        warningLog() << "IBLBaker::readCache(): outdated cache " << _filename;
+        return false;
+    }
+
+    m_shCoeffs.resize(9);
+    file.read((char*)m_shCoeffs.data(), 9 * sizeof(glm::vec3));
+    m_specularData.assign(m_numLevels, std::vector<float>());
+    for(int level = 0; level < m_numLevels; level++)
+    {
+        int size = std::max(1, m_specularSize >> level);
+        m_specularData[level].resize(6 * size * size * 3);
+        file.read((char*)m_specularData[level].data(), m_specularData[level].size() * sizeof(float));
+    }
+    m_lutData.resize(m_lutSize * m_lutSize * 2);
+    file.read((char*)m_lutData.data(), m_lutData.size() * sizeof(float));
+
+    return (bool)file;
+}
+
+
+void IBLBaker::writeCache(const std::string& _filename, int _srcSize, uint64_t _srcHash)
+{
+    std::ofstream file(_filename, std::ios::binary);
+    if(!file.is_open())
+    {
+        warningLog() << "IBLBaker::writeCache(): cannot write " << _filename;
+        return;
+    }
+
+    int header[4] = { _srcSize, m_specularSize, m_numLevels, m_lutSize };
+    file.write(IBL_CACHE_MAGIC, 8);
+    file.write((const char*)header, sizeof(header));
+    file.write((const char*)&_srcHash, sizeof(_srcHash));
+    file.write((const char*)m_shCoeffs.data(), 9 * sizeof(glm::vec3));
+    for(int level = 0; level < m_numLevels; level++)
+        file.write((const char*)m_specularData[level].data(), m_specularData[level].size() * sizeof(float));
+    file.write((const char*)m_lutData.data(), m_lutData.size() * sizeof(float));
+}
+
+
+void IBLBaker::uploadTextures()
+{
+    const GLenum targets[] = {
+        GL_TEXTURE_CUBE_MAP_POSITIVE_X, GL_TEXTURE_CUBE_MAP_NEGATIVE_X,
+        GL_TEXTURE_CUBE_MAP_POSITIVE_Y, GL_TEXTURE_CUBE_MAP_NEGATIVE_Y,
+        GL_TEXTURE_CUBE_MAP_POSITIVE_Z, GL_TEXTURE_CUBE_MAP_NEGATIVE_Z
+    };
+
+    // pre-filtered specular cube map: one roughness value per mip level
+    if(!m_specularMap)
+        glGenTextures(1, &m_specularMap);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, m_specularMap);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_CUBE_MAP, GL_TEXTURE_MAX_LEVEL, m_numLevels - 1);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for(int level = 0; level < m_numLevels; level++)
+    {
+        int size = std::max(1, m_specularSize >> level);
+        for (unsigned int f = 0; f < 6; ++f)
+            glTexImage2D(targets[f], level, GL_RGB16F, size, size, 0, GL_RGB, GL_FLOAT, &m_specularData[level][f * size * size * 3]);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_CUBE_MAP, 0);
+
+    // split-sum BRDF look-up table
+    if(!m_brdfLUT)
+        glGenTextures(1, &m_brdfLUT);
+    glBindTexture(GL_TEXTURE_2D, m_brdfLUT);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RG16F, m_lutSize, m_lutSize, 0, GL_RG, GL_FLOAT, m_lutData.data());
+    glBindTexture(GL_TEXTURE_2D, 0);
+
+    // CPU copies are not needed anymore
+    m_specularData.clear();
+    m_lutData.clear();
+}
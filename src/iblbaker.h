@@ -0,0 +1,161 @@
+/*********************************************************************************************************************
+ *
+ * iblbaker.h
+ *
+ * CPU pre-computation of image-based lighting (IBL) data from an environment cube map
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef IBLBAKER_H
+#define IBLBAKER_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <cstdint>
+#include <vector>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+
+/*!
+* \class IBLBaker
+* \brief Bake image-based lighting data from a cube map (on multiple CPU threads):
+*        - diffuse irradiance projected on 9 spherical harmonics coefficients
+*        - GGX pre-filtered specular cube map (one mip level per roughness value)
+*        - split-sum BRDF look-up table (scale and bias applied to F0)
+* Results are cached in a binary file in the cube map directory, so the baking is only done once per environment.
+* Based on:
+*       R. Ramamoorthi and P. Hanrahan, "An Efficient Representation for Irradiance Environment Maps", SIGGRAPH 2001.
+*       B. Karis, "Real Shading in Unreal Engine 4", SIGGRAPH 2013 course.
+*       https://learnopengl.com/PBR/IBL/Specular-IBL
+*/
+class IBLBaker
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn IBLBaker
+        * \brief Default constructor of IBLBaker
+        */
+        IBLBaker();
+
+        /*!
+        * \fn ~IBLBaker
+        * \brief Destructor of IBLBaker: deletes the GL textures
+        */
+        ~IBLBaker();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn isValid */
+        inline bool isValid() { return m_isValid; }
+        /*! \fn getSHCoeffs */
+        inline const std::vector<glm::vec3>& getSHCoeffs() { return m_shCoeffs; }
+        /*! \fn getSpecularMap */
+        inline GLuint getSpecularMap() { return m_specularMap; }
+        /*! \fn getBRDFLut */
+        inline GLuint getBRDFLut() { return m_brdfLUT; }
+        /*! \fn getNumSpecularLevels */
+        inline int getNumSpecularLevels() { return m_numLevels; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn bake
+        * \brief Compute (or read from cache) the IBL data of a cube map, and upload them to GL textures
+        * \param _dirname : directory of the cube map images (posx.png, negx.png, ...)
+        * \return true if IBL data are available
+        */
+        bool bake(const std::string& _dirname);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        bool m_isValid;                         /*!< flag to indicate if IBL data are available */
+
+        std::vector<glm::vec3> m_shCoeffs;      /*!< 9 SH coefficients of diffuse irradiance (cosine lobe and 1/PI included) */
+
+        int m_specularSize;                     /*!< face size of the first level of the pre-filtered cube map */
+        int m_numLevels;                        /*!< number of levels in the pre-filtered cube map */
+        std::vector<std::vector<float> > m_specularData;   /*!< pre-filtered RGB texels, per level (6 faces each) */
+
+        int m_lutSize;                          /*!< size of the BRDF look-up table */
+        std::vector<float> m_lutData;           /*!< BRDF look-up table RG texels */
+
+        GLuint m_specularMap;                   /*!< index of pre-filtered specular cube map texture */
+        GLuint m_brdfLUT;                       /*!< index of BRDF look-up table texture */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn computeSH
+        * \brief Project the environment radiance onto the first 9 SH basis functions, and convolve with a cosine lobe
+        * \param _faces : linear RGB source mip chain, per level and per face
+        * \param _size : face size of the first source level
+        */
+        void computeSH(const std::vector<std::vector<std::vector<glm::vec3> > >& _faces, int _size);
+
+        /*!
+        * \fn computeSpecular
+        * \brief Pre-filter the environment with the GGX distribution, for increasing roughness values
+        * \param _faces : linear RGB source mip chain, per level and per face
+        * \param _size : face size of the first source level
+        */
+        void computeSpecular(const std::vector<std::vector<std::vector<glm::vec3> > >& _faces, int _size);
+
+        /*!
+        * \fn computeBRDFLut
+        * \brief Integrate the split-sum BRDF term as a function of N.V and roughness
+        */
+        void computeBRDFLut();
+
+        /*!
+        * \fn readCache
+        * \brief Read baked data from a cache file
+        * \param _filename : cache file name
+        * \param _srcSize : face size of the source cube map (to detect outdated caches)
+        * \param _srcHash : hash of the face files of the source cube map (to detect outdated caches)
+        * \return true if cache is valid
+        */
+        bool readCache(const std::string& _filename, int _srcSize, uint64_t _srcHash);
+
+        /*!
+        * \fn writeCache
+        * \brief Write baked data into a cache file
+        * \param _filename : cache file name
+        * \param _srcSize : face size of the source cube map
+        * \param _srcHash : hash of the face files of the source cube map
+        */
+        void writeCache(const std::string& _filename, int _srcSize, uint64_t _srcHash);
+
+        /*!
+        * \fn uploadTextures
+        * \brief Create (or replace) the GL textures from the baked data
+        */
+        void uploadTextures();
+
+};
+#endif // IBLBAKER_H
@@ -0,0 +1,168 @@
+/*********************************************************************************************************************
+ *
+ * imagediff.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "imagediff.h"
+#include "parallel.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+// D65 reference white
+static const float WHITE_X = 0.95047f;
+static const float WHITE_Y = 1.0f;
+static const float WHITE_Z = 1.08883f;
+
+
+// CIELAB non-linearity
+static float labCurve(float _t)
+{
+    const float delta = 6.0f / 29.0f;
+    if(_t > delta * delta * delta)
+        return std::cbrt(_t);
+    return _t / (3.0f * delta * delta) + 4.0f / 29.0f;
+}
+
+
+// convert a RGBA8 image (sRGB) to CIELAB, 3 floats per pixel
+static void toLab(const std::vector<unsigned char>& _image, size_t _numPixels, std::vector<float>& _lab)
+{
+    // sRGB decoding of the 256 possible values
+    float linear[256];
+    for(int i = 0; i < 256; i++)
+    {
+        float c = (float)i / 255.0f;
+        linear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+
+    _lab.resize(_numPixels * 3);
+    unsigned int numRows = (unsigned int)((_numPixels + 1023) / 1024);
+    parallelFor(numRows, [&](unsigned int _row, unsigned int)
+    {
+        size_t end = std::min(_numPixels, (size_t)(_row + 1) * 1024);
+        for(size_t p = (size_t)_row * 1024; p < end; p++)
+        {
+            float r = linear[_image[p * 4]], g = linear[_image[p * 4 + 1]], b = linear[_image[p * 4 + 2]];
+            float fx = labCurve((0.4124f * r + 0.3576f * g + 0.1805f * b) / WHITE_X);
+            float fy = labCurve((0.2126f * r + 0.7152f * g + 0.0722f * b) / WHITE_Y);
+            float fz = labCurve((0.0193f * r + 0.1192f * g + 0.9505f * b) / WHITE_Z);
+            _lab[p * 3] = 116.0f * fy - 16.0f;
+            _lab[p * 3 + 1] = 500.0f * (fx - fy);
+            _lab[p * 3 + 2] = 200.0f * (fy - fz);
+        }
+    });
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                        CONSTRUCTORS / DESTRUCTORS                                           |
++-------------------------------------------------------------------------------------------------------------*/
+
+ImageDiff::ImageDiff(float _threshold, int _searchRadius)
+{
+    m_threshold = _threshold;
+    m_searchRadius = std::max(0, _searchRadius);
+    m_numPixels = 0;
+    m_numDiffPixels = 0;
+    m_maxDeltaE = 0.0f;
+    m_meanDeltaE = 0.0f;
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               OTHER METHODS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+bool ImageDiff::compare(const std::vector<unsigned char>& _imageA, const std::vector<unsigned char>& _imageB, int _width, int _height)
+{
+    m_numPixels = 0;
+    m_numDiffPixels = 0;
+    m_maxDeltaE = 0.0f;
+    m_meanDeltaE = 0.0f;
+    m_diffImage.clear();
+
+    size_t numPixels = (size_t)std::max(0, _width) * std::max(0, _height);
+    if(numPixels == 0 || _imageA.size() < numPixels * 4 || _imageB.size() < numPixels * 4)
+        return false;
+
+    std::vector<float> labA, labB;
+    toLab(_imageA, numPixels, labA);
+    toLab(_imageB, numPixels, labB);
+
+    // smallest color difference between a pixel and the neighborhood of the same pixel in the other image
+    auto closestDistance = [&](const std::vector<float>& _lab, const std::vector<float>& _labOther, int _x, int _y)
+    {
+        const float* color = &_lab[((size_t)_y * _width + _x) * 3];
+        float minDist2 = -1.0f;
+        for(int y = std::max(0, _y - m_searchRadius); y <= std::min(_height - 1, _y + m_searchRadius); y++)
+        {
+            for(int x = std::max(0, _x - m_searchRadius); x <= std::min(_width - 1, _x + m_searchRadius); x++)
+            {
+                const float* other = &_labOther[((size_t)y * _width + x) * 3];
+                float dL = color[0] - other[0], da = color[1] - other[1], db = color[2] - other[2];
+                float dist2 = dL * dL + da * da + db * db;
+                if(minDist2 < 0.0f || dist2 < minDist2)
+                    minDist2 = dist2;
+            }
+        }
+        return std::sqrt(minDist2);
+    };
+
+    m_diffImage.resize(numPixels * 4);
+    std::vector<size_t> rowDiffPixels(_height, 0);
+    std::vector<float> rowMaxDeltaE(_height, 0.0f);
+    std::vector<double> rowSumDeltaE(_height, 0.0);
+    parallelFor((unsigned int)_height, [&](unsigned int _y, unsigned int)
+    {
+        int y = (int)_y;
+        for(int x = 0; x < _width; x++)
+        {
+            float deltaE = std::max(closestDistance(labA, labB, x, y), closestDistance(labB, labA, x, y));
+            rowMaxDeltaE[y] = std::max(rowMaxDeltaE[y], deltaE);
+            rowSumDeltaE[y] += deltaE;
+
+            size_t p = (size_t)y * _width + x;
+            unsigned char* pixel = &m_diffImage[p * 4];
+            if(deltaE > m_threshold)
+            {
+                // different pixels in red, brighter for larger differences
+                rowDiffPixels[y]++;
+                pixel[0] = (unsigned char)std::min(255.0f, 128.0f + deltaE * 4.0f);
+                pixel[1] = pixel[2] = 0;
+            }
+            else
+            {
+                // darkened lightness of the first image
+                pixel[0] = pixel[1] = pixel[2] = (unsigned char)(std::clamp(labA[p * 3], 0.0f, 100.0f) * 0.8f);
+            }
+            pixel[3] = 255;
+        }
+    });
+
+    double sumDeltaE = 0.0;
+    for(int y = 0; y < _height; y++)
+    {
+        m_numDiffPixels += rowDiffPixels[y];
+        m_maxDeltaE = std::max(m_maxDeltaE, rowMaxDeltaE[y]);
+        sumDeltaE += rowSumDeltaE[y];
+    }
+    m_numPixels = numPixels;
+    m_meanDeltaE = (float)(sumDeltaE / (double)numPixels);
+
+    return true;
+}
+
+
+void ImageDiff::writeSummary(std::ostream& _out)
+{
+    _out << "Image diff: " << m_numDiffPixels << " / " << m_numPixels << " pixels above Delta E " << m_threshold
+         << " (" << getDiffRatio() * 100.0f << " %), mean Delta E " << m_meanDeltaE << ", max " << m_maxDeltaE << std::endl;
+}
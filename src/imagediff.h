@@ -0,0 +1,99 @@
+/*********************************************************************************************************************
+ *
+ * imagediff.h
+ *
+ * Perceptual comparison of two images, for image-diff regression tests
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef IMAGEDIFF_H
+#define IMAGEDIFF_H
+
+#include <vector>
+#include <ostream>
+
+
+
+/*!
+* \class ImageDiff
+* \brief Compare two RGBA8 images (sRGB encoded) in the CIELAB color space: the difference of two pixels is their
+*        CIE76 color difference (Delta E, about 2.3 for a just noticeable difference).
+*        Rasterizers can differ by one pixel along the edges (sub-pixel precision, fill rules), so a pixel of one
+*        image is compared with the closest color in a small neighborhood of the other image, in both directions.
+*        A pixel is different if this distance is above the threshold, and the images match if the ratio of
+*        different pixels is below the tolerance.
+*/
+class ImageDiff
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn ImageDiff
+        * \brief Constructor of ImageDiff
+        * \param _threshold : Delta E above which two pixels are different
+        * \param _searchRadius : radius of the neighborhood searched in the other image (0: same pixel only)
+        */
+        ImageDiff(float _threshold = 2.3f, int _searchRadius = 1);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumDiffPixels */
+        inline size_t getNumDiffPixels() { return m_numDiffPixels; }
+        /*! \fn getDiffRatio : ratio of different pixels */
+        inline float getDiffRatio() { return m_numPixels > 0 ? (float)m_numDiffPixels / (float)m_numPixels : 0.0f; }
+        /*! \fn getMaxDeltaE */
+        inline float getMaxDeltaE() { return m_maxDeltaE; }
+        /*! \fn getMeanDeltaE */
+        inline float getMeanDeltaE() { return m_meanDeltaE; }
+        /*! \fn getDiffImage : RGBA8 image, the first image in grey and the different pixels in red */
+        inline const std::vector<unsigned char>& getDiffImage() { return m_diffImage; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn compare
+        * \brief Compare two images of the same size (the alpha channel is ignored)
+        * \param _imageA, _imageB : RGBA8 pixels
+        * \param _width, _height : image size
+        * \return false if the image sizes are not valid
+        */
+        bool compare(const std::vector<unsigned char>& _imageA, const std::vector<unsigned char>& _imageB, int _width, int _height);
+
+        /*!
+        * \fn writeSummary
+        * \brief Print the statistics of the last comparison
+        * \param _out : output stream
+        */
+        void writeSummary(std::ostream& _out);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        float m_threshold;                      /*!< Delta E above which two pixels are different */
+        int m_searchRadius;                     /*!< radius of the neighborhood searched in the other image */
+
+        size_t m_numPixels;                     /*!< number of compared pixels */
+        size_t m_numDiffPixels;                 /*!< number of different pixels */
+        float m_maxDeltaE;                      /*!< largest Delta E */
+        float m_meanDeltaE;                     /*!< average Delta E */
+        std::vector<unsigned char> m_diffImage; /*!< RGBA8 image of the differences */
+};
+
+#endif // IMAGEDIFF_H
@@ -0,0 +1,239 @@
+/*********************************************************************************************************************
+ *
+ * lightclusters.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "lightclusters.h"
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// number of floats of a light in the packed light data (3 RGBA texels)
+static const int LIGHT_DATA_SIZE = 12;
+
+
+
+// tightest sphere bounding the volume lit by a light (a spherical sector for a spot light)
+static void boundingSphere(const LocalLight& _light, glm::vec3& _center, float& _radius)
+{
+    // point light, or spot wider than a hemisphere: whole range
+    if(_light.cosOuter < 0.0f)
+    {
+        _center = _light.position;
+        _radius = _light.range;
+    }
+    else if(_light.cosOuter < 0.70710678f)
+    {
+        // wide cone: sphere through the circle at the end of the cone
+        _center = _light.position + _light.direction * (_light.range * _light.cosOuter);
+        _radius = _light.range * std::sqrt(1.0f - _light.cosOuter * _light.cosOuter);
+    }
+    else
+    {
+        // narrow cone: sphere through the apex and the circle at the end of the cone
+        _radius = _light.range / (2.0f * _light.cosOuter);
+        _center = _light.position + _light.direction * _radius;
+    }
+}
+
+
+
+LightClusters::LightClusters()
+{
+    m_clusters.assign(2 * getNumClusters(), 0);
+    m_sliceIndices.resize(GRID_Z);
+    m_depthParams = glm::vec2(0.0f);
+    m_maxLightsPerCluster = 0;
+}
+
+
+int LightClusters::getCluster(const glm::vec2& _ndc, float _viewDepth)
+{
+    int x = std::clamp((int)std::floor((_ndc.x * 0.5f + 0.5f) * (float)GRID_X), 0, GRID_X - 1);
+    int y = std::clamp((int)std::floor((_ndc.y * 0.5f + 0.5f) * (float)GRID_Y), 0, GRID_Y - 1);
+    int z = std::clamp((int)std::floor(std::log(std::max(_viewDepth, 1e-6f)) * m_depthParams.x + m_depthParams.y), 0, GRID_Z - 1);
+    return x + GRID_X * (y + GRID_Y * z);
+}
+
+
+void LightClusters::setLights(const std::vector<LocalLight>& _lights)
+{
+    m_lights = _lights;
+
+    m_lightData.resize(m_lights.size() * LIGHT_DATA_SIZE);
+    for(size_t l = 0; l < m_lights.size(); l++)
+    {
+        const LocalLight& light = m_lights[l];
+        float* data = &m_lightData[l * LIGHT_DATA_SIZE];
+        data[0] = light.position.x;     data[1] = light.position.y;     data[2] = light.position.z;     data[3] = light.range;
+        data[4] = light.color.x;        data[5] = light.color.y;        data[6] = light.color.z;        data[7] = light.cosOuter;
+        data[8] = light.direction.x;    data[9] = light.direction.y;    data[10] = light.direction.z;   data[11] = light.cosInner;
+    }
+}
+
+
+void LightClusters::build(const glm::mat4& _viewMat, const glm::mat4& _projMat, const glm::vec3& _sceneMin, const glm::vec3& _sceneMax)
+{
+    // view space x of the tile boundaries (resp. y), on the near and far planes (the frustum edges are lerped in depth)
+    glm::mat4 invProj = glm::inverse(_projMat);
+    float xNear[GRID_X + 1], xFar[GRID_X + 1], yNear[GRID_Y + 1], yFar[GRID_Y + 1];
+    float nearDepth = 0.0f, farDepth = 0.0f;
+    for(int i = 0; i <= std::max(GRID_X, GRID_Y); i++)
+    {
+        float ndcX = -1.0f + 2.0f * (float)std::min(i, GRID_X) / (float)GRID_X;
+        float ndcY = -1.0f + 2.0f * (float)std::min(i, GRID_Y) / (float)GRID_Y;
+        glm::vec4 nearPoint = invProj * glm::vec4(ndcX, ndcY, -1.0f, 1.0f);
+        glm::vec4 farPoint = invProj * glm::vec4(ndcX, ndcY, 1.0f, 1.0f);
+        glm::vec3 pNear = glm::vec3(nearPoint) / nearPoint.w;
+        glm::vec3 pFar = glm::vec3(farPoint) / farPoint.w;
+        if(i <= GRID_X)
+        {
+            xNear[i] = pNear.x;
+            xFar[i] = pFar.x;
+        }
+        if(i <= GRID_Y)
+        {
+            yNear[i] = pNear.y;
+            yFar[i] = pFar.y;
+        }
+        nearDepth = -pNear.z;
+        farDepth = -pFar.z;
+    }
+
+    // exponential slices over the depth range of the scene (the first and last slices extend to the near and far planes)
+    float minDepth = 1e30f, maxDepth = -1e30f;
+    for(int c = 0; c < 8; c++)
+    {
+        glm::vec3 corner((c & 1) ? _sceneMax.x : _sceneMin.x, (c & 2) ? _sceneMax.y : _sceneMin.y, (c & 4) ? _sceneMax.z : _sceneMin.z);
+        float depth = -(_viewMat * glm::vec4(corner, 1.0f)).z;
+        minDepth = std::min(minDepth, depth);
+        maxDepth = std::max(maxDepth, depth);
+    }
+    float n = std::clamp(minDepth, nearDepth, farDepth);
+    float f = std::clamp(maxDepth, n * 1.01f, std::max(farDepth, n * 1.01f));
+
+    float logRatio = std::log(f / n);
+    m_depthParams = glm::vec2((float)GRID_Z / logRatio, -(float)GRID_Z * std::log(n) / logRatio);
+
+    float sliceDepths[GRID_Z + 1];
+    for(int s = 0; s <= GRID_Z; s++)
+        sliceDepths[s] = n * std::pow(f / n, (float)s / (float)GRID_Z);
+    sliceDepths[0] = nearDepth;
+    sliceDepths[GRID_Z] = std::max(farDepth, f);
+
+    // bounding spheres of the lights in view space, as arrays (vectorizable tests)
+    int numLights = (int)m_lights.size();
+    std::vector<float> centerX(numLights), centerY(numLights), centerZ(numLights), radius(numLights);
+    for(int l = 0; l < numLights; l++)
+    {
+        glm::vec3 center;
+        boundingSphere(m_lights[l], center, radius[l]);
+        glm::vec3 centerView = glm::vec3(_viewMat * glm::vec4(center, 1.0f));
+        centerX[l] = centerView.x;
+        centerY[l] = centerView.y;
+        centerZ[l] = centerView.z;
+    }
+
+    const int numTiles = GRID_X * GRID_Y;
+    std::vector<uint32_t> counts(getNumClusters(), 0);
+
+    // slices are independent: one slice per work item
+    parallelFor(GRID_Z, [&](unsigned int _slice, unsigned int)
+    {
+        float depthNear = sliceDepths[_slice];
+        float depthFar = sliceDepths[_slice + 1];
+        float tNear = (depthNear - nearDepth) / (farDepth - nearDepth);
+        float tFar = (depthFar - nearDepth) / (farDepth - nearDepth);
+
+        // bounds of the tiles of the slice (view space, z < 0 in front of the camera)
+        float minX[GRID_X], maxX[GRID_X], minY[GRID_Y], maxY[GRID_Y];
+        for(int i = 0; i < GRID_X; i++)
+        {
+            float x0 = xNear[i] + (xFar[i] - xNear[i]) * tNear, x1 = xNear[i] + (xFar[i] - xNear[i]) * tFar;
+            float x2 = xNear[i + 1] + (xFar[i + 1] - xNear[i + 1]) * tNear, x3 = xNear[i + 1] + (xFar[i + 1] - xNear[i + 1]) * tFar;
+            minX[i] = std::min(std::min(x0, x1), std::min(x2, x3));
+            maxX[i] = std::max(std::max(x0, x1), std::max(x2, x3));
+        }
+        for(int j = 0; j < GRID_Y; j++)
+        {
+            float y0 = yNear[j] + (yFar[j] - yNear[j]) * tNear, y1 = yNear[j] + (yFar[j] - yNear[j]) * tFar;
+            float y2 = yNear[j + 1] + (yFar[j + 1] - yNear[j + 1]) * tNear, y3 = yNear[j + 1] + (yFar[j + 1] - yNear[j + 1]) * tFar;
+            minY[j] = std::min(std::min(y0, y1), std::min(y2, y3));
+            maxY[j] = std::max(std::max(y0, y1), std::max(y2, y3));
+        }
+
+        // squared distance of each light to the slice (depth only), lights which do not reach the slice are skipped
+        std::vector<float> distZ(numLights);
+        for(int l = 0; l < numLights; l++)
+        {
+            float d = std::max(std::max(-depthFar - centerZ[l], 0.0f), centerZ[l] + depthNear);
+            distZ[l] = d * d;
+        }
+        std::vector<int> sliceLights;
+        for(int l = 0; l < numLights; l++)
+            if(distZ[l] <= radius[l] * radius[l])
+                sliceLights.push_back(l);
+
+        std::vector<uint32_t>& indices = m_sliceIndices[_slice];
+        indices.clear();
+        std::vector<int> rowLights;
+        std::vector<float> rowDist;
+        for(int j = 0; j < GRID_Y; j++)
+        {
+            // lights reaching the row of tiles
+            rowLights.clear();
+            rowDist.clear();
+            for(int l : sliceLights)
+            {
+                float d = std::max(std::max(minY[j] - centerY[l], 0.0f), centerY[l] - maxY[j]);
+                float dist = distZ[l] + d * d;
+                if(dist <= radius[l] * radius[l])
+                {
+                    rowLights.push_back(l);
+                    rowDist.push_back(dist);
+                }
+            }
+
+            // sphere / box test of the lights of the row against each tile
+            for(int i = 0; i < GRID_X; i++)
+            {
+                uint32_t count = 0;
+                for(size_t k = 0; k < rowLights.size(); k++)
+                {
+                    int l = rowLights[k];
+                    float d = std::max(std::max(minX[i] - centerX[l], 0.0f), centerX[l] - maxX[i]);
+                    if(rowDist[k] + d * d <= radius[l] * radius[l])
+                    {
+                        indices.push_back((uint32_t)l);
+                        count++;
+                    }
+                }
+                counts[_slice * numTiles + j * GRID_X + i] = count;
+            }
+        }
+    });
+
+    // pack the lists of all slices
+    m_lightIndices.clear();
+    m_maxLightsPerCluster = 0;
+    uint32_t offset = 0;
+    for(int s = 0; s < GRID_Z; s++)
+    {
+        for(int t = 0; t < numTiles; t++)
+        {
+            int cluster = s * numTiles + t;
+            m_clusters[2 * cluster] = offset;
+            m_clusters[2 * cluster + 1] = counts[cluster];
+            offset += counts[cluster];
+            m_maxLightsPerCluster = std::max(m_maxLightsPerCluster, (int)counts[cluster]);
+        }
+        m_lightIndices.insert(m_lightIndices.end(), m_sliceIndices[s].begin(), m_sliceIndices[s].end());
+    }
+}
@@ -0,0 +1,135 @@
+/*********************************************************************************************************************
+ *
+ * lightclusters.h
+ *
+ * Clustered light culling: assignment of local lights to the cells of a view frustum grid (CPU only)
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef LIGHTCLUSTERS_H
+#define LIGHTCLUSTERS_H
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+
+
+/*!
+* \struct LocalLight
+* \brief Point or spot light with a finite range
+*/
+struct LocalLight
+{
+    glm::vec3 position;         /*!< position (space of the view matrix given to LightClusters::build) */
+    float range;                /*!< distance at which the light has no effect anymore */
+    glm::vec3 color;            /*!< color times intensity */
+    glm::vec3 direction;        /*!< spot direction (normalized, ignored for point lights) */
+    float cosOuter;             /*!< cosine of the outer cone angle (-1 for point lights) */
+    float cosInner;             /*!< cosine of the inner cone angle (full intensity inside) */
+};
+
+
+
+/*!
+* \class LightClusters
+* \brief Split the view frustum in a grid of clusters (screen tiles x exponential depth slices), and list the lights
+*        whose volume intersects each cluster, so that a fragment only shades the lights of its cluster.
+*        The clusters are built on the CPU (no GL dependency): the depth slices are processed in parallel, and the
+*        intersection tests run over arrays of cluster bounds (vectorizable loops). The results are packed in the
+*        layout of the texture buffers read by lighting.frag:
+*        - light data: 3 RGBA texels per light, (position, range), (color, cosOuter), (direction, cosInner)
+*        - clusters: 2 integers per cluster (x fastest, then y, then depth slice), offset and number of lights
+*        - light indices: lights of every cluster, one after the other
+* Based on:
+*       O. Olsson, M. Billeter, U. Assarsson, "Clustered Deferred and Forward Shading", HPG 2012.
+*/
+class LightClusters
+{
+    public:
+
+        static constexpr int GRID_X = 16;       /*!< number of tiles along the width of the screen */
+        static constexpr int GRID_Y = 9;        /*!< number of tiles along the height of the screen */
+        static constexpr int GRID_Z = 24;       /*!< number of depth slices */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn LightClusters
+        * \brief Constructor of LightClusters
+        */
+        LightClusters();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumClusters */
+        inline int getNumClusters() { return GRID_X * GRID_Y * GRID_Z; }
+        /*! \fn getLightData : packed lights (4 floats per texel, 3 texels per light) */
+        inline const std::vector<float>& getLightData() { return m_lightData; }
+        /*! \fn getClusters : offset and number of lights of each cluster */
+        inline const std::vector<uint32_t>& getClusters() { return m_clusters; }
+        /*! \fn getLightIndices : lights of all clusters */
+        inline const std::vector<uint32_t>& getLightIndices() { return m_lightIndices; }
+        /*! \fn getDepthParams : scale and bias giving the depth slice of a view depth z: log(z) * scale + bias */
+        inline glm::vec2 getDepthParams() { return m_depthParams; }
+        /*! \fn getMaxLightsPerCluster */
+        inline int getMaxLightsPerCluster() { return m_maxLightsPerCluster; }
+
+        /*!
+        * \fn getCluster
+        * \brief Index of the cluster containing a point
+        * \param _ndc : xy normalized device coordinates of the point
+        * \param _viewDepth : distance of the point to the camera, along the view direction
+        * \return cluster index (clamped to the grid)
+        */
+        int getCluster(const glm::vec2& _ndc, float _viewDepth);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn setLights
+        * \brief Pack the lights in the light data layout (only needed when the lights change)
+        * \param _lights : lights
+        */
+        void setLights(const std::vector<LocalLight>& _lights);
+
+        /*!
+        * \fn build
+        * \brief Compute the bounds of the clusters and list the lights intersecting each cluster
+        * \param _viewMat : camera view matrix (from the space of the lights)
+        * \param _projMat : camera projection matrix
+        * \param _sceneMin, _sceneMax : bounding box of the scene (depth slices are distributed over its depth range)
+        */
+        void build(const glm::mat4& _viewMat, const glm::mat4& _projMat, const glm::vec3& _sceneMin, const glm::vec3& _sceneMax);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        std::vector<LocalLight> m_lights;               /*!< lights */
+        std::vector<float> m_lightData;                 /*!< packed lights */
+        std::vector<uint32_t> m_clusters;               /*!< offset and number of lights of each cluster */
+        std::vector<uint32_t> m_lightIndices;           /*!< lights of all clusters */
+        std::vector<std::vector<uint32_t> > m_sliceIndices; /*!< lights of the clusters of each depth slice (before packing) */
+        glm::vec2 m_depthParams;                        /*!< log(depth) to depth slice scale and bias */
+        int m_maxLightsPerCluster;                      /*!< highest number of lights in a cluster */
+};
+
+#endif // LIGHTCLUSTERS_H
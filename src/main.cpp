@@ -16,6 +16,7 @@
 #include <math.h>
 #include <cstdlib>
 #include <algorithm>
+#include <chrono>
 
 // OpenGL includes
 #include <GL/glew.h>
@@ -28,13 +29,37 @@
 
 #include "utils.h"
 #include "drawablemesh.h"
+#include "iblbaker.h"
+#include "profiler.h"
+#include "benchmark.h"
+#include "dynamicresolution.h"
+#include "rendertargetpool.h"
+#include "framegraph.h"
+#include "temporalhistory.h"
+#include "computeblur.h"
+#include "shadowcascades.h"
+#include "shadowcache.h"
+#include "lightclusters.h"
+#include "depthprepass.h"
+#include "softrasterizer.h"
+#include "imagediff.h"
+#include "aobaker.h"
+#include "pathtracer.h"
+#include "parallel.h"
 
 
 // Window
 GLFWwindow *m_window;           /*!<  GLFW window */
 int m_winWidth = 1024;          /*!<  window width (XGA) */
 int m_winHeight = 720;          /*!<  window height (XGA) */
-const unsigned int TEX_WIDTH = 2048, TEX_HEIGHT = 2048; /*!< textures dimensions  */
+const unsigned int TEX_WIDTH = 2048, TEX_HEIGHT = 2048; /*!< textures dimensions (shadow map and texture space diffusion) */
+
+// Internal resolution
+int m_renderWidth = 1024;       /*!<  width of screen-space render targets (window width x resolution scale) */
+int m_renderHeight = 720;       /*!<  height of screen-space render targets (window height x resolution scale) */
+float m_renderScale = 1.0f;     /*!<  resolution scale chosen in the GUI (if dynamic resolution is off) */
+bool m_isDynamicResOn = false;  /*!<  adapt resolution scale to frame time budget */
+DynamicResolution m_dynamicRes; /*!<  resolution scale controller */
 
 GLtools::Trackball m_trackball; /*!<  model trackball */
 
@@ -58,45 +83,73 @@ float m_lightCamFarRad;         /*!< distance between scene center and light cam
 
 // 3D objects
 std::unique_ptr<TriMesh> m_triMesh;             /*!<  triangle mesh */
+std::string m_meshFile;                         /*!<  file of the triangle mesh */
 std::unique_ptr<DrawableMesh> m_drawMesh;       /*!<  drawable object: mesh object */
 std::unique_ptr<DrawableMesh> m_drawQuad;       /*!<  drawable object: screen quad */
 std::unique_ptr<DrawableMesh> m_drawFloor;      /*!<  drawable object: floor quad */
 std::unique_ptr<DrawableMesh> m_drawSkybox;     /*!<  drawable object: skybox */
+std::unique_ptr<IBLBaker> m_iblBaker;           /*!<  image-based lighting data of the current cube map */
+
+// Profiling
+std::unique_ptr<Profiler> m_profiler;           /*!<  per-pass CPU/GPU timings */
+CameraPath m_cameraPath;                        /*!<  recorded or keyframed camera/light path */
+bool m_isPathPlaying = false;                   /*!<  replay m_cameraPath instead of using trackball, zoom and light controls */
+bool m_isPathRecording = false;                 /*!<  record trackball, zoom and light controls into m_cameraPath */
+float m_pathTime = 0.0f;                        /*!<  current time in m_cameraPath, in seconds */
+double m_pathStartTime = 0.0;                   /*!<  GLFW time at which the recording/replay started */
 
 glm::mat4 m_modelMatrix;        /*!<  model matrix of the mesh */
+
+// Picking
+bool m_isPointPicked = false;               /*!< a point of the mesh has been picked (right click) */
+TriMesh::SurfacePoint m_pickedPoint;        /*!< last picked point (mesh coords) */
+float m_pickTime = 0.0f;                    /*!< duration of the last pick, in microseconds (BVH build excluded) */
     
 GLuint m_defaultVAO;            /*!<  default VAO */
 
-// FBOs
-GLuint m_shadowFBO;             /*!< FBO for shadow map calculation: renders depthbuffer into m_shadowMapTex */
-GLuint m_shadowMapTex;          /*!< Texture for shadow map rendering (i.e., depthbuffer from light cam) */
-GLuint m_tsdFBO;                /*!< FBO for texture space diffusion: renders color component into m_tsdTex */
-GLuint m_tsdTex;                /*!< Destination texture for texture space diffusion (stores result of lighting to texture space) */
-GLuint m_gFBO;                  /*!< FBO for G-buffer: renders fragment position and normals coords as rgb colors into m_gPosition and m_gNormal */
-GLuint m_gPosition;             /*!< G-buffer position screen-texture */
-GLuint m_gNormal;               /*!< G-buffer normal screen-texture */
-GLuint m_gColor;                /*!< G-buffer color screen-textures */
-GLuint m_screenFBO;             /*!< FBO for screen-space processing: renders color component into m_screenTex*/
-GLuint m_screenTex;             /*!< Destination texture for screen-space processing (stores final lighting result) */
-GLuint m_SSAOFBO;               /*!< FBO for SSAO processing: renders SSAO (as color component) into m_SSAOTex */
-GLuint m_SSAOTex;               /*!< Screen-texture to store SSAO result */
-GLuint m_BlurFBO;               /*!< FBO for SSAO blurring: renders blured SSAO (as color component) into m_BlurTex */   
-GLuint m_BlurFBO2;              /*!< FBO for SSLR blurring: renders blured SSLR (as color component) into m_BlurTex2 */    
-GLuint m_BlurTex;               /*!< Screen-texture to store blurred SSAO */
-GLuint m_BlurTex2;              /*!< Screen-texture to store blurred SSLR */
-GLuint m_SSLRFBO;               /*!< FBO for SSLR renders SSLR (as color component) into m_SSLRTex */    
-GLuint m_SSLRTex;               /*!< Screen-texture to store SSLR */
+// Render targets (declared every frame in m_frameGraph, allocated from m_rtPool only if a pass using them is executed)
+std::unique_ptr<RenderTargetPool> m_rtPool;     /*!< pool of transient FBOs and textures */
+std::unique_ptr<FrameGraph> m_frameGraph;       /*!< render passes of the frame and their targets */
+std::unique_ptr<TemporalHistory> m_aoHistory;   /*!< accumulated SSAO of the previous frames (temporal accumulation) */
+std::unique_ptr<TemporalHistory> m_lrHistory;   /*!< accumulated SSLR of the previous frames (temporal accumulation) */
+std::unique_ptr<ComputeBlur> m_computeBlur;     /*!< compute shader blur (null if compute shaders are not supported) */
+std::unique_ptr<ShadowCache> m_shadowCache;     /*!< shadow map kept across frames (re-rendered when the light or the casters change) */
+std::unique_ptr<ShadowCache> m_cascadeCache;    /*!< cascaded shadow maps kept across frames */
+std::unique_ptr<ShadowCache> m_momentCache;     /*!< filtered moment shadow map kept across frames */
+std::unique_ptr<DepthPrepass> m_lightingPrepass; /*!< depth pre-pass of the forward lighting pass (enabled by measured overdraw) */
+std::unique_ptr<DepthPrepass> m_gBufferPrepass;  /*!< depth pre-pass of the G-buffer pass */
+std::unique_ptr<DepthPrepass> m_tsdPrepass;      /*!< depth pre-pass of the texture space diffusion display pass */
+int m_prepassMode = DepthPrepass::ADAPTIVE;     /*!< depth pre-pass of the geometry passes: never, when the overdraw is high enough, always */
+int m_outputRes = -1;           /*!< frame graph target: final image (m_outputFBO) */
+int m_shadowRes = -1;           /*!< frame graph target: shadow map, depth texture rendered from light cam */
+int m_cascadeRes = -1;          /*!< frame graph target: cascaded shadow maps, depth texture array (one layer per cascade) */
+int m_momentRes = -1;           /*!< frame graph target: moment shadow map, blurred and mipmapped moments of the depth from light cam */
+int m_gBufferRes = -1;          /*!< frame graph target: G-buffer, fragment depth, normal and material screen-textures */
+int m_tsdRes = -1;              /*!< frame graph target: texture space diffusion, result of lighting in texture space */
+int m_sceneRes = -1;            /*!< frame graph target: lighting result in screen space */
+int m_colorRes = -1;            /*!< frame graph target: latest color result (lighting, + SSAO, + SSLR) */
+GLuint m_outputFBO = 0;         /*!< FBO receiving the final image: default framebuffer (0), or offscreen FBO in headless mode */
+GLuint m_outputTex;             /*!< Screen-texture of the offscreen output FBO (headless mode only) */
 
 // shader programs
 GLuint m_programLighting;       /*!< handle of the program object (i.e. shaders) for shaded surface rendering */
+GLuint m_programDeferred;       /*!< handle of the program object (i.e. shaders) for deferred shading of the G-buffer */
 GLuint m_programShadow;         /*!< handle of the program object (i.e. shaders) for shadow map rendering */
+GLuint m_programShadowMoments;  /*!< handle of the program object (i.e. shaders) for moment shadow map rendering */
 GLuint m_programQuad;           /*!< handle of the program object (i.e. shaders) for screen quad rendering */
 GLuint m_programSkybox;         /*!< handle of the program object (i.e. shaders) for skybox rendering */
 GLuint m_programTex;            /*!< handle of the program object (i.e. shaders) for texture space diffusion rendering */
 GLuint m_programGbuffer;        /*!< handle of the program object (i.e. shaders) for G-buffer calculation */
 GLuint m_programSSAO;           /*!< handle of the program object (i.e. shaders) for SSAO calculation */
+GLuint m_programSSAODownsample; /*!< handle of the program object (i.e. shaders) for G-buffer downsampling (reduced resolution SSAO) */
+GLuint m_programSSAOBlur;       /*!< handle of the program object (i.e. shaders) for depth and normal aware SSAO blur */
+GLuint m_programHiZ;            /*!< handle of the program object (i.e. shaders) for hierarchical depth buffer levels */
+GLuint m_programGTAO;           /*!< handle of the program object (i.e. shaders) for horizon-based AO calculation */
 GLuint m_programQuadFinal;      /*!< handle of the program object (i.e. shaders) for Final color + SSAO rendering */
 GLuint m_programSSLR;           /*!< handle of the program object (i.e. shaders) for SSLR calculation */
+GLuint m_programSSR;            /*!< handle of the program object (i.e. shaders) for Hi-Z ray marched reflections */
+GLuint m_programTemporal;       /*!< handle of the program object (i.e. shaders) for temporal accumulation of SSAO/SSLR */
+GLuint m_programBlur = 0;       /*!< handle of the program object (i.e. compute shader) for separable Gaussian blur (GL 4.3) */
 
 
 /* 2 types of quads: floor (horizontal), or screen quad */
@@ -107,6 +160,26 @@ bool m_isBackgroundWhite = false;   /*!< background color flag */
 bool m_isFloorOn = true;            /*!< draw floor flag */
 static int m_lightType = 0;         /*!< Type of light source: Point = 0, Directional = 1 */
 bool m_isShadowOn = false;          /*!< Shadow mapping flag */
+bool m_isCascadedShadowOn = false;  /*!< cascaded shadow maps (fitted to the view frustum) instead of a single shadow map */
+int m_numCascades = 3;              /*!< number of shadow cascades */
+const int CASCADE_MAP_SIZE = 1024;  /*!< size of the shadow map of each cascade (3 cascades: 3/4 of the texels of a single map) */
+ShadowCascades m_shadowCascades(3, CASCADE_MAP_SIZE); /*!< splits and light matrices of the shadow cascades */
+bool m_isShadowCacheOn = true;      /*!< shadow maps are only rendered when the light or the casters change */
+int m_shadowMethod = 0;             /*!< filtering of the single shadow map: PCF = 0, VSM = 1, EVSM = 2, MSM = 3 (moments) */
+int m_shadowSoftness = 4;           /*!< filter half-width of the moment shadow map, in texels (penumbra width) */
+const int MOMENT_MAP_SIZE = 1024;   /*!< size of the moment shadow map (filtered, so lower than the depth shadow map) */
+bool m_isLocalLightsOn = false;     /*!< local point and spot lights, culled per cluster of the view frustum */
+int m_numLocalLights = 256;         /*!< number of local lights */
+const int MAX_LOCAL_LIGHTS = 4096;  /*!< highest number of local lights */
+bool m_isLocalLightsDirty = true;   /*!< local lights to be generated again (new number of lights, or new scene) */
+LightClusters m_lightClusters;      /*!< local lights of each cluster of the view frustum (built on the CPU every frame) */
+float m_clusterBuildTime = 0.0f;    /*!< CPU time of the last light clusters build, in ms */
+GLuint m_lightDataBuffer = 0;       /*!< buffer of the local lights */
+GLuint m_lightDataTex = 0;          /*!< buffer texture of the local lights (3 RGBA32F texels per light) */
+GLuint m_clustersBuffer = 0;        /*!< buffer of the offset and number of lights of each cluster */
+GLuint m_clustersTex = 0;           /*!< buffer texture of the offset and number of lights of each cluster (RG32UI) */
+GLuint m_lightIndicesBuffer = 0;    /*!< buffer of the lights of all clusters */
+GLuint m_lightIndicesTex = 0;       /*!< buffer texture of the lights of all clusters (R32UI) */
 bool m_isEnvReflecOn = true;        /*!< Environment mapping reflection on  */
 bool m_isEnvRefracOn = false;       /*!< Environment mapping refraction on  */
 static int m_modelType = 0;         /*!< Type of model : basic mesh (no UV) = 0, UV (unwrapped) mesh = 1, PBR (provided with textures) mesh = 2 */
@@ -117,20 +190,39 @@ bool m_isPBRMapOn = false;          /*!< gloss and/or metal map mapping on  */
 bool m_isEnvMapOn = false;          /*!< environment mapping on  */
 int m_envMapType = 0;               /*!< environment mapping type: reflection = 0 , refraction = 1  */
 bool m_isAOMapOn = false;           /*!< ambient occlusion mapping on  */
+bool m_isBakedAOOn = false;         /*!< per-vertex ambient occlusion baked on the CPU on  */
+bool m_isAOBaked = false;           /*!< the baked ambient occlusion of the current mesh is in its vertex colors */
 bool m_isSimTransmitOn = false;     /*!< simulate transmission on  */
 bool m_isTSDOn = false;             /*!< texture space diffusion on  */
 bool m_isSSAOOn = false;            /*!< screen-space ambient occlusion on  */
 bool m_isSSLROn = false;            /*!< screen-space light reflection on  */
+bool m_isIBLOn = false;             /*!< image-based (ambient) lighting on  */
+bool m_isDeferredOn = false;        /*!< deferred shading: lighting of the G-buffer in a single screen pass */
 
 
 int m_filterWidth = 2;
+bool m_isComputeBlurOn = true;      /*!< TSD and SSLR blurs in a compute shader (if supported), or in a fragment shader */
 
 float m_ssaoRadius = 1.0;
+int m_ssaoDownsampling = 2;         /*!< SSAO resolution divider: 1 = full, 2 = half, 4 = quarter resolution */
+int m_aoMethod = 0;                 /*!< ambient occlusion method: hemisphere kernel (SSAO) = 0, horizon search in Hi-Z buffer (GTAO) = 1 */
+const int HIZ_MAX_LEVELS = 6;       /*!< number of Hi-Z levels (taps of the horizon search are at most 128 pixels away) */
+int m_sslrMethod = 0;               /*!< screen-space reflection method: hemisphere kernel (SSLR) = 0, ray marching in Hi-Z buffer (SSR) = 1 */
+const int SSR_HIZ_LEVELS = 8;       /*!< number of Hi-Z levels of the reflection ray marching (steps of up to 128 pixels) */
+const int SCENE_MIP_LEVELS = 6;     /*!< mip levels of the lighting result read by SSR (cone filtering of glossy reflections) */
+bool m_isTemporalOn = false;        /*!< temporal accumulation of SSAO and SSLR: fewer samples per frame, rotated every frame */
+const int KERNEL_SIZE = 40;         /*!< SSAO/SSLR kernel samples per fragment */
+const int TEMPORAL_KERNEL_SIZE = 8; /*!< SSAO/SSLR kernel samples per fragment and per frame with temporal accumulation */
+const float TEMPORAL_BLEND = 0.1f;  /*!< weight of the current frame in the accumulated result */
+long long m_frameIndex = 0;         /*!< index of the rendered frame (rotation of the sample patterns, history validity) */
+glm::mat4 m_prevModelMatrix;        /*!< model matrix of the previous frame (reprojection) */
+glm::mat4 m_prevViewProjMatrix;     /*!< view-projection matrix of the previous frame (reprojection) */
 
 std::vector<glm::vec3> m_ssaoKernel;
 GLuint m_noiseTex;          
 
 glm::vec3 bBoxMin;
+glm::vec3 bBoxMax;
 static int m_fileMesh = 0;
 const char *m_fileBasicMeshList[] = { "armadillo",
                                       "gargoyle",
@@ -143,6 +235,10 @@ const char *m_fileUVMeshList[] =    { "bunny_UV",
 const char *m_filePBRMeshList[] =   { "grenade_PBR",
                                       "cerberus_PBR",
                                       "matball_PBR" };
+// texture maps of PBR meshes (same order as m_filePBRMeshList): albedo, normal, roughness, metalness, AO
+const PBRMaterial m_pbrMaterialList[] = { { "tex_grenade/Grenade_A.png", "tex_grenade/Grenade_N.png", "tex_grenade/Grenade_R.png", "tex_grenade/Grenade_M.png", "tex_grenade/Grenade_AO.png" },
+                                          { "tex_cerberus/Cerberus_A.png", "tex_cerberus/Cerberus_N.png", "tex_cerberus/Cerberus_R.png", "tex_cerberus/Cerberus_M.png", "" },
+                                          { "tex_matball/Matball_A.png", "tex_matball/Matball_N.png", "tex_matball/Matball_R.png", "tex_matball/Matball_M.png", "tex_matball/Matball_AO.png" } };
 
 static int m_fileTex = 0;
 const char *m_fileTexList[] =       { "UV_template",
@@ -168,18 +264,55 @@ void initialize();
 void initScene();
 void setupImgui(GLFWwindow *window);
 void update();
-void displayShadowMap();
-void displayGBuffering();
-void displayLighting();
-void displayTSD();
-void displaySSAO();
-void displaySSLR();
+void sceneBounds(glm::vec3& _min, glm::vec3& _max);
+std::vector<LocalLight> generateLocalLights(int _numLights);
+void updateLightClusters();
+void addShadowMapPass();
+void addShadowMomentsPasses();
+glm::vec4 farPlaneMoments(int _method);
+void addShadowCascadesPass();
+bool isDeferredShading();
+void addGBufferPass();
+void setLightingInputs(int _shadowRes, int _cascadeRes, int _momentRes);
+void drawWithPrepass(DepthPrepass* _prepass, const std::vector<DrawableMesh*>& _meshes, const std::function<void()>& _drawShading);
+void addLightingPass();
+void addTSDPasses();
+int addBlurPasses(const std::string& _name, int _srcRes, int _filterWidth);
+void drawBlur(int _srcRes, int _dstRes, bool _isHorizontal, int _filterWidth, bool _isMasked);
+int addTemporalPass(const std::string& _name, int _currentRes, int _geomRes, TemporalHistory& _history);
+void temporalSamplePattern(int& _kernelSize, int& _kernelOffset, float& _noiseAngle);
+void addSSAOPasses();
+int addHiZPass(const std::string& _name, int _geomRes, int _divider, int _maxLevels);
+void buildHiZ(GLuint _hiZTex, GLuint _depthTex, int _width, int _height, int _numLevels);
+void addSSLRPasses();
+void addOutputPass();
+glm::vec4 backgroundColor();
+RenderTargetDesc screenTargetDesc(int _numColorTex, bool _hasDepth, GLint _filter, int _divider = 1);
+RenderTargetDesc sceneTargetDesc();
+RenderTargetDesc gBufferTargetDesc(int _numColorTex, int _divider = 1);
+int numMipLevels(const RenderTargetDesc& _desc, int _maxLevels);
+void resizeScreenTargets(float _scale);
 void resizeCallback(GLFWwindow* window, int width, int height);
 void keyCallback(GLFWwindow* window, int key, int scancode, int action, int mods);
 void charCallback(GLFWwindow* window, unsigned int codepoint);
 void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods);
 void scrollCallback(GLFWwindow* window, double xoffset, double yoffset);
 void cursorPosCallback(GLFWwindow* window, double x, double y);
+bool pickMesh(double _x, double _y, TriMesh::SurfacePoint& _point);
+bool loadModel(int _modelType, int _fileMesh);
+void loadEnvironment(int _fileCubeMap);
+void applySettings();
+void bakeMeshAO();
+void renderFrame();
+void releaseGLResources();
+void applyPathKey(const PathKey& _key);
+PathKey currentPathKey(float _time);
+bool findModel(const std::string& _name, int& _modelType, int& _fileMesh);
+int runBenchmark(const std::vector<std::string>& _models, const std::string& _pathFile, int _numFrames, bool _fullMatrix,
+                 const std::string& _reportFile, const std::string& _baselineFile, float _tolerance);
+int runReference(const std::string& _referenceFile, const std::string& _diffFile, float _threshold, float _tolerance);
+int runPathTracer(const std::string& _file, int _numSamples, float _threshold);
+int runHeadless(int argc, char** argv);
 void runGUI();
 int main(int argc, char** argv);
 
@@ -203,13 +336,17 @@ void initialize()
     // Enable depth testing
     glEnable(GL_DEPTH_TEST);
     glDepthFunc(GL_LESS);    
+
+    // filter across cube map faces (needed by the low-resolution levels of the IBL pre-filtered map)
+    glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
         
     // init model matrix
     m_modelMatrix = glm::mat4(1.0f);
 
     // init mesh
     m_triMesh = std::make_unique<TriMesh>(true, false, false);
-    m_triMesh->readFile(modelDir + "teapot.obj");
+    m_meshFile = modelDir + "teapot.obj";
+    m_triMesh->readFile(m_meshFile);
 
     initScene();
 
@@ -233,44 +370,120 @@ void initialize()
     std::string fragHeader = shaderDir + "header.frag";
     // init shaders
     m_programLighting = loadShaderProgram(shaderDir + "lighting.vert", shaderDir + "lighting.frag", vertHeader, fragHeader);  // compute 3D lighting (writes to UV coords if TSD on) 
+    m_programDeferred = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "deferredLighting.frag", "", fragHeader); // computes 3D lighting of the G-buffer (deferred shading)
     m_programShadow = loadShaderProgram(shaderDir + "shadowMap.vert", shaderDir + "shadowMap.frag");    // renders 3D scene and writes depthbuffer to shadowmap
+    m_programShadowMoments = loadShaderProgram(shaderDir + "shadowMap.vert", shaderDir + "shadowMoments.frag"); // renders 3D scene and writes depth moments to moment shadow map
     m_programQuad = loadShaderProgram(shaderDir + "quadTex.vert", shaderDir + "quadTex.frag");          // renders screenQuad with texture one (blurs texture if blurring on)
     m_programSkybox = loadShaderProgram(shaderDir + "skyBox.vert", shaderDir + "skyBox.frag");          // renders sky box with environment map
     m_programTex = loadShaderProgram(shaderDir + "meshTex.vert", shaderDir + "meshTex.frag");           // renders mesh with texture, without any lighting
-    m_programGbuffer = loadShaderProgram(shaderDir + "gBuffer.vert", shaderDir + "gBuffer.frag");       // renders 3D scene and writes G-buffers to positionTex, normalTex, and colorTex
-    m_programSSAO = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "ssao.frag");                // renders scene from G-buffer and writes SSAO map
-    m_programQuadFinal = loadShaderProgram(shaderDir + "final.vert", shaderDir + "final.frag");         // renders scenes from screenTex and SSAmap
-    m_programSSLR = loadShaderProgram(shaderDir + "sslr.vert", shaderDir + "sslr.frag");                // renders scene from G-buffer and writes SSLR map
+    m_programGbuffer = loadShaderProgram(shaderDir + "gBuffer.vert", shaderDir + "gBuffer.frag", "", fragHeader); // renders 3D scene and writes G-buffers (depth, normal, color and reflectivity)
+    m_programSSAO = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "ssao.frag", "", fragHeader); // renders scene from G-buffer and writes SSAO map
+    m_programSSAODownsample = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "ssaoDownsample.frag", "", fragHeader); // downsamples G-buffer depth and normal for reduced resolution SSAO
+    m_programSSAOBlur = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "ssaoBlur.frag", "", fragHeader); // blurs SSAO map without crossing depth and normal discontinuities
+    m_programHiZ = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "hiZ.frag", "", fragHeader);  // builds one level of the hierarchical (min) depth buffer
+    m_programGTAO = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "gtao.frag", "", fragHeader); // renders scene from Hi-Z buffer and writes horizon-based AO map
+    m_programQuadFinal = loadShaderProgram(shaderDir + "final.vert", shaderDir + "final.frag", "", fragHeader); // renders scenes from screenTex and SSAmap
+    m_programSSLR = loadShaderProgram(shaderDir + "sslr.vert", shaderDir + "sslr.frag", "", fragHeader); // renders scene from G-buffer and writes SSLR map
+    m_programSSR = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "ssr.frag", "", fragHeader);  // renders reflections by ray marching the Hi-Z buffer
+    m_programTemporal = loadShaderProgram(shaderDir + "ssao.vert", shaderDir + "temporal.frag", "", fragHeader); // blends SSAO/SSLR map with its reprojected history
+
+    // FBOs and textures are allocated by the passes which need them
+    m_rtPool = std::make_unique<RenderTargetPool>();
+    m_frameGraph = std::make_unique<FrameGraph>(*m_rtPool);
+    m_aoHistory = std::make_unique<TemporalHistory>(*m_rtPool);
+    m_lrHistory = std::make_unique<TemporalHistory>(*m_rtPool);
+    m_shadowCache = std::make_unique<ShadowCache>(*m_rtPool);
+    m_cascadeCache = std::make_unique<ShadowCache>(*m_rtPool);
+    m_momentCache = std::make_unique<ShadowCache>(*m_rtPool);
+
+    // depth pre-passes (GL queries are created on first use). The G-buffer and TSD shaders are cheaper than lighting,
+    // so their pre-pass needs a higher overdraw to pay off
+    m_lightingPrepass = std::make_unique<DepthPrepass>(1.5f);
+    m_gBufferPrepass = std::make_unique<DepthPrepass>(2.0f);
+    m_tsdPrepass = std::make_unique<DepthPrepass>(2.0f);
+    for(DepthPrepass* prepass : { m_lightingPrepass.get(), m_gBufferPrepass.get(), m_tsdPrepass.get() })
+        prepass->setMode(m_prepassMode);
+
+    // compute shader blur: GL 4.3 only, the fragment shader blur (quadTex.frag) is used otherwise
+    if(ComputeBlur::isSupported())
+        m_programBlur = loadComputeProgram(shaderDir + "blur.comp");
+    if(m_programBlur != 0)
+        m_computeBlur = std::make_unique<ComputeBlur>(m_programBlur);
+    else
+        infoLog() << "Compute shaders not supported: blurs are rendered with fragment shaders";
+    resizeScreenTargets(m_renderScale);
+
+    m_ssaoKernel = buildRandKernel();
+    buildKernelRot(&m_noiseTex); 
+
+    m_drawQuad->setSSAOKernel(m_ssaoKernel);
+    m_drawQuad->setNoiseTex(m_noiseTex);
+}
+
+
+RenderTargetDesc screenTargetDesc(int _numColorTex, bool _hasDepth, GLint _filter, int _divider)
+{
+    RenderTargetDesc desc;
+    // reduced resolution targets cover the whole render (rounded up)
+    desc.width = (m_renderWidth + _divider - 1) / _divider;
+    desc.height = (m_renderHeight + _divider - 1) / _divider;
+    desc.colorFormat = GL_RGBA16F;
+    desc.numColorTex = _numColorTex;
+    desc.depthFormat = _hasDepth ? GL_DEPTH_COMPONENT24 : GL_NONE;
+    desc.isDepthTexture = false;
+    desc.filter = _filter;
+    return desc;
+}
 
-    // build FBO and depth texture output for shadow map generation
-    buildShadowFBOandTex(&m_shadowFBO, &m_shadowMapTex, TEX_WIDTH, TEX_HEIGHT);
 
-    // build FBO and texture output for texture space diffusion
-    buildScreenFBOandTex(&m_screenFBO, &m_screenTex, TEX_WIDTH, TEX_HEIGHT, true, false);
+RenderTargetDesc sceneTargetDesc()
+{
+    // lighting result, with mip levels when it is read by the cone-filtered reflections
+    RenderTargetDesc desc = screenTargetDesc(1, true, GL_LINEAR);
+    if(m_isSSLROn && m_sslrMethod == 1)
+        desc.numLevels = numMipLevels(desc, SCENE_MIP_LEVELS);
+    return desc;
+}
 
-    // build G-buffer FBO and textures
-    buildGbuffFBOandTex(&m_gFBO, &m_gPosition, &m_gNormal, &m_gColor, TEX_WIDTH, TEX_HEIGHT);
 
-    // build FBO and texture output for texture space diffusion
-    buildScreenFBOandTex(&m_tsdFBO, &m_tsdTex, TEX_WIDTH, TEX_HEIGHT, false, true);
+RenderTargetDesc gBufferTargetDesc(int _numColorTex, int _divider)
+{
+    // sampled depth (positions are reconstructed from it), octahedral normal in 2 channels, 8 bits material parameters
+    RenderTargetDesc desc = screenTargetDesc(_numColorTex, true, GL_NEAREST, _divider);
+    desc.firstColorFormat = GL_RG16;
+    desc.colorFormat = GL_RGBA8;
+    desc.depthFormat = GL_DEPTH_COMPONENT32F;
+    desc.isDepthTexture = true;
+    return desc;
+}
 
-    // build FBO and texture output for texture space diffusion
-    buildScreenFBOandTex(&m_SSAOFBO, &m_SSAOTex, TEX_WIDTH, TEX_HEIGHT, false, false);
 
-    // build FBO and texture output for blurring of SSAO texture
-    buildScreenFBOandTex(&m_BlurFBO, &m_BlurTex, TEX_WIDTH, TEX_HEIGHT, false, false);
+int numMipLevels(const RenderTargetDesc& _desc, int _maxLevels)
+{
+    // levels down to 1 pixel, at most _maxLevels
+    int maxSize = std::max(_desc.width, _desc.height);
+    int numLevels = 1;
+    while(numLevels < _maxLevels && (maxSize >> numLevels) > 0)
+        numLevels++;
+    return numLevels;
+}
 
-    // build FBO and texture output for blurring of SSAO texture
-    buildScreenFBOandTex(&m_BlurFBO2, &m_BlurTex2, TEX_WIDTH, TEX_HEIGHT, false, false);
 
-    // build FBO and texture output for SSLR
-    buildScreenFBOandTex(&m_SSLRFBO, &m_SSLRTex, TEX_WIDTH, TEX_HEIGHT, true, false);
+void resizeScreenTargets(float _scale)
+{
+    // targets of the previous size are deleted by the pool once they are not acquired anymore
+    m_renderWidth = std::max(1, (int)std::lround(m_winWidth * _scale));
+    m_renderHeight = std::max(1, (int)std::lround(m_winHeight * _scale));
+}
 
-    m_ssaoKernel = buildRandKernel();
-    buildKernelRot(&m_noiseTex); 
 
-    m_drawQuad->setSSAOKernel(m_ssaoKernel);
-    m_drawQuad->setNoiseTex(m_noiseTex);
+glm::vec4 backgroundColor()
+{
+    // null alpha (used as a mask by the TSD blur)
+    if(m_isBackgroundWhite)
+        return glm::vec4(1.0f, 1.0f, 1.0f, 0.0f);
+    else
+        return glm::vec4(0.0f, 0.0f, 0.0f, 0.0f);
 }
 
 
@@ -278,7 +491,7 @@ void initScene()
 {
     m_triMesh->computeAABB();
     bBoxMin = m_triMesh->getBBoxMin();
-    glm::vec3 bBoxMax = m_triMesh->getBBoxMax();
+    bBoxMax = m_triMesh->getBBoxMax();
     if(bBoxMin != bBoxMax)
     {
         // set the center of the scene to the center of the bBox
@@ -303,6 +516,145 @@ void initScene()
 }
 
 
+bool loadModel(int _modelType, int _fileMesh)
+{
+    const char **lists[] = { m_fileBasicMeshList, m_fileUVMeshList, m_filePBRMeshList };
+    std::string meshFile = modelDir + std::string(lists[_modelType][_fileMesh]) + ".obj";
+
+    // keep the current scene if the mesh cannot be read
+    if( !m_triMesh->readFile(meshFile) )
+    {
+        errorLog() << "loadModel(): cannot load " << meshFile;
+        return false;
+    }
+
+    m_modelType = _modelType;
+    m_fileMesh = _fileMesh;
+    m_meshFile = meshFile;
+    if (m_modelType == 2 )
+        m_triMesh->computeTB();
+    m_isAOBaked = false;
+    initScene();
+
+    // setup mesh rendering
+    m_drawMesh = std::make_unique<DrawableMesh>();
+    m_drawMesh->createMeshVAO(*m_triMesh);
+
+    if(m_modelType == 2)
+    {
+        // load corresponding PBR textures
+        m_drawMesh->loadMaterial( m_pbrMaterialList[m_fileMesh], modelDir );
+    }
+
+    // setup floor quad rendering
+    m_drawFloor = std::make_unique<DrawableMesh>();
+    m_drawFloor->createQuadVAO(FLOOR, bBoxMin.y, m_centerCoords, m_radScene);
+
+    // new casters (the meshes may be allocated at the same addresses as the previous ones)
+    m_shadowCache->invalidate();
+    m_cascadeCache->invalidate();
+    m_momentCache->invalidate();
+
+    // the overdraw depends on the geometry
+    for(DepthPrepass* prepass : { m_lightingPrepass.get(), m_gBufferPrepass.get(), m_tsdPrepass.get() })
+        prepass->reset();
+
+    // local lights are spread over the new scene
+    m_isLocalLightsDirty = true;
+
+    // the picked point belongs to the previous mesh
+    m_isPointPicked = false;
+
+    // keep image-based lighting of the current cube map
+    if(m_iblBaker && m_iblBaker->isValid())
+    {
+        m_drawMesh->setIBL(m_iblBaker->getSpecularMap(), m_iblBaker->getBRDFLut(), m_iblBaker->getSHCoeffs(), m_iblBaker->getNumSpecularLevels());
+        m_drawFloor->setIBL(m_iblBaker->getSpecularMap(), m_iblBaker->getBRDFLut(), m_iblBaker->getSHCoeffs(), m_iblBaker->getNumSpecularLevels());
+    }
+
+    applySettings();
+
+    return true;
+}
+
+
+void loadEnvironment(int _fileCubeMap)
+{
+    m_fileCubeMap = _fileCubeMap;
+    std::string cubeMapDir = modelDir + "cubemaps/" + std::string(m_fileCubeMapList[m_fileCubeMap]);
+
+    // add cube map to mesh rendering
+    m_drawMesh->loadCubeMap(cubeMapDir);
+    m_drawSkybox->loadCubeMap(cubeMapDir);
+    m_drawQuad->loadCubeMap(cubeMapDir);
+
+    // bake (or read from cache) image-based lighting data
+    if(!m_iblBaker)
+        m_iblBaker = std::make_unique<IBLBaker>();
+    if( m_iblBaker->bake(cubeMapDir) )
+    {
+        m_drawMesh->setIBL(m_iblBaker->getSpecularMap(), m_iblBaker->getBRDFLut(), m_iblBaker->getSHCoeffs(), m_iblBaker->getNumSpecularLevels());
+        m_drawFloor->setIBL(m_iblBaker->getSpecularMap(), m_iblBaker->getBRDFLut(), m_iblBaker->getSHCoeffs(), m_iblBaker->getNumSpecularLevels());
+        m_drawQuad->setIBL(m_iblBaker->getSpecularMap(), m_iblBaker->getBRDFLut(), m_iblBaker->getSHCoeffs(), m_iblBaker->getNumSpecularLevels());
+    }
+    else
+    {
+        // do not keep the IBL data of the previous cube map
+        errorLog() << "loadEnvironment(): no image-based lighting data for " << cubeMapDir << ", IBL disabled";
+        for(DrawableMesh* drawMesh : { m_drawMesh.get(), m_drawFloor.get(), m_drawQuad.get() })
+        {
+            drawMesh->setIBL(0, 0, std::vector<glm::vec3>(9, glm::vec3(0.0f)), 0);
+            drawMesh->setIBLFlag(false);
+        }
+        m_isIBLOn = false;
+    }
+}
+
+
+void applySettings()
+{
+    // texture maps are only available on models with UV coords
+    m_drawMesh->setAlbedoTexFlag(m_isAlbedoTexOn && m_modelType != 0);
+    m_drawMesh->setNormalMapFlag(m_isNormalMapOn && m_modelType == 2);
+    m_drawMesh->setPBRFlag(m_isPBRMapOn && m_modelType == 2);
+    m_drawMesh->setAmbMapFlag(m_isAOMapOn && m_modelType == 2);
+    if(m_isBakedAOOn)
+        bakeMeshAO();
+    m_drawMesh->setVertexAOFlag(m_isBakedAOOn && m_isAOBaked);
+
+    m_isEnvReflecOn = m_isEnvMapOn && m_envMapType == 0;
+    m_isEnvRefracOn = m_isEnvMapOn && m_envMapType == 1;
+    m_drawMesh->setEnvMapReflecFlag(m_isEnvReflecOn);
+    m_drawMesh->setEnvMapRefracFlag(m_isEnvRefracOn);
+
+    m_drawMesh->setShadowMapFlag(m_isShadowOn);
+    m_drawFloor->setShadowMapFlag(m_isShadowOn);
+    m_drawMesh->setSimTransmitFlag(m_isSimTransmitOn);
+    m_drawMesh->setTSDFlag(m_isTSDOn);
+
+    m_drawMesh->setIBLFlag(m_isIBLOn);
+    m_drawFloor->setIBLFlag(m_isIBLOn);
+
+    m_drawMesh->setLightDirFlag(m_lightType == 1);
+    m_drawFloor->setLightDirFlag(m_lightType == 1);
+}
+
+
+void bakeMeshAO()
+{
+    // the mesh is rigid: its AO is baked once (or read from the cache next to the mesh file), then uploaded in the vertex colors
+    if(m_isAOBaked)
+        return;
+
+    AOBaker aoBaker;
+    if(aoBaker.bake(*m_triMesh, m_meshFile))
+    {
+        m_drawMesh->updateMeshVAO(*m_triMesh);
+        m_isAOBaked = true;
+    }
+}
+
+
 void setupImgui(GLFWwindow *window)
 {
     IMGUI_CHECKVERSION();
@@ -321,10 +673,98 @@ void setupImgui(GLFWwindow *window)
     |                                                     UPDATE                                                  |
     +-------------------------------------------------------------------------------------------------------------*/
 
+void renderFrame()
+{
+    // free the render targets that are not needed anymore
+    m_rtPool->beginFrame();
+
+    // idle updates
+    update();
+
+    // lights of each cluster of the view frustum
+    updateLightClusters();
+
+    // histories of the effects which are not accumulated anymore go back to the pool
+    if(!m_isTemporalOn || !m_isSSAOOn)
+        m_aoHistory->release();
+    if(!m_isTemporalOn || !m_isSSLROn || m_sslrMethod != 0)
+        m_lrHistory->release();
+
+    // declare the passes of the enabled features (passes whose result is not used are culled by the graph)
+    m_frameGraph->reset();
+    m_outputRes = m_frameGraph->importTarget("output", m_outputFBO, m_winWidth, m_winHeight, true);
+    // render shadow map
+    addShadowMapPass();
+    addShadowMomentsPasses();
+    addShadowCascadesPass();
+    // render G-buffer
+    addGBufferPass();
+    // render lighting
+    addLightingPass();
+    // render scene
+    addTSDPasses();
+    // apply screen-space AO
+    addSSAOPasses(); 
+    // apply screen-space reflections
+    addSSLRPasses();
+    // upscale low resolution rendering to the window
+    addOutputPass();
+
+    // cull, schedule and render the passes
+    if(m_frameGraph->compile())
+        m_frameGraph->execute(m_profiler.get());
+
+    // transformations of this frame, to reproject the histories in the next one
+    m_prevModelMatrix = m_modelMatrix;
+    m_prevViewProjMatrix = m_camera.getProjectionMatrix() * m_camera.getViewMatrix();
+    m_frameIndex++;
+}
+
+
 void update()
 {
-    // update model matrix with trackball rotation
-    m_modelMatrix = glm::translate( m_trackball.getRotationMatrix(), -m_centerCoords);
+    if(m_isPathPlaying)
+    {
+        // replay camera/light path: overrides trackball, zoom and light controls
+        applyPathKey( m_cameraPath.evaluate(m_pathTime) );
+    }
+    else
+    {
+        // update model matrix with trackball rotation
+        m_modelMatrix = glm::translate( m_trackball.getRotationMatrix(), -m_centerCoords);
+
+        if(m_isPathRecording)
+            m_cameraPath.addKey( currentPathKey(m_pathTime) );
+    }
+}
+
+
+void applyPathKey(const PathKey& _key)
+{
+    m_modelMatrix = glm::translate( glm::mat4_cast(_key.rotation), -m_centerCoords);
+
+    // update camera
+    m_zoomFactor = _key.zoom;
+    m_ssaoRadius = m_zoomFactor;
+    m_camera.initProjectionMatrix(m_winWidth, m_winHeight, m_zoomFactor, 0);
+
+    // update light source (path radius is relative to scene radius)
+    m_lightSpherePos = glm::vec3(_key.lightSpherePos.x, _key.lightSpherePos.y, _key.lightSpherePos.z * m_radScene);
+    if(m_lightType == 1)
+        m_cameraLight.initViewMatrix(sphericalToEuclidean(glm::vec3(m_lightSpherePos.x, m_lightSpherePos.y, m_lightSpherePosInit.z))+m_centerCoords, m_centerCoords);
+    else
+        m_cameraLight.init(m_lightSpherePos.z - m_lightCamNearRad, m_lightSpherePos.z + m_lightCamFarRad, 45.0f, 1.0f, m_winWidth, m_winHeight, sphericalToEuclidean(m_lightSpherePos)+m_centerCoords, m_centerCoords, m_lightType, m_radScene);
+}
+
+
+PathKey currentPathKey(float _time)
+{
+    PathKey key;
+    key.time = _time;
+    key.rotation = glm::quat_cast( m_trackball.getRotationMatrix() );
+    key.zoom = m_zoomFactor;
+    key.lightSpherePos = glm::vec3(m_lightSpherePos.x, m_lightSpherePos.y, m_lightSpherePos.z / m_radScene);
+    return key;
 }
 
 
@@ -333,18 +773,124 @@ void update()
     |                                                     DISPLAY                                                 |
     +-------------------------------------------------------------------------------------------------------------*/
 
-void displayShadowMap() 
+void sceneBounds(glm::vec3& _min, glm::vec3& _max)
+{
+    // model space bounding box of the mesh, and of the floor quad (see DrawableMesh::createQuadVAO())
+    _min = bBoxMin;
+    _max = bBoxMax;
+    if(m_isFloorOn)
+    {
+        glm::vec3 floorMin(m_centerCoords.x - 2.0f * m_radScene, bBoxMin.y - 0.1f * m_radScene, m_centerCoords.z - 2.0f * m_radScene);
+        glm::vec3 floorMax(m_centerCoords.x + 2.0f * m_radScene, bBoxMin.y - 0.1f * m_radScene, m_centerCoords.z + 2.0f * m_radScene);
+        _min = glm::min(_min, floorMin);
+        _max = glm::max(_max, floorMax);
+    }
+}
+
+
+std::vector<LocalLight> generateLocalLights(int _numLights)
+{
+    // fixed seed: the same lights for a given scene and number of lights
+    std::mt19937 generator(1234);
+    std::uniform_real_distribution<float> random(0.0f, 1.0f);
+
+    // lights spread over the floor, below the top of the mesh (model space, as the main light)
+    float floorY = bBoxMin.y - 0.1f * m_radScene;
+    std::vector<LocalLight> lights(_numLights);
+    for(int l = 0; l < _numLights; l++)
+    {
+        LocalLight& light = lights[l];
+        light.position = glm::vec3(m_centerCoords.x + (random(generator) * 4.0f - 2.0f) * m_radScene,
+                                   floorY + (0.05f + random(generator) * 0.45f) * (bBoxMax.y - floorY),
+                                   m_centerCoords.z + (random(generator) * 4.0f - 2.0f) * m_radScene);
+
+        // saturated color of random hue
+        float hue = random(generator) * 6.0f;
+        glm::vec3 color(std::fabs(hue - 3.0f) - 1.0f, 2.0f - std::fabs(hue - 2.0f), 2.0f - std::fabs(hue - 4.0f));
+        light.color = glm::clamp(color, 0.0f, 1.0f) * 4.0f;
+
+        // one light out of three is a spot pointing to the floor
+        if(l % 3 == 2)
+        {
+            glm::vec3 tilt(random(generator) - 0.5f, 0.0f, random(generator) - 0.5f);
+            light.direction = glm::normalize(glm::vec3(0.0f, -1.0f, 0.0f) + tilt);
+            light.range = (0.6f + random(generator) * 0.4f) * m_radScene;
+            light.cosOuter = std::cos(glm::radians(35.0f));
+            light.cosInner = std::cos(glm::radians(25.0f));
+        }
+        else
+        {
+            light.direction = glm::vec3(0.0f, -1.0f, 0.0f);
+            light.range = (0.3f + random(generator) * 0.3f) * m_radScene;
+            light.cosOuter = -1.0f;
+            light.cosInner = -1.0f;
+        }
+    }
+    return lights;
+}
+
+
+void updateLightClusters()
 {
-    if(m_isShadowOn || m_isSimTransmitOn)
+    if(!m_isLocalLightsOn)
+        return;
+
+    if(m_isLocalLightsDirty)
     {
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_shadowFBO);
+        m_lightClusters.setLights(generateLocalLights(m_numLocalLights));
+        const std::vector<float>& lightData = m_lightClusters.getLightData();
+        updateTextureBuffer(&m_lightDataBuffer, &m_lightDataTex, GL_RGBA32F, lightData.data(), lightData.size() * sizeof(float));
+        m_isLocalLightsDirty = false;
+    }
 
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
+    // the lights are in model space: the camera sees them through the model matrix
+    glm::vec3 sceneMin, sceneMax;
+    sceneBounds(sceneMin, sceneMax);
+    auto start = std::chrono::steady_clock::now();
+    m_lightClusters.build(m_camera.getViewMatrix() * m_modelMatrix, m_camera.getProjectionMatrix(), sceneMin, sceneMax);
+    m_clusterBuildTime = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    const std::vector<uint32_t>& clusters = m_lightClusters.getClusters();
+    const std::vector<uint32_t>& lightIndices = m_lightClusters.getLightIndices();
+    updateTextureBuffer(&m_clustersBuffer, &m_clustersTex, GL_RG32UI, clusters.data(), clusters.size() * sizeof(uint32_t));
+    updateTextureBuffer(&m_lightIndicesBuffer, &m_lightIndicesTex, GL_R32UI, lightIndices.data(), lightIndices.size() * sizeof(uint32_t));
+}
+
+
+std::vector<ShadowCaster> shadowCasters(bool _isFloorCaster)
+{
+    // shadow pass vertices are not transformed: the light matrices are expressed in the model space of the mesh
+    std::vector<ShadowCaster> casters = { { m_drawMesh.get(), glm::mat4(1.0f) } };
+    if(_isFloorCaster)
+        casters.push_back({ m_drawFloor.get(), glm::mat4(1.0f) });
+    return casters;
+}
+
+
+void addShadowMapPass() 
+{
+    // depth texture rendered from light cam (read by PCF shadows without cascades, and by transmission)
+    RenderTargetDesc desc = { (int)TEX_WIDTH, (int)TEX_HEIGHT, GL_NONE, 0, GL_DEPTH_COMPONENT24, true, GL_NEAREST };
+    bool isNeeded = (m_isShadowOn && !m_isCascadedShadowOn && m_shadowMethod == 0) || m_isSimTransmitOn;
 
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    if(m_isShadowCacheOn && isNeeded)
+    {
+        // map kept across frames: the pass is only declared when the light or the casters changed
+        glm::mat4 lvp = m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
+        bool isDirty = m_shadowCache->update(desc, { lvp }, shadowCasters(m_isFloorOn));
+        m_shadowRes = m_frameGraph->importTarget("shadowMap", m_shadowCache->getTarget());
+        if(!isDirty)
+            return;
+    }
+    else
+    {
+        // transient map, rendered every frame (culled if not read)
+        m_shadowCache->release();
+        m_shadowRes = m_frameGraph->createTarget("shadowMap", desc);
+    }
 
+    int pass = m_frameGraph->addPass("ShadowMap", []()
+    {
 //        glEnable(GL_CULL_FACE);   // !! @ TODO ? !!
 //        glCullFace(GL_FRONT);
 
@@ -361,338 +907,777 @@ void displayShadowMap()
 
 //        glCullFace(GL_BACK);
 //        glDisable(GL_CULL_FACE);
-
-
-        // Bind default framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // resize viewport to window dimensions
-        glViewport(0, 0, m_winWidth, m_winHeight);
-    }
-
+    });
+    m_frameGraph->write(pass, m_shadowRes, GL_DEPTH_BUFFER_BIT);
 }
 
 
-void displayGBuffering()
+void addShadowMomentsPasses()
 {
-    // generate G-buffer only if SSAO is activated
-    if( m_isSSAOOn || m_isSSLROn )
+    m_momentRes = -1;
+    if(!m_isShadowOn || m_isCascadedShadowOn || m_shadowMethod == 0)
     {
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_gFBO);
-
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
-
-        // switch background to black to make sure empty fragments are not processed
-        glClearColor(0.0f, 0.0f, 0.0f, 0.0);    
+        m_momentCache->release();
+        return;
+    }
 
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    // moments of the depth (VSM only needs two), with mip levels for the minified areas of the shadow map
+    GLenum format = (m_shadowMethod == 1) ? GL_RG32F : GL_RGBA32F;
+    RenderTargetDesc desc = { MOMENT_MAP_SIZE, MOMENT_MAP_SIZE, format, 1, GL_NONE, false, GL_LINEAR };
+    RenderTargetDesc filteredDesc = desc;
+    filteredDesc.numLevels = numMipLevels(desc, 32);
 
+    if(m_isShadowCacheOn)
+    {
+        // the filtering is done once per light or caster change, not once per frame
+        glm::mat4 lvp = m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
+        bool isDirty = m_momentCache->update(filteredDesc, { lvp }, shadowCasters(m_isFloorOn));
+        m_momentRes = m_frameGraph->importTarget("shadowMoments", m_momentCache->getTarget());
+        if(!isDirty)
+            return;
+    }
+    else
+    {
+        m_momentCache->release();
+        m_momentRes = m_frameGraph->createTarget("shadowMoments", filteredDesc);
+    }
 
-        glm::mat4 modelMat = m_modelMatrix;
-        glm::mat4 viewMat = m_camera.getViewMatrix();
-        glm::mat4 projMat = m_camera.getProjectionMatrix();
+    // moments rendered from light cam (with a depth buffer), cleared to the moments of the far plane
+    RenderTargetDesc renderDesc = desc;
+    renderDesc.depthFormat = GL_DEPTH_COMPONENT24;
+    int renderRes = m_frameGraph->createTarget("shadowMomentsRender", renderDesc);
 
-        // draw objects
-        m_drawMesh->drawGbuffer(m_programGbuffer, modelMat, viewMat, projMat, false);
+    int method = m_shadowMethod;
+    int pass = m_frameGraph->addPass("ShadowMoments", [method]()
+    {
+        glm::mat4 lvp = m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
 
-//        if(m_isFloorOn)
-//            m_drawFloor->drawGbuffer(m_programGbuffer, modelMat, viewMat, projMat, true);
+        m_drawMesh->drawShadowMoments(m_programShadowMoments, lvp, method);
+        if(m_isFloorOn)
+            m_drawFloor->drawShadowMoments(m_programShadowMoments, lvp, method);
+    });
+    m_frameGraph->write(pass, renderRes, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, farPlaneMoments(method));
 
+    // separable blur (penumbra), computed once per shadow map texel instead of per shaded fragment
+    int blurHRes = m_frameGraph->createTarget("shadowMomentsBlurH", desc);
+    int filterWidth = m_shadowSoftness;
 
-        // Bind default framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // resize viewport to window dimensions
-        glViewport(0, 0, m_winWidth, m_winHeight);
+    pass = m_frameGraph->addPass("ShadowMomentsBlurH", [renderRes, blurHRes, filterWidth]()
+    {
+        drawBlur(renderRes, blurHRes, true, filterWidth, false);
+    }, true);
+    m_frameGraph->read(pass, renderRes);
+    m_frameGraph->write(pass, blurHRes);
 
+    int momentRes = m_momentRes;
+    pass = m_frameGraph->addPass("ShadowMomentsBlurV", [blurHRes, momentRes, filterWidth]()
+    {
+        drawBlur(blurHRes, momentRes, false, filterWidth, false);
+
+        // moments can be averaged: mip levels and trilinear filtering
+        glBindTexture(GL_TEXTURE_2D, m_frameGraph->getTexture(momentRes));
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glBindTexture(GL_TEXTURE_2D, 0);
+    }, true);
+    m_frameGraph->read(pass, blurHRes);
+    m_frameGraph->write(pass, m_momentRes);
+}
 
-        if(m_isBackgroundWhite)
-            glClearColor(1.0f, 1.0f, 1.0f, 0.0);
-        else
-            glClearColor(0.0f, 0.0f, 0.0f, 0.0);
 
+glm::vec4 farPlaneMoments(int _method)
+{
+    // moments of depth 1 (as written by shadowMoments.frag): no occluder
+    if(_method == 2)
+    {
+        // EVSM exponents of shadowMoments.frag
+        float pos = std::exp(40.0f), neg = -std::exp(-5.0f);
+        return glm::vec4(pos, pos * pos, neg, neg * neg);
     }
+    if(_method == 3)
+        return glm::vec4(1.0f);
+    return glm::vec4(1.0f, 1.0f, 0.0f, 0.0f);
 }
 
 
-void displayLighting()
+void addShadowCascadesPass()
 {
-    
-    if( m_isTSDOn )
+    m_cascadeRes = -1;
+    if(!m_isShadowOn || !m_isCascadedShadowOn)
     {
-        // Bind dedicated FBO if the results must be saved in mesh texture for TSD
+        m_cascadeCache->release();
+        return;
+    }
 
-        if (m_modelType != 1 && m_modelType != 2) 
-            errorLog() << "Main::Display(): Cannot apply texture space diffusion without UV map";
+    // the only caster is the mesh, the floor only receives shadows
+    glm::vec3 receiverMin, receiverMax;
+    sceneBounds(receiverMin, receiverMax);
+
+    // shadow pass vertices are in model space: the camera sees them through the model matrix
+    m_shadowCascades.setNumCascades(m_numCascades);
+    m_shadowCascades.update(m_camera.getViewMatrix() * m_modelMatrix, m_camera.getProjectionMatrix(),
+                            m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix(), bBoxMin, bBoxMax, receiverMin, receiverMax);
 
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_tsdFBO);
+    int numCascades = m_shadowCascades.getNumCascades();
+    RenderTargetDesc desc = { CASCADE_MAP_SIZE, CASCADE_MAP_SIZE, GL_NONE, 0, GL_DEPTH_COMPONENT24, true, GL_NEAREST };
+    desc.numLayers = numCascades;
 
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
+    if(m_isShadowCacheOn)
+    {
+        // the cascades follow the camera: they are only reused while both the camera and the light are still
+        std::vector<glm::mat4> matrices(m_shadowCascades.getMatrices(), m_shadowCascades.getMatrices() + numCascades);
+        bool isDirty = m_cascadeCache->update(desc, matrices, shadowCasters(false));
+        m_cascadeRes = m_frameGraph->importTarget("shadowCascades", m_cascadeCache->getTarget());
+        if(!isDirty)
+            return;
     }
-    else if( m_isSSAOOn || m_isSSLROn )
+    else
     {
-        // Bind dedicated FBO if the results must be saved in screen-space texture for future rendering steps
-
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_screenFBO);
-
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
+        m_cascadeCache->release();
+        m_cascadeRes = m_frameGraph->createTarget("shadowCascades", desc);
     }
 
+    int cascadeRes = m_cascadeRes;
+    int pass = m_frameGraph->addPass("ShadowCascades", [cascadeRes, numCascades]()
+    {
+        // the layers are cleared together, then rendered one at a time
+        GLuint cascadeMaps = m_frameGraph->getDepthTexture(cascadeRes);
+        for(int c = 0; c < numCascades; c++)
+        {
+            glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeMaps, 0, c);
+            glm::mat4 lvp = m_shadowCascades.getMatrices()[c];
+            m_drawMesh->drawShadow(m_programShadow, lvp);
+        }
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, cascadeMaps, 0);
+    });
+    m_frameGraph->write(pass, m_cascadeRes, GL_DEPTH_BUFFER_BIT);
+}
 
-    m_drawMesh->setShadowMap(m_shadowMapTex);
-    m_drawFloor->setShadowMap(m_shadowMapTex);
-
-    // Clear window with background color
-    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
+bool isDeferredShading()
+{
+    // environment mapping, transmission and texture space diffusion are only computed by the forward pass
+    return m_isDeferredOn && !m_isEnvMapOn && !m_isSimTransmitOn && !m_isTSDOn;
+}
 
 
-    // build ModelView matrix
-    glm::mat4 mv = m_camera.getViewMatrix() * m_modelMatrix;
-    // build ModelViewProjection matrix
-    glm::mat4 projection = m_camera.getProjectionMatrix();
-    glm::mat4 mvp = projection * mv;
+void addGBufferPass()
+{
+    // depth, normal and diffuse color (+ roughness) textures (read without filtering), and reflectivity (+ AO) for deferred
+    // shading: 12 bytes per pixel, 16 with deferred shading (culled if neither SSAO, SSLR nor deferred shading read it)
+    bool isDeferred = isDeferredShading();
+    m_gBufferRes = m_frameGraph->createTarget("gBuffer", gBufferTargetDesc(isDeferred ? 3 : 2));
 
-     
-    glm::mat4 modelMat = m_modelMatrix;
+    int pass = m_frameGraph->addPass("GBuffering", [isDeferred]()
+    {
+        glm::mat4 modelMat = m_modelMatrix;
+        glm::mat4 viewMat = m_camera.getViewMatrix();
+        glm::mat4 projMat = m_camera.getProjectionMatrix();
 
-    glm::mat4 viewMat = m_camera.getViewMatrix();
-    glm::mat4 projMat = m_camera.getProjectionMatrix();
+        // the passes reading the G-buffer reconstruct positions from depth with the same matrices
+        m_drawQuad->setGBufferViewProj(projMat * viewMat);
 
-    glm::mat4 lightSpaceMat =  m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
+        // the floor is only shaded from the G-buffer with deferred shading (screen-space effects skip it otherwise)
+        bool isFloorDrawn = m_isFloorOn && isDeferred;
+        std::vector<DrawableMesh*> meshes = { m_drawMesh.get() };
+        if(isFloorDrawn)
+            meshes.push_back(m_drawFloor.get());
 
+        // draw objects
+        drawWithPrepass(m_gBufferPrepass.get(), meshes, [&]()
+        {
+            m_drawMesh->drawGbuffer(m_programGbuffer, modelMat, viewMat, projMat, false);
+            if(isFloorDrawn)
+                m_drawFloor->drawGbuffer(m_programGbuffer, modelMat, viewMat, projMat, true);
+        });
+    });
+    // black background to make sure empty fragments are not processed
+    m_frameGraph->write(pass, m_gBufferRes, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, glm::vec4(0.0f));
+}
 
-    // draw objects
-    glm::vec3 lightEuclidPos = GLtools::sphericalToEuclidean(m_lightSpherePos);
-    m_drawMesh->draw(m_programLighting, modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
 
-    if(m_isFloorOn && !m_isTSDOn)
-        m_drawFloor->draw(m_programLighting, modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
+void setLightingInputs(int _shadowRes, int _cascadeRes, int _momentRes)
+{
+    // shadow maps and local lights, read by the forward pass (mesh and floor) or by the deferred pass (screen quad)
+    GLuint shadowMapTex = (_shadowRes != -1) ? m_frameGraph->getDepthTexture(_shadowRes) : 0;
+    GLuint momentMap = (_momentRes != -1) ? m_frameGraph->getTexture(_momentRes) : 0;
+    int shadowMethod = (_momentRes != -1) ? m_shadowMethod : 0;
+    GLuint cascadeMaps = (_cascadeRes != -1) ? m_frameGraph->getDepthTexture(_cascadeRes) : 0;
+    int numCascades = (_cascadeRes != -1) ? m_shadowCascades.getNumCascades() : 0;
+
+    // local lights of each cluster (see updateLightClusters())
+    int numLocalLights = m_isLocalLightsOn ? m_numLocalLights : 0;
+    glm::ivec3 clusterGrid(LightClusters::GRID_X, LightClusters::GRID_Y, LightClusters::GRID_Z);
+
+    for(DrawableMesh* mesh : { m_drawMesh.get(), m_drawFloor.get(), m_drawQuad.get() })
+    {
+        mesh->setShadowMap(shadowMapTex);
+        mesh->setShadowMoments(momentMap, shadowMethod);
+        mesh->setShadowCascades(cascadeMaps, numCascades, m_shadowCascades.getMatrices(), m_shadowCascades.getSplits());
+        mesh->setLightClusters(m_lightDataTex, m_clustersTex, m_lightIndicesTex, numLocalLights, clusterGrid, m_lightClusters.getDepthParams());
+    }
+}
 
 
-    // draw sky box
-    if(m_isEnvMapOn && !m_isTSDOn)
+void drawWithPrepass(DepthPrepass* _prepass, const std::vector<DrawableMesh*>& _meshes, const std::function<void()>& _drawShading)
+{
+    if(_prepass == nullptr)
     {
-        glm::mat4 v = glm::mat4(glm::mat3( m_camera.getViewMatrix() )) * m_modelMatrix;
-        //glm::mat4 v = m_camera.getViewMatrix() ;
-        glm::mat4 p = m_cstProjMatrix;// m_camera.getProjectionMatrix();
-
-        m_drawSkybox->drawSkyBox(m_programSkybox, v, p);
+        _drawShading();
+        return;
     }
 
-
-    if( m_isTSDOn || m_isSSAOOn || m_isSSLROn)
+    // depth of the closest surfaces first (shadow map shaders), if the overdraw makes it pay off
+    if(_prepass->begin())
     {
-        // Bind default framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // resize viewport to window dimensions
-        glViewport(0, 0, m_winWidth, m_winHeight);
+        glm::mat4 modelMat = m_modelMatrix;
+        glm::mat4 viewMat = m_camera.getViewMatrix();
+        glm::mat4 projMat = m_camera.getProjectionMatrix();
+
+        for(DrawableMesh* mesh : _meshes)
+            mesh->drawDepth(m_programShadow, modelMat, viewMat, projMat);
     }
+
+    // then the shading draws, once per pixel after a pre-pass
+    _prepass->beginShading();
+    _drawShading();
+    _prepass->end();
 }
 
 
-void displayTSD()
+void addLightingPass()
 {
+    int target;
     if( m_isTSDOn )
     {
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-     
-        glm::mat4 modelMat = m_modelMatrix;
-        glm::mat4 viewMat = m_camera.getViewMatrix();
-        glm::mat4 projMat = m_camera.getProjectionMatrix();
+        // results are saved in mesh texture for TSD
 
+        if (m_modelType != 1 && m_modelType != 2) 
+            errorLog() << "Main::Display(): Cannot apply texture space diffusion without UV map";
 
-        // re-use FBO to overwrite tsdTex
-        glBindFramebuffer(GL_FRAMEBUFFER, m_tsdFBO);
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
-        m_drawQuad->drawScreenQuad(m_programQuad, m_tsdTex, true, true, m_filterWidth);
-        m_drawQuad->drawScreenQuad(m_programQuad, m_tsdTex, true, false, m_filterWidth);
+        // texture space output (null alpha outside of the UV map is used as a mask by the TSD blur)
+        RenderTargetDesc desc = { (int)TEX_WIDTH, (int)TEX_HEIGHT, GL_RGBA16F, 1, GL_NONE, false, GL_NEAREST };
+        m_tsdRes = m_frameGraph->createTarget("tsdLighting", desc);
+        target = m_tsdRes;
+    }
+    else
+    {
+        // color texture read by the next passes (bilinear upscaling), with depth buffer.
+        // Written directly to the output if there are no screen-space effects and no upscaling
+        m_sceneRes = m_frameGraph->createTarget("scene", sceneTargetDesc());
+        m_colorRes = m_sceneRes;
+        target = m_sceneRes;
+    }
 
+    // the single shadow map is still used by transmission when the shadows are cascaded or filtered
+    int shadowRes = ((m_isShadowOn && m_cascadeRes == -1 && m_momentRes == -1) || m_isSimTransmitOn) ? m_shadowRes : -1;
+    int cascadeRes = m_cascadeRes;
+    int momentRes = m_momentRes;
 
-        if( m_isSSAOOn || m_isSSLROn )
+    if(isDeferredShading())
+    {
+        // shade every pixel of the G-buffer once, whatever the overdraw of the scene
+        int gBufferRes = m_gBufferRes;
+        int pass = m_frameGraph->addPass("DeferredLighting", [shadowRes, cascadeRes, momentRes, gBufferRes]()
         {
-            // Bind dedicated FBO if the results must be saved in screen-space texture for future rendering steps
+            setLightingInputs(shadowRes, cascadeRes, momentRes);
+            m_drawQuad->setShadowMapFlag(m_isShadowOn);
+            m_drawQuad->setIBLFlag(m_isIBLOn);
+            m_drawQuad->setLightDirFlag(m_lightType == 1);
+
+            glm::mat4 modelMat = m_modelMatrix;
+            glm::mat4 viewMat = m_camera.getViewMatrix();
+            glm::mat4 projMat = m_camera.getProjectionMatrix();
+            glm::mat4 lightSpaceMat =  m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
+            glm::vec3 lightEuclidPos = GLtools::sphericalToEuclidean(m_lightSpherePos);
 
-            // bind dedicated FBO
-            glBindFramebuffer(GL_FRAMEBUFFER, m_screenFBO);
+            m_drawQuad->drawDeferredLighting(m_programDeferred, m_frameGraph->getDepthTexture(gBufferRes), m_frameGraph->getTexture(gBufferRes, 0),
+                                             m_frameGraph->getTexture(gBufferRes, 1), m_frameGraph->getTexture(gBufferRes, 2),
+                                             modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
+        }, true);
+        m_frameGraph->read(pass, gBufferRes);
+        if(shadowRes != -1)
+            m_frameGraph->read(pass, shadowRes);
+        if(cascadeRes != -1)
+            m_frameGraph->read(pass, cascadeRes);
+        if(momentRes != -1)
+            m_frameGraph->read(pass, momentRes);
+        m_frameGraph->write(pass, target, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, backgroundColor());
+        return;
+    }
 
-            // resize viewport to output texture dimension
-            glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
-        }
-        else
-        {
-            // Bind default framebuffer if there is no future rendering steps
+    int pass = m_frameGraph->addPass("Lighting", [shadowRes, cascadeRes, momentRes]()
+    {
+        setLightingInputs(shadowRes, cascadeRes, momentRes);
 
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            glViewport(0, 0, m_winWidth, m_winHeight);
-        }
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        // build ModelView matrix
+        glm::mat4 mv = m_camera.getViewMatrix() * m_modelMatrix;
+        // build ModelViewProjection matrix
+        glm::mat4 projection = m_camera.getProjectionMatrix();
+        glm::mat4 mvp = projection * mv;
 
-        //m_drawQuad->drawScreenQuad(m_programQuad, modelMat, viewMat, projMat, m_tsdTex, false);
-        m_drawMesh->drawTex(m_programTex, modelMat, viewMat, projMat, m_tsdTex);
+     
+        glm::mat4 modelMat = m_modelMatrix;
 
+        glm::mat4 viewMat = m_camera.getViewMatrix();
+        glm::mat4 projMat = m_camera.getProjectionMatrix();
 
         glm::mat4 lightSpaceMat =  m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
 
-        // draw floor
-        if(m_isFloorOn)
+
+        // draw objects (the floor is drawn by the TSD pass with texture space diffusion)
+        glm::vec3 lightEuclidPos = GLtools::sphericalToEuclidean(m_lightSpherePos);
+        std::vector<DrawableMesh*> meshes = { m_drawMesh.get() };
+        if(m_isFloorOn && !m_isTSDOn)
+            meshes.push_back(m_drawFloor.get());
+
+        // no depth pre-pass in texture space (no depth buffer)
+        drawWithPrepass(m_isTSDOn ? nullptr : m_lightingPrepass.get(), meshes, [&]()
         {
-            glm::vec3 lightEuclidPos = GLtools::sphericalToEuclidean(m_lightSpherePos);
-            m_drawFloor->draw(m_programLighting, modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
-        }
+            for(DrawableMesh* mesh : meshes)
+                mesh->draw(m_programLighting, modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
+        });
 
-        // draw skybox
-        if(m_isEnvMapOn)
+
+        // draw sky box
+        if(m_isEnvMapOn && !m_isTSDOn)
         {
             glm::mat4 v = glm::mat4(glm::mat3( m_camera.getViewMatrix() )) * m_modelMatrix;
-            glm::mat4 p = m_cstProjMatrix;
+            //glm::mat4 v = m_camera.getViewMatrix() ;
+            glm::mat4 p = m_cstProjMatrix;// m_camera.getProjectionMatrix();
 
             m_drawSkybox->drawSkyBox(m_programSkybox, v, p);
         }
+    });
+    if(shadowRes != -1)
+        m_frameGraph->read(pass, shadowRes);
+    if(cascadeRes != -1)
+        m_frameGraph->read(pass, cascadeRes);
+    if(momentRes != -1)
+        m_frameGraph->read(pass, momentRes);
+    m_frameGraph->write(pass, target, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, backgroundColor());
+}
 
-        // Bind default framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // resize viewport to window dimensions
-        glViewport(0, 0, m_winWidth, m_winHeight);
-    }
 
-}
+void addTSDPasses()
+{
+    if( !m_isTSDOn )
+        return;
 
+    // texture space blur (separate targets for each direction, so a pass never samples the texture it writes)
+    const RenderTargetDesc& desc = m_frameGraph->getDesc(m_tsdRes);
+    int blurHRes = m_frameGraph->createTarget("tsdBlurH", desc);
+    int blurVRes = m_frameGraph->createTarget("tsdBlurV", desc);
 
+    int tsdRes = m_tsdRes;
+    int pass = m_frameGraph->addPass("TSDBlurH", [tsdRes, blurHRes]()
+    {
+        drawBlur(tsdRes, blurHRes, true, m_filterWidth, true);
+    }, true);
+    m_frameGraph->read(pass, tsdRes);
+    m_frameGraph->write(pass, blurHRes);
 
-void displaySSAO()
-{
-    if( m_isSSAOOn )
+    pass = m_frameGraph->addPass("TSDBlurV", [blurHRes, blurVRes]()
     {
+        drawBlur(blurHRes, blurVRes, false, m_filterWidth, true);
+    }, true);
+    m_frameGraph->read(pass, blurHRes);
+    m_frameGraph->write(pass, blurVRes);
+
+
+    // render mesh with the blurred texture
+    m_sceneRes = m_frameGraph->createTarget("scene", sceneTargetDesc());
+    m_colorRes = m_sceneRes;
 
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_SSAOFBO);
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
+    int shadowRes = (m_isShadowOn && m_cascadeRes == -1 && m_momentRes == -1) ? m_shadowRes : -1;
+    int cascadeRes = m_cascadeRes;
+    int momentRes = m_momentRes;
 
-        // switch background to white to make sure empty fragments do not disapear after applying AO factor to color
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0); 
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
- 
+    pass = m_frameGraph->addPass("TSD", [blurVRes]()
+    {
         glm::mat4 modelMat = m_modelMatrix;
         glm::mat4 viewMat = m_camera.getViewMatrix();
         glm::mat4 projMat = m_camera.getProjectionMatrix();
 
-        // generate SSAO texture
-        m_drawQuad->drawScreenQuadSSAO(m_programSSAO, projMat, m_gPosition, m_gNormal, m_ssaoRadius, (float)m_winWidth, (float)m_winHeight);
-
+        glm::mat4 lightSpaceMat =  m_cameraLight.getProjectionMatrix() * m_cameraLight.getViewMatrix();
+        glm::vec3 lightEuclidPos = GLtools::sphericalToEuclidean(m_lightSpherePos);
 
-        // bind Appropriate FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_BlurFBO);
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT); 
-        // SSAO texture blurring
-        m_drawQuad->drawScreenQuad(m_programQuad, m_SSAOTex, true, true, 4);
-        m_drawQuad->drawScreenQuad(m_programQuad, m_BlurTex, true, false, 4);
+        std::vector<DrawableMesh*> meshes = { m_drawMesh.get() };
+        if(m_isFloorOn)
+            meshes.push_back(m_drawFloor.get());
 
-        if( m_isSSLROn ) 
+        drawWithPrepass(m_tsdPrepass.get(), meshes, [&]()
         {
-            // Bind dedicated FBO if the results must be saved in screen-space texture for future rendering steps
+            //m_drawQuad->drawScreenQuad(m_programQuad, modelMat, viewMat, projMat, m_tsdTex, false);
+            m_drawMesh->drawTex(m_programTex, modelMat, viewMat, projMat, m_frameGraph->getTexture(blurVRes));
 
-            // bind dedicated FBO
-            glBindFramebuffer(GL_FRAMEBUFFER, m_SSAOFBO);
-            // resize viewport to output texture dimension
-            glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
-        }
-        else
+            // draw floor (shadow map set by the lighting pass)
+            if(m_isFloorOn)
+                m_drawFloor->draw(m_programLighting, modelMat, viewMat, projMat, lightEuclidPos, m_camPos, m_lightCol, lightSpaceMat, m_maxDistLight);
+        });
+
+        // draw skybox
+        if(m_isEnvMapOn)
         {
-            // Bind default framebuffer if there is no future rendering steps
+            glm::mat4 v = glm::mat4(glm::mat3( m_camera.getViewMatrix() )) * m_modelMatrix;
+            glm::mat4 p = m_cstProjMatrix;
 
-            // Bind default framebuffer
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
-            // resize viewport to window dimensions
-            glViewport(0, 0, m_winWidth, m_winHeight); 
+            m_drawSkybox->drawSkyBox(m_programSkybox, v, p);
         }
+    });
+    m_frameGraph->read(pass, blurVRes);
+    if(shadowRes != -1)
+        m_frameGraph->read(pass, shadowRes);
+    if(cascadeRes != -1)
+        m_frameGraph->read(pass, cascadeRes);
+    if(momentRes != -1)
+        m_frameGraph->read(pass, momentRes);
+    m_frameGraph->write(pass, m_sceneRes, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, backgroundColor());
+}
+
 
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+int addBlurPasses(const std::string& _name, int _srcRes, int _filterWidth)
+{
+    // separable blur of a screen-space texture (screen quads only: no depth buffer, no clear), without mask
+    int blurHRes = m_frameGraph->createTarget(_name + "BlurH", screenTargetDesc(1, false, GL_LINEAR));
+    int blurVRes = m_frameGraph->createTarget(_name + "BlurV", screenTargetDesc(1, false, GL_LINEAR));
 
-        // Draw screen Texture + SSAO
-        m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_BlurTex, m_screenTex, 1);// occ_type = ssao
+    int pass = m_frameGraph->addPass(_name + "BlurH", [_srcRes, blurHRes, _filterWidth]()
+    {
+        drawBlur(_srcRes, blurHRes, true, _filterWidth, false);
+    }, true);
+    m_frameGraph->read(pass, _srcRes);
+    m_frameGraph->write(pass, blurHRes);
 
+    pass = m_frameGraph->addPass(_name + "BlurV", [blurHRes, blurVRes, _filterWidth]()
+    {
+        drawBlur(blurHRes, blurVRes, false, _filterWidth, false);
+    }, true);
+    m_frameGraph->read(pass, blurHRes);
+    m_frameGraph->write(pass, blurVRes);
 
-        if(m_isBackgroundWhite)
-            glClearColor(1.0f, 1.0f, 1.0f, 0.0);
-        else
-            glClearColor(0.0f, 0.0f, 0.0f, 0.0);
+    return blurVRes;
+}
+
+
+void drawBlur(int _srcRes, int _dstRes, bool _isHorizontal, int _filterWidth, bool _isMasked)
+{
+    // compute shader: source and result must have the same size, and the result must be writable as an image
+    const RenderTargetDesc& srcDesc = m_frameGraph->getDesc(_srcRes);
+    const RenderTargetDesc& dstDesc = m_frameGraph->getDesc(_dstRes);
+    bool isComputeBlur = m_computeBlur && m_isComputeBlurOn && ComputeBlur::isFormatSupported(dstDesc.colorFormat) &&
+                         srcDesc.width == dstDesc.width && srcDesc.height == dstDesc.height;
+
+    if(isComputeBlur)
+        m_computeBlur->blur(m_frameGraph->getTexture(_srcRes), m_frameGraph->getTexture(_dstRes), dstDesc.width, dstDesc.height,
+                            _isHorizontal, _filterWidth, _isMasked);
+    else
+        m_drawQuad->drawScreenQuad(m_programQuad, m_frameGraph->getTexture(_srcRes), true, _isHorizontal, _filterWidth, _isMasked);
+}
 
 
+void temporalSamplePattern(int& _kernelSize, int& _kernelOffset, float& _noiseAngle)
+{
+    if(m_isTemporalOn)
+    {
+        // a different subset of the kernel every frame (the whole kernel in KERNEL_SIZE / TEMPORAL_KERNEL_SIZE frames),
+        // and noise rotated by the golden angle so that successive patterns do not repeat
+        int numSubsets = KERNEL_SIZE / TEMPORAL_KERNEL_SIZE;
+        _kernelSize = TEMPORAL_KERNEL_SIZE;
+        _kernelOffset = (int)(m_frameIndex % numSubsets) * TEMPORAL_KERNEL_SIZE;
+        _noiseAngle = (float)(m_frameIndex % 64) * 2.39996323f;
+    }
+    else
+    {
+        _kernelSize = KERNEL_SIZE;
+        _kernelOffset = 0;
+        _noiseAngle = 0.0f;
     }
 }
 
 
+int addTemporalPass(const std::string& _name, int _currentRes, int _geomRes, TemporalHistory& _history)
+{
+    // accumulated result of this frame, kept (with the view depth in alpha) to be reprojected in the next one
+    _history.update(m_frameGraph->getDesc(_currentRes), m_frameIndex);
+    int historyRes = m_frameGraph->importTarget(_name + "History", _history.getCurrent());
+    GLuint prevTex = _history.getPrevious()->colorTex[0];
+    bool isHistoryValid = _history.isValid();
+
+    int pass = m_frameGraph->addPass(_name + "Temporal", [_currentRes, _geomRes, prevTex, isHistoryValid]()
+    {
+        // G-buffer positions are transformed by the model matrix (trackball): back to the mesh, then to the previous frame
+        glm::mat4 reprojMat = m_prevModelMatrix * glm::inverse(m_modelMatrix);
+        glm::mat4 viewProjMat = m_camera.getProjectionMatrix() * m_camera.getViewMatrix();
+
+        m_drawQuad->drawScreenQuadTemporal(m_programTemporal, m_frameGraph->getTexture(_currentRes), prevTex, m_frameGraph->getDepthTexture(_geomRes),
+                                           reprojMat, viewProjMat, m_prevViewProjMatrix, TEMPORAL_BLEND, isHistoryValid);
+    }, true);
+    m_frameGraph->read(pass, _currentRes);
+    m_frameGraph->read(pass, _geomRes);
+    m_frameGraph->write(pass, historyRes);
+
+    return historyRes;
+}
+
 
-void displaySSLR()
+void addSSAOPasses()
 {
-    if( m_isSSLROn )
+    if( !m_isSSAOOn )
+        return;
+
+    int factor = m_ssaoDownsampling;
+    int gBufferRes = m_gBufferRes;
+
+    // depth and normal used by SSAO: G-buffer at full resolution, or downsampled copy (same encoding)
+    int geomRes = gBufferRes;
+    if(factor > 1)
+    {
+        geomRes = m_frameGraph->createTarget("gBufferLow", gBufferTargetDesc(1, factor));
+
+        // not a fullscreen pass: the depth test is needed to write the depth (empty texels keep the cleared far depth)
+        int pass = m_frameGraph->addPass("SSAODownsample", [gBufferRes, factor]()
+        {
+            m_drawQuad->drawScreenQuadDownsample(m_programSSAODownsample, m_frameGraph->getDepthTexture(gBufferRes), m_frameGraph->getTexture(gBufferRes, 0), factor);
+        });
+        m_frameGraph->read(pass, gBufferRes);
+        m_frameGraph->write(pass, geomRes, GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT, glm::vec4(0.0f));
+    }
+
+    // generate SSAO texture (every pixel is written, so no clear is needed)
+    int ssaoRes = m_frameGraph->createTarget("ssao", screenTargetDesc(1, false, GL_LINEAR, factor));
+    int pass;
+
+    if(m_aoMethod == 1)
+    {
+        // hierarchical (min) linear depth buffer at the AO resolution
+        int hiZRes = addHiZPass("HiZ", geomRes, factor, HIZ_MAX_LEVELS);
+
+        // horizon search through the Hi-Z levels
+        pass = m_frameGraph->addPass("GTAO", [geomRes, hiZRes]()
+        {
+            glm::mat4 projMat = m_camera.getProjectionMatrix();
+            // with temporal accumulation: a single slice (8 taps), rotated every frame
+            m_drawQuad->drawScreenQuadGTAO(m_programGTAO, projMat, m_frameGraph->getTexture(hiZRes), m_frameGraph->getDepthTexture(geomRes), m_frameGraph->getTexture(geomRes, 0),
+                                           m_ssaoRadius, m_frameGraph->getDesc(hiZRes).numLevels, m_isTemporalOn ? 1 : 4, m_isTemporalOn ? (int)(m_frameIndex % 64) : 0);
+        }, true);
+        m_frameGraph->read(pass, hiZRes);
+        m_frameGraph->read(pass, geomRes);
+        m_frameGraph->write(pass, ssaoRes);
+    }
+    else
+    {
+        pass = m_frameGraph->addPass("SSAO", [geomRes, ssaoRes]()
+        {
+            glm::mat4 projMat = m_camera.getProjectionMatrix();
+            const RenderTargetDesc& desc = m_frameGraph->getDesc(ssaoRes);
+            int kernelSize, kernelOffset;
+            float noiseAngle;
+            temporalSamplePattern(kernelSize, kernelOffset, noiseAngle);
+            m_drawQuad->drawScreenQuadSSAO(m_programSSAO, projMat, m_frameGraph->getDepthTexture(geomRes), m_frameGraph->getTexture(geomRes, 0),
+                                           m_ssaoRadius, (float)desc.width, (float)desc.height, kernelSize, kernelOffset, noiseAngle);
+        }, true);
+        m_frameGraph->read(pass, geomRes);
+        m_frameGraph->write(pass, ssaoRes);
+    }
+
+    // accumulate over frames (the history already averages many samples: the blur can be narrower)
+    int aoRes = ssaoRes;
+    int filterWidth = 4;
+    if(m_isTemporalOn)
+    {
+        aoRes = addTemporalPass("SSAO", ssaoRes, geomRes, *m_aoHistory);
+        filterWidth = 2;
+    }
+
+    // SSAO texture blurring, without crossing silhouettes and creases
+    int blurHRes = m_frameGraph->createTarget("SSAOBlurH", screenTargetDesc(1, false, GL_LINEAR, factor));
+    int blurVRes = m_frameGraph->createTarget("SSAOBlurV", screenTargetDesc(1, false, GL_LINEAR, factor));
+
+    pass = m_frameGraph->addPass("SSAOBlurH", [aoRes, geomRes, filterWidth]()
+    {
+        m_drawQuad->drawScreenQuadBilateral(m_programSSAOBlur, m_frameGraph->getTexture(aoRes), m_frameGraph->getDepthTexture(geomRes), m_frameGraph->getTexture(geomRes, 0), true, filterWidth);
+    }, true);
+    m_frameGraph->read(pass, aoRes);
+    m_frameGraph->read(pass, geomRes);
+    m_frameGraph->write(pass, blurHRes);
+
+    pass = m_frameGraph->addPass("SSAOBlurV", [blurHRes, geomRes, filterWidth]()
     {
+        m_drawQuad->drawScreenQuadBilateral(m_programSSAOBlur, m_frameGraph->getTexture(blurHRes), m_frameGraph->getDepthTexture(geomRes), m_frameGraph->getTexture(geomRes, 0), false, filterWidth);
+    }, true);
+    m_frameGraph->read(pass, blurHRes);
+    m_frameGraph->read(pass, geomRes);
+    m_frameGraph->write(pass, blurVRes);
 
-        // bind dedicated FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_SSLRFBO);
-        // resize viewport to output texture dimension
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT);
+    // Draw screen Texture + SSAO (joint bilateral upsampling of reduced resolution SSAO)
+    int colorRes = m_colorRes;
+    m_colorRes = m_frameGraph->createTarget("sceneAO", screenTargetDesc(1, false, GL_LINEAR));
 
-        // switch background to white to make sure empty fragments do not disapear after applying AO factor to color
-        glClearColor(1.0f, 1.0f, 1.0f, 1.0); 
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
- 
+    pass = m_frameGraph->addPass("SSAOComposite", [blurVRes, colorRes, gBufferRes, geomRes, factor]()
+    {
         glm::mat4 modelMat = m_modelMatrix;
         glm::mat4 viewMat = m_camera.getViewMatrix();
         glm::mat4 projMat = m_camera.getProjectionMatrix();
 
-        // generate SSLR texture
-        m_drawQuad->drawScreenQuadSSLR(m_programSSLR, modelMat, viewMat, projMat, m_gPosition, m_gNormal, m_screenTex, m_ssaoRadius, (float)m_winWidth, (float)m_winHeight);
+        if(factor > 1)
+            m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_frameGraph->getTexture(blurVRes), m_frameGraph->getTexture(colorRes), 1,
+                                            m_frameGraph->getDepthTexture(gBufferRes), m_frameGraph->getTexture(gBufferRes, 0),
+                                            m_frameGraph->getDepthTexture(geomRes), m_frameGraph->getTexture(geomRes, 0));
+        else
+            m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_frameGraph->getTexture(blurVRes), m_frameGraph->getTexture(colorRes), 1);// occ_type = ssao
+    }, true);
+    m_frameGraph->read(pass, blurVRes);
+    m_frameGraph->read(pass, colorRes);
+    if(factor > 1)
+    {
+        m_frameGraph->read(pass, gBufferRes);
+        m_frameGraph->read(pass, geomRes);
+    }
+    m_frameGraph->write(pass, m_colorRes);
+}
 
 
-        // bind Appropriate FBO
-        glBindFramebuffer(GL_FRAMEBUFFER, m_BlurFBO2);
-        glViewport(0, 0, TEX_WIDTH, TEX_HEIGHT); 
-        // SSLR texture blurring
-        m_drawQuad->drawScreenQuad(m_programQuad, m_SSLRTex, true, true, 4);
-        m_drawQuad->drawScreenQuad(m_programQuad, m_BlurTex2, true, false, 4);
+int addHiZPass(const std::string& _name, int _geomRes, int _divider, int _maxLevels)
+{
+    RenderTargetDesc desc = screenTargetDesc(1, false, GL_NEAREST, _divider);
+    desc.colorFormat = GL_R32F;
+    desc.numLevels = numMipLevels(desc, _maxLevels);
+    int hiZRes = m_frameGraph->createTarget(_name, desc);
 
-        // Bind default framebuffer
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
-        // resize viewport to window dimensions
-        glViewport(0, 0, m_winWidth, m_winHeight);
+    int pass = m_frameGraph->addPass(_name, [_geomRes, hiZRes]()
+    {
+        const RenderTargetDesc& desc = m_frameGraph->getDesc(hiZRes);
+        buildHiZ(m_frameGraph->getTexture(hiZRes), m_frameGraph->getDepthTexture(_geomRes), desc.width, desc.height, desc.numLevels);
+    }, true);
+    m_frameGraph->read(pass, _geomRes);
+    m_frameGraph->write(pass, hiZRes);
 
-        // Clear window with background color
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    return hiZRes;
+}
 
-        if( m_isSSAOOn )
-        {
-            // Draw SSLR + Screen texture (which contains SSAO already)
-            m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_BlurTex2, m_SSAOTex, 2); // occ_type = SSLR
-        }
-        else
+
+void buildHiZ(GLuint _hiZTex, GLuint _depthTex, int _width, int _height, int _numLevels)
+{
+    // level 0: linear depth (the frame graph binds the Hi-Z FBO with level 0 attached)
+    m_drawQuad->drawScreenQuadHiZ(m_programHiZ, _depthTex, true);
+
+    for(int level = 1; level < _numLevels; level++)
+    {
+        // render to this level while only the previous one can be sampled (no feedback loop)
+        glBindTexture(GL_TEXTURE_2D, _hiZTex);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+        glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _hiZTex, level);
+        glViewport(0, 0, std::max(1, _width >> level), std::max(1, _height >> level));
+
+        m_drawQuad->drawScreenQuadHiZ(m_programHiZ, _hiZTex, false);
+    }
+
+    // whole mip chain readable, level 0 attached
+    glBindTexture(GL_TEXTURE_2D, _hiZTex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, _numLevels - 1);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glFramebufferTexture(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, _hiZTex, 0);
+    glViewport(0, 0, _width, _height);
+}
+
+
+void addSSLRPasses()
+{
+    if( !m_isSSLROn )
+        return;
+
+    int gBufferRes = m_gBufferRes;
+    int sceneRes = m_sceneRes;
+    int reflectRes;
+    int pass;
+
+    if(m_sslrMethod == 1)
+    {
+        // hierarchical (min) linear depth buffer at the render resolution
+        int hiZRes = addHiZPass("SSRHiZ", gBufferRes, 1, SSR_HIZ_LEVELS);
+
+        // reflections ray marched through the Hi-Z levels, pre-filtered in the mip levels of the lighting result (no blur)
+        reflectRes = m_frameGraph->createTarget("ssr", screenTargetDesc(1, false, GL_LINEAR));
+
+        pass = m_frameGraph->addPass("SSR", [hiZRes, gBufferRes, sceneRes]()
         {
-            // Draw SSLR + Screen texture (without SSAO)
-            m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_BlurTex2, m_screenTex, 2); // occ_type = SSLR
-        }
+            glm::mat4 projMat = m_camera.getProjectionMatrix();
+
+            GLuint sceneTex = m_frameGraph->getTexture(sceneRes);
+            glBindTexture(GL_TEXTURE_2D, sceneTex);
+            glGenerateMipmap(GL_TEXTURE_2D);
+            glBindTexture(GL_TEXTURE_2D, 0);
+
+            m_drawQuad->drawScreenQuadSSR(m_programSSR, projMat, m_frameGraph->getTexture(hiZRes), m_frameGraph->getDepthTexture(gBufferRes), m_frameGraph->getTexture(gBufferRes, 0),
+                                          m_frameGraph->getTexture(gBufferRes, 1), sceneTex, 2.0f * m_radScene, m_frameGraph->getDesc(hiZRes).numLevels, m_frameGraph->getDesc(sceneRes).numLevels);
+        }, true);
+        m_frameGraph->read(pass, hiZRes);
+        m_frameGraph->read(pass, gBufferRes);
+        m_frameGraph->read(pass, sceneRes);
+        m_frameGraph->write(pass, reflectRes);
+    }
+    else
+    {
+        // generate SSLR texture from the lighting result (without SSAO)
+        int sslrRes = m_frameGraph->createTarget("sslr", screenTargetDesc(1, false, GL_LINEAR));
 
-        if(m_isBackgroundWhite)
-            glClearColor(1.0f, 1.0f, 1.0f, 0.0);
+        pass = m_frameGraph->addPass("SSLR", [gBufferRes, sceneRes]()
+        {
+            glm::mat4 modelMat = m_modelMatrix;
+            glm::mat4 viewMat = m_camera.getViewMatrix();
+            glm::mat4 projMat = m_camera.getProjectionMatrix();
+
+            int kernelSize, kernelOffset;
+            float noiseAngle;
+            temporalSamplePattern(kernelSize, kernelOffset, noiseAngle);
+            m_drawQuad->drawScreenQuadSSLR(m_programSSLR, modelMat, viewMat, projMat, m_frameGraph->getDepthTexture(gBufferRes), m_frameGraph->getTexture(gBufferRes, 0),
+                                           m_frameGraph->getTexture(sceneRes), m_ssaoRadius, (float)m_renderWidth, (float)m_renderHeight,
+                                           kernelSize, kernelOffset, noiseAngle);
+        }, true);
+        m_frameGraph->read(pass, gBufferRes);
+        m_frameGraph->read(pass, sceneRes);
+        m_frameGraph->write(pass, sslrRes);
+
+        // accumulate over frames, then SSLR texture blurring
+        if(m_isTemporalOn)
+            reflectRes = addBlurPasses("SSLR", addTemporalPass("SSLR", sslrRes, gBufferRes, *m_lrHistory), 2);
         else
-            glClearColor(0.0f, 0.0f, 0.0f, 0.0);
-
-        // debug
-        //m_drawQuad->drawScreenQuad(m_programQuad, /*m_SSLRTex*/ m_SSAOTex, false); 
+            reflectRes = addBlurPasses("SSLR", sslrRes, 4);
     }
 
+    // Draw SSLR + Screen texture (which contains SSAO already if enabled)
+    int colorRes = m_colorRes;
+    m_colorRes = m_frameGraph->createTarget("sceneLR", screenTargetDesc(1, false, GL_LINEAR));
+
+    pass = m_frameGraph->addPass("SSLRComposite", [reflectRes, colorRes]()
+    {
+        glm::mat4 modelMat = m_modelMatrix;
+        glm::mat4 viewMat = m_camera.getViewMatrix();
+        glm::mat4 projMat = m_camera.getProjectionMatrix();
+
+        m_drawQuad->drawScreenQuadFinal(m_programQuadFinal, modelMat, viewMat, projMat, m_frameGraph->getTexture(reflectRes), m_frameGraph->getTexture(colorRes), 2); // occ_type = SSLR
+    }, true);
+    m_frameGraph->read(pass, reflectRes);
+    m_frameGraph->read(pass, colorRes);
+    m_frameGraph->write(pass, m_colorRes);
+
+    // debug
+    //m_drawQuad->drawScreenQuad(m_programQuad, m_frameGraph->getTexture(sslrRes), false); 
+}
+
+
+void addOutputPass()
+{
+    // bilinear upscaling of the last result to the window.
+    // Removed by the graph if the last pass can render directly to the output (same size, or screen quad pass)
+    int colorRes = m_colorRes;
+    m_frameGraph->addCopyPass("Upscale", colorRes, m_outputRes, [colorRes]()
+    {
+        m_drawQuad->drawScreenQuad(m_programQuad, m_frameGraph->getTexture(colorRes), false, false, 0);
+    });
 }
 
 
@@ -703,6 +1688,10 @@ void displaySSLR()
 
 void resizeCallback(GLFWwindow* window, int width, int height)
 {
+    // nothing to render while minimized
+    if(width == 0 || height == 0)
+        return;
+
     m_winWidth = width;
     m_winHeight = height;
     glViewport(0, 0, width, height);
@@ -713,10 +1702,12 @@ void resizeCallback(GLFWwindow* window, int width, int height)
     m_camera.initProjectionMatrix(m_winWidth, m_winHeight, m_zoomFactor, 0);
     m_trackball.init(m_winWidth, m_winHeight);
 
+    // screen-space render targets follow the window size
+    resizeScreenTargets(m_isDynamicResOn ? m_dynamicRes.getScale() : m_renderScale);
+    m_dynamicRes.reset();
+
     // keep drawing while resize
-    update();
-    displayLighting();
-    displayTSD();
+    renderFrame();
 
     // Swap between front and back buffer
     glfwSwapBuffers(m_window);
@@ -812,11 +1803,13 @@ void mouseButtonCallback(GLFWwindow* window, int button, int action, int mods)
     double x, y;
     glfwGetCursorPos(window, &x, &y);
 
-    // activate/de-activate trackball with mouse button
+    // activate/de-activate trackball with mouse button, pick a point of the mesh with right button
     if (action == GLFW_PRESS) 
     {
         if (button == GLFW_MOUSE_BUTTON_LEFT)
             m_trackball.startTracking( glm::vec2(x, y) );
+        else if (button == GLFW_MOUSE_BUTTON_RIGHT)
+            m_isPointPicked = pickMesh(x, y, m_pickedPoint);
     }
     else 
     {
@@ -855,6 +1848,36 @@ void cursorPosCallback(GLFWwindow* window, double x, double y)
 
 
 
+bool pickMesh(double _x, double _y, TriMesh::SurfacePoint& _point)
+{
+    // cursor coords are in screen coordinates, which may differ from framebuffer pixels
+    int width, height;
+    glfwGetWindowSize(m_window, &width, &height);
+    if(width == 0 || height == 0)
+        return false;
+
+    // build the BVH out of the timing (once per mesh)
+    m_triMesh->getBVH();
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    // unproject the cursor on the near and far planes, back to mesh coords
+    glm::vec2 ndc(2.0f * (float)_x / (float)width - 1.0f, 1.0f - 2.0f * (float)_y / (float)height);
+    glm::mat4 invMVP = glm::inverse(m_camera.getProjectionMatrix() * m_camera.getViewMatrix() * m_modelMatrix);
+    glm::vec4 nearPoint = invMVP * glm::vec4(ndc, -1.0f, 1.0f);
+    glm::vec4 farPoint = invMVP * glm::vec4(ndc, 1.0f, 1.0f);
+    glm::vec3 origin = glm::vec3(nearPoint) / nearPoint.w;
+    glm::vec3 dir = glm::vec3(farPoint) / farPoint.w - origin;
+
+    bool isHit = m_triMesh->intersect(origin, dir, _point);
+    m_pickTime = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - startTime).count();
+
+    return isHit;
+}
+
+
+
+
     /*------------------------------------------------------------------------------------------------------------+
     |                                                      MAIN                                                   |
     +-------------------------------------------------------------------------------------------------------------*/
@@ -913,6 +1936,27 @@ void runGUI()
                     //m_cameraLight.init(m_lightSpherePos.z - m_lightCamNearRad, m_lightSpherePos.z + m_lightCamFarRad, 45.0f, 1.0f, m_winWidth, m_winHeight, sphericalToEuclidean(m_lightSpherePos)+m_centerCoords, m_centerCoords, m_lightType, m_radScene);
                 }
 
+                ImGui::Separator();
+
+                // attributes of the point picked with right click
+                ImGui::Text("Picked point (right click) ");
+                if(m_isPointPicked)
+                {
+                    const TriMesh::SurfacePoint& p = m_pickedPoint;
+                    ImGui::Text("triangle %u, barycentrics (%.3f, %.3f)  [%.1f us]", p.triangle, p.bary.x, p.bary.y, m_pickTime);
+                    ImGui::Text("position (%.3f, %.3f, %.3f)", p.position.x, p.position.y, p.position.z);
+                    ImGui::Text("normal (%.3f, %.3f, %.3f)", p.normal.x, p.normal.y, p.normal.z);
+                    if(m_modelType != 0)
+                        ImGui::Text("uv (%.3f, %.3f)", p.texCoords.x, p.texCoords.y);
+                    if(m_modelType == 0)
+                    {
+                        glm::vec3 diffuse = m_drawMesh->getDiffuseColor();
+                        ImGui::Text("diffuse (%.2f, %.2f, %.2f), specular power %.1f", diffuse.x, diffuse.y, diffuse.z, m_drawMesh->getSpecularPower());
+                    }
+                }
+                else
+                    ImGui::TextDisabled("none");
+
                 ImGui::EndTabItem();
             }
 
@@ -943,62 +1987,7 @@ void runGUI()
                     ImGui::ListBox("", &m_fileMesh, m_filePBRMeshList, IM_ARRAYSIZE(m_filePBRMeshList));
                 }
                 if (ImGui::Button("Load mesh"))
-                {
-                    if (m_modelType == 0 )
-                    {
-                        m_triMesh->readFile( modelDir + std::string(m_fileBasicMeshList[m_fileMesh]) + ".obj" );
-                    }
-                    if (m_modelType == 1 )
-                    {
-                        m_triMesh->readFile( modelDir + std::string(m_fileUVMeshList[m_fileMesh]) + ".obj" );
-                    }
-                    if (m_modelType == 2 )
-                    {
-                        m_triMesh->readFile( modelDir + std::string(m_filePBRMeshList[m_fileMesh]) + ".obj" );
-                        m_triMesh->computeTB();
-                    }
-                    initScene();
-
-                    // setup mesh rendering
-                    m_drawMesh = std::make_unique<DrawableMesh>();
-                    m_drawMesh->createMeshVAO(*m_triMesh);
-                    m_drawMesh->setAlbedoTexFlag(m_isAlbedoTexOn);
-                    m_drawMesh->setEnvMapReflecFlag(m_isEnvReflecOn);
-                    m_drawMesh->setEnvMapReflecFlag(m_isEnvRefracOn);
-                    m_drawMesh->setShadowMapFlag(m_isShadowOn);
-                    m_drawMesh->setSimTransmitFlag(m_isSimTransmitOn);
-                    m_drawMesh->setTSDFlag(m_isTSDOn);
-                    
-                    if(m_modelType == 2 && m_fileMesh == 0)
-                    {
-                        // load corresponding PBR textures
-                        m_drawMesh->loadAlbedoTex( modelDir + "tex_grenade/Grenade_A.png" );
-                        m_drawMesh->loadGlossMap( modelDir + "tex_grenade/Grenade_R.png" );
-                        m_drawMesh->loadMetalMap( modelDir + "tex_grenade/Grenade_M.png" );
-                        m_drawMesh->loadNormalMap( modelDir + "tex_grenade/Grenade_N.png" );
-                        m_drawMesh->loadAmbientMap( modelDir + "tex_grenade/Grenade_AO.png" );
-                    }
-                    else if (m_modelType == 2 && m_fileMesh == 1)
-                    {
-                        m_drawMesh->loadAlbedoTex( modelDir + "tex_cerberus/Cerberus_A.png" );
-                        m_drawMesh->loadGlossMap( modelDir + "tex_cerberus/Cerberus_R.png" );
-                        m_drawMesh->loadMetalMap( modelDir + "tex_cerberus/Cerberus_M.png" );
-                        m_drawMesh->loadNormalMap( modelDir + "tex_cerberus/Cerberus_N.png" );
-                    }
-                    else if (m_modelType == 2 && m_fileMesh == 2)
-                    {
-                        m_drawMesh->loadAlbedoTex( modelDir + "tex_matball/Matball_A.png" );
-                        m_drawMesh->loadGlossMap( modelDir + "tex_matball/Matball_R.png" );
-                        m_drawMesh->loadMetalMap( modelDir + "tex_matball/Matball_M.png" );
-                        m_drawMesh->loadNormalMap( modelDir + "tex_matball/Matball_N.png" );
-                        m_drawMesh->loadAmbientMap( modelDir + "tex_matball/Matball_AO.png" );
-                    }
-
-                    // setup floor quad rendering
-                    m_drawFloor = std::make_unique<DrawableMesh>();
-                    m_drawFloor->createQuadVAO(FLOOR, bBoxMin.y, m_centerCoords, m_radScene);
-                    m_drawFloor->setShadowMapFlag(m_isShadowOn);
-                }
+                    loadModel(m_modelType, m_fileMesh);
 
                 ImGui::EndTabItem();
             }
@@ -1020,13 +2009,140 @@ void runGUI()
                 // choose cubemap
                 ImGui::ListBox("", &m_fileCubeMap, m_fileCubeMapList, IM_ARRAYSIZE(m_fileCubeMapList));
                 if (ImGui::Button("Load Cube Map"))
+                    loadEnvironment(m_fileCubeMap);
+
+                ImGui::EndTabItem();
+            }
+
+            // fifth tab: per-pass timings
+            if (ImGui::BeginTabItem("Profiler"))
+            {
+                if(!m_profiler->isGPUTimingAvailable())
+                    ImGui::TextDisabled("GPU timer queries not supported");
+
+                // rolling statistics, in ms
+                if (ImGui::BeginTable("passes", 7, ImGuiTableFlags_Borders | ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingFixedFit))
+                {
+                    ImGui::TableSetupColumn("pass");
+                    ImGui::TableSetupColumn("CPU min");
+                    ImGui::TableSetupColumn("CPU mean");
+                    ImGui::TableSetupColumn("CPU p99");
+                    ImGui::TableSetupColumn("GPU min");
+                    ImGui::TableSetupColumn("GPU mean");
+                    ImGui::TableSetupColumn("GPU p99");
+                    ImGui::TableHeadersRow();
+
+                    for(int p = 0; p < m_profiler->getNumPasses(); p++)
+                    {
+                        PassStats stats = m_profiler->getStats(p);
+                        float values[6] = { stats.cpuMin, stats.cpuMean, stats.cpuP99, stats.gpuMin, stats.gpuMean, stats.gpuP99 };
+
+                        ImGui::TableNextRow();
+                        ImGui::TableSetColumnIndex(0);
+                        ImGui::Text("%s", m_profiler->getPassName(p).c_str());
+                        for(int v = 0; v < 6; v++)
+                        {
+                            ImGui::TableSetColumnIndex(v + 1);
+                            if(values[v] >= 0.0f)
+                                ImGui::Text("%.3f", values[v]);
+                            else
+                                ImGui::TextDisabled("-");
+                        }
+                    }
+                    ImGui::EndTable();
+                }
+
+                if (ImGui::Button("Export CSV"))
+                    m_profiler->exportCSV("profile.csv");
+                ImGui::SameLine();
+                if (ImGui::Button("Export trace"))
+                    m_profiler->exportChromeTrace("profile_trace.json");
+                ImGui::SameLine();
+                if (ImGui::Button("Reset"))
+                    m_profiler->reset();
+
+                ImGui::Separator();
+
+                // passes executed for the enabled features
+                ImGui::Text("Frame graph: %d passes (%d culled)", m_frameGraph->getNumPasses() - m_frameGraph->getNumCulledPasses(),
+                            m_frameGraph->getNumCulledPasses());
+
+                // memory of the render targets needed by the enabled features
+                ImGui::Text("Render targets: %d (%.1f MB, peak %.1f MB)", m_rtPool->getNumTargets(),
+                            (double)m_rtPool->getAllocatedBytes() / (1024.0 * 1024.0), (double)m_rtPool->getPeakBytes() / (1024.0 * 1024.0));
+
+                // shadow passes skipped while the light and the casters are static
+                ImGui::Checkbox("Shadow map caching", &m_isShadowCacheOn);
+                ImGui::SameLine();
+                ImGui::Text("%lld rendered, %lld cached",
+                            m_shadowCache->getNumRendered() + m_cascadeCache->getNumRendered() + m_momentCache->getNumRendered(),
+                            m_shadowCache->getNumReused() + m_cascadeCache->getNumReused() + m_momentCache->getNumReused());
+
+                // depth-only pre-pass of the geometry passes, so that their fragment shader runs once per pixel
+                ImGui::Text("Depth pre-pass:");
+                ImGui::SameLine();
+                bool isPrepassChanged = ImGui::RadioButton("off", &m_prepassMode, DepthPrepass::OFF);
+                ImGui::SameLine();
+                isPrepassChanged |= ImGui::RadioButton("adaptive", &m_prepassMode, DepthPrepass::ADAPTIVE);
+                ImGui::SameLine();
+                isPrepassChanged |= ImGui::RadioButton("always", &m_prepassMode, DepthPrepass::ALWAYS);
+                const char* prepassNames[] = { "lighting", "G-buffer", "TSD" };
+                DepthPrepass* prepasses[] = { m_lightingPrepass.get(), m_gBufferPrepass.get(), m_tsdPrepass.get() };
+                for(int p = 0; p < 3; p++)
+                {
+                    if(isPrepassChanged)
+                        prepasses[p]->setMode(m_prepassMode);
+                    // passes not measured yet are not listed
+                    if(prepasses[p]->getOverdraw() >= 0.0f)
+                        ImGui::Text("  %s: overdraw %.2f (min %.2f), pre-pass %s", prepassNames[p], prepasses[p]->getOverdraw(),
+                                    prepasses[p]->getMinOverdraw(), prepasses[p]->isActive() ? "on" : "off");
+                }
+
+                // internal resolution of screen-space passes (upscaled to the window in the final pass)
+                ImGui::Text("Render resolution: %d x %d", m_renderWidth, m_renderHeight);
+                if (ImGui::Checkbox("Dynamic resolution", &m_isDynamicResOn))
+                {
+                    m_dynamicRes.setScale(m_renderScale);
+                    resizeScreenTargets(m_isDynamicResOn ? m_dynamicRes.getScale() : m_renderScale);
+                }
+                if(m_isDynamicResOn)
+                {
+                    float budget = m_dynamicRes.getBudget();
+                    if (ImGui::SliderFloat("budget (ms)", &budget, 2.0f, 50.0f, "%.1f"))
+                        m_dynamicRes.setBudget(budget);
+                    float minScale = m_dynamicRes.getMinScale();
+                    if (ImGui::SliderFloat("min scale", &minScale, 0.25f, 1.0f, "%.2f"))
+                        m_dynamicRes.setScaleRange(minScale, 1.0f);
+                    ImGui::Text("scale %.2f, frame %.2f ms", m_dynamicRes.getScale(), m_dynamicRes.getSmoothedTime());
+                }
+                else if (ImGui::SliderFloat("resolution scale", &m_renderScale, 0.25f, 1.0f, "%.2f"))
                 {
-                    // add cube map to mesh rendering
-                    m_drawMesh->loadCubeMap( modelDir + "cubemaps/" + std::string(m_fileCubeMapList[m_fileCubeMap]) );
-                    m_drawSkybox->loadCubeMap( modelDir + "cubemaps/" + std::string(m_fileCubeMapList[m_fileCubeMap]) );
-                    m_drawQuad->loadCubeMap( modelDir + "cubemaps/" + std::string(m_fileCubeMapList[m_fileCubeMap]) );
+                    resizeScreenTargets(m_renderScale);
                 }
 
+                ImGui::Separator();
+
+                // record / replay camera and light controls (replayed by the headless benchmark)
+                ImGui::Text("Camera path: %d keys, %.1f s", m_cameraPath.getNumKeys(), m_cameraPath.getDuration());
+                if (ImGui::Checkbox("Record path", &m_isPathRecording))
+                {
+                    if(m_isPathRecording)
+                        m_cameraPath.clear();
+                    m_isPathPlaying = false;
+                    m_pathStartTime = glfwGetTime();
+                }
+                ImGui::SameLine();
+                if (ImGui::Checkbox("Play path", &m_isPathPlaying))
+                {
+                    m_isPathRecording = false;
+                    m_pathStartTime = glfwGetTime();
+                }
+                if (ImGui::Button("Save path"))
+                    m_cameraPath.save("camera_path.txt");
+                ImGui::SameLine();
+                if (ImGui::Button("Load path"))
+                    m_cameraPath.load("camera_path.txt");
+
                 ImGui::EndTabItem();
             }
 
@@ -1055,12 +2171,28 @@ void runGUI()
 
         }
 
+        // ambient occlusion baked at the vertices (computed on the first use for each mesh)
+        if( ImGui::Checkbox("Baked AO ", &m_isBakedAOOn) )
+        {
+            if(m_isBakedAOOn)
+                bakeMeshAO();
+            m_drawMesh->setVertexAOFlag(m_isBakedAOOn && m_isAOBaked);
+        }
+
         // Shadow mapping checkbox
         if( ImGui::Checkbox("Simulate transmission", &m_isSimTransmitOn) )
         {
             m_drawMesh->setSimTransmitFlag(m_isSimTransmitOn);
         }
 
+        // image-based ambient lighting (requires a loaded cube map)
+        if( ImGui::Checkbox("Image-based lighting", &m_isIBLOn) )
+        {
+            m_drawMesh->setIBLFlag(m_isIBLOn);
+            m_drawFloor->setIBLFlag(m_isIBLOn);
+            m_isIBLOn = m_drawMesh->getIBLFlag();
+        }
+
         if ( ImGui::Checkbox("Environment mapping ", &m_isEnvMapOn) )
         {
             m_envMapType = 0;
@@ -1101,6 +2233,58 @@ void runGUI()
             m_drawFloor->setShadowMapFlag(m_isShadowOn);
         }
 
+        if(m_isShadowOn)
+        {
+            // shadow maps fitted to slices of the view frustum
+            ImGui::Checkbox("Cascaded shadow maps", &m_isCascadedShadowOn);
+            if(m_isCascadedShadowOn)
+            {
+                ImGui::SliderInt("cascades", &m_numCascades, 1, ShadowCascades::MAX_CASCADES);
+                // texel density of each cascade, relative to the single shadow map
+                for(int c = 0; c < m_shadowCascades.getNumCascades(); c++)
+                    ImGui::Text("cascade %d: %.1fx resolution", c,
+                                ((float)CASCADE_MAP_SIZE / (float)TEX_WIDTH) / m_shadowCascades.getTexelSize(c));
+            }
+            else
+            {
+                // percentage-closer filtering per fragment, or moments filtered once in the shadow map
+                bool isFilterChanged = false;
+                ImGui::Text("Shadow filtering:");
+                isFilterChanged |= ImGui::RadioButton("PCF", &m_shadowMethod, 0);
+                ImGui::SameLine();
+                isFilterChanged |= ImGui::RadioButton("VSM", &m_shadowMethod, 1);
+                ImGui::SameLine();
+                isFilterChanged |= ImGui::RadioButton("EVSM", &m_shadowMethod, 2);
+                ImGui::SameLine();
+                isFilterChanged |= ImGui::RadioButton("MSM", &m_shadowMethod, 3);
+                if(m_shadowMethod > 0)
+                    isFilterChanged |= ImGui::SliderInt("softness", &m_shadowSoftness, 0, 16);
+
+                // the cached moments depend on the filter
+                if(isFilterChanged)
+                    m_momentCache->invalidate();
+            }
+        }
+
+        // lighting of the G-buffer in a single screen pass
+        ImGui::Checkbox("Deferred shading", &m_isDeferredOn);
+        if(m_isDeferredOn && !isDeferredShading())
+        {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(forward: env. map, transmission, TSD)");
+        }
+
+        // point and spot lights, only shaded in the clusters of the view frustum they reach
+        ImGui::Checkbox("Local lights", &m_isLocalLightsOn);
+        if(m_isLocalLightsOn)
+        {
+            if(ImGui::SliderInt("lights", &m_numLocalLights, 1, MAX_LOCAL_LIGHTS))
+                m_isLocalLightsDirty = true;
+            ImGui::Text("%.1f lights per cluster (max %d), built in %.2f ms",
+                        (float)m_lightClusters.getLightIndices().size() / (float)m_lightClusters.getNumClusters(),
+                        m_lightClusters.getMaxLightsPerCluster(), m_clusterBuildTime);
+        }
+
         // Shadow mapping checkbox
         if (m_modelType == 1 ||  m_modelType == 2)
         {
@@ -1115,12 +2299,50 @@ void runGUI()
             }
         }
 
+        // blur of TSD and SSLR (only available with compute shaders)
+        if(m_computeBlur && (m_isTSDOn || m_isSSLROn))
+        {
+            ImGui::Checkbox("Compute shader blur", &m_isComputeBlurOn);
+        }
+
         // Shadow mapping checkbox
         ImGui::Checkbox("SSAO", &m_isSSAOOn);
 
+        if(m_isSSAOOn)
+        {
+            // resolution of occlusion computation (upsampled to the render resolution)
+            ImGui::Text("SSAO resolution:");
+            ImGui::RadioButton("full", &m_ssaoDownsampling, 1);
+            ImGui::SameLine();
+            ImGui::RadioButton("half", &m_ssaoDownsampling, 2);
+            ImGui::SameLine();
+            ImGui::RadioButton("quarter", &m_ssaoDownsampling, 4);
+
+            // hemisphere kernel, or horizon search in a hierarchical depth buffer
+            ImGui::Text("AO method:");
+            ImGui::RadioButton("kernel", &m_aoMethod, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("horizon (GTAO)", &m_aoMethod, 1);
+        }
+
         // Shadow mapping checkbox
         ImGui::Checkbox("SSLR", &m_isSSLROn);
 
+        if(m_isSSLROn)
+        {
+            // hemisphere kernel, or reflected rays marched in a hierarchical depth buffer
+            ImGui::Text("Reflection method:");
+            ImGui::RadioButton("kernel##sslr", &m_sslrMethod, 0);
+            ImGui::SameLine();
+            ImGui::RadioButton("ray marching (Hi-Z SSR)", &m_sslrMethod, 1);
+        }
+
+        if(m_isSSAOOn || m_isSSLROn)
+        {
+            // fewer samples per frame, accumulated over the previous frames
+            ImGui::Checkbox("Temporal accumulation", &m_isTemporalOn);
+        }
+
     } // end "Settings"
 
     
@@ -1130,8 +2352,603 @@ void runGUI()
     ImGui::Render();
 }
 
+bool findModel(const std::string& _name, int& _modelType, int& _fileMesh)
+{
+    // look for the model in the 3 mesh lists
+    const char **lists[] = { m_fileBasicMeshList, m_fileUVMeshList, m_filePBRMeshList };
+    const int sizes[] = { IM_ARRAYSIZE(m_fileBasicMeshList), IM_ARRAYSIZE(m_fileUVMeshList), IM_ARRAYSIZE(m_filePBRMeshList) };
+    for(int t = 0; t < 3; t++)
+        for(int f = 0; f < sizes[t]; f++)
+            if(_name == lists[t][f])
+            {
+                _modelType = t;
+                _fileMesh = f;
+                return true;
+            }
+
+    errorLog() << "findModel(): unknown model " << _name;
+    return false;
+}
+
+
+void releaseGLResources()
+{
+    // every global owning GL objects, released before the context is destroyed
+    m_computeBlur.reset();
+    m_momentCache.reset();
+    m_tsdPrepass.reset();
+    m_gBufferPrepass.reset();
+    m_lightingPrepass.reset();
+    deleteTextureBuffer(&m_lightDataBuffer, &m_lightDataTex);
+    deleteTextureBuffer(&m_clustersBuffer, &m_clustersTex);
+    deleteTextureBuffer(&m_lightIndicesBuffer, &m_lightIndicesTex);
+    m_cascadeCache.reset();
+    m_shadowCache.reset();
+    m_lrHistory.reset();
+    m_aoHistory.reset();
+    m_frameGraph.reset();
+    m_rtPool.reset();
+    m_iblBaker.reset();
+
+    // offscreen output of headless mode
+    deleteFBO(&m_outputFBO);
+    glDeleteTextures(1, &m_outputTex);
+    m_outputTex = 0;
+
+    // GL queries
+    m_profiler.reset();
+}
+
+
+int runBenchmark(const std::vector<std::string>& _models, const std::string& _pathFile, int _numFrames, bool _fullMatrix,
+                 const std::string& _reportFile, const std::string& _baselineFile, float _tolerance)
+{
+    // feature toggles: shadow, SSAO, SSLR, TSD, environment mapping
+    const char* featureNames[] = { "shadow", "ssao", "sslr", "tsd", "envmap" };
+    const int numFeatures = 5;
+    const int numWarmupFrames = 5;
+
+    // path replayed for every configuration, sampled at fixed times (independent from the frame rate)
+    if(_pathFile.empty() || !m_cameraPath.load(_pathFile))
+        m_cameraPath.buildOrbit(10.0f);
+    m_isPathPlaying = true;
+
+    // configurations: all features off, each feature alone, all features on (or every combination)
+    std::vector<int> featureSets;
+    if(_fullMatrix)
+    {
+        for(int set = 0; set < (1 << numFeatures); set++)
+            featureSets.push_back(set);
+    }
+    else
+    {
+        featureSets.push_back(0);
+        for(int f = 0; f < numFeatures; f++)
+            featureSets.push_back(1 << f);
+        featureSets.push_back((1 << numFeatures) - 1);
+    }
+
+    BenchmarkReport report;
+    bool isModelMissing = false;
+    for(const std::string& model : _models)
+    {
+        int modelType, fileMesh;
+        if(!findModel(model, modelType, fileMesh) || !loadModel(modelType, fileMesh))
+        {
+            // do not report the timings of the previous model under this name
+            errorLog() << "runBenchmark(): model " << model << " skipped";
+            isModelMissing = true;
+            continue;
+        }
+
+        for(int set : featureSets)
+        {
+            // texture space diffusion needs UV coords
+            bool tsd = (set & 8) != 0;
+            if(tsd && modelType == 0)
+                continue;
+
+            m_isShadowOn = (set & 1) != 0;
+            m_isSSAOOn = (set & 2) != 0;
+            m_isSSLROn = (set & 4) != 0;
+            m_isTSDOn = tsd;
+            m_isEnvMapOn = (set & 16) != 0;
+            m_envMapType = 0;
+            applySettings();
+
+            BenchmarkResult result;
+            result.name = model + "/";
+            for(int f = 0; f < numFeatures; f++)
+                if(set & (1 << f))
+                    result.name += std::string(result.name.back() == '/' ? "" : "+") + featureNames[f];
+            if(set == 0)
+                result.name += "base";
+
+            // warm-up (shader compilation, texture uploads, ...)
+            for(int f = 0; f < numWarmupFrames; f++)
+            {
+                m_pathTime = 0.0f;
+                renderFrame();
+            }
+            glFinish();
+            m_profiler->reset();
+
+            for(int f = 0; f < _numFrames; f++)
+            {
+                m_pathTime = m_cameraPath.getDuration() * (float)f / (float)std::max(_numFrames - 1, 1);
+
+                // frame time includes GPU execution
+                auto frameStart = std::chrono::steady_clock::now();
+                m_profiler->beginFrame();
+                renderFrame();
+                glFinish();
+                result.frameTimes.push_back( std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - frameStart).count() );
+            }
+            m_profiler->flush();
+
+            for(int p = 0; p < m_profiler->getNumPasses(); p++)
+            {
+                PassStats stats = m_profiler->getStats(p);
+                if(stats.numSamples == 0)
+                    continue;
+                result.passNames.push_back(m_profiler->getPassName(p));
+                result.passStats.push_back(stats);
+            }
+
+            std::cout << std::endl << result.name << std::endl;
+            m_profiler->writeSummary(std::cout);
+            report.addResult(result);
+        }
+    }
+    m_isPathPlaying = false;
+
+    report.write(_reportFile, std::string((const char*)glGetString(GL_RENDERER)));
+
+    if(!_baselineFile.empty())
+    {
+        int numRegressions = report.compare(_baselineFile, _tolerance, std::cout);
+        if(numRegressions < 0)
+            return 1;
+        if(numRegressions > 0)
+            return 2;
+    }
+    return isModelMissing ? 1 : 0;
+}
+
+
+int runReference(const std::string& _referenceFile, const std::string& _diffFile, float _threshold, float _tolerance)
+{
+    // the CPU reference only renders the direct lighting of the meshes
+    if(m_isShadowOn || m_isSSAOOn || m_isSSLROn || m_isTSDOn || m_isEnvMapOn || m_isIBLOn || m_isSimTransmitOn || m_isLocalLightsOn ||
+       m_isAlbedoTexOn || m_isNormalMapOn || m_isPBRMapOn || m_isAOMapOn)
+        warningLog() << "runReference(): textures, shadows, environment, local lights and screen-space effects are not rendered by the CPU reference";
+
+    // same frame as the last GL frame
+    SoftRasterizer rasterizer(m_winWidth, m_winHeight);
+    rasterizer.setCamera(m_camera.getViewMatrix(), m_camera.getProjectionMatrix(), m_camPos);
+    rasterizer.setLight(GLtools::sphericalToEuclidean(m_lightSpherePos), m_lightCol, m_lightType == 1, m_maxDistLight);
+    rasterizer.setGammaCorrection(m_drawMesh->getUseGammaCorrecFlag());
+    rasterizer.setBackgroundColor(backgroundColor());
+
+    auto startTime = std::chrono::steady_clock::now();
+
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<uint32_t> indices;
+    m_triMesh->getVertices(vertices);
+    m_triMesh->getNormals(normals);
+    m_triMesh->getIndices(indices);
+    SoftRasterizer::Material material;
+    material.diffuseColor = m_drawMesh->getDiffuseColor();
+    material.specularColor = m_drawMesh->getSpecularColor();
+    material.specularPower = m_drawMesh->getSpecularPower();
+    rasterizer.addMesh(vertices, normals, indices, m_modelMatrix, material);
+
+    if(m_isFloorOn)
+    {
+        DrawableMesh::quadGeometry(FLOOR, bBoxMin.y, m_centerCoords, m_radScene, vertices, normals);
+        material.diffuseColor = m_drawFloor->getDiffuseColor();
+        material.specularColor = m_drawFloor->getSpecularColor();
+        material.specularPower = m_drawFloor->getSpecularPower();
+        rasterizer.addMesh(vertices, normals, { 0, 1, 2, 2, 3, 0 }, m_modelMatrix, material);
+    }
+
+    rasterizer.render();
+    double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    std::cout << "CPU reference: " << rasterizer.getNumTriangles() << " triangles in " << time << " ms" << std::endl;
+
+    if(!saveImagePNG(rasterizer.getPixels(), m_winWidth, m_winHeight, _referenceFile))
+        return 1;
+    std::cout << "Reference image written to " << _referenceFile << std::endl;
+
+    // perceptual comparison with the GL output
+    std::vector<unsigned char> pixels;
+    readFramebuffer(m_outputFBO, m_winWidth, m_winHeight, pixels);
+    ImageDiff diff(_threshold);
+    if(!diff.compare(pixels, rasterizer.getPixels(), m_winWidth, m_winHeight))
+    {
+        errorLog() << "runReference(): cannot compare the GL output (" << pixels.size() << " bytes) with the reference image ("
+                   << m_winWidth << "x" << m_winHeight << ")";
+        return 1;
+    }
+    diff.writeSummary(std::cout);
+    if(!_diffFile.empty() && saveImagePNG(diff.getDiffImage(), m_winWidth, m_winHeight, _diffFile))
+        std::cout << "Difference image written to " << _diffFile << std::endl;
+
+    if(diff.getDiffRatio() > _tolerance)
+    {
+        errorLog() << "runReference(): " << diff.getDiffRatio() * 100.0f << " % of the pixels differ from the reference (tolerance "
+                   << _tolerance * 100.0f << " %)";
+        return 2;
+    }
+    return 0;
+}
+
+
+int runPathTracer(const std::string& _file, int _numSamples, float _threshold)
+{
+    if(m_isAlbedoTexOn || m_isNormalMapOn || m_isPBRMapOn || m_isAOMapOn || m_isSimTransmitOn || m_isLocalLightsOn)
+        warningLog() << "runPathTracer(): textures, transmission and local lights are not rendered by the path tracer";
+
+    // same frame as the last GL frame
+    PathTracer pathTracer(m_winWidth, m_winHeight);
+    pathTracer.setCamera(m_camera.getViewMatrix(), m_camera.getProjectionMatrix());
+    // the light position is rotated by the model matrix in lighting.frag
+    pathTracer.setLight(glm::mat3(m_modelMatrix) * GLtools::sphericalToEuclidean(m_lightSpherePos), m_lightCol, m_lightType == 1, m_maxDistLight);
+    pathTracer.setGammaCorrection(m_drawMesh->getUseGammaCorrecFlag());
+    pathTracer.setBackgroundColor(backgroundColor());
+
+    // environment lighting, if the GL frame uses it (constant ambient term otherwise)
+    if(m_isEnvMapOn || m_isIBLOn)
+    {
+        std::string cubeMapDir = modelDir + "cubemaps/" + std::string(m_fileCubeMapList[m_fileCubeMap]);
+        pathTracer.loadEnvironment(cubeMapDir, glm::transpose(glm::mat3(m_modelMatrix)));
+    }
+
+    std::vector<glm::vec3> vertices, normals;
+    std::vector<uint32_t> indices;
+    m_triMesh->getVertices(vertices);
+    m_triMesh->getNormals(normals);
+    m_triMesh->getIndices(indices);
+    PathTracer::Material material;
+    material.diffuseColor = m_drawMesh->getDiffuseColor();
+    material.specularColor = m_drawMesh->getSpecularColor();
+    material.specularPower = m_drawMesh->getSpecularPower();
+    pathTracer.addMesh(vertices, normals, indices, m_modelMatrix, material);
+
+    if(m_isFloorOn)
+    {
+        DrawableMesh::quadGeometry(FLOOR, bBoxMin.y, m_centerCoords, m_radScene, vertices, normals);
+        material.diffuseColor = m_drawFloor->getDiffuseColor();
+        material.specularColor = m_drawFloor->getSpecularColor();
+        material.specularPower = m_drawFloor->getSpecularPower();
+        pathTracer.addMesh(vertices, normals, { 0, 1, 2, 2, 3, 0 }, m_modelMatrix, material);
+    }
+
+    // progressive rendering, by passes of a few samples per pixel
+    auto startTime = std::chrono::steady_clock::now();
+    int passSamples = std::max(1, std::min(_numSamples, 16));
+    while(pathTracer.getNumSamples() < _numSamples)
+    {
+        pathTracer.render(std::min(passSamples, _numSamples - pathTracer.getNumSamples()));
+        double time = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+        std::cout << "Path tracing: " << pathTracer.getNumSamples() << "/" << _numSamples << " samples per pixel, "
+                  << time << " s (" << getNumThreads() << " threads)" << std::endl;
+    }
+
+    bool isHDR = _file.size() >= 4 && _file.compare(_file.size() - 4, 4, ".hdr") == 0;
+    bool saved = isHDR ? saveImageHDR(pathTracer.getRadiance(), m_winWidth, m_winHeight, _file)
+                       : saveImagePNG(pathTracer.getPixels(), m_winWidth, m_winHeight, _file);
+    if(!saved)
+        return 1;
+    std::cout << "Path traced image written to " << _file << std::endl;
+
+    // distance of the GL output to the ground truth (for information only, the GL lighting is approximated)
+    std::vector<unsigned char> pixels;
+    readFramebuffer(m_outputFBO, m_winWidth, m_winHeight, pixels);
+    ImageDiff diff(_threshold);
+    if(diff.compare(pixels, pathTracer.getPixels(), m_winWidth, m_winHeight))
+        diff.writeSummary(std::cout);
+    else
+        warningLog() << "runPathTracer(): cannot compare the GL output (" << pixels.size() << " bytes) with the path traced image ("
+                     << m_winWidth << "x" << m_winHeight << ")";
+
+    return 0;
+}
+
+
+int runHeadless(int argc, char** argv)
+{
+    std::string modelName, cubeMapName;
+    std::string outputFile = "headless.png", csvFile, traceFile;
+    int numFrames = 100;
+    bool useOSMesa = false;
+    // benchmark options
+    bool isBenchmark = false, fullMatrix = false;
+    std::vector<std::string> benchModels = { "teapot", "head_UV", "grenade_PBR" };
+    std::string pathFile, reportFile = "benchmark.json", baselineFile;
+    float tolerance = 0.1f;
+    // CPU reference options
+    std::string referenceFile, diffFile;
+    float diffThreshold = 2.3f, diffTolerance = 0.01f;
+    // path tracer options
+    std::string pathTracedFile;
+    int numPathSamples = 64;
+
+    // parse command line
+    for(int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        bool hasValue = (i + 1 < argc);
+
+        if(arg == "--headless")                         continue;
+        else if(arg == "--model" && hasValue)           modelName = argv[++i];
+        else if(arg == "--cubemap" && hasValue)         cubeMapName = argv[++i];
+        else if(arg == "--frames" && hasValue)          numFrames = std::max(1, atoi(argv[++i]));
+        else if(arg == "--width" && hasValue)           m_winWidth = std::max(1, atoi(argv[++i]));
+        else if(arg == "--height" && hasValue)          m_winHeight = std::max(1, atoi(argv[++i]));
+        else if(arg == "--scale" && hasValue)           m_renderScale = std::clamp((float)atof(argv[++i]), 0.1f, 1.0f);
+        else if(arg == "--output" && hasValue)          outputFile = argv[++i];
+        else if(arg == "--csv" && hasValue)             csvFile = argv[++i];
+        else if(arg == "--trace" && hasValue)           traceFile = argv[++i];
+        else if(arg == "--shaders" && hasValue)         shaderDir = argv[++i];
+        else if(arg == "--models" && hasValue)          modelDir = argv[++i];
+        else if(arg == "--osmesa")                      useOSMesa = true;
+        else if(arg == "--shadow")                      m_isShadowOn = true;
+        else if(arg == "--csm")                         { m_isShadowOn = true; m_isCascadedShadowOn = true; }
+        else if(arg == "--no-shadow-cache")             m_isShadowCacheOn = false;
+        else if(arg == "--vsm")                         { m_isShadowOn = true; m_shadowMethod = 1; }
+        else if(arg == "--evsm")                        { m_isShadowOn = true; m_shadowMethod = 2; }
+        else if(arg == "--msm")                         { m_isShadowOn = true; m_shadowMethod = 3; }
+        else if(arg == "--shadow-softness" && hasValue) m_shadowSoftness = std::clamp(atoi(argv[++i]), 0, 16);
+        else if(arg == "--deferred")                    m_isDeferredOn = true;
+        else if(arg == "--prepass" && hasValue)         m_prepassMode = std::clamp(atoi(argv[++i]), 0, 2);
+        else if(arg == "--lights" && hasValue)          { m_isLocalLightsOn = true; m_numLocalLights = std::clamp(atoi(argv[++i]), 1, MAX_LOCAL_LIGHTS); }
+        else if(arg == "--ssao")                        m_isSSAOOn = true;
+        else if(arg == "--ssao-res" && hasValue)        m_ssaoDownsampling = std::clamp(atoi(argv[++i]), 1, 4);
+        else if(arg == "--gtao")                        { m_isSSAOOn = true; m_aoMethod = 1; }
+        else if(arg == "--sslr")                        m_isSSLROn = true;
+        else if(arg == "--ssr")                         { m_isSSLROn = true; m_sslrMethod = 1; }
+        else if(arg == "--temporal")                    m_isTemporalOn = true;
+        else if(arg == "--no-compute")                  m_isComputeBlurOn = false;
+        else if(arg == "--tsd")                         m_isTSDOn = true;
+        else if(arg == "--envmap")                      m_isEnvMapOn = true;
+        else if(arg == "--refraction")                  { m_isEnvMapOn = true; m_envMapType = 1; }
+        else if(arg == "--ibl")                         m_isIBLOn = true;
+        else if(arg == "--transmit")                    m_isSimTransmitOn = true;
+        else if(arg == "--albedo")                      m_isAlbedoTexOn = true;
+        else if(arg == "--normalmap")                   m_isNormalMapOn = true;
+        else if(arg == "--pbr")                         m_isPBRMapOn = true;
+        else if(arg == "--aomap")                       m_isAOMapOn = true;
+        else if(arg == "--directional")                 m_lightType = 1;
+        else if(arg == "--no-floor")                    m_isFloorOn = false;
+        else if(arg == "--path" && hasValue)            pathFile = argv[++i];
+        else if(arg == "--benchmark")                   isBenchmark = true;
+        else if(arg == "--full-matrix")                 fullMatrix = true;
+        else if(arg == "--report" && hasValue)          reportFile = argv[++i];
+        else if(arg == "--baseline" && hasValue)        baselineFile = argv[++i];
+        else if(arg == "--tolerance" && hasValue)       tolerance = (float)atof(argv[++i]);
+        else if(arg == "--reference" && hasValue)       referenceFile = argv[++i];
+        else if(arg == "--diff-image" && hasValue)      diffFile = argv[++i];
+        else if(arg == "--diff-threshold" && hasValue)  diffThreshold = (float)atof(argv[++i]);
+        else if(arg == "--diff-tolerance" && hasValue)  diffTolerance = (float)atof(argv[++i]);
+        else if(arg == "--path-trace" && hasValue)      pathTracedFile = argv[++i];
+        else if(arg == "--pt-samples" && hasValue)      numPathSamples = std::max(1, atoi(argv[++i]));
+        else if(arg == "--bench-models" && hasValue)
+        {
+            // comma-separated list of models
+            benchModels.clear();
+            std::stringstream list(argv[++i]);
+            std::string name;
+            while(std::getline(list, name, ','))
+                benchModels.push_back(name);
+        }
+        else
+        {
+            std::cout << "Usage: " << argv[0] << " --headless [options]" << std::endl
+                      << " --model <name>       mesh to load (e.g. armadillo, head_UV, grenade_PBR)" << std::endl
+                      << " --cubemap <name>     cube map to load (e.g. Water)" << std::endl
+                      << " --frames <n>         number of frames to render (default 100)" << std::endl
+                      << " --width <w>, --height <h>: framebuffer size" << std::endl
+                      << " --scale <s>          internal resolution scale of screen-space passes (default 1)" << std::endl
+                      << " --output <file.png>  final image (default headless.png)" << std::endl
+                      << " --csv <file>, --trace <file>: export per-pass timings" << std::endl
+                      << " --shaders <dir>, --models <dir>: data folders" << std::endl
+                      << " --osmesa             use OSMesa instead of EGL" << std::endl
+                      << " features: --shadow --ssao --sslr --tsd --envmap --refraction --ibl --transmit" << std::endl
+                      << " --csm                cascaded shadow maps (3 cascades of 1024x1024)" << std::endl
+                      << " --no-shadow-cache    render the shadow maps every frame, even if the light and the casters are static" << std::endl
+                      << " --vsm, --evsm, --msm shadows from filtered moments (variance, exponential variance, 4 moments)" << std::endl
+                      << " --shadow-softness N  filter half-width of the moment shadow map, in texels (default 4)" << std::endl
+                      << " --deferred           deferred shading: lighting of the G-buffer in a single screen pass" << std::endl
+                      << " --prepass <m>        depth pre-pass: 0 = off, 1 = when the measured overdraw is high (default), 2 = always" << std::endl
+                      << " --lights N           N local point and spot lights, culled per cluster of the view frustum" << std::endl
+                      << " --ssao-res <d>       SSAO resolution divider: 1 = full, 2 = half (default), 4 = quarter" << std::endl
+                      << " --gtao               horizon-based AO (Hi-Z buffer) instead of SSAO kernel" << std::endl
+                      << " --ssr                screen-space reflections ray marched in a Hi-Z buffer instead of SSLR kernel" << std::endl
+                      << " --temporal           accumulate SSAO/SSLR over frames (8 samples per frame)" << std::endl
+                      << " --no-compute         blur with fragment shaders instead of compute shaders (GL 4.3)" << std::endl
+                      << "           --albedo --normalmap --pbr --aomap --directional --no-floor" << std::endl
+                      << " --path <file>        replay a recorded camera/light path (default: orbit path in benchmark mode)" << std::endl
+                      << " --benchmark          run every model x feature configuration, and write a JSON report" << std::endl
+                      << "   --bench-models <a,b,c>  models to benchmark (default teapot,head_UV,grenade_PBR)" << std::endl
+                      << "   --full-matrix      all feature combinations instead of one feature at a time" << std::endl
+                      << "   --report <file>    JSON report (default benchmark.json)" << std::endl
+                      << "   --baseline <file>  compare against a previous report (exit code 2 on regression)" << std::endl
+                      << "   --tolerance <t>    relative tolerance for baseline comparison (default 0.1)" << std::endl
+                      << " --reference <file.png> render the last frame with the CPU reference rasterizer, and compare it with the" << std::endl
+                      << "                      GL output (exit code 2 if they differ)" << std::endl
+                      << "   --diff-image <file.png> image of the different pixels" << std::endl
+                      << "   --diff-threshold <d> color difference (CIELAB Delta E) above which pixels differ (default 2.3)" << std::endl
+                      << "   --diff-tolerance <t> ratio of different pixels accepted (default 0.01)" << std::endl
+                      << " --path-trace <file.png|.hdr> render the last frame with the CPU path tracer (ground truth of the lighting)" << std::endl
+                      << "   --pt-samples <n>   samples per pixel (default 64)" << std::endl;
+            return 1;
+        }
+    }
+
+    int modelType = -1, fileMesh = -1;
+    if(!modelName.empty() && !findModel(modelName, modelType, fileMesh))
+        return 1;
+
+    int fileCubeMap = -1;
+    if(!cubeMapName.empty())
+    {
+        for(int c = 0; c < IM_ARRAYSIZE(m_fileCubeMapList); c++)
+            if(cubeMapName == m_fileCubeMapList[c])
+                fileCubeMap = c;
+        if(fileCubeMap < 0)
+        {
+            errorLog() << "runHeadless(): unknown cube map " << cubeMapName;
+            return 1;
+        }
+    }
+    else if(m_isEnvMapOn || m_isIBLOn || isBenchmark)
+    {
+        // environment features need a cube map
+        fileCubeMap = m_fileCubeMap;
+    }
+
+
+    /* Initialize GLFW without display server, and create a hidden window with an offscreen context */
+#if GLFW_VERSION_MAJOR > 3 || (GLFW_VERSION_MAJOR == 3 && GLFW_VERSION_MINOR >= 4)
+    glfwInitHint(GLFW_PLATFORM, GLFW_PLATFORM_NULL);
+#endif
+    if(!glfwInit())
+    {
+        errorLog() << "runHeadless(): cannot initialize GLFW";
+        return 1;
+    }
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+    glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+    glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    glfwWindowHint(GLFW_CONTEXT_CREATION_API, useOSMesa ? GLFW_OSMESA_CONTEXT_API : GLFW_EGL_CONTEXT_API);
+    m_window = glfwCreateWindow(m_winWidth, m_winHeight, "RT_lite headless", nullptr, nullptr);
+    if(!m_window && !useOSMesa)
+    {
+        warningLog() << "runHeadless(): EGL context creation failed, trying OSMesa";
+        glfwWindowHint(GLFW_CONTEXT_CREATION_API, GLFW_OSMESA_CONTEXT_API);
+        m_window = glfwCreateWindow(m_winWidth, m_winHeight, "RT_lite headless", nullptr, nullptr);
+    }
+    if(!m_window)
+    {
+        errorLog() << "runHeadless(): cannot create offscreen GL context";
+        glfwTerminate();
+        return 1;
+    }
+    glfwMakeContextCurrent(m_window);
+
+    // init GL extension wrangler (there is no GLX display with EGL/OSMesa, which is not an error here)
+    glewExperimental = true;
+    GLenum res = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+    if (res == GLEW_ERROR_NO_GLX_DISPLAY)
+        res = GLEW_OK;
+#endif
+    if (res != GLEW_OK) 
+    {
+        fprintf(stderr, "Error: '%s'\n", glewGetErrorString(res));
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+        return 1;
+    }
+    std::cout << "OpenGL version: " << glGetString(GL_VERSION) << std::endl
+              << "Renderer: " << glGetString(GL_RENDERER) << std::endl;
+
+    glGenVertexArrays(1, &m_defaultVAO);
+    glBindVertexArray(m_defaultVAO);
+
+    // init per-pass timers
+    m_profiler = std::make_unique<Profiler>(numFrames);
+    m_profiler->init();
+
+    // call init function
+    initialize();
+
+    // final image is rendered in an offscreen FBO instead of the default framebuffer
+    buildScreenFBOandTex(&m_outputFBO, &m_outputTex, m_winWidth, m_winHeight, true, false);
+    glBindFramebuffer(GL_FRAMEBUFFER, m_outputFBO);
+    glViewport(0, 0, m_winWidth, m_winHeight);
+
+    // load scene and apply feature flags
+    if(modelType >= 0 && !loadModel(modelType, fileMesh))
+    {
+        releaseGLResources();
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+        return 1;
+    }
+    if(fileCubeMap >= 0)
+        loadEnvironment(fileCubeMap);
+    applySettings();
+
+    if(isBenchmark)
+    {
+        int ret = runBenchmark(benchModels, pathFile, numFrames, fullMatrix, reportFile, baselineFile, tolerance);
+
+        releaseGLResources();
+        glfwDestroyWindow(m_window);
+        glfwTerminate();
+        return ret;
+    }
+
+    // replay a camera/light path over the rendered frames
+    if(!pathFile.empty() && m_cameraPath.load(pathFile))
+        m_isPathPlaying = true;
+
+    // rendering loop
+    auto startTime = std::chrono::steady_clock::now();
+    for(int f = 0; f < numFrames; f++)
+    {
+        m_pathTime = m_cameraPath.getDuration() * (float)f / (float)std::max(numFrames - 1, 1);
+        m_profiler->beginFrame();
+        renderFrame();
+        // submit the frame, as buffer swapping would do
+        glFlush();
+    }
+    glFinish();
+    double totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+    m_profiler->flush();
+
+    // report
+    std::cout << std::endl << numFrames << " frames in " << totalTime << " ms (" << totalTime / numFrames << " ms/frame)" << std::endl;
+    m_profiler->writeSummary(std::cout);
+    m_frameGraph->writeSummary(std::cout);
+    m_rtPool->writeSummary(std::cout);
+    if(!csvFile.empty())
+        m_profiler->exportCSV(csvFile);
+    if(!traceFile.empty())
+        m_profiler->exportChromeTrace(traceFile);
+
+    bool saved = saveFramebufferPNG(m_outputFBO, m_winWidth, m_winHeight, outputFile);
+    if(saved)
+        std::cout << "Final image written to " << outputFile << std::endl;
+
+    // regression test against the CPU reference
+    int referenceRet = 0;
+    if(!referenceFile.empty())
+        referenceRet = runReference(referenceFile, diffFile, diffThreshold, diffTolerance);
+
+    // ground truth of the lighting
+    if(!pathTracedFile.empty() && runPathTracer(pathTracedFile, numPathSamples, diffThreshold) != 0 && referenceRet == 0)
+        referenceRet = 1;
+
+    // cleanup
+    releaseGLResources();
+    glfwDestroyWindow(m_window);
+    glfwTerminate();
+
+    return saved ? referenceRet : 1;
+}
+
+
 int main(int argc, char** argv)
 {
+    // headless mode: offscreen rendering, without window nor GUI
+    for(int i = 1; i < argc; i++)
+        if(std::string(argv[i]) == "--headless")
+            return runHeadless(argc, argv);
+
 
     /* Initialize GLFW and create a window */
     glfwInit();
@@ -1176,6 +2993,10 @@ int main(int argc, char** argv)
     glGenVertexArrays(1, &m_defaultVAO);
     glBindVertexArray(m_defaultVAO);
 
+    // init per-pass timers
+    m_profiler = std::make_unique<Profiler>();
+    m_profiler->init();
+
     // call init function
     initialize();
 
@@ -1191,20 +3012,30 @@ int main(int argc, char** argv)
         // build GUI
         runGUI();
 
-        // idle updates
-        update();
-        // render shadow map
-        displayShadowMap();
-        // render G-buffer
-        displayGBuffering();
-        // render lighting
-        displayLighting();
-        // render scene
-        displayTSD();
-        // apply screen-space AO
-        displaySSAO(); 
-        // apply screen-space reflections
-        displaySSLR();
+        // advance camera path recording / replay (replay loops over the path)
+        if(m_isPathRecording || m_isPathPlaying)
+        {
+            m_pathTime = (float)(glfwGetTime() - m_pathStartTime);
+            if(m_isPathPlaying && m_cameraPath.getDuration() > 0.0f)
+                m_pathTime = std::fmod(m_pathTime, m_cameraPath.getDuration());
+        }
+
+        // start collecting timings of the new frame
+        m_profiler->beginFrame();
+
+        // render all passes
+        double frameStart = glfwGetTime();
+        renderFrame();
+
+        // adapt internal resolution to the GPU time of the last complete frame (CPU submission time if not measured)
+        if(m_isDynamicResOn)
+        {
+            float frameTime = m_profiler->getLastFrameGPUTime();
+            if(frameTime < 0.0f)
+                frameTime = (float)((glfwGetTime() - frameStart) * 1000.0);
+            if(m_dynamicRes.update(frameTime))
+                resizeScreenTargets(m_dynamicRes.getScale());
+        }
 
         // render GUI
         ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
@@ -1214,9 +3045,8 @@ int main(int argc, char** argv)
     }
 
 
-    // delete shadow map FBO and texture
-    glDeleteFramebuffers(1, &m_shadowFBO);
-    glDeleteTextures(1, &m_shadowMapTex);
+    // delete all GL objects while the context is still alive
+    releaseGLResources();
 
     // Cleanup imGui
     ImGui_ImplOpenGL3_Shutdown();
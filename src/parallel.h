@@ -0,0 +1,67 @@
+/*********************************************************************************************************************
+ *
+ * parallel.h
+ *
+ * Minimal CPU multi-threading helpers
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+
+
+/*!
+* \fn getNumThreads
+* \brief Number of worker threads to use for CPU-side processing
+* \return number of hardware threads (at least 1)
+*/
+inline unsigned int getNumThreads()
+{
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+
+
+/*!
+* \fn parallelFor
+* \brief Run _func(i) for every i in [0, _count) on all hardware threads.
+*        Work items are distributed dynamically (atomic counter), so items of uneven cost are balanced.
+*        _func is called as _func(itemIndex, threadIndex).
+* \param _count : number of work items
+* \param _func : function to apply to each work item
+*/
+template<typename Func>
+void parallelFor(unsigned int _count, Func _func)
+{
+    unsigned int numThreads = std::min(getNumThreads(), std::max(1u, _count));
+    std::atomic<unsigned int> next(0);
+
+    auto worker = [&](unsigned int _threadId)
+    {
+        for(unsigned int i = next++; i < _count; i = next++)
+            _func(i, _threadId);
+    };
+
+    std::vector<std::thread> threads;
+    for(unsigned int t = 1; t < numThreads; t++)
+        threads.emplace_back(worker, t);
+
+    // calling thread takes its share of the work
+    worker(0);
+
+    for(std::thread& thread : threads)
+        thread.join();
+}
+
+#endif // PARALLEL_H
@@ -0,0 +1,469 @@
+/*********************************************************************************************************************
+ *
+ * pathtracer.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "pathtracer.h"
+#include "parallel.h"
+#include "sampling.h"
+
+#include "GLtools.h"
+
+#include <cmath>
+#include <limits>
+
+#include <stb_image.h>
+
+
+
+// size of the square screen tiles picked up by the threads
+static const int TILE_SIZE = 16;
+// number of bounces before paths may be stopped by russian roulette
+static const int RR_DEPTH = 3;
+
+// ambient term of lighting.frag, used as uniform environment radiance when no cube map is loaded
+static const float AMBIENT = 0.03f;
+// lighting.frag scales the direct lighting by (1.5 - shadow)
+static const float LIGHT_SCALE = 1.5f;
+
+
+namespace
+{
+    // Uniform random number in [0, 1[ (PCG hash of a linear congruential sequence)
+    float random(uint32_t& _state)
+    {
+        _state = _state * 747796405u + 2891336453u;
+        uint32_t word = ((_state >> ((_state >> 28u) + 4u)) ^ _state) * 277803737u;
+        word = (word >> 22u) ^ word;
+        return (float)(word >> 8u) * (1.0f / 16777216.0f);
+    }
+
+    float luminance(const glm::vec3& _c)
+    {
+        return glm::dot(_c, glm::vec3(0.2126f, 0.7152f, 0.0722f));
+    }
+
+    glm::vec3 fresnelSchlick(float _cosTheta, const glm::vec3& _F0)
+    {
+        float m = glm::clamp(1.0f - _cosTheta, 0.0f, 1.0f);
+        return _F0 + (glm::vec3(1.0f) - _F0) * (m * m * m * m * m);
+    }
+
+    /*!
+    * \struct Surface
+    * \brief Shading point and its material parameters (as in lighting.frag)
+    */
+    struct Surface
+    {
+        glm::vec3 N;            /*!< shading normal, on the side of the viewer */
+        glm::vec3 T, B;         /*!< tangent frame around N */
+        glm::vec3 albedo;       /*!< diffuse albedo */
+        glm::vec3 F0;           /*!< fresnel reflectance at normal incidence */
+        float roughness;        /*!< GGX roughness */
+    };
+
+    // BRDF of lighting.frag (fresnel-weighted Lambertian and Cook-Torrance terms), and density of the reflected
+    // directions of the specular lobe
+    glm::vec3 evalBRDF(const Surface& _s, const glm::vec3& _V, const glm::vec3& _L, float& _pdfSpec)
+    {
+        glm::vec3 H = glm::normalize(_V + _L);
+        float NdotV = std::max(glm::dot(_s.N, _V), 0.0f);
+        float NdotL = std::max(glm::dot(_s.N, _L), 0.0f);
+        float NdotH = std::max(glm::dot(_s.N, H), 0.0f);
+        float VdotH = std::max(glm::dot(_V, H), 0.0f);
+
+        // GGX distribution
+        float a = _s.roughness;
+        float a2 = a * a;
+        float denomD = NdotH * NdotH * (a2 - 1.0f) + 1.0f;
+        float D = a2 / (PI * denomD * denomD);
+
+        // Smith geometry with Schlick-GGX (k = roughness)
+        float G = (NdotV / (NdotV * (1.0f - a) + a)) * (NdotL / (NdotL * (1.0f - a) + a));
+
+        glm::vec3 F = fresnelSchlick(VdotH, _s.F0);
+        glm::vec3 specular = F * (D * G / std::max(4.0f * NdotV * NdotL, 0.001f));
+        glm::vec3 diffuse = (glm::vec3(1.0f) - F) * (1.0f - METALNESS) * _s.albedo / PI;
+
+        _pdfSpec = D * NdotH / std::max(4.0f * VdotH, 1e-6f);
+        return diffuse + specular;
+    }
+
+    // Cube map face and texture coords of a direction (GL conventions, as in IBLBaker)
+    int directionToFace(const glm::vec3& _dir, float& _s, float& _t)
+    {
+        glm::vec3 a(std::abs(_dir.x), std::abs(_dir.y), std::abs(_dir.z));
+        int face;
+        float sc, tc, ma;
+        if(a.x >= a.y && a.x >= a.z)
+        {
+            ma = a.x;
+            face = _dir.x > 0.0f ? 0 : 1;
+            sc = _dir.x > 0.0f ? -_dir.z : _dir.z;
+            tc = -_dir.y;
+        }
+        else if(a.y >= a.z)
+        {
+            ma = a.y;
+            face = _dir.y > 0.0f ? 2 : 3;
+            sc = _dir.x;
+            tc = _dir.y > 0.0f ? _dir.z : -_dir.z;
+        }
+        else
+        {
+            ma = a.z;
+            face = _dir.z > 0.0f ? 4 : 5;
+            sc = _dir.z > 0.0f ? _dir.x : -_dir.x;
+            tc = -_dir.y;
+        }
+        _s = 0.5f * (sc / ma + 1.0f);
+        _t = 0.5f * (tc / ma + 1.0f);
+        return face;
+    }
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                        CONSTRUCTORS / DESTRUCTORS                                           |
++-------------------------------------------------------------------------------------------------------------*/
+
+PathTracer::PathTracer(int _width, int _height)
+{
+    m_width = std::max(1, _width);
+    m_height = std::max(1, _height);
+    m_numTilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_numTilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    m_numSamples = 0;
+    m_maxDepth = 8;
+    m_accum.assign((size_t)m_width * m_height, glm::vec3(0.0f));
+    m_radiance.assign((size_t)m_width * m_height * 3, 0.0f);
+    m_pixels.assign((size_t)m_width * m_height * 4, 0);
+
+    m_invViewProj = glm::mat4(1.0f);
+    m_lightPos = glm::vec3(0.0f, 0.0f, 1.0f);
+    m_lightColor = glm::vec3(1.0f);
+    m_isLightDir = false;
+    m_distLightMax = 1.0f;
+    m_useGammaCorrec = true;
+    m_backgroundColor = glm::vec4(0.0f);
+
+    m_envSize = 0;
+    m_envMatrix = glm::mat3(1.0f);
+
+    m_isBVHDirty = false;
+    m_rayOffset = 1e-4f;
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               OTHER METHODS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+bool PathTracer::loadEnvironment(const std::string& _dirname, const glm::mat3& _envMatrix)
+{
+    const char *filenames[] = { "posx.png", "negx.png", "posy.png", "negy.png", "posz.png", "negz.png" };
+
+    // sRGB to linear conversion table (the GL cube map uses an sRGB internal format)
+    float toLinear[256];
+    for(int i = 0; i < 256; i++)
+        toLinear[i] = std::pow((float)i / 255.0f, 2.2f);
+
+    std::vector<std::vector<glm::vec3> > faces(6);
+    int size = 0;
+    for(unsigned int f = 0; f < 6; ++f)
+    {
+        std::string filename = _dirname + "/" + filenames[f];
+        int width, height, nbChannels;
+        stbi_uc* data = stbi_load(filename.c_str(), &width, &height, &nbChannels, STBI_rgb);
+        if(!data || width != height || (size != 0 && width != size))
+        {
+            errorLog() << "PathTracer::loadEnvironment(): failed to load cube map face " << filename;
+            if(data)
+                stbi_image_free(data);
+            return false;
+        }
+        size = width;
+        faces[f].resize(width * height);
+        for(int i = 0; i < width * height; i++)
+            faces[f][i] = glm::vec3(toLinear[data[i*3]], toLinear[data[i*3+1]], toLinear[data[i*3+2]]);
+        stbi_image_free(data);
+    }
+
+    m_envFaces.swap(faces);
+    m_envSize = size;
+    m_envMatrix = _envMatrix;
+    reset();
+
+    return true;
+}
+
+
+void PathTracer::addMesh(const std::vector<glm::vec3>& _vertices, const std::vector<glm::vec3>& _normals,
+                         const std::vector<uint32_t>& _indices, const glm::mat4& _model, const Material& _material)
+{
+    uint32_t meshIndex = (uint32_t)m_materials.size();
+    m_materials.push_back(_material);
+
+    uint32_t base = (uint32_t)m_worldPos.size();
+    glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(_model)));
+    for(size_t v = 0; v < _vertices.size(); v++)
+    {
+        m_worldPos.push_back(glm::vec3(_model * glm::vec4(_vertices[v], 1.0f)));
+        m_worldNormal.push_back(v < _normals.size() ? normalMat * _normals[v] : glm::vec3(0.0f));
+    }
+
+    for(size_t i = 0; i + 2 < _indices.size(); i += 3)
+    {
+        for(int k = 0; k < 3; k++)
+            m_indices.push_back(base + _indices[i + k]);
+        m_triMesh.push_back(meshIndex);
+    }
+
+    m_isBVHDirty = true;
+    reset();
+}
+
+
+void PathTracer::render(int _numSamples)
+{
+    if(_numSamples <= 0)
+        return;
+
+    if(m_isBVHDirty)
+    {
+        m_bvh.build(m_worldPos, m_indices);
+        m_rayOffset = 1e-4f * std::max(glm::length(m_bvh.getBBoxMax() - m_bvh.getBBoxMin()), 1e-3f);
+        m_isBVHDirty = false;
+    }
+
+    // tiles are distributed dynamically: threads done with cheap tiles take the next ones
+    parallelFor((unsigned int)(m_numTilesX * m_numTilesY), [&](unsigned int _tile, unsigned int)
+    {
+        renderTile((int)_tile, _numSamples);
+    });
+    m_numSamples += _numSamples;
+
+    // mean of the samples, and display image
+    float invNumSamples = 1.0f / (float)m_numSamples;
+    parallelFor((unsigned int)m_height, [&](unsigned int _row, unsigned int)
+    {
+        for(size_t index = (size_t)_row * m_width; index < (size_t)(_row + 1) * m_width; index++)
+        {
+            glm::vec3 color = m_accum[index] * invNumSamples;
+            for(int c = 0; c < 3; c++)
+            {
+                m_radiance[index * 3 + c] = color[c];
+                float value = std::max(color[c], 0.0f);
+                if(m_useGammaCorrec)
+                    value = std::pow(value, 1.0f / 2.2f);
+                m_pixels[index * 4 + c] = (unsigned char)(std::min(value, 1.0f) * 255.0f + 0.5f);
+            }
+            m_pixels[index * 4 + 3] = 255;
+        }
+    });
+}
+
+
+void PathTracer::reset()
+{
+    m_numSamples = 0;
+    std::fill(m_accum.begin(), m_accum.end(), glm::vec3(0.0f));
+}
+
+
+void PathTracer::renderTile(int _tile, int _numSamples)
+{
+    int x0 = (_tile % m_numTilesX) * TILE_SIZE;
+    int y0 = (_tile / m_numTilesX) * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, m_width);
+    int y1 = std::min(y0 + TILE_SIZE, m_height);
+
+    // the background color is displayed as is, whatever the gamma correction
+    glm::vec3 background(m_backgroundColor);
+    if(m_useGammaCorrec)
+        background = glm::pow(glm::max(background, glm::vec3(0.0f)), glm::vec3(2.2f));
+
+    for(int py = y0; py < y1; py++)
+    {
+        for(int px = x0; px < x1; px++)
+        {
+            size_t index = (size_t)py * m_width + px;
+            glm::vec3 sum(0.0f);
+            for(int s = 0; s < _numSamples; s++)
+            {
+                // independent sequence per pixel and sample index, so the result does not depend on the threads
+                uint32_t rng = hash32((uint32_t)index ^ hash32((uint32_t)(m_numSamples + s)));
+
+                // jittered position in the pixel, unprojected on the near and far planes
+                glm::vec2 ndc(((float)px + random(rng)) / (float)m_width * 2.0f - 1.0f,
+                              ((float)py + random(rng)) / (float)m_height * 2.0f - 1.0f);
+                glm::vec4 nearPos = m_invViewProj * glm::vec4(ndc, -1.0f, 1.0f);
+                glm::vec4 farPos = m_invViewProj * glm::vec4(ndc, 1.0f, 1.0f);
+                glm::vec3 origin = glm::vec3(nearPos) / nearPos.w;
+                glm::vec3 dir = glm::normalize(glm::vec3(farPos) / farPos.w - origin);
+
+                bool isHit;
+                glm::vec3 radiance = tracePath(origin, dir, rng, isHit);
+                if(!isHit)
+                    radiance = background;
+                // discard the rare invalid samples (degenerate triangles), rather than propagating NaNs
+                if(std::isfinite(radiance.x) && std::isfinite(radiance.y) && std::isfinite(radiance.z))
+                    sum += radiance;
+            }
+            m_accum[index] += sum;
+        }
+    }
+}
+
+
+glm::vec3 PathTracer::tracePath(glm::vec3 _origin, glm::vec3 _dir, uint32_t& _rng, bool& _isHit) const
+{
+    glm::vec3 radiance(0.0f), throughput(1.0f);
+    _isHit = true;
+
+    for(int depth = 0; ; depth++)
+    {
+        BVH::Hit hit;
+        if(!m_bvh.intersect(_origin, _dir, 0.0f, std::numeric_limits<float>::max(), hit))
+        {
+            if(depth == 0)
+                _isHit = false;
+            else
+                radiance += throughput * environment(_dir);
+            break;
+        }
+
+        // surface point: both sides of the triangles are lit, the normals are turned towards the viewer
+        uint32_t tri = hit.triangle;
+        uint32_t i0 = m_indices[tri * 3], i1 = m_indices[tri * 3 + 1], i2 = m_indices[tri * 3 + 2];
+        float b1 = hit.bary.x, b2 = hit.bary.y, b0 = 1.0f - b1 - b2;
+        glm::vec3 P = b0 * m_worldPos[i0] + b1 * m_worldPos[i1] + b2 * m_worldPos[i2];
+        glm::vec3 V = -_dir;
+        glm::vec3 Ng = glm::normalize(glm::cross(m_worldPos[i1] - m_worldPos[i0], m_worldPos[i2] - m_worldPos[i0]));
+        if(glm::dot(Ng, V) < 0.0f)
+            Ng = -Ng;
+
+        Surface surface;
+        surface.N = b0 * m_worldNormal[i0] + b1 * m_worldNormal[i1] + b2 * m_worldNormal[i2];
+        surface.N = glm::dot(surface.N, surface.N) > 0.0f ? glm::normalize(surface.N) : Ng;
+        if(glm::dot(surface.N, Ng) < 0.0f)
+            surface.N = -surface.N;
+
+        const glm::vec3& N = surface.N;
+        orthonormalBasis(N, surface.T, surface.B);
+
+        const Material& material = m_materials[m_triMesh[tri]];
+        surface.albedo = material.diffuseColor;
+        surface.F0 = glm::mix(glm::vec3(0.04f), material.specularColor, METALNESS);
+        // a minimum roughness keeps the GGX distribution finite
+        surface.roughness = std::max(1.0f - material.specularPower / 2048.0f, 0.02f);
+
+        // secondary rays leave from the side of the viewer
+        glm::vec3 origin = P + Ng * m_rayOffset;
+
+
+        // 1- Direct lighting, with a shadow ray -------------------------------------------------------------
+
+        glm::vec3 L;
+        float distance = std::numeric_limits<float>::max();
+        float attenuation = 10.0f;
+        if(m_isLightDir)
+            L = glm::normalize(m_lightPos);
+        else
+        {
+            glm::vec3 toLight = m_lightPos - P;
+            distance = glm::length(toLight);
+            L = toLight / distance;
+            attenuation = 1.0f / (distance * distance * 0.25f / (m_distLightMax * m_distLightMax));
+        }
+        float NdotL = glm::dot(N, L);
+        if(NdotL > 0.0f && glm::dot(Ng, L) > 0.0f && !m_bvh.isOccluded(origin, L, 0.0f, distance))
+        {
+            float pdfSpec;
+            glm::vec3 brdf = evalBRDF(surface, V, L, pdfSpec);
+            radiance += throughput * brdf * m_lightColor * (attenuation * NdotL * LIGHT_SCALE);
+        }
+
+        if(depth >= m_maxDepth)
+            break;
+
+        // russian roulette, on the contribution of the rest of the path
+        if(depth >= RR_DEPTH)
+        {
+            float survival = std::min(0.95f, std::max(throughput.x, std::max(throughput.y, throughput.z)));
+            if(random(_rng) >= survival)
+                break;
+            throughput /= survival;
+        }
+
+
+        // 2- Next direction, sampled from the diffuse or the specular lobe ------------------------------------
+
+        // lobe selection according to the albedo of each lobe in the direction of the viewer
+        float NdotV = std::max(glm::dot(N, V), 1e-4f);
+        glm::vec3 Fv = fresnelSchlick(NdotV, surface.F0);
+        float weightSpec = luminance(Fv);
+        float weightDiff = luminance((glm::vec3(1.0f) - Fv) * (1.0f - METALNESS) * surface.albedo);
+        float probSpec = (weightSpec + weightDiff > 0.0f) ? glm::clamp(weightSpec / (weightSpec + weightDiff), 0.1f, 0.9f) : 0.5f;
+
+        float u1 = random(_rng), u2 = random(_rng);
+        float phi = 2.0f * PI * u2;
+        if(random(_rng) < probSpec)
+        {
+            // half-vector distributed as GGX D(H) * NdotH
+            float a2 = surface.roughness * surface.roughness;
+            float cosTheta = std::sqrt((1.0f - u1) / (1.0f + (a2 - 1.0f) * u1));
+            float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+            glm::vec3 H = surface.T * (sinTheta * std::cos(phi)) + surface.B * (sinTheta * std::sin(phi)) + N * cosTheta;
+            L = 2.0f * glm::dot(V, H) * H - V;
+        }
+        else
+        {
+            // cosine-weighted hemisphere
+            float r = std::sqrt(u1);
+            L = surface.T * (r * std::cos(phi)) + surface.B * (r * std::sin(phi)) + N * std::sqrt(std::max(0.0f, 1.0f - u1));
+        }
+
+        NdotL = glm::dot(N, L);
+        if(NdotL <= 0.0f || glm::dot(Ng, L) <= 0.0f)
+            break;
+
+        // density of the mixture of both lobes
+        float pdfSpec;
+        glm::vec3 brdf = evalBRDF(surface, V, L, pdfSpec);
+        float pdf = probSpec * pdfSpec + (1.0f - probSpec) * NdotL / PI;
+        if(pdf <= 0.0f)
+            break;
+        throughput *= brdf * (NdotL / pdf);
+
+        _origin = origin;
+        _dir = glm::normalize(L);
+    }
+
+    return radiance;
+}
+
+
+glm::vec3 PathTracer::environment(const glm::vec3& _dir) const
+{
+    if(m_envFaces.empty())
+        return glm::vec3(AMBIENT);
+
+    // bilinear lookup, clamped at the face edges
+    float s, t;
+    const std::vector<glm::vec3>& face = m_envFaces[directionToFace(m_envMatrix * _dir, s, t)];
+    float x = glm::clamp(s * m_envSize - 0.5f, 0.0f, (float)(m_envSize - 1));
+    float y = glm::clamp(t * m_envSize - 0.5f, 0.0f, (float)(m_envSize - 1));
+    int x0 = (int)x, y0 = (int)y;
+    int x1 = std::min(x0 + 1, m_envSize - 1), y1 = std::min(y0 + 1, m_envSize - 1);
+    float fx = x - (float)x0, fy = y - (float)y0;
+    glm::vec3 top = glm::mix(face[y0 * m_envSize + x0], face[y0 * m_envSize + x1], fx);
+    glm::vec3 bottom = glm::mix(face[y1 * m_envSize + x0], face[y1 * m_envSize + x1], fx);
+    return glm::mix(top, bottom, fy);
+}
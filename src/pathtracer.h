@@ -0,0 +1,222 @@
+/*********************************************************************************************************************
+ *
+ * pathtracer.h
+ *
+ * Multi-threaded progressive CPU path tracer, ground truth of the GL lighting
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef PATHTRACER_H
+#define PATHTRACER_H
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <algorithm>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include "bvh.h"
+
+
+
+/*!
+* \class PathTracer
+* \brief Render triangle meshes on the CPU with unidirectional path tracing, using the materials of lighting.frag
+*        (Cook-Torrance BRDF with GGX distribution, Smith-Schlick geometry and Schlick fresnel, plus a Lambertian
+*        diffuse term), so the GL approximations (shadow maps, screen-space AO and reflections, pre-filtered IBL)
+*        can be compared with converged global illumination:
+*        - the light of the scene (point or directional) is sampled at each bounce, with a shadow ray
+*        - the next direction is sampled from the BRDF (cosine-weighted diffuse lobe or GGX distribution of the
+*          half-vectors, chosen according to their fresnel-weighted albedo), paths are stopped with russian roulette
+*        - escaped rays gather the environment cube map (or a uniform ambient radiance, the constant of lighting.frag)
+*        Samples are accumulated over successive calls of render(), so the image refines progressively. Each call
+*        splits the image into tiles of TILE_SIZE x TILE_SIZE pixels, which the threads pick up dynamically (see
+*        parallelFor()), so the load is balanced between cheap (background) and expensive tiles.
+*        Rays are traced in the 4-wide BVH of all the triangles of the scene (see BVH), which tests each ray
+*        against 4 boxes or 4 triangles at once. Textures, transmission and local lights are not rendered.
+*/
+class PathTracer
+{
+    public:
+
+        /*!
+        * \struct Material
+        * \brief Uniform material of a mesh (same defaults as DrawableMesh)
+        */
+        struct Material
+        {
+            glm::vec3 diffuseColor = glm::vec3(0.95f, 0.5f, 0.25f);    /*!< diffuse albedo */
+            glm::vec3 specularColor = glm::vec3(0.0f, 0.8f, 0.0f);     /*!< specular albedo */
+            float specularPower = 128.0f;                              /*!< specular power (roughness = 1 - power/2048) */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn PathTracer
+        * \brief Constructor of PathTracer
+        * \param _width : image width
+        * \param _height : image height
+        */
+        PathTracer(int _width, int _height);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getWidth */
+        inline int getWidth() { return m_width; }
+        /*! \fn getHeight */
+        inline int getHeight() { return m_height; }
+        /*! \fn getNumSamples : number of samples per pixel accumulated so far */
+        inline int getNumSamples() { return m_numSamples; }
+        /*! \fn getNumTriangles */
+        inline size_t getNumTriangles() { return m_indices.size() / 3; }
+        /*! \fn getPixels : RGBA8 image (gamma corrected if enabled), bottom row first (as read by glReadPixels) */
+        inline const std::vector<unsigned char>& getPixels() { return m_pixels; }
+        /*! \fn getRadiance : linear RGB image (mean of the samples), bottom row first */
+        inline const std::vector<float>& getRadiance() { return m_radiance; }
+
+        /*! \fn setCamera */
+        inline void setCamera(const glm::mat4& _view, const glm::mat4& _proj) { m_invViewProj = glm::inverse(_proj * _view); reset(); }
+        /*!
+        * \fn setLight
+        * \param _lightPos : light position, or direction of a directional light, in world space
+        * \param _lightColor : light color
+        * \param _isDirectional : directional light (constant attenuation) instead of point light
+        * \param _distLightMax : distance used to normalize the point light attenuation
+        */
+        inline void setLight(const glm::vec3& _lightPos, const glm::vec3& _lightColor, bool _isDirectional, float _distLightMax)
+        {
+            m_lightPos = _lightPos;
+            m_lightColor = _lightColor;
+            m_isLightDir = _isDirectional;
+            m_distLightMax = _distLightMax;
+            reset();
+        }
+        /*! \fn setGammaCorrection */
+        inline void setGammaCorrection(bool _useGammaCorrec) { m_useGammaCorrec = _useGammaCorrec; }
+        /*! \fn setBackgroundColor : color of the pixels where primary rays escape */
+        inline void setBackgroundColor(const glm::vec4& _color) { m_backgroundColor = _color; reset(); }
+        /*! \fn setMaxDepth : maximum number of bounces of a path */
+        inline void setMaxDepth(int _maxDepth) { m_maxDepth = std::max(1, _maxDepth); reset(); }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn loadEnvironment
+        * \brief Load the 6 faces of a cube map, lighting the escaped rays
+        * \param _dirname : folder of the faces (posx.png, negx.png, etc.)
+        * \param _envMatrix : rotation from world directions to cube map directions (transpose(mat3(model)) in the shaders)
+        * \return true if the faces were loaded
+        */
+        bool loadEnvironment(const std::string& _dirname, const glm::mat3& _envMatrix);
+
+        /*!
+        * \fn addMesh
+        * \brief Transform the vertices of a mesh and add its triangles to the scene
+        * \param _vertices : vertex positions (model space)
+        * \param _normals : vertex normals (model space)
+        * \param _indices : 3 vertex indices per triangle
+        * \param _model : model matrix
+        * \param _material : uniform material of the mesh
+        */
+        void addMesh(const std::vector<glm::vec3>& _vertices, const std::vector<glm::vec3>& _normals,
+                     const std::vector<uint32_t>& _indices, const glm::mat4& _model, const Material& _material);
+
+        /*!
+        * \fn render
+        * \brief Trace more samples per pixel, accumulate them, and update the images
+        * \param _numSamples : number of samples per pixel to add
+        */
+        void render(int _numSamples);
+
+        /*!
+        * \fn reset
+        * \brief Discard the accumulated samples
+        */
+        void reset();
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        int m_width;                            /*!< image width */
+        int m_height;                           /*!< image height */
+        int m_numTilesX;                        /*!< number of tiles in a row */
+        int m_numTilesY;                        /*!< number of tiles in a column */
+        int m_numSamples;                       /*!< number of samples per pixel accumulated */
+        int m_maxDepth;                         /*!< maximum number of bounces */
+        std::vector<glm::vec3> m_accum;         /*!< sum of the samples of each pixel */
+        std::vector<float> m_radiance;          /*!< linear RGB image */
+        std::vector<unsigned char> m_pixels;    /*!< RGBA8 image, bottom row first */
+
+        glm::mat4 m_invViewProj;                /*!< inverse of projection * view matrix (primary rays) */
+        glm::vec3 m_lightPos;                   /*!< light position or direction */
+        glm::vec3 m_lightColor;                 /*!< light color */
+        bool m_isLightDir;                      /*!< directional light */
+        float m_distLightMax;                   /*!< normalization distance of the point light attenuation */
+        bool m_useGammaCorrec;                  /*!< gamma correction of the output */
+        glm::vec4 m_backgroundColor;            /*!< color of the pixels where nothing is hit */
+
+        std::vector<std::vector<glm::vec3> > m_envFaces;  /*!< linear RGB texels of the 6 cube map faces (empty: uniform ambient) */
+        int m_envSize;                          /*!< size of the cube map faces */
+        glm::mat3 m_envMatrix;                  /*!< rotation from world to cube map directions */
+
+        std::vector<Material> m_materials;      /*!< material of each mesh */
+        std::vector<glm::vec3> m_worldPos;      /*!< world position of the vertices of all meshes */
+        std::vector<glm::vec3> m_worldNormal;   /*!< world normal of the vertices */
+        std::vector<uint32_t> m_indices;        /*!< 3 indices (in the vertex arrays above) per triangle */
+        std::vector<uint32_t> m_triMesh;        /*!< mesh of each triangle */
+        BVH m_bvh;                              /*!< hierarchy of all triangles */
+        bool m_isBVHDirty;                      /*!< meshes were added since the BVH was built */
+        float m_rayOffset;                      /*!< offset of secondary ray origins (scales with the scene) */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn tracePath
+        * \brief Estimate the radiance coming along a ray
+        * \param _origin, _dir : primary ray
+        * \param _rng : state of the random number generator of the pixel
+        * \param _isHit : set to false if the primary ray escapes
+        * \return radiance
+        */
+        glm::vec3 tracePath(glm::vec3 _origin, glm::vec3 _dir, uint32_t& _rng, bool& _isHit) const;
+
+        /*!
+        * \fn environment
+        * \brief Radiance of the environment in a direction (bilinear lookup in the cube map)
+        * \param _dir : world direction
+        * \return radiance
+        */
+        glm::vec3 environment(const glm::vec3& _dir) const;
+
+        /*!
+        * \fn renderTile
+        * \brief Add samples to the pixels of a tile
+        * \param _tile : tile index
+        * \param _numSamples : number of samples per pixel
+        */
+        void renderTile(int _tile, int _numSamples);
+};
+
+#endif // PATHTRACER_H
@@ -0,0 +1,338 @@
+/*********************************************************************************************************************
+ *
+ * profiler.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "profiler.h"
+
+#include "GLtools.h"
+
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cmath>
+
+
+Profiler::Profiler(int _windowSize)
+{
+    m_windowSize = std::max(1, _windowSize);
+    m_frame = 0;
+    m_gpuTimingAvailable = false;
+    m_startTime = std::chrono::steady_clock::now();
+}
+
+
+Profiler::~Profiler()
+{
+    if(m_gpuTimingAvailable)
+        for(Pass& pass : m_passes)
+            glDeleteQueries(2, pass.queries);
+}
+
+
+void Profiler::init()
+{
+    // GL_TIME_ELAPSED queries are core since GL 3.3
+    m_gpuTimingAvailable = GLEW_VERSION_3_3 || GLEW_ARB_timer_query;
+    if(!m_gpuTimingAvailable)
+        warningLog() << "Profiler::init(): GL timer queries not supported, only CPU times are measured";
+}
+
+
+double Profiler::now()
+{
+    return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - m_startTime).count();
+}
+
+
+void Profiler::beginFrame()
+{
+    m_frame++;
+
+    // collect every result already available (queries issued during the previous frames)
+    if(m_gpuTimingAvailable)
+        for(Pass& pass : m_passes)
+            for(int slot = 0; slot < 2; slot++)
+                collectQuery(pass, slot, false);
+}
+
+
+int Profiler::beginPass(const std::string& _name)
+{
+    int p = 0;
+    while(p < (int)m_passes.size() && m_passes[p].name != _name)
+        p++;
+
+    if(p == (int)m_passes.size())
+    {
+        // register new pass
+        Pass pass;
+        pass.name = _name;
+        pass.samples.resize(m_windowSize);
+        pass.next = 0;
+        pass.count = 0;
+        pass.queries[0] = pass.queries[1] = 0;
+        pass.querySample[0] = pass.querySample[1] = -1;
+        if(m_gpuTimingAvailable)
+            glGenQueries(2, pass.queries);
+        m_passes.push_back(pass);
+    }
+
+    Pass& pass = m_passes[p];
+    if(m_gpuTimingAvailable)
+    {
+        int slot = (int)(m_frame & 1);
+        // query still pending after 2 frames: its result is dropped rather than stalling the pipeline
+        pass.querySample[slot] = -1;
+        glBeginQuery(GL_TIME_ELAPSED, pass.queries[slot]);
+    }
+    pass.cpuStart = now();
+
+    return p;
+}
+
+
+void Profiler::endPass(int _pass)
+{
+    Pass& pass = m_passes[_pass];
+    double cpuEnd = now();
+
+    Sample& sample = pass.samples[pass.next];
+    sample.frame = m_frame;
+    sample.cpuStart = pass.cpuStart;
+    sample.cpuTime = (float)((cpuEnd - pass.cpuStart) * 0.001);
+    sample.gpuTime = -1.0f;
+
+    if(m_gpuTimingAvailable)
+    {
+        glEndQuery(GL_TIME_ELAPSED);
+        pass.querySample[m_frame & 1] = pass.next;
+    }
+
+    pass.next = (pass.next + 1) % m_windowSize;
+    pass.count = std::min(pass.count + 1, m_windowSize);
+}
+
+
+void Profiler::collectQuery(Pass& _pass, int _slot, bool _wait)
+{
+    if(_pass.querySample[_slot] < 0)
+        return;
+
+    GLint available = 0;
+    if(!_wait)
+        glGetQueryObjectiv(_pass.queries[_slot], GL_QUERY_RESULT_AVAILABLE, &available);
+
+    if(_wait || available)
+    {
+        GLuint64 elapsed = 0;
+        glGetQueryObjectui64v(_pass.queries[_slot], GL_QUERY_RESULT, &elapsed);
+        _pass.samples[_pass.querySample[_slot]].gpuTime = (float)((double)elapsed * 1.0e-6);
+        _pass.querySample[_slot] = -1;
+    }
+}
+
+
+void Profiler::flush()
+{
+    if(m_gpuTimingAvailable)
+        for(Pass& pass : m_passes)
+            for(int slot = 0; slot < 2; slot++)
+                collectQuery(pass, slot, true);
+}
+
+
+PassStats Profiler::getStats(int _pass)
+{
+    Pass& pass = m_passes[_pass];
+
+    std::vector<float> cpuTimes, gpuTimes;
+    for(int i = 0; i < pass.count; i++)
+    {
+        cpuTimes.push_back(pass.samples[i].cpuTime);
+        if(pass.samples[i].gpuTime >= 0.0f)
+            gpuTimes.push_back(pass.samples[i].gpuTime);
+    }
+
+    // min, mean and 99th percentile (nearest-rank) of a set of times
+    auto computeStats = [](std::vector<float>& _times, float& _min, float& _mean, float& _p99)
+    {
+        _min = _mean = _p99 = -1.0f;
+        if(_times.empty())
+            return;
+        std::sort(_times.begin(), _times.end());
+        double sum = 0.0;
+        for(float t : _times)
+            sum += t;
+        _min = _times.front();
+        _mean = (float)(sum / (double)_times.size());
+        size_t rank = (size_t)std::ceil(0.99 * (double)_times.size());
+        _p99 = _times[std::max<size_t>(rank, 1) - 1];
+    };
+
+    PassStats stats;
+    stats.numSamples = pass.count;
+    computeStats(cpuTimes, stats.cpuMin, stats.cpuMean, stats.cpuP99);
+    computeStats(gpuTimes, stats.gpuMin, stats.gpuMean, stats.gpuP99);
+
+    return stats;
+}
+
+
+float Profiler::getLastFrameGPUTime()
+{
+    if(!m_gpuTimingAvailable)
+        return -1.0f;
+
+    // results are read back with up to 2 frames of latency: only the last samples of each pass are searched
+    const int numRecent = std::min(3, m_windowSize);
+
+    // most recent frame with a GPU result
+    long long lastFrame = -1;
+    for(Pass& pass : m_passes)
+        for(int i = 1; i <= std::min(numRecent, pass.count); i++)
+        {
+            const Sample& s = pass.samples[(pass.next - i + m_windowSize) % m_windowSize];
+            if(s.gpuTime >= 0.0f)
+                lastFrame = std::max(lastFrame, s.frame);
+        }
+
+    // the frame is complete if none of its passes is still pending, otherwise the previous frame is used
+    for(long long frame = lastFrame; frame >= 0 && frame >= lastFrame - 1; frame--)
+    {
+        float total = 0.0f;
+        bool isComplete = true;
+        for(Pass& pass : m_passes)
+            for(int i = 1; i <= std::min(numRecent, pass.count); i++)
+            {
+                const Sample& s = pass.samples[(pass.next - i + m_windowSize) % m_windowSize];
+                if(s.frame != frame)
+                    continue;
+                if(s.gpuTime >= 0.0f)
+                    total += s.gpuTime;
+                else
+                    isComplete = false;
+            }
+        if(isComplete)
+            return total;
+    }
+
+    return -1.0f;
+}
+
+
+void Profiler::reset()
+{
+    for(Pass& pass : m_passes)
+    {
+        pass.next = 0;
+        pass.count = 0;
+        pass.querySample[0] = pass.querySample[1] = -1;
+    }
+}
+
+
+void Profiler::writeSummary(std::ostream& _out)
+{
+    std::ios_base::fmtflags flags = _out.flags();
+    std::streamsize precision = _out.precision();
+
+    _out << std::left << std::setw(14) << "pass" << std::right
+         << std::setw(10) << "cpu min" << std::setw(10) << "cpu mean" << std::setw(10) << "cpu p99"
+         << std::setw(10) << "gpu min" << std::setw(10) << "gpu mean" << std::setw(10) << "gpu p99" << "   (ms)" << std::endl;
+    _out << std::fixed << std::setprecision(3);
+    for(int p = 0; p < getNumPasses(); p++)
+    {
+        PassStats stats = getStats(p);
+        if(stats.numSamples == 0)
+            continue;
+        _out << std::left << std::setw(14) << m_passes[p].name << std::right
+             << std::setw(10) << stats.cpuMin << std::setw(10) << stats.cpuMean << std::setw(10) << stats.cpuP99;
+        if(stats.gpuMean >= 0.0f)
+            _out << std::setw(10) << stats.gpuMin << std::setw(10) << stats.gpuMean << std::setw(10) << stats.gpuP99;
+        else
+            _out << std::setw(10) << "-" << std::setw(10) << "-" << std::setw(10) << "-";
+        _out << std::endl;
+    }
+
+    _out.flags(flags);
+    _out.precision(precision);
+}
+
+
+bool Profiler::exportCSV(const std::string& _filename)
+{
+    std::ofstream file(_filename);
+    if(!file.is_open())
+    {
+        errorLog() << "Profiler::exportCSV(): cannot write " << _filename;
+        return false;
+    }
+
+    file << "frame,pass,cpu_start_us,cpu_ms,gpu_ms\n";
+    for(Pass& pass : m_passes)
+    {
+        // oldest sample first
+        int first = (pass.count < m_windowSize) ? 0 : pass.next;
+        for(int i = 0; i < pass.count; i++)
+        {
+            const Sample& s = pass.samples[(first + i) % m_windowSize];
+            file << s.frame << "," << pass.name << "," << (long long)s.cpuStart << "," << s.cpuTime << ",";
+            if(s.gpuTime >= 0.0f)
+                file << s.gpuTime;
+            file << "\n";
+        }
+    }
+
+    infoLog() << "Profiler::exportCSV(): timings written to " << _filename;
+    return true;
+}
+
+
+bool Profiler::exportChromeTrace(const std::string& _filename)
+{
+    std::ofstream file(_filename);
+    if(!file.is_open())
+    {
+        errorLog() << "Profiler::exportChromeTrace(): cannot write " << _filename;
+        return false;
+    }
+
+    // gather all samples in submission order
+    std::vector<std::pair<const Sample*, const std::string*> > events;
+    for(Pass& pass : m_passes)
+        for(int i = 0; i < pass.count; i++)
+            events.push_back(std::make_pair(&pass.samples[i], &pass.name));
+    std::sort(events.begin(), events.end(), [](const std::pair<const Sample*, const std::string*>& _a,
+                                               const std::pair<const Sample*, const std::string*>& _b)
+                                            { return _a.first->cpuStart < _b.first->cpuStart; });
+
+    file << std::fixed << std::setprecision(3);
+    file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"CPU\"}},\n";
+    file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}";
+
+    // GPU start times are not queried: GPU passes are laid out back to back, never before their CPU submission
+    double gpuCursor = 0.0;
+    for(const std::pair<const Sample*, const std::string*>& e : events)
+    {
+        const Sample& s = *e.first;
+        file << ",\n{\"name\":\"" << *e.second << "\",\"cat\":\"cpu\",\"ph\":\"X\",\"pid\":1,\"tid\":1,\"ts\":"
+             << s.cpuStart << ",\"dur\":" << s.cpuTime * 1000.0f << ",\"args\":{\"frame\":" << s.frame << "}}";
+        if(s.gpuTime >= 0.0f)
+        {
+            gpuCursor = std::max(gpuCursor, s.cpuStart);
+            file << ",\n{\"name\":\"" << *e.second << "\",\"cat\":\"gpu\",\"ph\":\"X\",\"pid\":1,\"tid\":2,\"ts\":"
+                 << gpuCursor << ",\"dur\":" << s.gpuTime * 1000.0f << ",\"args\":{\"frame\":" << s.frame << "}}";
+            gpuCursor += s.gpuTime * 1000.0;
+        }
+    }
+    file << "\n]}\n";
+
+    infoLog() << "Profiler::exportChromeTrace(): trace written to " << _filename;
+    return true;
+}
@@ -0,0 +1,253 @@
+/*********************************************************************************************************************
+ *
+ * profiler.h
+ *
+ * Per-pass CPU and GPU timing instrumentation
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+
+#include <string>
+#include <vector>
+#include <chrono>
+#include <ostream>
+
+
+
+/*!
+* \struct PassStats
+* \brief Rolling statistics of a render pass, in milliseconds (GPU values are negative if not available)
+*/
+struct PassStats
+{
+    float cpuMin, cpuMean, cpuP99;      /*!< CPU time statistics */
+    float gpuMin, gpuMean, gpuP99;      /*!< GPU time statistics */
+    int numSamples;                     /*!< number of samples in the rolling window */
+};
+
+
+
+/*!
+* \class Profiler
+* \brief Measure the CPU time and GPU time (GL_TIME_ELAPSED queries) of each render pass.
+*        GPU queries are double-buffered: the result of a query is read one frame later, so the CPU never waits for the GPU.
+*        Statistics are computed over a rolling window of the last frames, and can be exported as CSV or Chrome trace JSON
+*        (to be opened in chrome://tracing or https://ui.perfetto.dev).
+*/
+class Profiler
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn Profiler
+        * \brief Constructor of Profiler
+        * \param _windowSize : number of frames kept for rolling statistics
+        */
+        Profiler(int _windowSize = 256);
+
+        /*!
+        * \fn ~Profiler
+        * \brief Destructor of Profiler: deletes GL queries
+        */
+        ~Profiler();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumPasses */
+        inline int getNumPasses() { return (int)m_passes.size(); }
+        /*! \fn getPassName */
+        inline const std::string& getPassName(int _pass) { return m_passes[_pass].name; }
+        /*! \fn isGPUTimingAvailable */
+        inline bool isGPUTimingAvailable() { return m_gpuTimingAvailable; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn init
+        * \brief Check GL timer query support (requires a current GL context)
+        */
+        void init();
+
+        /*!
+        * \fn beginFrame
+        * \brief Start a new frame: collect GPU results of the queries issued two frames ago
+        */
+        void beginFrame();
+
+        /*!
+        * \fn beginPass
+        * \brief Start timing a pass (passes must not be nested, since GL_TIME_ELAPSED queries cannot be)
+        * \param _name : pass name (the pass is registered on first use)
+        * \return index of the pass
+        */
+        int beginPass(const std::string& _name);
+
+        /*!
+        * \fn endPass
+        * \brief Stop timing a pass
+        * \param _pass : index of the pass returned by beginPass()
+        */
+        void endPass(int _pass);
+
+        /*!
+        * \fn flush
+        * \brief Wait for the results of all pending GPU queries (e.g. before a final report)
+        */
+        void flush();
+
+        /*!
+        * \fn getStats
+        * \brief Compute rolling min, mean and 99th percentile of a pass
+        * \param _pass : index of the pass
+        * \return statistics of the pass
+        */
+        PassStats getStats(int _pass);
+
+        /*!
+        * \fn getLastFrameGPUTime
+        * \brief Sum of the GPU times of all passes, for the most recent frame whose queries are all available
+        * \return GPU time of the frame, in ms (negative if not available)
+        */
+        float getLastFrameGPUTime();
+
+        /*!
+        * \fn reset
+        * \brief Clear all recorded samples
+        */
+        void reset();
+
+        /*!
+        * \fn writeSummary
+        * \brief Write a text table of the statistics of every pass
+        * \param _out : output stream
+        */
+        void writeSummary(std::ostream& _out);
+
+        /*!
+        * \fn exportCSV
+        * \brief Write all samples of the rolling window in a CSV file (one line per pass and per frame)
+        * \param _filename : output file name
+        * \return true if file was written
+        */
+        bool exportCSV(const std::string& _filename);
+
+        /*!
+        * \fn exportChromeTrace
+        * \brief Write all samples of the rolling window in Chrome trace event JSON format (CPU and GPU tracks)
+        * \param _filename : output file name
+        * \return true if file was written
+        */
+        bool exportChromeTrace(const std::string& _filename);
+
+
+    protected:
+
+        /*!
+        * \struct Sample
+        * \brief Timing of one pass for one frame
+        */
+        struct Sample
+        {
+            long long frame;        /*!< frame index */
+            double cpuStart;        /*!< CPU start time, in microseconds since profiler creation */
+            float cpuTime;          /*!< CPU time, in ms */
+            float gpuTime;          /*!< GPU time, in ms (negative while pending) */
+        };
+
+        /*!
+        * \struct Pass
+        * \brief Samples and GL queries of a pass
+        */
+        struct Pass
+        {
+            std::string name;               /*!< pass name */
+            std::vector<Sample> samples;    /*!< ring buffer of samples */
+            int next;                       /*!< next slot in ring buffer */
+            int count;                      /*!< number of valid samples in ring buffer */
+            GLuint queries[2];              /*!< double-buffered GL_TIME_ELAPSED queries */
+            int querySample[2];             /*!< sample slot waiting for the result of each query (-1 if none) */
+            double cpuStart;                /*!< start of the running CPU timer */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        std::vector<Pass> m_passes;         /*!< registered passes */
+        int m_windowSize;                   /*!< number of samples per pass */
+        long long m_frame;                  /*!< current frame index */
+        bool m_gpuTimingAvailable;          /*!< flag to indicate if GL timer queries are supported */
+
+        std::chrono::steady_clock::time_point m_startTime;   /*!< reference time */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn now
+        * \brief Current CPU time, in microseconds since profiler creation
+        */
+        double now();
+
+        /*!
+        * \fn collectQuery
+        * \brief Read back the result of a query, if available
+        * \param _pass : pass
+        * \param _slot : query slot (0 or 1)
+        * \param _wait : wait for the result if not available yet
+        */
+        void collectQuery(Pass& _pass, int _slot, bool _wait);
+
+};
+
+
+
+/*!
+* \class ScopedPassTimer
+* \brief Time a render pass from construction to destruction
+*/
+class ScopedPassTimer
+{
+    public:
+
+        /*!
+        * \fn ScopedPassTimer
+        * \brief Start timing the pass
+        * \param _profiler : profiler collecting the samples
+        * \param _name : pass name
+        */
+        ScopedPassTimer(Profiler& _profiler, const std::string& _name) : m_profiler(_profiler) { m_pass = m_profiler.beginPass(_name); }
+
+        /*!
+        * \fn ~ScopedPassTimer
+        * \brief Stop timing the pass
+        */
+        ~ScopedPassTimer() { m_profiler.endPass(m_pass); }
+
+    protected:
+
+        Profiler& m_profiler;       /*!< profiler collecting the samples */
+        int m_pass;                 /*!< index of the pass */
+};
+
+#endif // PROFILER_H
@@ -0,0 +1,288 @@
+/*********************************************************************************************************************
+ *
+ * rendertargetpool.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "rendertargetpool.h"
+
+#include "GLtools.h"
+
+#include <iomanip>
+#include <string>
+#include <algorithm>
+
+
+RenderTargetPool::RenderTargetPool(int _maxUnusedFrames)
+{
+    m_maxUnusedFrames = std::max(0, _maxUnusedFrames);
+    m_frame = 0;
+    m_allocatedBytes = 0;
+    m_peakBytes = 0;
+}
+
+
+RenderTargetPool::~RenderTargetPool()
+{
+    clear();
+}
+
+
+int RenderTargetPool::getNumTargetsInUse()
+{
+    int count = 0;
+    for(std::unique_ptr<RenderTarget>& target : m_targets)
+        if(target->isInUse)
+            count++;
+    return count;
+}
+
+
+size_t RenderTargetPool::computeBytes(const RenderTargetDesc& _desc)
+{
+    // bytes per pixel of the formats used by the render passes
+    auto pixelSize = [](GLenum _format) -> size_t
+    {
+        switch(_format)
+        {
+            case GL_R8:                     return 1;
+            case GL_R16F:                   return 2;
+            case GL_RG8:                    return 2;
+            case GL_RGBA8:                  return 4;
+            case GL_RG16:
+            case GL_RG16F:
+            case GL_R32F:                   return 4;
+            case GL_RGB16F:                 return 6;
+            case GL_RGBA16F:                return 8;
+            case GL_RGBA32F:                return 16;
+            case GL_DEPTH_COMPONENT16:      return 2;
+            case GL_DEPTH_COMPONENT:
+            case GL_DEPTH_COMPONENT24:
+            case GL_DEPTH_COMPONENT32F:
+            case GL_DEPTH24_STENCIL8:       return 4;
+            default:                        return 4;
+        }
+    };
+
+    size_t numPixels = (size_t)_desc.width * (size_t)_desc.height;
+    // color textures with their mip levels
+    size_t numColorPixels = 0;
+    for(int level = 0; level < std::max(1, _desc.numLevels); level++)
+        numColorPixels += (size_t)std::max(1, _desc.width >> level) * (size_t)std::max(1, _desc.height >> level);
+    size_t bytes = 0;
+    for(int t = 0; t < _desc.numColorTex; t++)
+        bytes += numColorPixels * pixelSize(_desc.getColorFormat(t));
+    if(_desc.depthFormat != GL_NONE)
+        bytes += numPixels * pixelSize(_desc.depthFormat);
+    return bytes * (size_t)std::max(1, _desc.numLayers);
+}
+
+
+std::unique_ptr<RenderTarget> RenderTargetPool::createTarget(const RenderTargetDesc& _desc)
+{
+    std::unique_ptr<RenderTarget> target = std::make_unique<RenderTarget>();
+    target->desc = _desc;
+    target->isInUse = false;
+    target->lastUsedFrame = m_frame;
+    target->depth = 0;
+    for(int t = 0; t < RenderTarget::MAX_COLOR_TEX; t++)
+        target->colorTex[t] = 0;
+
+    int numColorTex = std::clamp(_desc.numColorTex, 0, RenderTarget::MAX_COLOR_TEX);
+    target->desc.numColorTex = numColorTex;
+    int numLevels = std::max(1, _desc.numLevels);
+    target->desc.numLevels = numLevels;
+    int numLayers = std::max(1, _desc.numLayers);
+    target->desc.numLayers = numLayers;
+    // texture arrays are attached as layered targets (a pass selects the layer it renders to)
+    GLenum texTarget = (numLayers > 1) ? GL_TEXTURE_2D_ARRAY : GL_TEXTURE_2D;
+
+    // generate FBO
+    glGenFramebuffers(1, &target->fbo);
+    glBindFramebuffer(GL_FRAMEBUFFER, target->fbo);
+
+    // color textures
+    GLenum attachments[RenderTarget::MAX_COLOR_TEX];
+    for(int t = 0; t < numColorTex; t++)
+    {
+        glGenTextures(1, &target->colorTex[t]);
+        glBindTexture(texTarget, target->colorTex[t]);
+        for(int level = 0; level < numLevels; level++)
+        {
+            int width = std::max(1, _desc.width >> level);
+            int height = std::max(1, _desc.height >> level);
+            if(numLayers > 1)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, level, _desc.getColorFormat(t), width, height, numLayers, 0, GL_RGBA, GL_FLOAT, NULL);
+            else
+                glTexImage2D(GL_TEXTURE_2D, level, _desc.getColorFormat(t), width, height, 0, GL_RGBA, GL_FLOAT, NULL);
+        }
+        glTexParameteri(texTarget, GL_TEXTURE_MAX_LEVEL, numLevels - 1);
+        if(numLevels > 1)
+            glTexParameteri(texTarget, GL_TEXTURE_MIN_FILTER, (_desc.filter == GL_LINEAR) ? GL_LINEAR_MIPMAP_NEAREST : GL_NEAREST_MIPMAP_NEAREST);
+        else
+            glTexParameteri(texTarget, GL_TEXTURE_MIN_FILTER, _desc.filter);
+        glTexParameteri(texTarget, GL_TEXTURE_MAG_FILTER, _desc.filter);
+        glTexParameteri(texTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(texTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        attachments[t] = GL_COLOR_ATTACHMENT0 + t;
+        glFramebufferTexture(GL_FRAMEBUFFER, attachments[t], target->colorTex[t], 0);
+    }
+
+    if(numColorTex > 0)
+    {
+        glDrawBuffers(numColorTex, attachments);
+        // start with null color and alpha everywhere (alpha is used as a mask by the TSD blur)
+        GLfloat clearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+        for(int t = 0; t < numColorTex; t++)
+            glClearBufferfv(GL_COLOR, t, clearColor);
+    }
+    else
+    {
+        // we are not going to render any color
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+    }
+
+    // depth attachment
+    if(_desc.depthFormat != GL_NONE)
+    {
+        if(_desc.isDepthTexture)
+        {
+            glGenTextures(1, &target->depth);
+            glBindTexture(texTarget, target->depth);
+            if(numLayers > 1)
+                glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, _desc.depthFormat, _desc.width, _desc.height, numLayers, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            else
+                glTexImage2D(GL_TEXTURE_2D, 0, _desc.depthFormat, _desc.width, _desc.height, 0, GL_DEPTH_COMPONENT, GL_FLOAT, nullptr);
+            glTexParameteri(texTarget, GL_TEXTURE_MIN_FILTER, _desc.filter);
+            glTexParameteri(texTarget, GL_TEXTURE_MAG_FILTER, _desc.filter);
+            glTexParameteri(texTarget, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+            glTexParameteri(texTarget, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+            float borderColor[] = { 1.0f, 1.0f, 1.0f, 1.0f };   // border depth set to far plane to avoid fake shadow outside shadowmap
+            glTexParameterfv(texTarget, GL_TEXTURE_BORDER_COLOR, borderColor);
+            glFramebufferTexture(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, target->depth, 0);
+        }
+        else
+        {
+            glGenRenderbuffers(1, &target->depth);
+            glBindRenderbuffer(GL_RENDERBUFFER, target->depth);
+            glRenderbufferStorage(GL_RENDERBUFFER, _desc.depthFormat, _desc.width, _desc.height);
+            glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, target->depth);
+        }
+    }
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        errorLog() << "RenderTargetPool::createTarget(): FBO incomplete (" << _desc.width << "x" << _desc.height << ")";
+    }
+
+    glBindTexture(texTarget, 0);
+    glBindRenderbuffer(GL_RENDERBUFFER, 0);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    m_allocatedBytes += computeBytes(target->desc);
+    m_peakBytes = std::max(m_peakBytes, m_allocatedBytes);
+
+    return target;
+}
+
+
+void RenderTargetPool::deleteTarget(RenderTarget& _target)
+{
+    glDeleteFramebuffers(1, &_target.fbo);
+    glDeleteTextures(_target.desc.numColorTex, _target.colorTex);
+    if(_target.depth != 0)
+    {
+        if(_target.desc.isDepthTexture)
+            glDeleteTextures(1, &_target.depth);
+        else
+            glDeleteRenderbuffers(1, &_target.depth);
+    }
+
+    m_allocatedBytes -= computeBytes(_target.desc);
+}
+
+
+void RenderTargetPool::beginFrame()
+{
+    m_frame++;
+
+    // delete targets that the enabled passes do not need anymore
+    for(size_t t = 0; t < m_targets.size(); )
+    {
+        RenderTarget& target = *m_targets[t];
+        if(!target.isInUse && m_frame - target.lastUsedFrame > m_maxUnusedFrames)
+        {
+            deleteTarget(target);
+            m_targets.erase(m_targets.begin() + t);
+        }
+        else
+            t++;
+    }
+}
+
+
+RenderTarget* RenderTargetPool::acquire(const RenderTargetDesc& _desc)
+{
+    // recycle a free target with the same format and size
+    for(std::unique_ptr<RenderTarget>& target : m_targets)
+        if(!target->isInUse && target->desc == _desc)
+        {
+            target->isInUse = true;
+            target->lastUsedFrame = m_frame;
+            return target.get();
+        }
+
+    m_targets.push_back( createTarget(_desc) );
+    RenderTarget* target = m_targets.back().get();
+    target->isInUse = true;
+    target->lastUsedFrame = m_frame;
+    return target;
+}
+
+
+void RenderTargetPool::release(RenderTarget*& _target)
+{
+    if(_target == nullptr)
+        return;
+
+    _target->isInUse = false;
+    _target->lastUsedFrame = m_frame;
+    _target = nullptr;
+}
+
+
+void RenderTargetPool::clear()
+{
+    for(std::unique_ptr<RenderTarget>& target : m_targets)
+        deleteTarget(*target);
+    m_targets.clear();
+}
+
+
+void RenderTargetPool::writeSummary(std::ostream& _out)
+{
+    std::ios_base::fmtflags flags = _out.flags();
+    std::streamsize precision = _out.precision();
+
+    _out << std::fixed << std::setprecision(2);
+    _out << "render targets: " << m_targets.size() << ", " << (double)m_allocatedBytes / (1024.0 * 1024.0) << " MB"
+         << " (peak " << (double)m_peakBytes / (1024.0 * 1024.0) << " MB)" << std::endl;
+    for(std::unique_ptr<RenderTarget>& target : m_targets)
+    {
+        const RenderTargetDesc& d = target->desc;
+        _out << "  " << d.width << "x" << d.height << ", " << d.numColorTex << " color tex (0x" << std::hex;
+        if(d.firstColorFormat != GL_NONE)
+            _out << d.firstColorFormat << ", 0x";
+        _out << d.colorFormat << std::dec << ")"
+             << (d.numLevels > 1 ? ", " + std::to_string(d.numLevels) + " levels" : "")
+             << (d.depthFormat != GL_NONE ? (d.isDepthTexture ? ", depth tex" : ", depth rb") : "")
+             << ": " << (double)computeBytes(d) / (1024.0 * 1024.0) << " MB" << std::endl;
+    }
+
+    _out.flags(flags);
+    _out.precision(precision);
+}
@@ -0,0 +1,201 @@
+/*********************************************************************************************************************
+ *
+ * rendertargetpool.h
+ *
+ * Pool of transient render targets (FBO + attached textures)
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef RENDERTARGETPOOL_H
+#define RENDERTARGETPOOL_H
+
+#include <GL/glew.h>
+
+#include <vector>
+#include <memory>
+#include <ostream>
+
+
+
+/*!
+* \struct RenderTargetDesc
+* \brief Format and size of a render target. Two targets with equal descriptions are interchangeable.
+*/
+struct RenderTargetDesc
+{
+    int width;                  /*!< width, in pixels */
+    int height;                 /*!< height, in pixels */
+    GLenum colorFormat;         /*!< internal format of the color textures (ignored if numColorTex is 0) */
+    int numColorTex;            /*!< number of color textures (attached to GL_COLOR_ATTACHMENT0..n-1) */
+    GLenum depthFormat;         /*!< internal format of the depth attachment (GL_NONE if no depth buffer) */
+    bool isDepthTexture;        /*!< depth attachment is a texture that can be sampled (renderbuffer otherwise) */
+    GLint filter;               /*!< min/mag filter of the textures (GL_NEAREST or GL_LINEAR) */
+    int numLevels = 1;          /*!< number of mip levels of the color textures (only level 0 is attached to the FBO) */
+    int numLayers = 1;          /*!< number of layers: texture arrays attached as layered targets if > 1 (depth must be a texture) */
+    GLenum firstColorFormat = GL_NONE;  /*!< internal format of the first color texture, if it differs from the others (GL_NONE otherwise) */
+
+    bool operator==(const RenderTargetDesc& _other) const
+    {
+        return width == _other.width && height == _other.height && colorFormat == _other.colorFormat &&
+               numColorTex == _other.numColorTex && depthFormat == _other.depthFormat &&
+               isDepthTexture == _other.isDepthTexture && filter == _other.filter && numLevels == _other.numLevels &&
+               numLayers == _other.numLayers && firstColorFormat == _other.firstColorFormat;
+    }
+
+    /*! \fn getColorFormat : internal format of a color texture */
+    GLenum getColorFormat(int _tex) const { return (_tex == 0 && firstColorFormat != GL_NONE) ? firstColorFormat : colorFormat; }
+};
+
+
+
+/*!
+* \struct RenderTarget
+* \brief FBO and its attachments, owned by the RenderTargetPool
+*/
+struct RenderTarget
+{
+    static constexpr int MAX_COLOR_TEX = 4; /*!< maximum number of color textures */
+
+    RenderTargetDesc desc;                  /*!< format and size */
+    GLuint fbo;                             /*!< framebuffer object */
+    GLuint colorTex[MAX_COLOR_TEX];         /*!< color textures */
+    GLuint depth;                           /*!< depth texture or renderbuffer (0 if none) */
+    bool isInUse;                           /*!< acquired and not released yet */
+    long long lastUsedFrame;                /*!< last frame in which the target was acquired */
+};
+
+
+
+/*!
+* \class RenderTargetPool
+* \brief Allocate render targets on demand, and recycle them.
+*        A pass acquires a target with a given description, and releases it after its last reader: the memory is then
+*        reused by the next pass acquiring the same description (i.e. targets whose lifetimes do not overlap are
+*        aliased). Targets which have not been acquired for a few frames are deleted, so the allocated memory follows
+*        the features which are actually enabled.
+*/
+class RenderTargetPool
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn RenderTargetPool
+        * \brief Constructor of RenderTargetPool
+        * \param _maxUnusedFrames : number of frames a free target is kept before being deleted
+        */
+        RenderTargetPool(int _maxUnusedFrames = 4);
+
+        /*!
+        * \fn ~RenderTargetPool
+        * \brief Destructor of RenderTargetPool: deletes all targets (requires a current GL context)
+        */
+        ~RenderTargetPool();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumTargets */
+        inline int getNumTargets() { return (int)m_targets.size(); }
+        /*! \fn getAllocatedBytes */
+        inline size_t getAllocatedBytes() { return m_allocatedBytes; }
+        /*! \fn getPeakBytes */
+        inline size_t getPeakBytes() { return m_peakBytes; }
+
+        /*!
+        * \fn getNumTargetsInUse
+        * \return number of targets currently acquired
+        */
+        int getNumTargetsInUse();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn beginFrame
+        * \brief Start a new frame: delete targets that have not been acquired during the last frames
+        */
+        void beginFrame();
+
+        /*!
+        * \fn acquire
+        * \brief Get a free target matching the description, or allocate a new one.
+        *        The content of a recycled target is undefined: it must be cleared or fully overwritten.
+        * \param _desc : format and size of the target
+        * \return target (owned by the pool, valid until released)
+        */
+        RenderTarget* acquire(const RenderTargetDesc& _desc);
+
+        /*!
+        * \fn release
+        * \brief Give a target back to the pool (its memory can be reused by the next acquire)
+        * \param _target : target to release (set to nullptr; nothing is done if already nullptr)
+        */
+        void release(RenderTarget*& _target);
+
+        /*!
+        * \fn clear
+        * \brief Delete all targets, including those in use
+        */
+        void clear();
+
+        /*!
+        * \fn writeSummary
+        * \brief Write the list of allocated targets and their memory
+        * \param _out : output stream
+        */
+        void writeSummary(std::ostream& _out);
+
+        /*!
+        * \fn computeBytes
+        * \brief Estimate the memory of a target (textures and renderbuffers, without driver padding)
+        * \param _desc : format and size of the target
+        * \return size in bytes
+        */
+        static size_t computeBytes(const RenderTargetDesc& _desc);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        std::vector<std::unique_ptr<RenderTarget> > m_targets;     /*!< allocated targets */
+        int m_maxUnusedFrames;                                      /*!< frames a free target is kept */
+        long long m_frame;                                          /*!< current frame index */
+        size_t m_allocatedBytes;                                    /*!< memory of the allocated targets */
+        size_t m_peakBytes;                                         /*!< highest allocated memory */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn createTarget
+        * \brief Allocate FBO, textures and renderbuffer of a target
+        * \param _desc : format and size of the target
+        * \return new target
+        */
+        std::unique_ptr<RenderTarget> createTarget(const RenderTargetDesc& _desc);
+
+        /*!
+        * \fn deleteTarget
+        * \brief Delete FBO, textures and renderbuffer of a target
+        * \param _target : target to delete
+        */
+        void deleteTarget(RenderTarget& _target);
+};
+
+#endif // RENDERTARGETPOOL_H
@@ -0,0 +1,63 @@
+/*********************************************************************************************************************
+ *
+ * sampling.h
+ *
+ * Constants and small helpers shared by the CPU renderers and bakers
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef SAMPLING_H
+#define SAMPLING_H
+
+
+#include <cstdint>
+#include <cmath>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+
+static const float PI = 3.14159265359f;
+// metalness of the materials without PBR textures (lighting.frag)
+static const float METALNESS = 0.5f;
+
+
+
+/*!
+* \fn hash32
+* \brief Integer hash (lowbias32), to seed and decorrelate random sequences
+* \param _x : value to hash
+* \return hashed value
+*/
+inline uint32_t hash32(uint32_t _x)
+{
+    _x ^= _x >> 16u;
+    _x *= 0x7feb352du;
+    _x ^= _x >> 15u;
+    _x *= 0x846ca68bu;
+    _x ^= _x >> 16u;
+    return _x;
+}
+
+
+/*!
+* \fn orthonormalBasis
+* \brief Tangent and bitangent around a normal, without branches nor normalization (Duff et al. 2017)
+* \param _N : normalized normal
+* \param _T, _B : tangent and bitangent
+*/
+inline void orthonormalBasis(const glm::vec3& _N, glm::vec3& _T, glm::vec3& _B)
+{
+    float sign = std::copysign(1.0f, _N.z);
+    float a = -1.0f / (sign + _N.z);
+    float b = _N.x * _N.y * a;
+    _T = glm::vec3(1.0f + sign * _N.x * _N.x * a, sign * b, -sign * _N.x);
+    _B = glm::vec3(b, sign + _N.y * _N.y * a, -_N.y);
+}
+
+#endif // SAMPLING_H
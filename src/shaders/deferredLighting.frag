@@ -0,0 +1,120 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Deferred shading: lighting of the surfaces stored in the G-buffer, in a single screen pass.
+// Each pixel is shaded once, whatever the number of overlapping surfaces (no overdraw cost).
+// Same lighting as lighting.frag: Cook-Torrance BRDF, shadow mapping (single, filtered moments
+// or cascaded), image-based ambient lighting and clustered local lights.
+// Environment mapping, light transmission and texture space diffusion keep the forward pass.
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_depthTex;		// depth (world space position, see gBufferPosition())
+uniform sampler2D u_normalTex;		// octahedral normal, world space
+uniform sampler2D u_colorTex;		// diffuse color (rgb) and roughness (a)
+uniform sampler2D u_specularTex;	// base reflectivity F0 (rgb) and ambient occlusion (a)
+
+uniform mat4 u_matMInv;				// inverse of the model matrix (world to model space, for shadow maps)
+uniform mat4 u_matPV_light;			// projection-view matrix of the light camera (model space)
+uniform vec3 u_lightColor;
+uniform vec3 u_lightPos;
+uniform vec3 u_camPos;
+uniform int u_isLightDir;
+uniform float u_distLightMax;
+uniform int u_useShadowMap;
+uniform int u_useIBL;
+uniform int u_useGammaCorrec;
+
+
+// INPUT
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec4 frag_color;
+
+
+
+
+// MAIN
+void main()
+{
+	// 1- Read G-buffer ------------------------------------------------
+
+	vec3 pos_world = gBufferPosition(u_depthTex, vert_uv.xy);
+	// background (cleared G-buffer): keep the clear color of the target
+	if(pos_world == vec3(0.0))
+		discard;
+
+	vec4 colorRoughness = texture(u_colorTex, vert_uv.xy);
+	vec4 F0Occlusion = texture(u_specularTex, vert_uv.xy);
+
+	vec3 N = gBufferNormal(u_normalTex, vert_uv.xy);
+	vec3 V = normalize(u_camPos - pos_world);
+	// the diffuse color is already weighted by (1 - metalness)
+	vec3 albedoD = colorRoughness.rgb;
+	float metalness = 0.0;
+	float roughness = colorRoughness.a;
+	vec3 F0 = F0Occlusion.rgb;
+
+	// position in the space of the shadow pass, and distance to the camera
+	vec3 pos_model = vec3(u_matMInv * vec4(pos_world, 1.0));
+	float view_depth = -(u_matV * vec4(pos_world, 1.0)).z;
+
+
+	// 2- Main light ---------------------------------------------------
+
+	vec3 L;
+	float attenuation = 10.0f;
+	if(u_isLightDir == 1)
+	{
+		// cst vec if directional light
+		L = normalize(mat3(u_matM) * u_lightPos);
+	}
+	else
+	{
+		// point light
+		L = mat3(u_matM) * u_lightPos - pos_world;
+		float distance = length(L) / u_distLightMax;
+		distance *= 0.5; // reduce distance to reduce attenuation
+		attenuation = 1.0 / (distance * distance);
+		L = normalize(L);
+	}
+
+	vec3 Lo = CookTorranceBRDF(N, V, L, albedoD, F0, roughness, metalness) * u_lightColor * attenuation;
+
+	// Shadow mapping
+	float shadow = 0.0;
+	if(u_useShadowMap == 1)
+	{
+		if(u_numCascades > 0)
+			shadow = CascadeShadowCalculation(pos_model, view_depth, N, L);
+		else if(u_shadowMethod > 0)
+			shadow = MomentShadowCalculation(u_matPV_light * vec4(pos_model, 1.0), N, L);
+		else
+			shadow = ShadowCalculation(u_matPV_light * vec4(pos_model, 1.0), N, L);
+	}
+
+
+	// 3- Ambient and local lights -------------------------------------
+
+	vec3 ambient = vec3(0.03) * albedoD;
+	if(u_useIBL == 1)
+		ambient = ambient_IBL(N, V, albedoD, F0, roughness, metalness);
+
+	vec3 Lo_local = vec3(0.0);
+	if(u_numLocalLights > 0)
+		Lo_local = LocalLightsRadiance(pos_world, view_depth, N, V, albedoD, F0, roughness, metalness);
+
+	// points in shadow still have a 0.5 illumination factor, as in the forward pass
+	vec3 color = (ambient + Lo * (1.5 - shadow) + Lo_local) * F0Occlusion.a;
+
+	//GAMMA CORRECTION
+	if(u_useGammaCorrec == 1)
+		color = linear_to_gamma(color);
+
+	frag_color = vec4(color, 1.0);
+}
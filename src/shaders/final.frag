@@ -1,14 +1,19 @@
 // Fragment shader
 //#version 150
-#version 330
+//#version 330
 
 
 uniform sampler2D u_colorTex;
 uniform sampler2D u_aoTex;
 
+// reduced resolution SSAO: full and low resolution G-buffers for joint bilateral upsampling
+uniform sampler2D u_depthTex;
+uniform sampler2D u_normalTex;
+uniform sampler2D u_lowDepthTex;
+uniform sampler2D u_lowNormalTex;
+uniform int u_isUpsampleOn;
 
 
-uniform mat4 u_matP;
 
 uniform int u_occlusion_type; // 1 = SSAO, 2 = SSDO
 	
@@ -22,6 +27,72 @@ in vec3 vert_uv;
 out vec4 frag_color;
 
 
+// relative distance to the tangent plane at which the weight is divided by e
+const float PLANE_TOLERANCE = 0.02;
+// exponent of the normal similarity weight
+const float NORMAL_POWER = 8.0;
+
+
+
+// Upsample the low resolution AO map: bilinear weights of the 4 closest low resolution texels are
+// modulated by their geometric similarity with the full resolution fragment, so that occlusion
+// does not leak across silhouettes. Falls back to the most similar texel if none matches.
+vec4 upsampleAO(vec2 uv)
+{
+	vec3 pos = gBufferPosition(u_depthTex, uv);
+
+	// empty fragment
+	if(pos == vec3(0.0))
+		return texture(u_aoTex, uv);
+
+	vec3 normal = gBufferNormal(u_normalTex, uv);
+
+	ivec2 maxCoord = textureSize(u_aoTex, 0) - 1;
+	vec2 st = uv * vec2(maxCoord + 1) - 0.5;
+	ivec2 base = ivec2(floor(st));
+	vec2 f = fract(st);
+	float planeScale = 1.0 / (PLANE_TOLERANCE * max(abs(pos.z), 1e-4));
+
+	float sum = 0.0;
+	float weightSum = 0.0;
+	float bestWeight = -1.0;
+	float bestAO = 1.0;
+
+	for(int i = 0; i < 4; i++)
+	{
+		ivec2 offset = ivec2(i & 1, i >> 1);
+		ivec2 coord = clamp(base + offset, ivec2(0), maxCoord);
+
+		vec3 samplePos = gBufferPositionFetch(u_lowDepthTex, coord);
+		float sampleAO = texelFetch(u_aoTex, coord, 0).r;
+
+		float geomWeight = 0.0;
+		if(samplePos != vec3(0.0))
+		{
+			vec3 sampleNormal = gBufferNormalFetch(u_lowNormalTex, coord);
+			geomWeight = exp(-abs(dot(samplePos - pos, normal)) * planeScale);
+			geomWeight *= pow(max(dot(sampleNormal, normal), 0.0), NORMAL_POWER);
+		}
+
+		vec2 bilinear = mix(1.0 - f, f, vec2(offset));
+		float weight = bilinear.x * bilinear.y * geomWeight;
+
+		sum += weight * sampleAO;
+		weightSum += weight;
+
+		if(geomWeight > bestWeight)
+		{
+			bestWeight = geomWeight;
+			bestAO = sampleAO;
+		}
+	}
+
+	if(weightSum > 1e-4)
+		return vec4(sum / weightSum);
+	return vec4(bestAO);
+}
+
+
 
 
 // MAIN
@@ -29,7 +100,11 @@ void main()
 {
 	
 	vec3 color = texture(u_colorTex, vert_uv.xy).rgb;
-	vec4 ao = texture(u_aoTex, vert_uv.xy).rgba;
+	vec4 ao;
+	if(u_occlusion_type == 1 && u_isUpsampleOn == 1)
+		ao = upsampleAO(vert_uv.xy);
+	else
+		ao = texture(u_aoTex, vert_uv.xy).rgba;
 
 	if(u_occlusion_type == 1)
 		frag_color = vec4(color.rgb * ao.rgb, 1.0);
@@ -1,36 +1,68 @@
 // Fragment shader
 //#version 330 core
-#version 410
 
 
-//uniform sampler2D u_albedoTex;
-//uniform vec3 u_diffuseColor;
-//uniform int u_useAlbedoTex;
+uniform sampler2D u_albedoTex;
+uniform sampler2D u_normalMap;
+uniform sampler2D u_ormMap;			// packed occlusion (R), roughness (G), metalness (B)
+uniform vec3 u_diffuseColor;
+uniform vec3 u_specularColor;
+uniform int u_useAlbedoTex;
+uniform int u_useNormalMap;
+uniform int u_usePBR;
+uniform int u_useAmbMap;
+uniform int u_useVertexAO;
+uniform float u_specularPower;
 
-// Ouput data
-layout (location = 0) out vec3 gPosition;
-layout (location = 1) out vec3 gNormal;
-layout (location = 2) out vec3 gColor;
+// Ouput data (see the G-buffer encoding in the header, the position is reconstructed from depth)
+layout (location = 0) out vec2 gNormal;		// octahedral normal (RG16)
+layout (location = 1) out vec4 gColor;		// diffuse color (rgb) and roughness (a) (RGBA8)
+layout (location = 2) out vec4 gSpecular;	// base reflectivity F0 (rgb) and ambient occlusion (a) (RGBA8, only attached for deferred shading)
 
 
 in vec3 vert_uv;
-in vec3 pos_view;
 in vec3 vecN_view;
+in vec3 vecT_view;
+in vec3 vecBT_view;
+in float vert_ao;
 
 void main()
 {
+	// material parameters, as in the lighting pass (read by deferred shading)
 	vec3 albedo;
-	/*if(u_useAlbedoTex == 1)
+	vec3 albedoS;
+	if(u_useAlbedoTex == 1)
+	{
 		albedo = texture(u_albedoTex, vert_uv.xy).rgb;
+		albedoS = albedo;
+	}
 	else
-		albedo = u_diffuseColor;*/
-	
-	gColor = albedo;
-	
-	// store the fragment position vector in the first gbuffer texture
-    //gPosition = vec3(pos_view.x, pos_view.y, -pos_view.z);
-	gPosition = pos_view;
-    // also store the per-fragment normals into the gbuffer
-    //gNormal = normalize(vec3(vecN_view.x, vecN_view.y, -vecN_view.z));	
-	gNormal = normalize(vecN_view);
-}
\ No newline at end of file
+	{
+		albedo = u_diffuseColor;
+		albedoS = u_specularColor;
+	}
+
+	vec3 orm = vec3(1.0);
+	if(u_usePBR == 1 || u_useAmbMap == 1)
+		orm = texture(u_ormMap, vert_uv.xy).rgb;
+
+	float metalness = (u_usePBR == 1) ? orm.b : 0.5;
+	float roughness = (u_usePBR == 1) ? orm.g : 1.0 - (u_specularPower / 2048.0);
+
+	// the metallic part of the surface has no diffuse reflection: metalness is not needed anymore
+	gColor.rgb = albedo * (1.0 - metalness);
+	gColor.a = roughness;
+	gSpecular.rgb = mix(vec3(0.04), albedoS, metalness);
+	gSpecular.a = (u_useAmbMap == 1) ? orm.r : 1.0;
+	if(u_useVertexAO == 1)
+		gSpecular.a *= vert_ao;
+
+	// normal, perturbed by the normal map, if any
+	vec3 normal = normalize(vecN_view);
+	if(u_useNormalMap == 1)
+	{
+		vec3 normalTS = normalize(texture(u_normalMap, vert_uv.xy).rgb * 2.0 - 1.0);
+		normal = normalize(mat3(normalize(vecT_view), normalize(vecBT_view), normal) * normalTS);
+	}
+	gNormal = encodeNormal(normal);
+}
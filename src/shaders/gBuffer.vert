@@ -4,39 +4,43 @@
 
 layout(location = 0) in vec4 a_position;
 layout(location = 1) in vec3 a_normal;
+layout(location = 2) in vec3 a_color;
 layout(location = 3) in vec2 a_uv;
+layout(location = 4) in vec3 a_tangent;
+layout(location = 5) in vec3 a_bitangent;
 
 
 uniform mat4 u_matM;
 uniform mat4 u_matV;
 uniform mat4 u_matP;
+uniform mat4 u_matMVP;		// u_matP * u_matV * u_matM, computed on the CPU (same positions as the depth pre-pass)
 
 
+invariant gl_Position;
 out vec3 vert_uv;
 out vec3 vecN_view;
-out vec3 pos_view;
+out vec3 vecT_view;
+out vec3 vecBT_view;
+out float vert_ao;
 
 void main()
 {
 
-	// compute Model-View and Model-View-Projection matrices
-	mat4 matMV = u_matV * u_matM;
-	mat4 matMVP = u_matP * matMV;
-	
 	// Normal in view coords
 	mat3 normalMatrix = transpose(inverse(mat3(u_matM)));
 	//vec4 normal = matMV * vec4(a_normal.xyz, 1.0);
 	//vecN_view = vec3(normal.xyz);
 	vecN_view = normalMatrix * a_normal;
-	
-	// Normal in view coords
-	vec4 pos = /*matMV*/u_matM * a_position;
-	pos_view = vec3(pos.xyz);
+	// Tangent and bitangent (normal mapping)
+	vecT_view = mat3(u_matM) * a_tangent;
+	vecBT_view = mat3(u_matM) * a_bitangent;
 	
 	// vertex UV
 	vert_uv = vec3(a_uv.x, 1.0 - a_uv.y, 0.0);
+	// ambient occlusion baked in the vertex colors (see AOBaker)
+	vert_ao = a_color.r;
 	
 	// project vertices to view space
-	gl_Position = matMVP * a_position;	
+	gl_Position = u_matMVP * a_position;	
 	
 }
@@ -0,0 +1,160 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Compute horizon-based ambient occlusion (GTAO) from a hierarchical depth buffer.
+// For a few screen-space directions (slices), the maximum horizon angle is searched on both
+// sides of the fragment with a few steps. Farther steps read coarser Hi-Z levels, so that taps
+// stay close in texture memory. Visibility is the cosine-weighted integral of the unoccluded
+// arc of each slice, around the projected normal.
+//
+// Based on:
+// 		J. Jimenez et al., "Practical Realtime Strategies for Accurate Indirect Occlusion", 2016.
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_hiZTex;
+uniform sampler2D u_depthTex;
+uniform sampler2D u_normalTex;
+uniform float u_radius;
+uniform int u_numLevels;
+uniform int u_numDirections;	// number of slices (fewer with temporal accumulation)
+uniform int u_frameIndex;		// offsets the noise every frame (temporal accumulation), 0 otherwise
+
+
+// INPUT	
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec4 frag_color;
+
+
+const float PI_HALF = 1.57079633;
+
+// number of steps per side
+const int NUM_STEPS = 4;
+// screen-space radius bounds, in pixels
+const float MIN_RADIUS_PIXELS = 2.0;
+const float MAX_RADIUS_PIXELS = 128.0;
+// Hi-Z level = log2(tap distance in pixels) - MIP_OFFSET
+const float MIP_OFFSET = 3.3;
+
+
+
+// view-space position from linear depth
+vec3 viewPos(vec2 uv, float depth)
+{
+	vec2 ndc = uv * 2.0 - 1.0;
+	return vec3(ndc.x * depth / u_matP[0][0], ndc.y * depth / u_matP[1][1], -depth);
+}
+
+
+// per-pixel noise in [0,1[ (interleaved gradient noise)
+float noise(vec2 pixel)
+{
+	return fract(52.9829189 * fract(dot(pixel, vec2(0.06711056, 0.00583715))));
+}
+
+
+
+// MAIN
+void main()
+{
+	vec3 pos = gBufferPosition(u_depthTex, vert_uv.xy);
+
+	// ignore fragment if position is empty
+	if(pos == vec3(0.0))
+	{
+		frag_color = vec4(1.0);
+		return;
+	}
+
+	vec3 normal = gBufferNormal(u_normalTex, vert_uv.xy);
+	vec3 viewVec = normalize(-pos);
+
+	vec2 size = vec2(textureSize(u_hiZTex, 0));
+	float radiusPixels = u_radius * u_matP[1][1] * 0.5 * size.y / -pos.z;
+	radiusPixels = min(radiusPixels, MAX_RADIUS_PIXELS);
+	if(radiusPixels < MIN_RADIUS_PIXELS)
+	{
+		frag_color = vec4(1.0);
+		return;
+	}
+
+	// distance falloff of the occluders (weight 0 beyond the radius)
+	float falloffRange = 0.6 * u_radius;
+	float falloffMul = -1.0 / falloffRange;
+	float falloffAdd = u_radius / falloffRange;
+
+	// additive recurrence (golden ratio) over the frames: the accumulated slices and steps cover the hemisphere
+	float angleJitter = fract(noise(gl_FragCoord.xy) + 0.618034 * float(u_frameIndex));
+	float stepJitter = fract(noise(gl_FragCoord.xy + vec2(37.0, 17.0)) + 0.754878 * float(u_frameIndex));
+	float visibility = 0.0;
+
+	for(int d = 0; d < u_numDirections; d++)
+	{
+		float phi = (float(d) + angleJitter) * PI / float(u_numDirections);
+		vec2 direction = vec2(cos(phi), sin(phi));
+
+		// slice plane, and normal projected into it
+		vec3 directionVec = vec3(direction, 0.0);
+		vec3 orthoDirectionVec = directionVec - dot(directionVec, viewVec) * viewVec;
+		vec3 axisVec = normalize(cross(orthoDirectionVec, viewVec));
+		vec3 projNormal = normal - axisVec * dot(normal, axisVec);
+		float projNormalLength = length(projNormal);
+		float signNormal = sign(dot(orthoDirectionVec, projNormal));
+		float cosNormal = clamp(dot(projNormal, viewVec) / max(projNormalLength, 1e-4), 0.0, 1.0);
+		float n = signNormal * acos(cosNormal);
+
+		// horizons start at the tangent plane
+		float horizonCos0 = cos(n + PI_HALF);
+		float horizonCos1 = cos(n - PI_HALF);
+		float lowHorizonCos0 = horizonCos0;
+		float lowHorizonCos1 = horizonCos1;
+
+		for(int s = 0; s < NUM_STEPS; s++)
+		{
+			// quadratic step distribution: more taps close to the fragment
+			float t = (float(s) + stepJitter) / float(NUM_STEPS);
+			float offsetPixels = max(t * t * radiusPixels, 1.0);
+			vec2 offset = direction * offsetPixels / size;
+			int level = int(clamp(log2(offsetPixels) - MIP_OFFSET, 0.0, float(u_numLevels - 1)));
+			vec2 levelSize = vec2(textureSize(u_hiZTex, level));
+
+			for(int side = 0; side < 2; side++)
+			{
+				vec2 sampleUV = vert_uv.xy + ((side == 0) ? offset : -offset);
+				ivec2 sampleCoord = clamp(ivec2(sampleUV * levelSize), ivec2(0), ivec2(levelSize) - 1);
+				vec3 samplePos = viewPos(sampleUV, texelFetch(u_hiZTex, sampleCoord, level).r);
+
+				vec3 sampleDelta = samplePos - pos;
+				float sampleDist = length(sampleDelta);
+				float weight = clamp(sampleDist * falloffMul + falloffAdd, 0.0, 1.0);
+				float sampleHorizonCos = dot(sampleDelta / max(sampleDist, 1e-4), viewVec);
+
+				if(side == 0)
+					horizonCos0 = max(horizonCos0, mix(lowHorizonCos0, sampleHorizonCos, weight));
+				else
+					horizonCos1 = max(horizonCos1, mix(lowHorizonCos1, sampleHorizonCos, weight));
+			}
+		}
+
+		// horizon angles, clamped to the hemisphere around the projected normal
+		float h0 = -acos(clamp(horizonCos1, -1.0, 1.0));
+		float h1 = acos(clamp(horizonCos0, -1.0, 1.0));
+		h0 = n + clamp(h0 - n, -PI_HALF, PI_HALF);
+		h1 = n + clamp(h1 - n, -PI_HALF, PI_HALF);
+
+		// cosine-weighted visible arc
+		float arc0 = (cosNormal + 2.0 * h0 * sin(n) - cos(2.0 * h0 - n)) / 4.0;
+		float arc1 = (cosNormal + 2.0 * h1 * sin(n) - cos(2.0 * h1 - n)) / 4.0;
+		visibility += projNormalLength * (arc0 + arc1);
+	}
+
+	visibility = clamp(visibility / float(u_numDirections), 0.0, 1.0);
+
+	frag_color = vec4(visibility);
+}
@@ -5,6 +5,25 @@
 uniform mat4 u_matM;
 uniform samplerCube u_cubemap;
 uniform sampler2D u_shadowMap;
+uniform sampler2DArray u_cascadeMaps;	// cascaded shadow maps, one layer per cascade
+uniform mat4 u_matCascades[4];			// light view-projection matrix of each cascade (model space)
+uniform float u_cascadeSplits[4];		// view depth of the far end of each cascade
+uniform int u_numCascades;				// 0 if cascaded shadow maps are off
+uniform sampler2D u_momentMap;			// filtered (blurred and mipmapped) moments of the shadow map depth
+uniform int u_shadowMethod;				// 0: PCF on the shadow map, 1: VSM, 2: EVSM, 3: MSM on the moment map
+uniform samplerCube u_prefilteredMap;	// IBL: GGX pre-filtered environment, one roughness per mip level
+uniform sampler2D u_brdfLUT;			// IBL: split-sum BRDF scale (R) and bias (G)
+uniform vec3 u_shCoeffs[9];				// IBL: irradiance SH coefficients
+uniform float u_prefilteredMaxLevel;
+uniform mat4 u_matV;
+uniform mat4 u_matP;
+uniform samplerBuffer u_lightData;		// local lights, 3 texels each: (position, range), (color, cos outer), (direction, cos inner)
+uniform usamplerBuffer u_clusters;		// offset and number of lights of each cluster
+uniform usamplerBuffer u_lightIndices;	// lights of all clusters
+uniform int u_numLocalLights;			// 0 if local lights are off
+uniform ivec3 u_clusterGrid;			// number of clusters along x, y and depth
+uniform vec2 u_clusterDepthParams;		// depth slice of a view depth z: log(z) * scale + bias
+uniform mat4 u_matInvVP;				// inverse view-projection matrix of the G-buffer pass (positions from depth)
 
 
 const float PI = 3.14159265359;
@@ -29,6 +48,42 @@ vec3 ambient_refraction(in vec3 _N, in vec3 _V, in float _specularPower, in samp
 }
 
 
+// Diffuse irradiance from 9 SH coefficients (no texture fetch)
+// R. Ramamoorthi and P. Hanrahan, "An Efficient Representation for Irradiance Environment Maps", SIGGRAPH 2001.
+vec3 irradianceSH(in vec3 _N)
+{
+	return max( u_shCoeffs[0] * 0.282095
+			  + u_shCoeffs[1] * 0.488603 * _N.y
+			  + u_shCoeffs[2] * 0.488603 * _N.z
+			  + u_shCoeffs[3] * 0.488603 * _N.x
+			  + u_shCoeffs[4] * 1.092548 * _N.x * _N.y
+			  + u_shCoeffs[5] * 1.092548 * _N.y * _N.z
+			  + u_shCoeffs[6] * 0.315392 * (3.0 * _N.z * _N.z - 1.0)
+			  + u_shCoeffs[7] * 1.092548 * _N.x * _N.z
+			  + u_shCoeffs[8] * 0.546274 * (_N.x * _N.x - _N.y * _N.y), vec3(0.0) );
+}
+
+// Image-based ambient lighting (split-sum approximation): 2 texture fetches
+// B. Karis, "Real Shading in Unreal Engine 4", SIGGRAPH 2013 course.
+vec3 ambient_IBL(in vec3 _N, in vec3 _V, in vec3 _albedo, in vec3 _F0, in float _roughness, in float _metalness)
+{
+	float NdotV = max(dot(_N, _V), 0.0);
+	vec3 R = reflect(-_V, _N);
+
+	// environment is expressed in model space
+	mat3 envMat = transpose( mat3(u_matM) );
+
+	vec3 F = _F0 + (max(vec3(1.0 - _roughness), _F0) - _F0) * pow(1.0 - NdotV, 5.0);
+	vec3 k_d = (vec3(1.0) - F) * (1.0 - _metalness);
+
+	vec3 diffuse = irradianceSH(envMat * _N) * _albedo;
+	vec3 prefiltered = textureLod(u_prefilteredMap, envMat * R, _roughness * u_prefilteredMaxLevel).rgb;
+	vec2 brdf = texture(u_brdfLUT, vec2(NdotV, _roughness)).rg;
+
+	return k_d * diffuse + prefiltered * (F * brdf.x + brdf.y);
+}
+
+
 // Normal distribution function (D)
 float DistributionGGX(vec3 _N, vec3 _H, float _a)
 {
@@ -77,6 +132,17 @@ vec3 fresnelSchlick(float _cosTheta, vec3 _F0)
     return _F0 + (1.0 - _F0) * pow(1.0 - _cosTheta, 5.0);
 }
 
+// Cook-Torrance specular and Lambertian diffuse terms, times the cosine of the light (radiance of a unit light)
+vec3 CookTorranceBRDF(vec3 _N, vec3 _V, vec3 _L, vec3 _albedo, vec3 _F0, float _roughness, float _metalness)
+{
+	float NdotL = max(dot(_N, _L), 0.0);
+	vec3 H = normalize(_L + _V);
+	vec3 F = fresnelSchlick(max(dot(H, _V), 0.0), _F0);
+	vec3 f_spec = DistributionGGX(_N, H, _roughness) * GeometrySmith(_N, _V, _L, _roughness) * F / max(4.0 * max(dot(_N, _V), 0.0) * NdotL, 0.001);
+	vec3 f_diff = (vec3(1.0) - F) * (1.0 - _metalness) * _albedo / PI;
+	return (f_diff + f_spec) * NdotL;
+}
+
 float ShadowCalculation(vec4 pos_ls, vec3 normal, vec3 lightDir)
 {
     // perform perspective divide
@@ -122,6 +188,185 @@ float minBias = 0.0001;
 
 }  
 
+// EVSM exponents (positive, negative), as in shadowMoments.frag
+const vec2 EVSM_EXPONENTS = vec2(40.0, 5.0);
+// fraction of the lit probability cut off to reduce light bleeding (VSM, EVSM)
+const float LIGHT_BLEEDING_REDUCTION = 0.2;
+// weight of the moments of a uniform depth distribution blended with the filtered moments (MSM)
+const float MSM_MOMENT_BIAS = 3e-5;
+
+// Chebyshev upper bound of the probability that the depth is lit, from the first two moments
+float ChebyshevUpperBound(vec2 moments, float depth, float minVariance)
+{
+	if(depth <= moments.x)
+		return 1.0;
+
+	float variance = max(moments.y - moments.x * moments.x, minVariance);
+	float d = depth - moments.x;
+	float pMax = variance / (variance + d * d);
+
+	// the tail of the bound is cut off: light bleeding between overlapping occluders disappears
+	return clamp((pMax - LIGHT_BLEEDING_REDUCTION) / (1.0 - LIGHT_BLEEDING_REDUCTION), 0.0, 1.0);
+}
+
+// Shadow intensity from four moments: sharpest lower bound of the occluded fraction (Hamburger 4MSM)
+float HamburgerShadowIntensity(vec4 moments, float depth)
+{
+	vec4 b = mix(moments, vec4(0.5), MSM_MOMENT_BIAS);
+
+	// Cholesky factorization of the Hankel matrix of the moments
+	float L32D22 = -b.x * b.y + b.z;
+	float D22 = -b.x * b.x + b.y;
+	float squaredDepthVariance = -b.y * b.y + b.w;
+	float D33D22 = dot(vec2(squaredDepthVariance, -L32D22), vec2(D22, L32D22));
+	float InvD22 = 1.0 / D22;
+	float L32 = L32D22 * InvD22;
+
+	// solve B c = (1, z, z^2)
+	vec3 c = vec3(1.0, depth, depth * depth);
+	c.y -= b.x;
+	c.z -= b.y + L32 * c.y;
+	c.y *= InvD22;
+	c.z *= D22 / D33D22;
+	c.y -= L32 * c.z;
+	c.x -= dot(c.yz, b.xy);
+
+	// roots of c.x + c.y z + c.z z^2: support of the distribution, with the fragment depth
+	float p = c.y / c.z;
+	float q = c.x / c.z;
+	float r = sqrt(max(p * p * 0.25 - q, 0.0));
+	float z1 = -p * 0.5 - r;
+	float z2 = -p * 0.5 + r;
+
+	vec4 switchVal = (z2 < depth) ? vec4(z1, depth, 1.0, 1.0) :
+	                 ((z1 < depth) ? vec4(depth, z1, 0.0, 1.0) : vec4(0.0));
+	float quotient = (switchVal.x * z2 - b.x * (switchVal.x + z2) + b.y) / ((z2 - switchVal.y) * (depth - z1));
+
+	return clamp(switchVal.z + switchVal.w * quotient, 0.0, 1.0);
+}
+
+// Shadow factor from the filtered moment map: one trilinear fetch, whatever the filter width
+float MomentShadowCalculation(vec4 pos_ls, vec3 normal, vec3 lightDir)
+{
+	vec3 projCoords = pos_ls.xyz / pos_ls.w * 0.5 + 0.5;
+	float depth = min(projCoords.z, 1.0);
+	vec4 moments = texture(u_momentMap, projCoords.xy);
+
+	// small slope-scaled bias: filtering already removes most of the acne
+	float bias = max(0.001 * (1.0 - dot(normal, lightDir)), 0.0001);
+
+	if(u_shadowMethod == 2)
+	{
+		float warped = 2.0 * (depth - bias) - 1.0;
+		float pos = exp(EVSM_EXPONENTS.x * warped);
+		float neg = -exp(-EVSM_EXPONENTS.y * warped);
+		// minimum variance scaled by the derivative of the warp
+		vec2 minVariance = 1e-5 * EVSM_EXPONENTS * vec2(pos, -neg);
+		float lit = min(ChebyshevUpperBound(moments.xy, pos, minVariance.x * minVariance.x),
+		                ChebyshevUpperBound(moments.zw, neg, minVariance.y * minVariance.y));
+		return 1.0 - lit;
+	}
+	if(u_shadowMethod == 3)
+		return HamburgerShadowIntensity(moments, depth - bias);
+
+	return 1.0 - ChebyshevUpperBound(moments.xy, depth - bias, 1e-6);
+}
+
+// fraction of the range of a cascade over which it is blended with the next one
+const float CASCADE_BLEND = 0.1;
+
+float CascadeShadow(int cascade, vec3 pos_model, vec3 normal, vec3 lightDir)
+{
+	vec4 pos_ls = u_matCascades[cascade] * vec4(pos_model, 1.0);
+	vec3 projCoords = pos_ls.xyz / pos_ls.w * 0.5 + 0.5;
+
+	// cascades only cover the shadow casters: no shadow outside
+	if(any(lessThan(projCoords.xy, vec2(0.0))) || any(greaterThan(projCoords.xy, vec2(1.0))))
+		return 0.0;
+
+	// the depth range only covers the casters: receivers behind them are clamped to the far plane
+	float currentDepth = min(projCoords.z, 1.0);
+
+	float maxBias = 0.005;
+	float minBias = 0.0001;
+	float bias = max(maxBias * (1.0 - dot(normal, lightDir)), minBias);
+
+	// percentage-closer filtering
+	float shadow = 0.0;
+	vec2 texelSize = 1.0 / vec2(textureSize(u_cascadeMaps, 0).xy);
+	for(int x = -1; x <= 1; ++x)
+	{
+		for(int y = -1; y <= 1; ++y)
+		{
+			float pcfDepth = texture(u_cascadeMaps, vec3(projCoords.xy + vec2(x, y) * texelSize, float(cascade))).r;
+			shadow += currentDepth - bias > pcfDepth ? 1.0 : 0.0;
+		}
+	}
+	return shadow / 9.0;
+}
+
+// Cascaded shadow maps: the cascade is selected by the view depth of the fragment,
+// and blended with the next one at the end of its range (no visible seam between cascades)
+float CascadeShadowCalculation(vec3 pos_model, float viewDepth, vec3 normal, vec3 lightDir)
+{
+	int cascade = 0;
+	while(cascade < u_numCascades && viewDepth > u_cascadeSplits[cascade])
+		cascade++;
+	if(cascade == u_numCascades)
+		return 0.0;
+
+	float shadow = CascadeShadow(cascade, pos_model, normal, lightDir);
+
+	float start = (cascade > 0) ? u_cascadeSplits[cascade - 1] : 0.0;
+	float blendStart = u_cascadeSplits[cascade] - CASCADE_BLEND * (u_cascadeSplits[cascade] - start);
+	if(viewDepth > blendStart && cascade + 1 < u_numCascades)
+	{
+		float t = (viewDepth - blendStart) / (u_cascadeSplits[cascade] - blendStart);
+		shadow = mix(shadow, CascadeShadow(cascade + 1, pos_model, normal, lightDir), t);
+	}
+
+	return shadow;
+}
+
+// outgoing radiance due to the local lights of the cluster of a point (world space, no shadows)
+// Based on: O. Olsson, M. Billeter, U. Assarsson, "Clustered Deferred and Forward Shading", HPG 2012.
+vec3 LocalLightsRadiance(vec3 pos_world, float viewDepth, vec3 N, vec3 V, vec3 albedo, vec3 F0, float roughness, float metalness)
+{
+	// cluster: screen tile, and exponential depth slice
+	vec4 pos_clip = u_matP * u_matV * vec4(pos_world, 1.0);
+	vec2 tile = (pos_clip.xy / pos_clip.w * 0.5 + 0.5) * vec2(u_clusterGrid.xy);
+	float slice = log(max(viewDepth, 1e-6)) * u_clusterDepthParams.x + u_clusterDepthParams.y;
+	ivec3 cell = clamp(ivec3(floor(vec3(tile, slice))), ivec3(0), u_clusterGrid - 1);
+	uvec2 lights = texelFetch(u_clusters, cell.x + u_clusterGrid.x * (cell.y + u_clusterGrid.y * cell.z)).rg;
+
+	vec3 Lo = vec3(0.0);
+	for(uint i = 0u; i < lights.y; i++)
+	{
+		int light = 3 * int(texelFetch(u_lightIndices, int(lights.x + i)).r);
+		vec4 posRange = texelFetch(u_lightData, light);
+		vec4 colorCos = texelFetch(u_lightData, light + 1);
+		vec4 dirCos = texelFetch(u_lightData, light + 2);
+
+		// lights are placed in the scene (model space), as the main light
+		vec3 L = vec3(u_matM * vec4(posRange.xyz, 1.0)) - pos_world;
+		float dist = length(L);
+		if(dist >= posRange.w)
+			continue;
+		L /= dist;
+
+		// inverse square falloff, windowed to reach 0 at the range of the light
+		float ratio = dist / posRange.w;
+		float window = clamp(1.0 - ratio * ratio * ratio * ratio, 0.0, 1.0);
+		float attenuation = window * window / (1.0 + 16.0 * ratio * ratio);
+		// spot cone
+		if(colorCos.w > -1.0)
+			attenuation *= smoothstep(colorCos.w, dirCos.w, dot(-L, normalize(mat3(u_matM) * dirCos.xyz)));
+
+		Lo += CookTorranceBRDF(N, V, L, albedo, F0, roughness, metalness) * colorCos.rgb * attenuation;
+	}
+	return Lo;
+}
+
 vec3 linear_to_gamma(in vec3 _color)
 {
     return pow(_color, vec3(1.0f / 2.2f));
@@ -199,4 +444,62 @@ vec3 myMax(vec3 a, vec3 b)
     a = clamp(a, 0, 1);
     b = clamp(b, 0, 1);
     return vec3(max(a.x, b.x), max(a.y, b.y), max(a.z, b.z));
-}
\ No newline at end of file
+}
+
+
+
+// G-BUFFER ENCODING ------------------------------------------------------------------------------
+// The G-buffer stores no position: it is reconstructed from the depth buffer with the inverse
+// view-projection matrix. Normals are mapped on an octahedron, unfolded to 2 components in [0,1]:
+//		Z. H. Cigolle et al., "A Survey of Efficient Representations for Independent Unit Vectors", JCGT 2014.
+
+vec2 octahedronWrap(vec2 _v)
+{
+	return (1.0 - abs(_v.yx)) * vec2(_v.x >= 0.0 ? 1.0 : -1.0, _v.y >= 0.0 ? 1.0 : -1.0);
+}
+
+vec2 encodeNormal(vec3 _N)
+{
+	_N /= abs(_N.x) + abs(_N.y) + abs(_N.z);
+	vec2 e = (_N.z >= 0.0) ? _N.xy : octahedronWrap(_N.xy);
+	return e * 0.5 + 0.5;
+}
+
+vec3 decodeNormal(vec2 _e)
+{
+	_e = _e * 2.0 - 1.0;
+	vec3 N = vec3(_e, 1.0 - abs(_e.x) - abs(_e.y));
+	if(N.z < 0.0)
+		N.xy = octahedronWrap(N.xy);
+	return normalize(N);
+}
+
+// Position of a G-buffer texel (same space as the G-buffer pass output), null vector if empty
+vec3 gBufferPositionFetch(sampler2D _depthTex, ivec2 _coord)
+{
+	float depth = texelFetch(_depthTex, _coord, 0).r;
+	// nothing was rendered: depth is still cleared to the far plane
+	if(depth >= 1.0)
+		return vec3(0.0);
+
+	vec2 uv = (vec2(_coord) + 0.5) / vec2(textureSize(_depthTex, 0));
+	vec4 pos = u_matInvVP * vec4(vec3(uv, depth) * 2.0 - 1.0, 1.0);
+	return pos.xyz / pos.w;
+}
+
+// Same, at the texel containing a texture coordinate (clamped to the edges of the screen)
+vec3 gBufferPosition(sampler2D _depthTex, vec2 _uv)
+{
+	ivec2 size = textureSize(_depthTex, 0);
+	return gBufferPositionFetch(_depthTex, clamp(ivec2(floor(_uv * vec2(size))), ivec2(0), size - 1));
+}
+
+vec3 gBufferNormalFetch(sampler2D _normalTex, ivec2 _coord)
+{
+	return decodeNormal(texelFetch(_normalTex, _coord, 0).rg);
+}
+
+vec3 gBufferNormal(sampler2D _normalTex, vec2 _uv)
+{
+	return decodeNormal(texture(_normalTex, _uv).rg);
+}
@@ -0,0 +1,55 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Build one level of the hierarchical depth buffer (Hi-Z).
+// Level 0 stores the linear depth (distance along -z in view space) of the positions decoded from
+// the G-buffer depth. Next levels keep the minimum (i.e. closest) depth of the texels they cover in the
+// previous level, which is the only level that can be sampled (base level) while rendering.
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_srcTex;
+uniform int u_isFirstLevel;
+
+
+// OUTPUT
+out vec4 frag_depth;
+
+
+// depth of empty fragments (farther than any geometry)
+const float FAR_DEPTH = 1.0e4;
+
+
+
+// MAIN
+void main()
+{
+	ivec2 coord = ivec2(gl_FragCoord.xy);
+
+	if(u_isFirstLevel == 1)
+	{
+		vec3 pos = gBufferPositionFetch(u_srcTex, coord);
+		frag_depth = vec4( (pos == vec3(0.0)) ? FAR_DEPTH : -pos.z );
+		return;
+	}
+
+	ivec2 srcSize = textureSize(u_srcTex, 0);
+	ivec2 dstSize = max(srcSize / 2, ivec2(1));
+
+	// the last texel of a level also covers the extra texel of odd-sized previous level
+	ivec2 extent = ivec2(2);
+	if(coord.x == dstSize.x - 1 && (srcSize.x & 1) == 1)
+		extent.x = 3;
+	if(coord.y == dstSize.y - 1 && (srcSize.y & 1) == 1)
+		extent.y = 3;
+
+	float depth = FAR_DEPTH;
+	for(int y = 0; y < extent.y; y++)
+		for(int x = 0; x < extent.x; x++)
+			depth = min(depth, texelFetch(u_srcTex, min(2 * coord + ivec2(x, y), srcSize - 1), 0).r);
+
+	frag_depth = vec4(depth);
+}
@@ -19,6 +19,9 @@
 // - Compute shadow mapping, based on the following tutorials:
 //		https://learnopengl.com/Advanced-Lighting/Shadows/Shadow-Mapping
 //		http://www.opengl-tutorial.org/intermediate-tutorials/tutorial-16-shadow-mapping/
+//
+// - Add local point and spot lights, culled per cluster of the view frustum (see LightClusters):
+//		O. Olsson, M. Billeter, U. Assarsson, "Clustered Deferred and Forward Shading", HPG 2012.
 // ------------------------------------------------------------------------------------------------
 
 
@@ -32,9 +35,7 @@ uniform float u_specularPower;
 
 uniform sampler2D u_albedoTex;
 uniform sampler2D u_normalMap;
-uniform sampler2D u_metalMap;
-uniform sampler2D u_glossMap;
-uniform sampler2D u_ambientMap;
+uniform sampler2D u_ormMap;		// packed occlusion (R), roughness (G), metalness (B)
 
 
 uniform int u_useAmbient;
@@ -44,6 +45,7 @@ uniform int u_useAlbedoTex;
 uniform int u_useNormalMap;
 uniform int u_usePBR;
 uniform int u_useAmbMap;
+uniform int u_useVertexAO;
 uniform int u_useEnvMapReflec;
 uniform int u_useEnvMapRefrac;
 uniform int u_useShadowMap;
@@ -53,6 +55,7 @@ uniform vec3 u_camPos;
 uniform int u_isLightDir;
 uniform float u_distLightMax;
 uniform int u_useSimTransmit;
+uniform int u_useIBL;
 	
 // INPUT
 
@@ -65,6 +68,9 @@ in vec3 vert_uv;
 in vec3 pos_world;
 
 in vec4 pos_ls;
+in vec3 pos_model;
+in float view_depth;
+in float vert_ao;
 
 
 // OUTPUT
@@ -150,11 +156,22 @@ void main()
 		albedoS += ambient_reflection(l_vecN, l_vecV, u_specularPower, u_cubemap, 7);			
 	}
 	
+	// occlusion, roughness and metalness are read with a single fetch
+	vec3 orm = vec3(1.0);
+	if(u_usePBR == 1 || u_useAmbMap == 1)
+	{
+		orm = texture(u_ormMap, vert_uv.xy).rgb;
+	}
+
 	// ambient occlusion
 	float ambOcc = 1.0;
 	if(u_useAmbMap == 1)
 	{
-		ambOcc = texture(u_ambientMap, vert_uv.xy).r;
+		ambOcc = orm.r;
+	}
+	if(u_useVertexAO == 1)
+	{
+		ambOcc *= vert_ao;
 	}
 	
 
@@ -165,11 +182,11 @@ void main()
 	float glossiness;
 	if(u_usePBR == 1)
 	{
-		// Get metallic factor from metallicness texture
-		metalness = texture(u_metalMap, vert_uv.xy).r;
+		// Get metallic factor from metallicness channel
+		metalness = orm.b;
 		
-		// Get gloss factor from glossiness texture
-		roughness = texture(u_glossMap, vert_uv.xy).r;
+		// Get gloss factor from roughness channel
+		roughness = orm.g;
 		glossiness = 1.0f - roughness;
 	}
 	else
@@ -288,21 +305,43 @@ void main()
 	float shadow = 0.0;
 	if(u_useShadowMap == 1)
 	{
-		// get shadow factor		
-		shadow = ShadowCalculation(pos_ls, l_vecN, l_vecL); 
+		// get shadow factor (from the cascades, or the filtered moments, if any)
+		if(u_numCascades > 0)
+			shadow = CascadeShadowCalculation(pos_model, view_depth, l_vecN, l_vecL);
+		else if(u_shadowMethod > 0)
+			shadow = MomentShadowCalculation(pos_ls, l_vecN, l_vecL);
+		else
+			shadow = ShadowCalculation(pos_ls, l_vecN, l_vecL); 
 	}
 
 	// 2.4- Compute ambient --------------------------------------------
 	
+	// image-based lighting and local lights are computed in world space
+	vec3 N_world = vecN_world;
+	if(u_useNormalMap == 1)
+		N_world = mat3(vecT_world, vecBT_world, vecN_world) * l_vecN;
+	N_world = normalize(N_world);
+
 	// ambient lighting
 	vec3 ambient = vec3(0.03) * albedoD;
+	if(u_useIBL == 1)
+	{
+		ambient = ambient_IBL(N_world, normalize(vecV_world), albedoD, F0, roughness, metalness);
+	}
+
+	// local lights (not shadowed)
+	vec3 Lo_local = vec3(0.0);
+	if(u_numLocalLights > 0)
+	{
+		Lo_local = LocalLightsRadiance(pos_world, view_depth, N_world, normalize(vecV_world), albedoD, F0, roughness, metalness);
+	}
 
 	// add ambient lighting to color and apply shadow mapping
-	color.rgb = ambient + Lo * (1.5 - shadow); // points in shadow still have a 0.5 illumination factor (not complete ambient)
+	color.rgb = ambient + Lo * (1.5 - shadow) + Lo_local; // points in shadow still have a 0.5 illumination factor (not complete ambient)
 
-	if(u_useAmbMap == 1) 
+	if(u_useAmbMap == 1 || u_useVertexAO == 1) 
 	{
-		// multiply by ambient occlusion txexture, if any
+		// multiply by ambient occlusion txexture and/or baked vertex occlusion, if any
 		color.rgb = ambOcc * color.rgb;
 	}
 
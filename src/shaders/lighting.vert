@@ -15,12 +15,14 @@
 uniform mat4 u_matM;
 uniform mat4 u_matV;
 uniform mat4 u_matP;
+uniform mat4 u_matMVP;		// u_matP * u_matV * u_matM, computed on the CPU (same positions as the depth pre-pass)
 uniform mat4 u_matPV_light; //projection-view matrix of the light camera
 uniform vec3 u_camPos;
 uniform int u_useTSD;
 
 
 // OUTPUT
+invariant gl_Position;
 out vec3 vecN_world;
 out vec3 vecV_world;
 out vec3 vecT_world;
@@ -30,15 +32,17 @@ out vec3 vert_uv;
 out vec3 pos_world;
 
 out vec4 pos_ls;
+out vec3 pos_model;
+out float view_depth;
+out float vert_ao;
 
 
 
 
 void main()
 {
-	// compute Model-View and Model-View-Projection matrices
+	// compute Model-View matrix
 	mat4 matMV = u_matV * u_matM;
-	mat4 matMVP = u_matP * matMV;
 	
 	// vertex position in world space
 	pos_world = vec3(u_matM * a_position);
@@ -55,12 +59,17 @@ vecN_world =  normalize( mat3(transpose(inverse(u_matM))) * a_normal );
 	
 	//	Fragment position in light view space
 	pos_ls = u_matPV_light * vec4(vec3(a_position.xyz), 1.0);
+	// position in the space of the shadow pass, and distance to the camera (cascaded shadow maps)
+	pos_model = a_position.xyz;
+	view_depth = -(matMV * a_position).z;
 
 	// vertex UV
 	vert_uv = vec3(a_uv.x, 1.0 - a_uv.y, 0.0);
+	// ambient occlusion baked in the vertex colors (see AOBaker)
+	vert_ao = a_color.r;
 
 
-	gl_Position = matMVP * a_position;
+	gl_Position = u_matMVP * a_position;
 	
 	// if texture space diffusion activated
 	if(u_useTSD == 1)
@@ -12,20 +12,17 @@ layout(location = 3) in vec2 a_uv;
 uniform mat4 u_matM;
 uniform mat4 u_matV;
 uniform mat4 u_matP;
+uniform mat4 u_matMVP;		// u_matP * u_matV * u_matM, computed on the CPU (same positions as the depth pre-pass)
 
 
 // OUTPUT
+invariant gl_Position;
 out vec3 vert_uv;
 
 
 void main()
 {
-	// compute Model-View and Model-View-Projection matrices
-	mat4 matMV = u_matV * u_matM;
-	mat4 matMVP = u_matP * matMV;
-	
-
-	gl_Position = matMVP * a_position;
+	gl_Position = u_matMVP * a_position;
 	
 	vert_uv = vec3(a_uv.x, a_uv.y, 0.0);
 }
@@ -5,9 +5,9 @@
 // ------------------------------------------------------------------------------------------------
 // - Render texture to a mesh, with no lighting.
 // - Apply Gaussian blur on the texture (horizontal or vertical), if activated.
-// This shader is used to blur TSD texture or SSAO map.
+// This shader is used to blur TSD texture or SSLR map (fallback of blur.comp on GL < 4.3).
 //
-// A texture mask can be defined by alpha values (1=inside / 0=outside).
+// A texture mask can be defined by alpha values (1=inside / 0=outside), if isMasked is on.
 // It is used to avoid black texels bleeding during TSD.
 // (the texture to blur in TSD is a UV map: we don't want to include texels outside the UV map in 
 // the blurring, as it would cause color bleeding along the edges of the UV map).
@@ -23,6 +23,7 @@ uniform sampler2D u_screenTex;
 uniform int isBlurOn;
 uniform int isFilterH;
 uniform int filterSize;
+uniform int isMasked = 1;
 
 	
 // INPUT	
@@ -44,6 +45,14 @@ vec3 coefficientSum = vec3(0);
 vec4 texLookup(vec2 uvCoords, float coeff)
 {
     vec4 lookup = texture(u_screenTex, uvCoords);
+
+    // no mask: every texel contributes, with its own alpha
+    if (isMasked == 0)
+    {
+        coefficientSum += coeff;
+        return lookup * coeff;
+    }
+
     float maskLookup = lookup.a;
     vec3 color = lookup.xyz; 
 
@@ -75,15 +84,16 @@ void main()
 		float weight = 1.0;
 		vec4 lookup, avgValue;
 
-		float mapResolution = 2048.0;
+		// texture size: texture space (TSD) or screen-space textures (sized to the viewport)
+		vec2 mapResolution = vec2(textureSize(u_screenTex, 0));
 		vec2 direction;
 		
 		// Guassian blur is decomposed into horizontal and vertical weighted sums
 		// Horizontal blur if isFilterH is on, Vertical blur if not
 		if(isFilterH == 1)
-			direction = vec2(1.0f / mapResolution, 0);
+			direction = vec2(1.0f / mapResolution.x, 0);
 		else
-			direction = vec2(0, 1.0f/ mapResolution);
+			direction = vec2(0, 1.0f/ mapResolution.y);
 				
 		
 		lookup = texLookup(vert_uv.xy, weight);
@@ -98,7 +108,11 @@ void main()
 			avgValue += texLookup(vert_uv.xy - i * direction, weight);
 		}
 
-		if(avgValue.a != 0)
+		if(isMasked == 0)
+		{
+			frag_color = avgValue / coefficientSum.x;
+		}
+		else if(avgValue.a != 0)
 		{
 			vec3 diffuseColor = avgValue.xyz / coefficientSum;
 			frag_color = vec4(diffuseColor, lookup.a );
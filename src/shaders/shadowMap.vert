@@ -7,6 +7,9 @@ layout(location = 0) in vec4 a_position;
 
 uniform mat4 u_lvp;
 
+// same clip space positions as the shading passes, when used as a depth pre-pass
+invariant gl_Position;
+
 void main()
 {
 
@@ -0,0 +1,54 @@
+// Fragment shader
+//#version 330 core
+#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Moments of the light space depth, for filterable shadow maps.
+// Unlike depths, moments can be blurred and mipmapped: the lighting shader reconstructs the
+// fraction of occluders in the filtered area from a single (trilinear) fetch.
+//
+// Methods (u_shadowMethod):
+//  1: variance shadow maps (VSM), moments (z, z^2)
+//		W. Donnelly, A. Lauritzen, "Variance Shadow Maps", I3D 2006.
+//  2: exponential variance shadow maps (EVSM), moments of exp(c+ z) and -exp(-c- z)
+//		A. Lauritzen, M. McCool, "Layered Variance Shadow Maps", GI 2008.
+//  3: moment shadow maps (MSM), moments (z, z^2, z^3, z^4)
+//		C. Peters, R. Klein, "Moment Shadow Mapping", I3D 2015.
+// The exponents and the depth mapping must match MomentShadowCalculation() (header.frag).
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform int u_shadowMethod;
+
+// Ouput data
+layout(location = 0) out vec4 frag_moments;
+
+// EVSM exponents (positive, negative), small enough for 32-bit float moments
+const vec2 EVSM_EXPONENTS = vec2(40.0, 5.0);
+
+
+
+void main()
+{
+	float depth = gl_FragCoord.z;
+
+	if(u_shadowMethod == 2)
+	{
+		// exponential warp of the depth mapped to [-1,1]
+		float warped = 2.0 * depth - 1.0;
+		float pos = exp(EVSM_EXPONENTS.x * warped);
+		float neg = -exp(-EVSM_EXPONENTS.y * warped);
+		frag_moments = vec4(pos, pos * pos, neg, neg * neg);
+	}
+	else if(u_shadowMethod == 3)
+	{
+		float depth2 = depth * depth;
+		frag_moments = vec4(depth, depth2, depth2 * depth, depth2 * depth2);
+	}
+	else
+	{
+		frag_moments = vec4(depth, depth * depth, 0.0, 0.0);
+	}
+}
@@ -1,9 +1,9 @@
 // Fragment shader
-#version 330
+//#version 330
 
 
 // ------------------------------------------------------------------------------------------------
-// - Render a geomtery defined by G-buffers (Position and normal textures)
+// - Render a geomtery defined by G-buffers (depth and normal textures)
 // - Compute Screen-Space Ambient Occlusion (SSAO)
 // This shader is used to generate SSAO map.
 //
@@ -14,13 +14,15 @@
 
 // UNIFORMS
 uniform sampler2D u_noiseTex;
-uniform sampler2D u_posTex;
+uniform sampler2D u_depthTex;
 uniform sampler2D u_normalTex;
 uniform vec3 u_samples[64];
-uniform mat4 u_matP;
 uniform float u_radius;
 uniform float u_screenWidth;
 uniform float u_screenHeight;
+uniform int u_kernelSize;		// number of samples (subset of u_samples, fewer with temporal accumulation)
+uniform int u_kernelOffset;		// first sample of the subset (changes every frame with temporal accumulation)
+uniform float u_noiseAngle;		// rotation of the noise pattern around the normal (changes every frame)
 
 	
 // INPUT	
@@ -38,7 +40,6 @@ vec3 coefficientSum = vec3(0);
 //const vec2 noiseScale = vec2(1024.0/4.0, 720.0/4.0); // screen = 1024 x 720
 
 //uniform AOparams params;
-int kernelSize = 40;
 float radius = 0.05;
 float bias = 0.1;
 
@@ -53,13 +54,13 @@ void main()
 	radius = 1.0;
 	float occlusion = 0.0;
 	
-	// read fragment 3D pos from G-buffer position texture
-	vec3 fragPos = texture(u_posTex, vert_uv.xy).xyz;
+	// read fragment 3D pos from G-buffer depth
+	vec3 fragPos = gBufferPosition(u_depthTex, vert_uv.xy);
 	// read fragment 3D normal from G-buffer normal texture
-	vec3 normal = texture(u_normalTex, vert_uv.xy).rgb;
+	vec3 normal = gBufferNormal(u_normalTex, vert_uv.xy);
 	
-	// ignore fragment if normal or position is empty
-	if (normal == vec3(0.0f) || fragPos == vec3(0.0f) ) 
+	// ignore fragment if position is empty
+	if (fragPos == vec3(0.0f)) 
 	{
 		occlusion = 1.0;
 	}
@@ -70,14 +71,15 @@ void main()
 
 		// build TBN matrix
 		vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+		tangent = cos(u_noiseAngle) * tangent + sin(u_noiseAngle) * cross(normal, tangent);
 		vec3 bitangent = cross(normal, tangent);
 		mat3 TBN = mat3(tangent, bitangent, normal); 
 
 
-		for(int i = 0; i < kernelSize; ++i)
+		for(int i = 0; i < u_kernelSize; ++i)
 		{
 			// get sample position
-			vec3 samplePos = TBN * u_samples[i]; // from tangent to view-space
+			vec3 samplePos = TBN * u_samples[(u_kernelOffset + i) % 64]; // from tangent to view-space
 			samplePos = fragPos + samplePos * radius; 
 			
 			vec4 offset = vec4(samplePos, 1.0);
@@ -85,14 +87,14 @@ void main()
 			offset.xyz /= offset.w;               	// perspective divide
 			offset.xyz  = offset.xyz * 0.5 + 0.5; 	// transform to range 0.0 - 1.0  
 			
-			float sampleDepth = texture(u_posTex, offset.xy).z;
+			float sampleDepth = gBufferPosition(u_depthTex, offset.xy).z;
 			
 			float rangeCheck = smoothstep(0.0, 1.0, radius / abs(fragPos.z - sampleDepth));
 			occlusion += (sampleDepth >= samplePos.z + bias ? 1.0 : 0.0) * rangeCheck;  
 			
 		}  
 
-		occlusion = 1.0 - (occlusion / kernelSize);
+		occlusion = 1.0 - (occlusion / float(u_kernelSize));
 		occlusion = pow(occlusion, 0.5);
 
 	}
@@ -0,0 +1,79 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Bilateral blur of the SSAO map (horizontal or vertical).
+// Neighbors are weighted by a Gaussian, and by their distance to the tangent plane and normal
+// difference with the center fragment: occlusion does not bleed across silhouettes or creases.
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_aoTex;
+uniform sampler2D u_depthTex;
+uniform sampler2D u_normalTex;
+uniform int isFilterH;
+uniform int filterSize;
+
+	
+// INPUT	
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec4 frag_color;
+
+
+// relative distance to the tangent plane at which the weight is divided by e
+const float PLANE_TOLERANCE = 0.02;
+// exponent of the normal similarity weight
+const float NORMAL_POWER = 8.0;
+
+
+
+// MAIN
+void main()
+{
+	ivec2 maxCoord = textureSize(u_aoTex, 0) - 1;
+	ivec2 coord = clamp(ivec2(vert_uv.xy * vec2(maxCoord + 1)), ivec2(0), maxCoord);
+
+	float ao = texelFetch(u_aoTex, coord, 0).r;
+	vec3 pos = gBufferPositionFetch(u_depthTex, coord);
+
+	// empty fragment: nothing to blur
+	if(pos == vec3(0.0))
+	{
+		frag_color = vec4(ao);
+		return;
+	}
+
+	vec3 normal = gBufferNormalFetch(u_normalTex, coord);
+	ivec2 direction = (isFilterH == 1) ? ivec2(1, 0) : ivec2(0, 1);
+	float sigma = float(filterSize) / 1.96;
+	float planeScale = 1.0 / (PLANE_TOLERANCE * max(abs(pos.z), 1e-4));
+
+	float sum = ao;
+	float weightSum = 1.0;
+
+	for(int i = -filterSize; i <= filterSize; i++)
+	{
+		if(i == 0)
+			continue;
+
+		ivec2 sampleCoord = clamp(coord + i * direction, ivec2(0), maxCoord);
+		vec3 samplePos = gBufferPositionFetch(u_depthTex, sampleCoord);
+		if(samplePos == vec3(0.0))
+			continue;
+		vec3 sampleNormal = gBufferNormalFetch(u_normalTex, sampleCoord);
+
+		float weight = exp(-0.5 * float(i * i) / (sigma * sigma));
+		weight *= exp(-abs(dot(samplePos - pos, normal)) * planeScale);
+		weight *= pow(max(dot(sampleNormal, normal), 0.0), NORMAL_POWER);
+
+		sum += weight * texelFetch(u_aoTex, sampleCoord, 0).r;
+		weightSum += weight;
+	}
+
+	frag_color = vec4(sum / weightSum);
+}
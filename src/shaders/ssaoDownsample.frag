@@ -0,0 +1,57 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Downsample G-buffer depth and normal textures for reduced resolution SSAO.
+// Each low resolution texel keeps the closest (non-empty) fragment of its footprint, so position
+// and normal stay consistent (no averaging across silhouettes). The depth is written to the depth
+// buffer of the low resolution target, which is decoded as the full resolution G-buffer.
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_depthTex;
+uniform sampler2D u_normalTex;
+uniform int u_factor;
+
+	
+// INPUT	
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec2 frag_normal;
+
+
+
+// MAIN
+void main()
+{
+	ivec2 maxCoord = textureSize(u_depthTex, 0) - 1;
+	// full resolution block (u_factor x u_factor texels) covered by this low resolution texel
+	ivec2 base = ivec2(gl_FragCoord.xy) * u_factor;
+
+	float bestDepth = 1.0;
+	vec2 bestNormal = vec2(0.0);
+
+	for(int y = 0; y < u_factor; y++)
+	{
+		for(int x = 0; x < u_factor; x++)
+		{
+			ivec2 coord = clamp(base + ivec2(x, y), ivec2(0), maxCoord);
+			float depth = texelFetch(u_depthTex, coord, 0).r;
+
+			// closest fragment (empty fragments are on the far plane)
+			if(depth < bestDepth)
+			{
+				bestDepth = depth;
+				bestNormal = texelFetch(u_normalTex, coord, 0).rg;
+			}
+		}
+	}
+
+	// the G-buffer depth is copied as is (same projection): positions are decoded the same way
+	gl_FragDepth = bestDepth;
+	frag_normal = bestNormal;
+}
@@ -1,5 +1,5 @@
 // Fragment shader
-#version 330
+//#version 330
 
 
 // ------------------------------------------------------------------------------------------------
@@ -19,15 +19,16 @@
 // UNIFORMS
 uniform sampler2D u_screenTex;
 uniform sampler2D u_noiseTex;
-uniform sampler2D u_posTex;
+uniform sampler2D u_depthTex;
 uniform sampler2D u_normalTex;
-uniform samplerCube u_cubemap;
 uniform vec3 u_samples[64];
-uniform mat4 u_matP;
-uniform mat4 u_matV;
+uniform mat4 u_matInvV;		// inverse view matrix (cube map lookups in world space)
 uniform float u_radius;
 uniform float u_screenWidth;
 uniform float u_screenHeight;
+uniform int u_kernelSize;		// number of samples (subset of u_samples, fewer with temporal accumulation)
+uniform int u_kernelOffset;		// first sample of the subset (changes every frame with temporal accumulation)
+uniform float u_noiseAngle;		// rotation of the noise pattern around the normal (changes every frame)
 
 	
 // INPUT	
@@ -45,13 +46,10 @@ vec3 coefficientSum = vec3(0);
 //const vec2 noiseScale = vec2(1024.0/4.0, 720.0/4.0); // screen = 1024 x 720
 
 //uniform AOparams params;
-int kernelSize = 40;
 float radius = 0.05;
 float bias = 0.1;
 
 
-const float PI = 3.14159265359;
-
 // MAIN
 void main()
 {
@@ -59,31 +57,33 @@ void main()
 	radius = u_radius;
 	radius = 1.0;
 	
-	// read fragment 3D pos from G-buffer position texture
-	vec3 fragPos = texture(u_posTex, vert_uv.xy).xyz;
+	// read fragment 3D pos from G-buffer depth
+	vec3 fragPos = gBufferPosition(u_depthTex, vert_uv.xy);
 	// read fragment 3D normal from G-buffer normal texture
-	vec3 normal = texture(u_normalTex, vert_uv.xy).rgb;
+	vec3 normal = gBufferNormal(u_normalTex, vert_uv.xy);
 	
 	
 	vec3 directionalLight = vec3(0.0);
 	vec3 indirectLight = vec3(0.0);	
 	
-	// ignore fragment if normal or position is empty
-	if (normal != vec3(0.0f) && fragPos != vec3(0.0f) ) 
+	// ignore fragment if position is empty
+	if (fragPos != vec3(0.0f)) 
 	{
+
 		// build random direction vector from noise texture
 		vec3 randomVec = texture(u_noiseTex, vert_uv.xy * noiseScale).xyz; 
 
 		// build TBN matrix
 		vec3 tangent = normalize(randomVec - normal * dot(randomVec, normal));
+		tangent = cos(u_noiseAngle) * tangent + sin(u_noiseAngle) * cross(normal, tangent);
 		vec3 bitangent = cross(normal, tangent);
 		mat3 TBN = mat3(tangent, bitangent, normal); 
 
 
-		for(int i = 0; i < kernelSize; ++i)
+		for(int i = 0; i < u_kernelSize; ++i)
 		{
 			// get sample position
-			vec3 samplePos = TBN * u_samples[i]; // from tangent to view-space
+			vec3 samplePos = TBN * u_samples[(u_kernelOffset + i) % 64]; // from tangent to view-space
 			samplePos = fragPos + samplePos * radius; 
 			
 			vec4 offset = vec4(samplePos, 1.0);
@@ -92,15 +92,15 @@ void main()
 			offset.xyz  = offset.xyz * 0.5 + 0.5; 	// transform to range 0.0 - 1.0  
 			
 
-			float sampleDepth = texture(u_posTex, offset.xy).z; // get depth value at kernel sample
-			vec3 sampleNormal = texture(u_normalTex, offset.xy).rgb;
-			vec3 samplePos2 = texture(u_posTex, offset.xy).xyz;
+			vec3 samplePos2 = gBufferPosition(u_depthTex, offset.xy);
+			float sampleDepth = samplePos2.z; // get depth value at kernel sample
+			vec3 sampleNormal = gBufferNormal(u_normalTex, offset.xy);
 			vec3 sampleColor = texture(u_screenTex, offset.xy).xyz; 
 			
 			if (sampleDepth < samplePos.z || radius < abs(fragPos.z - sampleDepth))
 			{
 				// Directionnal Light : Irradiance from cubemap (if any)
-				vec4 skyboxDirection = inverse(u_matV) * vec4(samplePos - fragPos, 0.0);
+				vec4 skyboxDirection = u_matInvV * vec4(samplePos - fragPos, 0.0);
 				vec3 skyboxColor = texture(u_cubemap, skyboxDirection.xyz).xyz;
 				directionalLight += skyboxColor * dot(normal, normalize(samplePos - fragPos));
 				
@@ -119,10 +119,11 @@ void main()
 	}
 
 
-	directionalLight = PI * directionalLight / kernelSize;
+	directionalLight = PI * directionalLight / float(u_kernelSize);
 	frag_color = vec4( directionalLight.rgb, 1.0);
 
-	frag_color.rgb += indirectLight;
+	// indirect light is a sum over samples, scaled for the full kernel (40 samples)
+	frag_color.rgb += indirectLight * (40.0 / float(u_kernelSize));
 
 
 }
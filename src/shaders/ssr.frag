@@ -0,0 +1,198 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Render a geometry defined by G-buffers (depth, normal and roughness)
+// - Compute Screen-Space Reflections (SSR) by ray marching the hierarchical depth buffer (Hi-Z)
+//
+// The reflected ray is marched in screen space, with perspective-correct depth. Each step crosses
+// a cell of the current Hi-Z level: if the ray stays in front of the closest depth of the cell,
+// it moves on and the next step uses a coarser level, otherwise the step is refined at a finer
+// level. The color at the hit point is read in the mip level matching the footprint of the
+// reflection cone, whose aperture grows with roughness (glossy reflections are pre-filtered).
+//
+// Based on:
+//		Y. Uludag, "Hi-Z Screen-Space Cone-Traced Reflections", GPU Pro 5, 2014
+//		M. McGuire and M. Mara, "Efficient GPU Screen-Space Ray Tracing", JCGT 2014
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_hiZTex;
+uniform sampler2D u_depthTex;
+uniform sampler2D u_normalTex;
+uniform sampler2D u_colorTex;		// diffuse color (rgb) and roughness (a)
+uniform sampler2D u_screenTex;		// lighting result, with mip levels
+uniform float u_maxDistance;		// maximum length of the reflected rays, in view space
+uniform int u_numLevels;			// number of Hi-Z levels
+uniform int u_numScreenLevels;		// number of mip levels of the lighting result
+
+
+// INPUT
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec4 frag_color;
+
+
+// number of ray steps for mirror and for the roughest traced surfaces
+const int MAX_STEPS = 32;
+const int MIN_STEPS = 8;
+// surfaces rougher than this are not traced (their reflections are the lighting pass ambient term)
+const float MAX_ROUGHNESS = 0.7;
+// thickness of the depth layer behind a surface, relative to its depth
+const float THICKNESS = 0.02;
+// offset of the ray origin along the normal, relative to its depth (no self-intersection at grazing angles)
+const float NORMAL_OFFSET = 0.01;
+// reflectance at normal incidence (dielectrics)
+const float F0 = 0.04;
+
+
+
+// depth (distance along -z) of the ray at parameter s, interpolated linearly in screen space
+float rayDepth(float s, float k0, float k1, float zk0, float zk1)
+{
+	return -mix(zk0, zk1, s) / mix(k0, k1, s);
+}
+
+
+// parameter at which the 2D segment [a, b] leaves [0,1]^2 (1 if it does not)
+float clipToScreen(vec2 a, vec2 b)
+{
+	vec2 d = b - a;
+	float s = 1.0;
+	if(d.x > 0.0) s = min(s, (1.0 - a.x) / d.x);
+	if(d.x < 0.0) s = min(s, -a.x / d.x);
+	if(d.y > 0.0) s = min(s, (1.0 - a.y) / d.y);
+	if(d.y < 0.0) s = min(s, -a.y / d.y);
+	return max(s, 0.0);
+}
+
+
+// closest depth of the Hi-Z cell containing uv
+float hiZDepth(vec2 uv, int level)
+{
+	ivec2 size = textureSize(u_hiZTex, level);
+	ivec2 coord = clamp(ivec2(uv * vec2(size)), ivec2(0), size - 1);
+	return texelFetch(u_hiZTex, coord, level).r;
+}
+
+
+
+// MAIN
+void main()
+{
+	vec3 fragPos = gBufferPosition(u_depthTex, vert_uv.xy);
+	float roughness = texture(u_colorTex, vert_uv.xy).a;
+
+	// nothing to reflect on empty fragments, and rough ones are handled by the ambient term
+	if(fragPos == vec3(0.0) || roughness > MAX_ROUGHNESS)
+	{
+		frag_color = vec4(0.0);
+		return;
+	}
+
+	vec3 normal = gBufferNormal(u_normalTex, vert_uv.xy);
+	vec3 viewDir = normalize(fragPos);
+	vec3 reflectDir = reflect(viewDir, normal);
+	fragPos += normal * (NORMAL_OFFSET * -fragPos.z);
+
+	// segment of the reflected ray: limited by u_maxDistance and by the near plane
+	float near = u_matP[3][2] / (u_matP[2][2] - 1.0);
+	float rayLength = u_maxDistance;
+	if(reflectDir.z > 0.0)
+		rayLength = min(rayLength, (-near * 1.01 - fragPos.z) / reflectDir.z);
+	vec3 endPos = fragPos + reflectDir * rayLength;
+
+	// screen-space end points, and homogeneous terms interpolated linearly in screen space
+	vec4 h0 = u_matP * vec4(fragPos, 1.0);
+	vec4 h1 = u_matP * vec4(endPos, 1.0);
+	float k0 = 1.0 / h0.w;
+	float k1 = 1.0 / h1.w;
+	float zk0 = fragPos.z * k0;
+	float zk1 = endPos.z * k1;
+	vec2 uv0 = h0.xy * k0 * 0.5 + 0.5;
+	vec2 uv1 = h1.xy * k1 * 0.5 + 0.5;
+
+	ivec2 size = textureSize(u_hiZTex, 0);
+	float sMax = clipToScreen(uv0, uv1);
+	float lengthPixels = length((uv1 - uv0) * vec2(size));
+	if(lengthPixels * sMax < 1.0)
+	{
+		frag_color = vec4(0.0);
+		return;
+	}
+
+	// rougher surfaces: fewer steps (their reflections are blurred anyway), starting at a coarser level
+	float roughnessRatio = roughness / MAX_ROUGHNESS;
+	int numSteps = int(mix(float(MAX_STEPS), float(MIN_STEPS), roughnessRatio));
+	int maxLevel = u_numLevels - 1;
+	int level = min(int(roughnessRatio * 2.0), maxLevel);
+
+	// start one pixel away from the surface (no self-intersection)
+	float s = 1.5 / lengthPixels;
+	float hitS = -1.0;
+
+	for(int i = 0; i < numSteps && s < sMax; i++)
+	{
+		float cellPixels = float(1 << level);
+		float sNext = min(s + cellPixels / lengthPixels, sMax);
+
+		// depth range of the ray over the step, and closest scene depth of the cells it crosses
+		float d0 = rayDepth(s, k0, k1, zk0, zk1);
+		float d1 = rayDepth(sNext, k0, k1, zk0, zk1);
+		float sceneDepth = min(hiZDepth(mix(uv0, uv1, s), level), hiZDepth(mix(uv0, uv1, sNext), level));
+
+		if(max(d0, d1) < sceneDepth)
+		{
+			// in front of everything in these cells: move on, with larger steps
+			s = sNext;
+			level = min(level + 1, maxLevel);
+		}
+		else if(level > 0)
+		{
+			// potential intersection: refine
+			level--;
+		}
+		else
+		{
+			// finest level: hit if the ray is inside the depth layer of the surface, otherwise it passes behind
+			if(min(d0, d1) < sceneDepth * (1.0 + THICKNESS))
+			{
+				hitS = sNext;
+				break;
+			}
+			s = sNext;
+		}
+	}
+
+	if(hitS < 0.0)
+	{
+		frag_color = vec4(0.0);
+		return;
+	}
+
+	vec2 hitUV = mix(uv0, uv1, hitS);
+
+	// footprint of the reflection cone at the hit point (specular lobe width ~ roughness^2)
+	float coneTan = roughness * roughness;
+	float footprintPixels = 2.0 * coneTan * hitS * lengthPixels;
+	float lod = clamp(log2(max(footprintPixels, 1.0)), 0.0, float(u_numScreenLevels - 1));
+	vec3 reflectColor = textureLod(u_screenTex, hitUV, lod).rgb;
+
+	// confidence: fade near the screen borders, at the end of the ray, for rough surfaces, and for rays toward the camera
+	vec2 border = smoothstep(vec2(0.0), vec2(0.1), hitUV) * smoothstep(vec2(0.0), vec2(0.1), 1.0 - hitUV);
+	float fade = border.x * border.y;
+	fade *= 1.0 - smoothstep(0.8, 1.0, hitS);
+	fade *= 1.0 - smoothstep(0.5 * MAX_ROUGHNESS, MAX_ROUGHNESS, roughness);
+	fade *= clamp(1.0 - dot(reflectDir, -viewDir), 0.0, 1.0);
+
+	// Fresnel (Schlick), attenuated for rough surfaces
+	float cosTheta = clamp(dot(-viewDir, normal), 0.0, 1.0);
+	float fresnel = F0 + (1.0 - F0) * pow(1.0 - cosTheta, 5.0);
+	float weight = fresnel * (1.0 - roughness) * fade;
+
+	frag_color = vec4(reflectColor * weight, fade);
+}
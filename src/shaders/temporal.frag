@@ -0,0 +1,99 @@
+// Fragment shader
+//#version 330
+
+
+// ------------------------------------------------------------------------------------------------
+// - Temporal accumulation of a screen-space effect (SSAO, SSLR).
+// The result of the previous frames (history) is reprojected at the current fragment and blended
+// with the current (noisy, few samples) value. The history is rejected when the fragment was not
+// visible in the previous frame (disocclusion: depth mismatch, or outside the screen), and clamped
+// to the statistics of the 3x3 current neighborhood (variance clipping) to limit ghosting.
+// Output: rgb = accumulated value, a = view depth (used for the disocclusion test next frame).
+// ------------------------------------------------------------------------------------------------
+
+
+// UNIFORMS
+uniform sampler2D u_currentTex;
+uniform sampler2D u_historyTex;
+uniform sampler2D u_depthTex;
+uniform mat4 u_matReproj;		// current to previous G-buffer position (model transform of both frames)
+uniform mat4 u_matVP;			// view-projection matrix
+uniform mat4 u_matPrevVP;		// previous view-projection matrix
+uniform float u_blendFactor;	// weight of the current frame
+uniform int u_isHistoryValid;
+
+
+// INPUT
+in vec3 vert_uv;
+
+
+// OUTPUT
+out vec4 frag_color;
+
+
+// relative depth difference beyond which the history belongs to another surface
+const float DEPTH_TOLERANCE = 0.05;
+// width of the clipping box, in standard deviations of the neighborhood
+const float CLIP_GAMMA = 1.25;
+
+
+
+// MAIN
+void main()
+{
+	ivec2 maxCoord = textureSize(u_currentTex, 0) - 1;
+	ivec2 coord = clamp(ivec2(vert_uv.xy * vec2(maxCoord + 1)), ivec2(0), maxCoord);
+	vec3 current = texelFetch(u_currentTex, coord, 0).rgb;
+
+	vec3 fragPos = gBufferPosition(u_depthTex, vert_uv.xy);
+	if(fragPos == vec3(0.0))
+	{
+		// background: nothing to accumulate
+		frag_color = vec4(current, 0.0);
+		return;
+	}
+	float depth = (u_matVP * vec4(fragPos, 1.0)).w;
+
+	// position of the fragment in the previous frame
+	vec3 prevPos = (u_matReproj * vec4(fragPos, 1.0)).xyz;
+	vec4 prevClip = u_matPrevVP * vec4(prevPos, 1.0);
+	vec2 prevUV = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+
+	bool isHistoryValid = (u_isHistoryValid != 0) && prevClip.w > 0.0 &&
+	                      all(greaterThanEqual(prevUV, vec2(0.0))) && all(lessThanEqual(prevUV, vec2(1.0)));
+
+	if(isHistoryValid)
+	{
+		// disocclusion: the surface seen at this location in the previous frame is not the same
+		ivec2 prevCoord = clamp(ivec2(prevUV * vec2(maxCoord + 1)), ivec2(0), maxCoord);
+		float prevDepth = texelFetch(u_historyTex, prevCoord, 0).a;
+		float expectedDepth = prevClip.w;
+		isHistoryValid = abs(prevDepth - expectedDepth) < DEPTH_TOLERANCE * expectedDepth;
+	}
+
+	if(!isHistoryValid)
+	{
+		frag_color = vec4(current, depth);
+		return;
+	}
+
+	// mean and standard deviation of the current 3x3 neighborhood
+	vec3 m1 = vec3(0.0);
+	vec3 m2 = vec3(0.0);
+	for(int y = -1; y <= 1; y++)
+	{
+		for(int x = -1; x <= 1; x++)
+		{
+			vec3 value = texelFetch(u_currentTex, clamp(coord + ivec2(x, y), ivec2(0), maxCoord), 0).rgb;
+			m1 += value;
+			m2 += value * value;
+		}
+	}
+	vec3 mean = m1 / 9.0;
+	vec3 sigma = sqrt(max(m2 / 9.0 - mean * mean, vec3(0.0)));
+
+	vec3 history = texture(u_historyTex, prevUV).rgb;
+	history = clamp(history, mean - CLIP_GAMMA * sigma, mean + CLIP_GAMMA * sigma);
+
+	frag_color = vec4(mix(history, current, u_blendFactor), depth);
+}
@@ -0,0 +1,72 @@
+/*********************************************************************************************************************
+ *
+ * shadowcache.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "shadowcache.h"
+
+
+ShadowCache::ShadowCache(RenderTargetPool& _pool) : m_pool(_pool)
+{
+    m_target = nullptr;
+    m_isValid = false;
+    m_isDirty = true;
+    resetCounters();
+}
+
+
+ShadowCache::~ShadowCache()
+{
+    release();
+}
+
+
+bool ShadowCache::update(const RenderTargetDesc& _desc, const std::vector<glm::mat4>& _lightMatrices, const std::vector<ShadowCaster>& _casters)
+{
+    if(m_target == nullptr || !(m_target->desc == _desc))
+    {
+        release();
+        m_target = m_pool.acquire(_desc);
+    }
+
+    // exact comparisons: any change of the light or of a caster is visible in the shadow map
+    m_isDirty = !m_isValid || _lightMatrices != m_lightMatrices || _casters != m_casters;
+
+    if(m_isDirty)
+    {
+        m_lightMatrices = _lightMatrices;
+        m_casters = _casters;
+        m_numRendered++;
+    }
+    else
+        m_numReused++;
+
+    // the shadow map is rendered by the caller during this frame
+    m_isValid = true;
+
+    return m_isDirty;
+}
+
+
+void ShadowCache::invalidate()
+{
+    m_isValid = false;
+}
+
+
+void ShadowCache::release()
+{
+    m_pool.release(m_target);
+    m_isValid = false;
+}
+
+
+void ShadowCache::resetCounters()
+{
+    m_numRendered = 0;
+    m_numReused = 0;
+}
@@ -0,0 +1,132 @@
+/*********************************************************************************************************************
+ *
+ * shadowcache.h
+ *
+ * Shadow map kept across frames, re-rendered only when the light or the casters change
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SHADOWCACHE_H
+#define SHADOWCACHE_H
+
+#include "rendertargetpool.h"
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+#include <vector>
+
+
+
+/*!
+* \struct ShadowCaster
+* \brief Object drawn in a shadow map: its geometry and its transformation in the space of the light matrices
+*/
+struct ShadowCaster
+{
+    const void* geometry;       /*!< geometry drawn (e.g. DrawableMesh) */
+    glm::mat4 transform;        /*!< model matrix of the geometry in the shadow pass */
+
+    bool operator==(const ShadowCaster& _other) const { return geometry == _other.geometry && transform == _other.transform; }
+};
+
+
+
+/*!
+* \class ShadowCache
+* \brief Shadow map target kept across frames (as TemporalHistory does for accumulated effects).
+*        The map is only marked dirty when the state it was rendered with changes: the light matrices, the set of
+*        casters or their transformations, or the format of the map. Changes which are not visible in this state
+*        (e.g. a mesh reloaded at the same address) must be signaled with invalidate().
+*        The target is acquired from a RenderTargetPool and kept in use until release() is called.
+*/
+class ShadowCache
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn ShadowCache
+        * \brief Constructor of ShadowCache
+        * \param _pool : pool providing the target
+        */
+        ShadowCache(RenderTargetPool& _pool);
+
+        /*!
+        * \fn ~ShadowCache
+        * \brief Destructor of ShadowCache: gives the target back to the pool (which must still exist)
+        */
+        ~ShadowCache();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getTarget : shadow map target (nullptr before the first update) */
+        inline RenderTarget* getTarget() { return m_target; }
+        /*! \fn isDirty : the shadow map must be rendered this frame */
+        inline bool isDirty() { return m_isDirty; }
+        /*! \fn getNumRendered : number of updates which required rendering the shadow map */
+        inline long long getNumRendered() { return m_numRendered; }
+        /*! \fn getNumReused : number of updates which reused the shadow map of a previous frame */
+        inline long long getNumReused() { return m_numReused; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn update
+        * \brief Compare the state of this frame to the state of the cached shadow map, at the beginning of a frame.
+        *        The shadow map must be rendered in the target if the function returns true.
+        * \param _desc : format and size of the target
+        * \param _lightMatrices : light view-projection matrices (one per layer)
+        * \param _casters : objects drawn in the shadow map
+        * \return true if the shadow map is dirty
+        */
+        bool update(const RenderTargetDesc& _desc, const std::vector<glm::mat4>& _lightMatrices, const std::vector<ShadowCaster>& _casters);
+
+        /*!
+        * \fn invalidate
+        * \brief Force the shadow map to be rendered at the next update (e.g. geometry modified)
+        */
+        void invalidate();
+
+        /*!
+        * \fn release
+        * \brief Give the target back to the pool (the shadow map is rendered again at the next update)
+        */
+        void release();
+
+        /*!
+        * \fn resetCounters
+        * \brief Reset the numbers of rendered and reused shadow maps
+        */
+        void resetCounters();
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        RenderTargetPool& m_pool;                   /*!< pool providing the target */
+        RenderTarget* m_target;                     /*!< shadow map target */
+        std::vector<glm::mat4> m_lightMatrices;     /*!< light matrices the shadow map was rendered with */
+        std::vector<ShadowCaster> m_casters;        /*!< casters the shadow map was rendered with */
+        bool m_isValid;                             /*!< the target contains the shadow map of the cached state */
+        bool m_isDirty;                             /*!< the shadow map must be rendered this frame */
+        long long m_numRendered;                    /*!< number of updates which rendered the shadow map */
+        long long m_numReused;                      /*!< number of updates which reused the shadow map */
+};
+
+#endif // SHADOWCACHE_H
@@ -0,0 +1,179 @@
+/*********************************************************************************************************************
+ *
+ * shadowcascades.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "shadowcascades.h"
+
+#include <algorithm>
+#include <cmath>
+
+
+// the crop size is a multiple of this fraction of the light frustum (it only changes by steps, so texel snapping holds)
+static const float CROP_SIZE_STEP = 1.0f / 32.0f;
+// margin added to the depth range of the casters (relative), so their closest and farthest faces are not clipped
+static const float DEPTH_MARGIN = 0.01f;
+
+
+
+// corners of an axis-aligned bounding box
+static void boxCorners(const glm::vec3& _min, const glm::vec3& _max, glm::vec3 _corners[8])
+{
+    for(int c = 0; c < 8; c++)
+        _corners[c] = glm::vec3((c & 1) ? _max.x : _min.x, (c & 2) ? _max.y : _min.y, (c & 4) ? _max.z : _min.z);
+}
+
+
+// bounds of points projected by the light (normalized device coordinates), false if a point is behind a point light
+static bool projectedBounds(const glm::mat4& _lightMat, const glm::vec3* _points, int _numPoints, glm::vec3& _min, glm::vec3& _max)
+{
+    _min = glm::vec3(1e30f);
+    _max = glm::vec3(-1e30f);
+    for(int p = 0; p < _numPoints; p++)
+    {
+        glm::vec4 clip = _lightMat * glm::vec4(_points[p], 1.0f);
+        if(clip.w <= 0.0f)
+            return false;
+        glm::vec3 ndc = glm::vec3(clip) / clip.w;
+        _min = glm::min(_min, ndc);
+        _max = glm::max(_max, ndc);
+    }
+    return true;
+}
+
+
+
+ShadowCascades::ShadowCascades(int _numCascades, int _mapSize, float _splitLambda)
+{
+    m_mapSize = std::max(1, _mapSize);
+    m_splitLambda = std::clamp(_splitLambda, 0.0f, 1.0f);
+    setNumCascades(_numCascades);
+
+    for(int c = 0; c < MAX_CASCADES; c++)
+    {
+        m_matrices[c] = glm::mat4(1.0f);
+        m_splits[c] = 0.0f;
+        m_texelSizes[c] = 1.0f;
+    }
+}
+
+
+void ShadowCascades::setNumCascades(int _numCascades)
+{
+    m_numCascades = std::clamp(_numCascades, 1, MAX_CASCADES);
+}
+
+
+void ShadowCascades::update(const glm::mat4& _viewMat, const glm::mat4& _projMat, const glm::mat4& _lightMat,
+                            const glm::vec3& _casterMin, const glm::vec3& _casterMax,
+                            const glm::vec3& _receiverMin, const glm::vec3& _receiverMax)
+{
+    // corners of the view frustum (view space), on the near and far planes
+    glm::mat4 invProj = glm::inverse(_projMat);
+    glm::vec3 nearCorners[4], farCorners[4];
+    for(int c = 0; c < 4; c++)
+    {
+        glm::vec2 ndc((c & 1) ? 1.0f : -1.0f, (c & 2) ? 1.0f : -1.0f);
+        glm::vec4 nearPoint = invProj * glm::vec4(ndc, -1.0f, 1.0f);
+        glm::vec4 farPoint = invProj * glm::vec4(ndc, 1.0f, 1.0f);
+        nearCorners[c] = glm::vec3(nearPoint) / nearPoint.w;
+        farCorners[c] = glm::vec3(farPoint) / farPoint.w;
+    }
+    float nearDepth = -nearCorners[0].z;
+    float farDepth = -farCorners[0].z;
+
+    // depth range which actually contains receivers
+    glm::vec3 corners[8];
+    boxCorners(_receiverMin, _receiverMax, corners);
+    float minDepth = 1e30f, maxDepth = -1e30f;
+    for(int c = 0; c < 8; c++)
+    {
+        float depth = -(_viewMat * glm::vec4(corners[c], 1.0f)).z;
+        minDepth = std::min(minDepth, depth);
+        maxDepth = std::max(maxDepth, depth);
+    }
+    float n = std::clamp(minDepth, nearDepth, farDepth);
+    float f = std::clamp(maxDepth, n, farDepth);
+    if(f - n < 1e-4f * farDepth)
+        f = n + 1e-4f * farDepth;
+
+    // practical split scheme: logarithmic splits (constant texel/pixel ratio) blended with uniform splits
+    for(int c = 0; c < m_numCascades; c++)
+    {
+        float ratio = (float)(c + 1) / (float)m_numCascades;
+        float logSplit = n * std::pow(f / n, ratio);
+        float uniformSplit = n + (f - n) * ratio;
+        m_splits[c] = m_splitLambda * logSplit + (1.0f - m_splitLambda) * uniformSplit;
+    }
+
+    // casters seen from the light (the whole light frustum if they are not entirely in front of it)
+    boxCorners(_casterMin, _casterMax, corners);
+    glm::vec3 casterNdcMin, casterNdcMax;
+    if(!projectedBounds(_lightMat, corners, 8, casterNdcMin, casterNdcMax))
+    {
+        casterNdcMin = glm::vec3(-1.0f);
+        casterNdcMax = glm::vec3(1.0f);
+    }
+    casterNdcMin = glm::clamp(casterNdcMin, glm::vec3(-1.0f), glm::vec3(1.0f));
+    casterNdcMax = glm::clamp(casterNdcMax, glm::vec3(-1.0f), glm::vec3(1.0f));
+    float depthMargin = DEPTH_MARGIN * (casterNdcMax.z - casterNdcMin.z);
+    float zMin = std::max(casterNdcMin.z - depthMargin, -1.0f);
+    float zMax = std::min(casterNdcMax.z + depthMargin, 1.0f);
+
+    glm::mat4 invView = glm::inverse(_viewMat);
+    float sliceNear = n;
+    for(int c = 0; c < m_numCascades; c++)
+    {
+        float sliceFar = m_splits[c];
+
+        // corners of the slice, in the space of the casters
+        glm::vec3 sliceCorners[8];
+        for(int k = 0; k < 4; k++)
+        {
+            float tNear = (sliceNear - nearDepth) / (farDepth - nearDepth);
+            float tFar = (sliceFar - nearDepth) / (farDepth - nearDepth);
+            sliceCorners[k] = glm::vec3(invView * glm::vec4(glm::mix(nearCorners[k], farCorners[k], tNear), 1.0f));
+            sliceCorners[k + 4] = glm::vec3(invView * glm::vec4(glm::mix(nearCorners[k], farCorners[k], tFar), 1.0f));
+        }
+
+        // shadow map area seen by the slice, restricted to the casters
+        glm::vec3 sliceMin, sliceMax;
+        if(!projectedBounds(_lightMat, sliceCorners, 8, sliceMin, sliceMax))
+        {
+            sliceMin = glm::vec3(-1.0f);
+            sliceMax = glm::vec3(1.0f);
+        }
+        glm::vec2 cropMin = glm::max(glm::vec2(sliceMin), glm::vec2(casterNdcMin));
+        glm::vec2 cropMax = glm::min(glm::vec2(sliceMax), glm::vec2(casterNdcMax));
+        if(cropMin.x >= cropMax.x || cropMin.y >= cropMax.y)
+        {
+            // no caster seen by this slice: any (small) area will do
+            cropMin = glm::vec2(casterNdcMin);
+            cropMax = glm::vec2(casterNdcMax);
+        }
+
+        // square crop (square texels), whose size changes by steps, snapped to its texels
+        float size = std::max(cropMax.x - cropMin.x, cropMax.y - cropMin.y);
+        size = std::min(std::ceil(size / (2.0f * CROP_SIZE_STEP)) * 2.0f * CROP_SIZE_STEP, 2.0f);
+        float texel = size / (float)m_mapSize;
+        glm::vec2 center = (cropMin + cropMax) * 0.5f;
+        glm::vec2 origin = glm::floor((center - 0.5f * size) / texel) * texel;
+
+        // crop matrix: [origin, origin + size] x [zMin, zMax] to [-1,1]^3 (applied in clip space, i.e. before the division by w)
+        glm::mat4 crop(1.0f);
+        crop[0][0] = 2.0f / size;
+        crop[1][1] = 2.0f / size;
+        crop[2][2] = 2.0f / (zMax - zMin);
+        crop[3][0] = -(2.0f * origin.x + size) / size;
+        crop[3][1] = -(2.0f * origin.y + size) / size;
+        crop[3][2] = -(zMax + zMin) / (zMax - zMin);
+
+        m_matrices[c] = crop * _lightMat;
+        m_texelSizes[c] = size / 2.0f;
+        sliceNear = sliceFar;
+    }
+}
@@ -0,0 +1,106 @@
+/*********************************************************************************************************************
+ *
+ * shadowcascades.h
+ *
+ * Cascaded shadow maps: view frustum splits and light matrices fitted to the shadow casters
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SHADOWCASCADES_H
+#define SHADOWCASCADES_H
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+
+/*!
+* \class ShadowCascades
+* \brief Split the camera view frustum in depth, and compute for each slice (cascade) a light view-projection matrix
+*        whose frustum only covers the shadow casters seen by the slice:
+*        - the depth range of the slices is limited to the depth range of the receivers (no shadow map texels are
+*          spent beyond the scene), and split with the practical scheme (blend of logarithmic and uniform splits)
+*        - the light frustum is cropped in xy to the intersection of the projected slice and the projected casters,
+*          and in depth to the casters (receivers farther than the casters are clamped to the far plane)
+*        - the crop is snapped to the shadow map texels, so shadows do not shimmer when the camera moves
+*        Matrices are expressed in the space of the casters' bounding box (i.e. the space of the shadow pass vertices).
+* Based on:
+*       F. Zhang et al., "Parallel-Split Shadow Maps for Large-scale Virtual Environments", VRCIA 2006.
+*       R. Dimitrov, "Cascaded Shadow Maps", NVIDIA whitepaper, 2007.
+*/
+class ShadowCascades
+{
+    public:
+
+        static const int MAX_CASCADES = 4;     /*!< maximum number of cascades (size of the shader arrays) */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn ShadowCascades
+        * \brief Constructor of ShadowCascades
+        * \param _numCascades : number of cascades, in [1, MAX_CASCADES]
+        * \param _mapSize : width (and height) of the shadow map of each cascade, in texels
+        * \param _splitLambda : weight of the logarithmic splits (1) against the uniform splits (0)
+        */
+        ShadowCascades(int _numCascades = 3, int _mapSize = 1024, float _splitLambda = 0.75f);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getNumCascades */
+        inline int getNumCascades() { return m_numCascades; }
+        /*! \fn getMapSize */
+        inline int getMapSize() { return m_mapSize; }
+        /*! \fn getMatrices : light view-projection matrix of each cascade */
+        inline const glm::mat4* getMatrices() { return m_matrices; }
+        /*! \fn getSplits : view depth of the far end of each cascade */
+        inline const float* getSplits() { return m_splits; }
+        /*! \fn getTexelSize : size of a shadow map texel of a cascade, relative to a single map of the same size */
+        inline float getTexelSize(int _cascade) { return m_texelSizes[_cascade]; }
+
+        /*! \fn setNumCascades */
+        void setNumCascades(int _numCascades);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn update
+        * \brief Compute the splits and the light matrices of the cascades
+        * \param _viewMat : camera view matrix (from the space of the casters)
+        * \param _projMat : camera projection matrix
+        * \param _lightMat : light projection * view matrix covering the whole scene (as used by a single shadow map)
+        * \param _casterMin, _casterMax : bounding box of the shadow casters
+        * \param _receiverMin, _receiverMax : bounding box of the shadow receivers (casters included)
+        */
+        void update(const glm::mat4& _viewMat, const glm::mat4& _projMat, const glm::mat4& _lightMat,
+                    const glm::vec3& _casterMin, const glm::vec3& _casterMax,
+                    const glm::vec3& _receiverMin, const glm::vec3& _receiverMax);
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        int m_numCascades;                      /*!< number of cascades */
+        int m_mapSize;                          /*!< size of the shadow map of each cascade, in texels */
+        float m_splitLambda;                    /*!< weight of the logarithmic splits */
+        glm::mat4 m_matrices[MAX_CASCADES];     /*!< light view-projection matrix of each cascade */
+        float m_splits[MAX_CASCADES];           /*!< view depth of the far end of each cascade */
+        float m_texelSizes[MAX_CASCADES];       /*!< texel size of each cascade, relative to the uncropped light frustum */
+};
+
+#endif // SHADOWCASCADES_H
@@ -0,0 +1,142 @@
+/*********************************************************************************************************************
+ *
+ * simd.h
+ *
+ * Minimal 4-wide float operations for the CPU renderers (SSE2, or scalar fallback)
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+
+#ifndef SIMD_H
+#define SIMD_H
+
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SIMD_SSE2
+#endif
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                              4 FLOATS, 4 MASKS                                              |
++-------------------------------------------------------------------------------------------------------------*/
+
+#ifdef SIMD_SSE2
+
+/*!
+* \struct Float4
+* \brief 4 floats processed together (e.g. 4 pixels, 4 boxes, 4 triangles)
+*/
+struct Float4
+{
+    __m128 v;
+    Float4() {}
+    Float4(__m128 _v) : v(_v) {}
+    Float4(float _s) : v(_mm_set1_ps(_s)) {}
+    Float4(float _a, float _b, float _c, float _d) : v(_mm_setr_ps(_a, _b, _c, _d)) {}
+    static Float4 load(const float* _p) { return _mm_loadu_ps(_p); }
+    void store(float* _p) const { _mm_storeu_ps(_p, v); }
+};
+
+/*!
+* \struct Mask4
+* \brief 4 booleans, result of the comparison of two Float4
+*/
+struct Mask4
+{
+    __m128 v;
+    Mask4(__m128 _v) : v(_v) {}
+    Mask4(bool _b) : v(_mm_castsi128_ps(_mm_set1_epi32(_b ? -1 : 0))) {}
+    /*! bit i is set if lane i is true */
+    int bits() const { return _mm_movemask_ps(v); }
+};
+
+inline Float4 operator+(Float4 _a, Float4 _b) { return _mm_add_ps(_a.v, _b.v); }
+inline Float4 operator-(Float4 _a, Float4 _b) { return _mm_sub_ps(_a.v, _b.v); }
+inline Float4 operator*(Float4 _a, Float4 _b) { return _mm_mul_ps(_a.v, _b.v); }
+inline Float4 operator/(Float4 _a, Float4 _b) { return _mm_div_ps(_a.v, _b.v); }
+inline Float4 min4(Float4 _a, Float4 _b) { return _mm_min_ps(_a.v, _b.v); }
+inline Float4 max4(Float4 _a, Float4 _b) { return _mm_max_ps(_a.v, _b.v); }
+inline Float4 sqrt4(Float4 _a) { return _mm_sqrt_ps(_a.v); }
+inline Mask4 operator>(Float4 _a, Float4 _b) { return _mm_cmpgt_ps(_a.v, _b.v); }
+inline Mask4 operator<(Float4 _a, Float4 _b) { return _mm_cmplt_ps(_a.v, _b.v); }
+inline Mask4 operator>=(Float4 _a, Float4 _b) { return _mm_cmpge_ps(_a.v, _b.v); }
+inline Mask4 operator<=(Float4 _a, Float4 _b) { return _mm_cmple_ps(_a.v, _b.v); }
+inline Mask4 operator==(Float4 _a, Float4 _b) { return _mm_cmpeq_ps(_a.v, _b.v); }
+inline Mask4 operator!=(Float4 _a, Float4 _b) { return _mm_cmpneq_ps(_a.v, _b.v); }
+inline Mask4 operator&(Mask4 _a, Mask4 _b) { return _mm_and_ps(_a.v, _b.v); }
+inline Mask4 operator|(Mask4 _a, Mask4 _b) { return _mm_or_ps(_a.v, _b.v); }
+inline Float4 select(Mask4 _m, Float4 _a, Float4 _b) { return _mm_or_ps(_mm_and_ps(_m.v, _a.v), _mm_andnot_ps(_m.v, _b.v)); }
+
+#else
+
+struct Float4
+{
+    float v[4];
+    Float4() {}
+    Float4(float _s) { v[0] = v[1] = v[2] = v[3] = _s; }
+    Float4(float _a, float _b, float _c, float _d) { v[0] = _a; v[1] = _b; v[2] = _c; v[3] = _d; }
+    static Float4 load(const float* _p) { Float4 r; for(int i = 0; i < 4; i++) r.v[i] = _p[i]; return r; }
+    void store(float* _p) const { for(int i = 0; i < 4; i++) _p[i] = v[i]; }
+};
+
+struct Mask4
+{
+    bool v[4];
+    Mask4() {}
+    Mask4(bool _b) { v[0] = v[1] = v[2] = v[3] = _b; }
+    int bits() const { return (v[0] ? 1 : 0) | (v[1] ? 2 : 0) | (v[2] ? 4 : 0) | (v[3] ? 8 : 0); }
+};
+
+#define SIMD_FLOAT4_OP(OP, RET, EXPR) inline RET OP(Float4 _a, Float4 _b) { RET r; for(int i = 0; i < 4; i++) r.v[i] = EXPR; return r; }
+SIMD_FLOAT4_OP(operator+, Float4, _a.v[i] + _b.v[i])
+SIMD_FLOAT4_OP(operator-, Float4, _a.v[i] - _b.v[i])
+SIMD_FLOAT4_OP(operator*, Float4, _a.v[i] * _b.v[i])
+SIMD_FLOAT4_OP(operator/, Float4, _a.v[i] / _b.v[i])
+SIMD_FLOAT4_OP(min4, Float4, std::min(_a.v[i], _b.v[i]))
+SIMD_FLOAT4_OP(max4, Float4, std::max(_a.v[i], _b.v[i]))
+SIMD_FLOAT4_OP(operator>, Mask4, _a.v[i] > _b.v[i])
+SIMD_FLOAT4_OP(operator<, Mask4, _a.v[i] < _b.v[i])
+SIMD_FLOAT4_OP(operator>=, Mask4, _a.v[i] >= _b.v[i])
+SIMD_FLOAT4_OP(operator<=, Mask4, _a.v[i] <= _b.v[i])
+SIMD_FLOAT4_OP(operator==, Mask4, _a.v[i] == _b.v[i])
+SIMD_FLOAT4_OP(operator!=, Mask4, _a.v[i] != _b.v[i])
+#undef SIMD_FLOAT4_OP
+inline Float4 sqrt4(Float4 _a) { Float4 r; for(int i = 0; i < 4; i++) r.v[i] = std::sqrt(_a.v[i]); return r; }
+inline Mask4 operator&(Mask4 _a, Mask4 _b) { Mask4 r; for(int i = 0; i < 4; i++) r.v[i] = _a.v[i] && _b.v[i]; return r; }
+inline Mask4 operator|(Mask4 _a, Mask4 _b) { Mask4 r; for(int i = 0; i < 4; i++) r.v[i] = _a.v[i] || _b.v[i]; return r; }
+inline Float4 select(Mask4 _m, Float4 _a, Float4 _b) { Float4 r; for(int i = 0; i < 4; i++) r.v[i] = _m.v[i] ? _a.v[i] : _b.v[i]; return r; }
+
+#endif
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                                4 3D VECTORS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+/*!
+* \struct Vec3x4
+* \brief 4 3D vectors (structure of arrays)
+*/
+struct Vec3x4
+{
+    Float4 x, y, z;
+};
+
+inline Vec3x4 load3(const float _p[3][4]) { return { Float4::load(_p[0]), Float4::load(_p[1]), Float4::load(_p[2]) }; }
+inline Vec3x4 operator+(const Vec3x4& _a, const Vec3x4& _b) { return { _a.x + _b.x, _a.y + _b.y, _a.z + _b.z }; }
+inline Vec3x4 operator-(const Vec3x4& _a, const Vec3x4& _b) { return { _a.x - _b.x, _a.y - _b.y, _a.z - _b.z }; }
+inline Vec3x4 operator*(const Vec3x4& _a, Float4 _s) { return { _a.x * _s, _a.y * _s, _a.z * _s }; }
+inline Float4 dot(const Vec3x4& _a, const Vec3x4& _b) { return _a.x * _b.x + _a.y * _b.y + _a.z * _b.z; }
+inline Vec3x4 cross(const Vec3x4& _a, const Vec3x4& _b) { return { _a.y * _b.z - _a.z * _b.y, _a.z * _b.x - _a.x * _b.z, _a.x * _b.y - _a.y * _b.x }; }
+inline Vec3x4 normalize(const Vec3x4& _a) { return _a * (Float4(1.0f) / sqrt4(dot(_a, _a))); }
+
+#endif // SIMD_H
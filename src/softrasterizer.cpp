@@ -0,0 +1,495 @@
+/*********************************************************************************************************************
+ *
+ * softrasterizer.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "softrasterizer.h"
+#include "parallel.h"
+#include "simd.h"
+#include "sampling.h"
+
+#include <cmath>
+#include <algorithm>
+
+
+
+// size of the square screen tiles rendered in parallel (multiple of 4)
+static const int TILE_SIZE = 32;
+// number of triangles (or vertices) per work item of the geometry stages
+static const unsigned int CHUNK_SIZE = 4096;
+// window coords are snapped to 1/SUBPIXEL pixel, as the GL fixed-point rasterizers do
+static const float SUBPIXEL = 256.0f;
+// triangles are only clipped against the X and Y planes beyond GUARD_BAND times the viewport, the bounding box
+// takes care of the rest (keeps the window coords in a range where edge functions are accurate)
+static const float GUARD_BAND = 2.0f;
+// visibility buffer value of the pixels not covered by any triangle
+static const uint32_t EMPTY = 0xffffffffu;
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                        CONSTRUCTORS / DESTRUCTORS                                           |
++-------------------------------------------------------------------------------------------------------------*/
+
+SoftRasterizer::SoftRasterizer(int _width, int _height)
+{
+    m_width = std::max(1, _width);
+    m_height = std::max(1, _height);
+    m_numTilesX = (m_width + TILE_SIZE - 1) / TILE_SIZE;
+    m_numTilesY = (m_height + TILE_SIZE - 1) / TILE_SIZE;
+    m_pixels.assign((size_t)m_width * m_height * 4, 0);
+    m_numTriangles = 0;
+
+    m_viewProj = glm::mat4(1.0f);
+    m_camPos = glm::vec3(0.0f);
+    m_lightPos = glm::vec3(0.0f, 0.0f, 1.0f);
+    m_lightColor = glm::vec3(1.0f);
+    m_isLightDir = false;
+    m_distLightMax = 1.0f;
+    m_useGammaCorrec = true;
+    m_backgroundColor = glm::vec4(0.0f);
+}
+
+
+
+/*------------------------------------------------------------------------------------------------------------+
+|                                               OTHER METHODS                                                 |
++-------------------------------------------------------------------------------------------------------------*/
+
+void SoftRasterizer::addMesh(const std::vector<glm::vec3>& _vertices, const std::vector<glm::vec3>& _normals,
+                             const std::vector<uint32_t>& _indices, const glm::mat4& _model, const Material& _material)
+{
+    uint32_t meshIndex = (uint32_t)m_meshes.size();
+    // the light position is rotated by the model matrix in lighting.frag
+    m_meshes.push_back({ _material, glm::mat3(_model) * m_lightPos });
+
+    // vertex stage of lighting.vert
+    size_t base = m_clipPos.size();
+    size_t numVertices = _vertices.size();
+    m_clipPos.resize(base + numVertices);
+    m_worldPos.resize(base + numVertices);
+    m_worldNormal.resize(base + numVertices);
+    m_viewVec.resize(base + numVertices);
+
+    glm::mat4 mvp = m_viewProj * _model;
+    glm::mat3 normalMat = glm::transpose(glm::inverse(glm::mat3(_model)));
+    unsigned int numChunks = (unsigned int)((numVertices + CHUNK_SIZE - 1) / CHUNK_SIZE);
+    parallelFor(numChunks, [&](unsigned int _chunk, unsigned int)
+    {
+        size_t end = std::min(numVertices, (size_t)(_chunk + 1) * CHUNK_SIZE);
+        for(size_t v = (size_t)_chunk * CHUNK_SIZE; v < end; v++)
+        {
+            glm::vec4 position(_vertices[v], 1.0f);
+            glm::vec3 worldPos = glm::vec3(_model * position);
+            m_clipPos[base + v] = mvp * position;
+            m_worldPos[base + v] = worldPos;
+            m_worldNormal[base + v] = glm::normalize(normalMat * (v < _normals.size() ? _normals[v] : glm::vec3(0.0f, 1.0f, 0.0f)));
+            m_viewVec[base + v] = glm::normalize(m_camPos - worldPos);
+        }
+    });
+
+    size_t numIndices = _indices.size() - _indices.size() % 3;
+    m_indices.reserve(m_indices.size() + numIndices);
+    for(size_t i = 0; i < numIndices; i++)
+        m_indices.push_back((uint32_t)base + _indices[i]);
+    m_triMesh.resize(m_indices.size() / 3, meshIndex);
+}
+
+
+void SoftRasterizer::render()
+{
+    // 1- Clip and set up the triangles, in chunks of consecutive triangles -----------------------------------
+
+    unsigned int numPrims = (unsigned int)(m_indices.size() / 3);
+    unsigned int numChunks = (numPrims + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    std::vector<std::vector<Triangle> > chunkTriangles(numChunks);
+    parallelFor(numChunks, [&](unsigned int _chunk, unsigned int)
+    {
+        unsigned int end = std::min(numPrims, (_chunk + 1) * CHUNK_SIZE);
+        for(unsigned int p = _chunk * CHUNK_SIZE; p < end; p++)
+            setupTriangle(p, chunkTriangles[_chunk]);
+    });
+
+    // concatenate the chunks in draw order
+    std::vector<size_t> offsets(numChunks + 1, 0);
+    for(unsigned int c = 0; c < numChunks; c++)
+        offsets[c + 1] = offsets[c] + chunkTriangles[c].size();
+    std::vector<Triangle> triangles(offsets[numChunks]);
+    m_numTriangles = triangles.size();
+    parallelFor(numChunks, [&](unsigned int _chunk, unsigned int)
+    {
+        std::copy(chunkTriangles[_chunk].begin(), chunkTriangles[_chunk].end(), triangles.begin() + offsets[_chunk]);
+        std::vector<Triangle>().swap(chunkTriangles[_chunk]);
+    });
+
+
+    // 2- Bin the triangles to the tiles they overlap ----------------------------------------------------------
+
+    int numTiles = m_numTilesX * m_numTilesY;
+    std::vector<std::vector<std::vector<uint32_t> > > bins(numChunks, std::vector<std::vector<uint32_t> >(numTiles));
+    parallelFor(numChunks, [&](unsigned int _chunk, unsigned int)
+    {
+        for(size_t t = offsets[_chunk]; t < offsets[_chunk + 1]; t++)
+        {
+            const int* bbox = triangles[t].bbox;
+            for(int ty = bbox[1] / TILE_SIZE; ty <= bbox[3] / TILE_SIZE; ty++)
+                for(int tx = bbox[0] / TILE_SIZE; tx <= bbox[2] / TILE_SIZE; tx++)
+                    bins[_chunk][ty * m_numTilesX + tx].push_back((uint32_t)t);
+        }
+    });
+
+
+    // 3- Rasterize and shade the tiles ------------------------------------------------------------------------
+
+    parallelFor((unsigned int)numTiles, [&](unsigned int _tile, unsigned int)
+    {
+        renderTile((int)_tile % m_numTilesX, (int)_tile / m_numTilesX, triangles, bins);
+    });
+
+
+    // the meshes are consumed
+    m_meshes.clear();
+    m_clipPos.clear();
+    m_worldPos.clear();
+    m_worldNormal.clear();
+    m_viewVec.clear();
+    m_indices.clear();
+    m_triMesh.clear();
+}
+
+
+void SoftRasterizer::setupTriangle(uint32_t _prim, std::vector<Triangle>& _triangles)
+{
+    // clip space position and barycentric coords (1 and 2) in the unclipped triangle
+    struct ClipVertex
+    {
+        glm::vec4 pos;
+        glm::vec2 bary;
+    };
+
+    ClipVertex poly[9], tmp[9];
+    int numVertices = 3;
+    for(int i = 0; i < 3; i++)
+        poly[i] = { m_clipPos[m_indices[3 * _prim + i]], glm::vec2(i == 1 ? 1.0f : 0.0f, i == 2 ? 1.0f : 0.0f) };
+
+    // signed distances to the clipping planes: near, far, then X and Y planes of the guard band
+    auto planeDistance = [](const glm::vec4& _p, int _plane, float _scale)
+    {
+        switch(_plane)
+        {
+            case 0: return _p.w + _p.z;
+            case 1: return _p.w - _p.z;
+            case 2: return _scale * _p.w + _p.x;
+            case 3: return _scale * _p.w - _p.x;
+            case 4: return _scale * _p.w + _p.y;
+            default: return _scale * _p.w - _p.y;
+        }
+    };
+
+    // trivial rejection: all vertices outside of a plane of the view frustum
+    for(int plane = 0; plane < 6; plane++)
+        if(planeDistance(poly[0].pos, plane, 1.0f) < 0.0f && planeDistance(poly[1].pos, plane, 1.0f) < 0.0f &&
+           planeDistance(poly[2].pos, plane, 1.0f) < 0.0f)
+            return;
+
+    // Sutherland-Hodgman clipping (attributes are linear in clip space)
+    for(int plane = 0; plane < 6; plane++)
+    {
+        float dist[9];
+        bool isClipped = false;
+        for(int i = 0; i < numVertices; i++)
+        {
+            dist[i] = planeDistance(poly[i].pos, plane, GUARD_BAND);
+            isClipped |= (dist[i] < 0.0f);
+        }
+        if(!isClipped)
+            continue;
+
+        int numClipped = 0;
+        for(int i = 0; i < numVertices; i++)
+        {
+            int j = (i + 1) % numVertices;
+            if(dist[i] >= 0.0f)
+                tmp[numClipped++] = poly[i];
+            if((dist[i] >= 0.0f) != (dist[j] >= 0.0f))
+            {
+                float t = dist[i] / (dist[i] - dist[j]);
+                tmp[numClipped++] = { glm::mix(poly[i].pos, poly[j].pos, t), glm::mix(poly[i].bary, poly[j].bary, t) };
+            }
+        }
+        numVertices = numClipped;
+        if(numVertices < 3)
+            return;
+        std::copy(tmp, tmp + numVertices, poly);
+    }
+
+    // viewport transform, snapped to the sub-pixel grid
+    float x[9], y[9], z[9], invW[9];
+    for(int i = 0; i < numVertices; i++)
+    {
+        invW[i] = 1.0f / poly[i].pos.w;
+        x[i] = std::round((poly[i].pos.x * invW[i] * 0.5f + 0.5f) * (float)m_width * SUBPIXEL) / SUBPIXEL;
+        y[i] = std::round((poly[i].pos.y * invW[i] * 0.5f + 0.5f) * (float)m_height * SUBPIXEL) / SUBPIXEL;
+        z[i] = poly[i].pos.z * invW[i] * 0.5f + 0.5f;
+    }
+
+    // triangle fan of the clipped polygon
+    for(int i = 1; i + 1 < numVertices; i++)
+    {
+        int v[3] = { 0, i, i + 1 };
+        float area = (x[v[1]] - x[v[0]]) * (y[v[2]] - y[v[0]]) - (x[v[2]] - x[v[0]]) * (y[v[1]] - y[v[0]]);
+        if(area == 0.0f)
+            continue;
+        // no face culling: clockwise triangles are made counter-clockwise
+        if(area < 0.0f)
+            std::swap(v[1], v[2]);
+
+        Triangle tri;
+        float minX = x[v[0]], maxX = x[v[0]], minY = y[v[0]], maxY = y[v[0]];
+        for(int k = 0; k < 3; k++)
+        {
+            tri.x[k] = x[v[k]];
+            tri.y[k] = y[v[k]];
+            tri.z[k] = z[v[k]];
+            tri.invW[k] = invW[v[k]];
+            tri.bary[k] = poly[v[k]].bary;
+            minX = std::min(minX, tri.x[k]);
+            maxX = std::max(maxX, tri.x[k]);
+            minY = std::min(minY, tri.y[k]);
+            maxY = std::max(maxY, tri.y[k]);
+        }
+        tri.prim = _prim;
+
+        // pixels whose center is in the bounding box
+        tri.bbox[0] = std::max(0, (int)std::ceil(minX - 0.5f));
+        tri.bbox[1] = std::max(0, (int)std::ceil(minY - 0.5f));
+        tri.bbox[2] = std::min(m_width - 1, (int)std::floor(maxX - 0.5f));
+        tri.bbox[3] = std::min(m_height - 1, (int)std::floor(maxY - 0.5f));
+        if(tri.bbox[0] > tri.bbox[2] || tri.bbox[1] > tri.bbox[3])
+            continue;
+
+        _triangles.push_back(tri);
+    }
+}
+
+
+void SoftRasterizer::renderTile(int _tileX, int _tileY, const std::vector<Triangle>& _triangles,
+                                const std::vector<std::vector<std::vector<uint32_t> > >& _bins)
+{
+    int tileIndex = _tileY * m_numTilesX + _tileX;
+    int x0 = _tileX * TILE_SIZE;
+    int y0 = _tileY * TILE_SIZE;
+    int x1 = std::min(x0 + TILE_SIZE, m_width) - 1;
+    int y1 = std::min(y0 + TILE_SIZE, m_height) - 1;
+
+    // visibility buffer of the tile: depth, triangle and its screen-space barycentric coords 1 and 2
+    alignas(16) float depth[TILE_SIZE * TILE_SIZE];
+    alignas(16) float lambda1[TILE_SIZE * TILE_SIZE];
+    alignas(16) float lambda2[TILE_SIZE * TILE_SIZE];
+    uint32_t visible[TILE_SIZE * TILE_SIZE];
+    std::fill(depth, depth + TILE_SIZE * TILE_SIZE, 1.0f);
+    std::fill(visible, visible + TILE_SIZE * TILE_SIZE, EMPTY);
+
+    const Float4 laneOffset(0.5f, 1.5f, 2.5f, 3.5f);
+    const Float4 zero(0.0f);
+
+
+    // 1- Rasterization -------------------------------------------------------------------------------------
+
+    for(const std::vector<std::vector<uint32_t> >& chunkBins : _bins)
+    {
+        for(uint32_t t : chunkBins[tileIndex])
+        {
+            const Triangle& tri = _triangles[t];
+
+            // edge functions E_i(x, y) = A_i * x + B_i * y + C_i of the edges opposite to each vertex, positive inside
+            float A[3], B[3], C[3];
+            Mask4 isTopLeft[3] = { false, false, false };
+            for(int i = 0; i < 3; i++)
+            {
+                int j = (i + 1) % 3, k = (i + 2) % 3;
+                A[i] = tri.y[j] - tri.y[k];
+                B[i] = tri.x[k] - tri.x[j];
+                C[i] = tri.x[j] * tri.y[k] - tri.x[k] * tri.y[j];
+                // top-left fill rule (counter-clockwise triangle, Y axis up): pixel centers on a top or left edge are in
+                isTopLeft[i] = (A[i] > 0.0f) || (A[i] == 0.0f && B[i] < 0.0f);
+            }
+            float area = (A[0] * tri.x[0] + B[0] * tri.y[0]) + C[0];
+            if(area <= 0.0f)
+                continue;
+            float invArea = 1.0f / area;
+            Float4 dz1((tri.z[1] - tri.z[0]) * invArea), dz2((tri.z[2] - tri.z[0]) * invArea), z0(tri.z[0]);
+
+            int minX = std::max(tri.bbox[0], x0), maxX = std::min(tri.bbox[2], x1);
+            int minY = std::max(tri.bbox[1], y0), maxY = std::min(tri.bbox[3], y1);
+            // 4 pixels at once, aligned on the tile
+            minX = x0 + ((minX - x0) & ~3);
+
+            for(int py = minY; py <= maxY; py++)
+            {
+                Float4 fy((float)py + 0.5f);
+                Float4 rowE[3];
+                for(int i = 0; i < 3; i++)
+                    rowE[i] = Float4(B[i]) * fy;
+
+                for(int px = minX; px <= maxX; px += 4)
+                {
+                    Float4 fx = Float4((float)px) + laneOffset;
+
+                    // same evaluation order for all triangles, so shared edges are exactly opposite (no crack, no double hit)
+                    Float4 E[3];
+                    Mask4 isInside(true);
+                    for(int i = 0; i < 3; i++)
+                    {
+                        E[i] = (Float4(A[i]) * fx + rowE[i]) + Float4(C[i]);
+                        isInside = isInside & ((E[i] > zero) | ((E[i] == zero) & isTopLeft[i]));
+                    }
+                    if(isInside.bits() == 0)
+                        continue;
+
+                    int index = (py - y0) * TILE_SIZE + (px - x0);
+                    Float4 storedDepth = Float4::load(depth + index);
+                    Float4 z = z0 + dz1 * E[1] + dz2 * E[2];
+                    Mask4 isPassed = isInside & (z < storedDepth);
+                    int bits = isPassed.bits();
+                    if(bits == 0)
+                        continue;
+
+                    select(isPassed, z, storedDepth).store(depth + index);
+                    select(isPassed, E[1] * Float4(invArea), Float4::load(lambda1 + index)).store(lambda1 + index);
+                    select(isPassed, E[2] * Float4(invArea), Float4::load(lambda2 + index)).store(lambda2 + index);
+                    for(int lane = 0; lane < 4; lane++)
+                        if(bits & (1 << lane))
+                            visible[index + lane] = t;
+                }
+            }
+        }
+    }
+
+
+    // 2- Shading of the visible pixels, 4 at once -----------------------------------------------------------
+
+    auto writePixel = [&](int _index, const glm::vec4& _color)
+    {
+        int px = x0 + _index % TILE_SIZE;
+        int py = y0 + _index / TILE_SIZE;
+        unsigned char* pixel = &m_pixels[((size_t)py * m_width + px) * 4];
+        for(int c = 0; c < 4; c++)
+            pixel[c] = (unsigned char)(std::clamp(_color[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+    };
+
+    int visiblePixels[TILE_SIZE * TILE_SIZE];
+    int numVisible = 0;
+    for(int py = y0; py <= y1; py++)
+    {
+        for(int px = x0; px <= x1; px++)
+        {
+            int index = (py - y0) * TILE_SIZE + (px - x0);
+            if(visible[index] == EMPTY)
+                writePixel(index, m_backgroundColor);
+            else
+                visiblePixels[numVisible++] = index;
+        }
+    }
+
+    for(int first = 0; first < numVisible; first += 4)
+    {
+        const int* pixels = visiblePixels + first;
+        int numPixels = std::min(4, numVisible - first);
+
+        // gather the interpolated attributes of the vertex stage (lanes without pixel repeat the first one)
+        alignas(16) float pos[3][4], normal[3][4], view[3][4], lightPos[3][4];
+        alignas(16) float albedoD[3][4], F0[3][4], roughness[4];
+        for(int lane = 0; lane < 4; lane++)
+        {
+            int pixel = pixels[lane < numPixels ? lane : 0];
+            const Triangle& tri = _triangles[visible[pixel]];
+
+            // perspective-correct barycentric coords in the clipped triangle, then in the unclipped one
+            float l1 = lambda1[pixel], l2 = lambda2[pixel];
+            float p0 = (1.0f - l1 - l2) * tri.invW[0], p1 = l1 * tri.invW[1], p2 = l2 * tri.invW[2];
+            float invSum = 1.0f / (p0 + p1 + p2);
+            glm::vec2 bary = (tri.bary[0] * p0 + tri.bary[1] * p1 + tri.bary[2] * p2) * invSum;
+            float w[3] = { 1.0f - bary.x - bary.y, bary.x, bary.y };
+
+            glm::vec3 P(0.0f), N(0.0f), V(0.0f);
+            for(int k = 0; k < 3; k++)
+            {
+                uint32_t v = m_indices[3 * tri.prim + k];
+                P += m_worldPos[v] * w[k];
+                N += m_worldNormal[v] * w[k];
+                V += m_viewVec[v] * w[k];
+            }
+
+            const MeshData& mesh = m_meshes[m_triMesh[tri.prim]];
+            glm::vec3 f0 = glm::mix(glm::vec3(0.04f), mesh.material.specularColor, METALNESS);
+            for(int c = 0; c < 3; c++)
+            {
+                pos[c][lane] = P[c];
+                normal[c][lane] = N[c];
+                view[c][lane] = V[c];
+                lightPos[c][lane] = mesh.lightPos[c];
+                albedoD[c][lane] = mesh.material.diffuseColor[c];
+                F0[c][lane] = f0[c];
+            }
+            roughness[lane] = 1.0f - mesh.material.specularPower / 2048.0f;
+        }
+
+        // lighting.frag without textures, shadows nor environment (the interpolated N and V are not normalized)
+        Vec3x4 vecN = load3(normal), vecV = load3(view), vecP = load3(pos), vecLight = load3(lightPos);
+        Vec3x4 vecL = normalize(m_isLightDir ? vecLight : vecLight - vecP);
+        Vec3x4 vecH = normalize(vecL + vecV);
+        Float4 one(1.0f), a = Float4::load(roughness);
+
+        // GGX distribution
+        Float4 a2 = a * a;
+        Float4 NdotH = max4(dot(vecN, vecH), zero);
+        Float4 denomD = NdotH * NdotH * (a2 - one) + one;
+        Float4 D = a2 / (Float4(PI) * denomD * denomD);
+
+        // Smith geometry with Schlick-GGX (k = roughness)
+        Float4 NdotV = max4(dot(vecN, vecV), zero);
+        Float4 NdotL = max4(dot(vecN, vecL), zero);
+        Float4 G = (NdotV / (NdotV * (one - a) + a)) * (NdotL / (NdotL * (one - a) + a));
+
+        // Schlick fresnel
+        Float4 m = one - max4(dot(vecH, vecV), zero);
+        Float4 m5 = m * m * m * m * m;
+        Vec3x4 f0 = load3(F0);
+        Vec3x4 F = { f0.x + (one - f0.x) * m5, f0.y + (one - f0.y) * m5, f0.z + (one - f0.z) * m5 };
+
+        Float4 specScale = D * G / max4(Float4(4.0f) * NdotV * NdotL, Float4(0.001f));
+
+        // point light attenuation, or constant attenuation of a directional light
+        Float4 attenuation(10.0f);
+        if(!m_isLightDir)
+        {
+            Vec3x4 toLight = vecLight - vecP;
+            Float4 distance2 = dot(toLight, toLight) * Float4(0.25f / (m_distLightMax * m_distLightMax));
+            attenuation = one / distance2;
+        }
+
+        Vec3x4 albedo = load3(albedoD);
+        Float4 kd(1.0f - METALNESS), ambient(0.03f), lightScale = attenuation * NdotL * Float4(1.5f);
+        Float4 color[3] = {
+            ambient * albedo.x + ((one - F.x) * kd * albedo.x * Float4(1.0f / PI) + F.x * specScale) * Float4(m_lightColor.x) * lightScale,
+            ambient * albedo.y + ((one - F.y) * kd * albedo.y * Float4(1.0f / PI) + F.y * specScale) * Float4(m_lightColor.y) * lightScale,
+            ambient * albedo.z + ((one - F.z) * kd * albedo.z * Float4(1.0f / PI) + F.z * specScale) * Float4(m_lightColor.z) * lightScale };
+
+        alignas(16) float rgb[3][4];
+        for(int c = 0; c < 3; c++)
+            color[c].store(rgb[c]);
+        for(int lane = 0; lane < numPixels; lane++)
+        {
+            glm::vec4 out(rgb[0][lane], rgb[1][lane], rgb[2][lane], 1.0f);
+            if(m_useGammaCorrec)
+                for(int c = 0; c < 3; c++)
+                    out[c] = std::pow(std::max(out[c], 0.0f), 1.0f / 2.2f);
+            writePixel(pixels[lane], out);
+        }
+    }
+}
@@ -0,0 +1,205 @@
+/*********************************************************************************************************************
+ *
+ * softrasterizer.h
+ *
+ * Multi-threaded CPU rasterizer, reference of the forward lighting pass for image-diff regression tests
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef SOFTRASTERIZER_H
+#define SOFTRASTERIZER_H
+
+#include <vector>
+#include <cstdint>
+
+#define GLM_FORCE_RADIANS
+#include <glm/glm.hpp>
+
+
+
+/*!
+* \class SoftRasterizer
+* \brief Render triangle meshes on the CPU with the default lighting model of lighting.frag: Cook-Torrance BRDF (GGX
+*        distribution, Smith-Schlick geometry, Schlick fresnel) and Lambertian diffuse term, lit by a point or a
+*        directional light, with a constant ambient term and gamma correction. Textures, shadows, environment maps,
+*        local lights and screen-space effects are not rendered.
+*        The screen is split in tiles of TILE_SIZE x TILE_SIZE pixels, rendered in parallel:
+*        - vertices are transformed, and triangles are clipped, set up and binned to the tiles they overlap
+*          (in parallel over chunks of triangles, the chunks are then read in order so the draw order is kept)
+*        - each tile rasterizes its triangles into a visibility buffer (depth, triangle, barycentric coords),
+*          evaluating the edge functions of 4 pixels at once
+*        - visible pixels are shaded once each, 4 pixels at once
+*        Rasterization follows the GL rules (pixel centers, 8 bits of sub-pixel precision, top-left fill rule, depth
+*        test GL_LESS, perspective-correct interpolation), so the output can be compared with the GL output pixel
+*        per pixel. 4-wide operations use SSE2 when available, scalar code otherwise.
+*/
+class SoftRasterizer
+{
+    public:
+
+        /*!
+        * \struct Material
+        * \brief Uniform material of a mesh (same defaults as DrawableMesh)
+        */
+        struct Material
+        {
+            glm::vec3 diffuseColor = glm::vec3(0.95f, 0.5f, 0.25f);    /*!< diffuse albedo */
+            glm::vec3 specularColor = glm::vec3(0.0f, 0.8f, 0.0f);     /*!< specular albedo */
+            float specularPower = 128.0f;                              /*!< specular power (roughness = 1 - power/2048) */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn SoftRasterizer
+        * \brief Constructor of SoftRasterizer
+        * \param _width : image width
+        * \param _height : image height
+        */
+        SoftRasterizer(int _width, int _height);
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getWidth */
+        inline int getWidth() { return m_width; }
+        /*! \fn getHeight */
+        inline int getHeight() { return m_height; }
+        /*! \fn getPixels : RGBA8 image, bottom row first (as read by glReadPixels) */
+        inline const std::vector<unsigned char>& getPixels() { return m_pixels; }
+        /*! \fn getNumTriangles : number of triangles rasterized by the last render() (after clipping) */
+        inline size_t getNumTriangles() { return m_numTriangles; }
+
+        /*! \fn setCamera */
+        inline void setCamera(const glm::mat4& _view, const glm::mat4& _proj, const glm::vec3& _camPos) { m_viewProj = _proj * _view; m_camPos = _camPos; }
+        /*!
+        * \fn setLight
+        * \param _lightPos : light position, or direction of a directional light (rotated by the model matrix, as in lighting.frag)
+        * \param _lightColor : light color
+        * \param _isDirectional : directional light (constant attenuation) instead of point light
+        * \param _distLightMax : distance used to normalize the point light attenuation
+        */
+        inline void setLight(const glm::vec3& _lightPos, const glm::vec3& _lightColor, bool _isDirectional, float _distLightMax)
+        {
+            m_lightPos = _lightPos;
+            m_lightColor = _lightColor;
+            m_isLightDir = _isDirectional;
+            m_distLightMax = _distLightMax;
+        }
+        /*! \fn setGammaCorrection */
+        inline void setGammaCorrection(bool _useGammaCorrec) { m_useGammaCorrec = _useGammaCorrec; }
+        /*! \fn setBackgroundColor */
+        inline void setBackgroundColor(const glm::vec4& _color) { m_backgroundColor = _color; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn addMesh
+        * \brief Transform the vertices of a mesh and add its triangles to the next render()
+        * \param _vertices : vertex positions (model space)
+        * \param _normals : vertex normals (model space)
+        * \param _indices : 3 vertex indices per triangle
+        * \param _model : model matrix
+        * \param _material : uniform material of the mesh
+        */
+        void addMesh(const std::vector<glm::vec3>& _vertices, const std::vector<glm::vec3>& _normals,
+                     const std::vector<uint32_t>& _indices, const glm::mat4& _model, const Material& _material);
+
+        /*!
+        * \fn render
+        * \brief Rasterize and shade the meshes added since the last call into the image
+        */
+        void render();
+
+
+    protected:
+
+        /*!
+        * \struct Triangle
+        * \brief Triangle in window coords, after clipping
+        */
+        struct Triangle
+        {
+            float x[3], y[3];       /*!< window coords of the vertices, snapped to the sub-pixel grid */
+            float z[3];             /*!< window depth of the vertices */
+            float invW[3];          /*!< 1/w of the vertices (perspective-correct interpolation) */
+            glm::vec2 bary[3];      /*!< barycentric coords (1 and 2) of the vertices in the unclipped triangle */
+            uint32_t prim;          /*!< index of the unclipped triangle */
+            int bbox[4];            /*!< pixel bounding box (min x, min y, max x, max y), inclusive */
+        };
+
+        /*!
+        * \struct MeshData
+        * \brief Per-mesh constants of the shading
+        */
+        struct MeshData
+        {
+            Material material;      /*!< material of the mesh */
+            glm::vec3 lightPos;     /*!< light position (or direction) rotated by the model matrix */
+        };
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        int m_width;                            /*!< image width */
+        int m_height;                           /*!< image height */
+        int m_numTilesX;                        /*!< number of tiles in a row */
+        int m_numTilesY;                        /*!< number of tiles in a column */
+        std::vector<unsigned char> m_pixels;    /*!< RGBA8 image, bottom row first */
+        size_t m_numTriangles;                  /*!< number of triangles rasterized by the last render() */
+
+        glm::mat4 m_viewProj;                   /*!< projection * view matrix */
+        glm::vec3 m_camPos;                     /*!< camera position */
+        glm::vec3 m_lightPos;                   /*!< light position or direction */
+        glm::vec3 m_lightColor;                 /*!< light color */
+        bool m_isLightDir;                      /*!< directional light */
+        float m_distLightMax;                   /*!< normalization distance of the point light attenuation */
+        bool m_useGammaCorrec;                  /*!< gamma correction of the output */
+        glm::vec4 m_backgroundColor;            /*!< color of the empty pixels */
+
+        std::vector<MeshData> m_meshes;         /*!< meshes added since the last render() */
+        std::vector<glm::vec4> m_clipPos;       /*!< clip space position of the vertices of all meshes */
+        std::vector<glm::vec3> m_worldPos;      /*!< world position of the vertices */
+        std::vector<glm::vec3> m_worldNormal;   /*!< world normal of the vertices */
+        std::vector<glm::vec3> m_viewVec;       /*!< normalized vector from the vertices to the camera */
+        std::vector<uint32_t> m_indices;        /*!< 3 indices (in the vertex arrays above) per triangle */
+        std::vector<uint32_t> m_triMesh;        /*!< mesh of each triangle */
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn setupTriangle
+        * \brief Clip a triangle against the view frustum, and append the resulting triangles in window coords
+        * \param _prim : triangle index
+        * \param _triangles : output triangles
+        */
+        void setupTriangle(uint32_t _prim, std::vector<Triangle>& _triangles);
+
+        /*!
+        * \fn renderTile
+        * \brief Rasterize the binned triangles of a tile into a visibility buffer, then shade its visible pixels
+        * \param _tileX, _tileY : tile coords
+        * \param _triangles : triangles of all chunks, in draw order
+        * \param _bins : per chunk and per tile, indices of the overlapping triangles in _triangles
+        */
+        void renderTile(int _tileX, int _tileY, const std::vector<Triangle>& _triangles,
+                        const std::vector<std::vector<std::vector<uint32_t> > >& _bins);
+};
+
+#endif // SOFTRASTERIZER_H
@@ -0,0 +1,52 @@
+/*********************************************************************************************************************
+ *
+ * temporalhistory.cpp
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "temporalhistory.h"
+
+
+TemporalHistory::TemporalHistory(RenderTargetPool& _pool) : m_pool(_pool)
+{
+    m_targets[0] = nullptr;
+    m_targets[1] = nullptr;
+    m_current = 0;
+    m_lastFrame = -1;
+    m_isValid = false;
+}
+
+
+TemporalHistory::~TemporalHistory()
+{
+    release();
+}
+
+
+void TemporalHistory::update(const RenderTargetDesc& _desc, long long _frame)
+{
+    if(m_targets[0] == nullptr || !(m_targets[0]->desc == _desc))
+    {
+        release();
+        m_targets[0] = m_pool.acquire(_desc);
+        m_targets[1] = m_pool.acquire(_desc);
+    }
+    else
+    {
+        m_isValid = (_frame == m_lastFrame + 1);
+        m_current = 1 - m_current;
+    }
+
+    m_lastFrame = _frame;
+}
+
+
+void TemporalHistory::release()
+{
+    m_pool.release(m_targets[0]);
+    m_pool.release(m_targets[1]);
+    m_isValid = false;
+}
@@ -0,0 +1,92 @@
+/*********************************************************************************************************************
+ *
+ * temporalhistory.h
+ *
+ * History targets of a temporally accumulated effect
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#ifndef TEMPORALHISTORY_H
+#define TEMPORALHISTORY_H
+
+#include "rendertargetpool.h"
+
+
+
+/*!
+* \class TemporalHistory
+* \brief Pair of targets kept across frames (ping-pong): every frame, the accumulated result of the previous frame is
+*        read while the new result is written in the other target.
+*        The targets are acquired from a RenderTargetPool and kept in use until release() is called.
+*/
+class TemporalHistory
+{
+    public:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                        CONSTRUCTORS / DESTRUCTORS                                           |
+        +------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn TemporalHistory
+        * \brief Constructor of TemporalHistory
+        * \param _pool : pool providing the targets
+        */
+        TemporalHistory(RenderTargetPool& _pool);
+
+        /*!
+        * \fn ~TemporalHistory
+        * \brief Destructor of TemporalHistory: gives the targets back to the pool (which must still exist)
+        */
+        ~TemporalHistory();
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                              GETTERS/SETTERS                                                |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*! \fn getCurrent : target written this frame */
+        inline RenderTarget* getCurrent() { return m_targets[m_current]; }
+        /*! \fn getPrevious : target written during the previous frame */
+        inline RenderTarget* getPrevious() { return m_targets[1 - m_current]; }
+        /*! \fn isValid : the previous target contains the result of the previous frame */
+        inline bool isValid() { return m_isValid; }
+
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                               OTHER METHODS                                                 |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        /*!
+        * \fn update
+        * \brief Swap the targets at the beginning of a frame. The history is invalidated if the description changed
+        *        (e.g. resize) or if it was not updated during the previous frame (effect disabled in between).
+        * \param _desc : format and size of the targets
+        * \param _frame : index of the current frame
+        */
+        void update(const RenderTargetDesc& _desc, long long _frame);
+
+        /*!
+        * \fn release
+        * \brief Give the targets back to the pool
+        */
+        void release();
+
+
+    protected:
+
+        /*------------------------------------------------------------------------------------------------------------+
+        |                                                ATTRIBUTES                                                   |
+        +-------------------------------------------------------------------------------------------------------------*/
+
+        RenderTargetPool& m_pool;           /*!< pool providing the targets */
+        RenderTarget* m_targets[2];         /*!< ping-pong targets */
+        int m_current;                      /*!< index of the target written this frame */
+        long long m_lastFrame;              /*!< last frame in which the history was updated */
+        bool m_isValid;                     /*!< previous target can be reprojected */
+};
+
+#endif // TEMPORALHISTORY_H
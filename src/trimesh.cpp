@@ -11,10 +11,15 @@
 
 #include "GLtools.h"
 
+#include <chrono>
+#include <limits>
+
 
 TriMesh::TriMesh()
 {
     m_TBComputed = false;
+    m_BVHBuilt = false;
+    m_BVHRefitNeeded = false;
 
     m_bBoxMin = glm::vec3(0.0f, 0.0f, 0.0f);
     m_bBoxMax = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -24,6 +29,8 @@ TriMesh::TriMesh()
 TriMesh::TriMesh(bool _normals, bool _texCoords2D, bool _col)
 {
     m_TBComputed = false;
+    m_BVHBuilt = false;
+    m_BVHRefitNeeded = false;
 
     m_bBoxMin = glm::vec3(0.0f, 0.0f, 0.0f);
     m_bBoxMax = glm::vec3(0.0f, 0.0f, 0.0f);
@@ -136,7 +143,9 @@ bool TriMesh::readFile(const std::string& _filename)
 {
     if(_filename.substr(_filename.find_last_of(".") + 1) == "obj")
     {
-        importOBJ(_filename);
+        if(!importOBJ(_filename))
+            return false;
+        m_BVHBuilt = false;
         return true;
     }
     else
@@ -148,6 +157,86 @@ bool TriMesh::readFile(const std::string& _filename)
 
 
 
+const BVH& TriMesh::getBVH()
+{
+    if(!m_BVHBuilt)
+    {
+        auto startTime = std::chrono::steady_clock::now();
+        m_bvh.build(m_vertices, m_indices);
+        double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+        infoLog() << "TriMesh::getBVH(): BVH of " << m_bvh.getNumTriangles() << " triangles (" << m_bvh.getNumNodes()
+                  << " nodes) built in " << time << " ms";
+        m_BVHBuilt = true;
+        m_BVHRefitNeeded = false;
+    }
+    else if(m_BVHRefitNeeded)
+    {
+        m_bvh.refit(m_vertices);
+        m_BVHRefitNeeded = false;
+    }
+    return m_bvh;
+}
+
+
+void TriMesh::setColors(const std::vector<glm::vec3>& _colors)
+{
+    if(_colors.size() != m_vertices.size())
+    {
+        errorLog() << "TriMesh::setColors(): " << _colors.size() << " colors for " << m_vertices.size() << " vertices";
+        return;
+    }
+
+    m_colors.assign(_colors.begin(), _colors.end());
+}
+
+
+void TriMesh::setVertices(const std::vector<glm::vec3>& _vertices)
+{
+    if(_vertices.size() != m_vertices.size())
+    {
+        errorLog() << "TriMesh::setVertices(): " << _vertices.size() << " vertices instead of " << m_vertices.size();
+        return;
+    }
+
+    m_vertices.assign(_vertices.begin(), _vertices.end());
+    // same triangles: the BVH topology is still valid
+    m_BVHRefitNeeded = true;
+}
+
+
+bool TriMesh::intersect(const glm::vec3& _origin, const glm::vec3& _dir, SurfacePoint& _point)
+{
+    BVH::Hit hit;
+    if(!getBVH().intersect(_origin, _dir, 0.0f, std::numeric_limits<float>::max(), hit))
+        return false;
+
+    uint32_t i0 = m_indices[hit.triangle * 3], i1 = m_indices[hit.triangle * 3 + 1], i2 = m_indices[hit.triangle * 3 + 2];
+    glm::vec3 w(1.0f - hit.bary.x - hit.bary.y, hit.bary.x, hit.bary.y);
+
+    _point.triangle = hit.triangle;
+    _point.bary = hit.bary;
+    _point.t = hit.t;
+    _point.position = w.x * m_vertices[i0] + w.y * m_vertices[i1] + w.z * m_vertices[i2];
+
+    if(m_normals.size() == m_vertices.size())
+        _point.normal = w.x * m_normals[i0] + w.y * m_normals[i1] + w.z * m_normals[i2];
+    else
+        _point.normal = glm::cross(m_vertices[i1] - m_vertices[i0], m_vertices[i2] - m_vertices[i0]);
+    float length = glm::length(_point.normal);
+    _point.normal = (length > 0.0f) ? _point.normal / length : glm::vec3(0.0f);
+
+    _point.texCoords = glm::vec2(0.0f);
+    if(m_texcoords.size() == m_vertices.size())
+        _point.texCoords = w.x * m_texcoords[i0] + w.y * m_texcoords[i1] + w.z * m_texcoords[i2];
+
+    _point.color = glm::vec3(0.0f);
+    if(m_colors.size() == m_vertices.size())
+        _point.color = w.x * m_colors[i0] + w.y * m_colors[i1] + w.z * m_colors[i2];
+
+    return true;
+}
+
+
 void TriMesh::computeAABB()
 {
     if(m_vertices.size() != 0)
@@ -336,6 +425,7 @@ bool TriMesh::importOBJ(const std::string& _filename)
     m_normals.clear();
     m_normals.reserve(normals.size());
     m_indices.clear();
+    m_colors.clear();
 
     // Set up dictionary for mapping unique tuples to indices
     std::map<glm::uvec3, unsigned, uvec3Less> visited;
@@ -443,6 +533,8 @@ void TriMesh::compTandBT(glm::vec3 _delta_pos1, glm::vec3 _delta_pos2, glm::vec3
 
 void TriMesh::clear()
 {
+    m_BVHBuilt = false;
+
     m_vertices.clear();
     m_normals.clear();
     m_indices.clear();
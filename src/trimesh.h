@@ -21,6 +21,8 @@
 #define GLM_FORCE_RADIANS
 #include <glm/glm.hpp>
 
+#include "bvh.h"
+
 
 
 /*!
@@ -33,6 +35,21 @@ class TriMesh
 {
     public:
 
+        /*!
+        * \struct SurfacePoint
+        * \brief Point of the surface hit by a ray, with the vertex attributes interpolated at this point
+        */
+        struct SurfacePoint
+        {
+            uint32_t triangle;      /*!< index of the triangle (in the indices array, divided by 3) */
+            glm::vec2 bary;         /*!< barycentric coords of the 2nd and 3rd vertices of the triangle */
+            float t;                /*!< distance along the ray (in units of the ray direction) */
+            glm::vec3 position;     /*!< interpolated position */
+            glm::vec3 normal;       /*!< interpolated normal (normalized), or geometric normal if the mesh has no normals */
+            glm::vec2 texCoords;    /*!< interpolated uvs (0 if the mesh has no uvs) */
+            glm::vec3 color;        /*!< interpolated color (0 if the mesh has no colors) */
+        };
+
         /*------------------------------------------------------------------------------------------------------------+
         |                                        CONSTRUCTORS / DESTRUCTORS                                           |
         +------------------------------------------------------------------------------------------------------------*/
@@ -93,6 +110,28 @@ class TriMesh
         */
         glm::vec3 getBBoxMax() { return m_bBoxMax; }
 
+        /*!
+        * \fn getBVH
+        * \brief get the bounding volume hierarchy of the triangles (for CPU ray queries). It is built on the first
+        *        call after the mesh was read, and refit on the first call after the vertices moved
+        * \return BVH of the mesh
+        */
+        const BVH& getBVH();
+
+        /*!
+        * \fn setColors
+        * \brief set the vertex colors (e.g. baked ambient occlusion, see AOBaker)
+        * \param _colors : one color per vertex
+        */
+        void setColors(const std::vector<glm::vec3>& _colors);
+
+        /*!
+        * \fn setVertices
+        * \brief move the vertices (same number of vertices, same triangles)
+        * \param _vertices : new vertex positions
+        */
+        void setVertices(const std::vector<glm::vec3>& _vertices);
+
 
         /*------------------------------------------------------------------------------------------------------------+
         |                                               OTHER METHODS                                                 |
@@ -106,6 +145,16 @@ class TriMesh
         */
         bool readFile(const std::string& _filename);
 
+        /*!
+        * \fn intersect
+        * \brief find the closest point of the surface hit by a ray (builds the BVH on the first call)
+        * \param _origin : origin of the ray (mesh coords)
+        * \param _dir : direction of the ray (mesh coords, not necessarily normalized)
+        * \param _point : closest point hit by the ray
+        * \return true if the ray hits the mesh
+        */
+        bool intersect(const glm::vec3& _origin, const glm::vec3& _dir, SurfacePoint& _point);
+
         /*!
         * \fn computeAABB
         * \brief compute Axis Oriented Bounding Box
@@ -142,6 +191,10 @@ class TriMesh
         
         bool m_TBComputed;                      /*!< Flag that indicates if tangent and bitangents had been computed */
 
+        BVH m_bvh;                              /*!< bounding volume hierarchy of the triangles */
+        bool m_BVHBuilt;                        /*!< Flag that indicates if the BVH matches the triangles */
+        bool m_BVHRefitNeeded;                  /*!< Flag that indicates if the vertices moved since the BVH was built */
+
         glm::vec3 m_bBoxMin;                    /*!< 3D coordinates of the min corner of the bounding box */
         glm::vec3 m_bBoxMax;                    /*!< 3D coordinates of the max corner of the bounding box */
 
@@ -15,6 +15,7 @@
 
 
 #include <vector>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iostream>
@@ -28,6 +29,9 @@
 
 #include "GLtools.h"
 
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include <stb_image_write.h>
+
 
 
         /*------------------------------------------------------------------------------------------------------------+
@@ -204,6 +208,56 @@ GLuint loadShaderProgram(const std::string& _vertShaderFilename, const std::stri
 
 
 
+/*!
+* \fn loadComputeProgram
+* \brief load compute shader program from a shader file (requires GL 4.3)
+* \param _compShaderFilename : compute shader filename
+* \return program id, or 0 if the compilation or the linking failed
+*/
+GLuint loadComputeProgram(const std::string& _compShaderFilename)
+{
+    // Load and compile compute shader
+    GLuint computeShader = glCreateShader(GL_COMPUTE_SHADER);
+    std::string computeShaderSource = readShaderSource(_compShaderFilename);
+    const char *computeShaderSourcePtr = computeShaderSource.c_str();
+    glShaderSource(computeShader, 1, &computeShaderSourcePtr, nullptr);
+    glCompileShader(computeShader);
+    GLint success = 0;
+    glGetShaderiv(computeShader, GL_COMPILE_STATUS, &success);
+    if (!success)
+    {
+        errorLog() << "loadComputeProgram(): Compute shader compilation failed:";
+        showShaderInfoLog(computeShader);
+        glDeleteShader(computeShader);
+        return 0;
+    }
+
+
+    // Create program object and link it
+    GLuint program = glCreateProgram();
+    glAttachShader(program, computeShader);
+    glLinkProgram(program);
+
+    success = 0;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    if (!success)
+    {
+        errorLog() << "loadComputeProgram(): Linking failed:";
+        showProgramInfoLog(program);
+        glDeleteProgram(program);
+        glDeleteShader(computeShader);
+        return 0;
+    }
+
+    // Clean up
+    glDetachShader(program, computeShader);
+    glDeleteShader(computeShader);
+
+    return program;
+}
+
+
+
 /*!
 * \fn buildShadowFBOandTex
 * \brief Generate a FBO and attach a texture to its depth output (used for shadow maps generation)
@@ -375,6 +429,84 @@ void buildGbuffFBOandTex(GLuint *_gFBO, GLuint * _gPosition, GLuint * _gNormal,
 }
 
 
+/*!
+* \fn deleteFBO
+* \brief Delete a FBO and the depth renderbuffer attached to it (if any). Attached textures are not deleted.
+* \param _fbo : pointer to id of FBO to delete (set to 0)
+*/
+void deleteFBO(GLuint *_fbo)
+{
+    if(*_fbo == 0)
+        return;
+
+    glBindFramebuffer(GL_FRAMEBUFFER, *_fbo);
+
+    // depth renderbuffers created by buildScreenFBOandTex() and buildGbuffFBOandTex() are only referenced by the FBO
+    GLint type = GL_NONE;
+    glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_TYPE, &type);
+    if(type == GL_RENDERBUFFER)
+    {
+        GLint rbo = 0;
+        glGetFramebufferAttachmentParameteriv(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_FRAMEBUFFER_ATTACHMENT_OBJECT_NAME, &rbo);
+        GLuint rboName = (GLuint)rbo;
+        glDeleteRenderbuffers(1, &rboName);
+    }
+
+    // Bind default framebuffer
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    glDeleteFramebuffers(1, _fbo);
+    *_fbo = 0;
+}
+
+
+/*!
+* \fn updateTextureBuffer
+* \brief Upload data to a buffer texture (read in shaders with texelFetch on a samplerBuffer).
+*        The buffer and the texture are generated on first call; the storage is reallocated on each call
+* \param _buffer : pointer to id of the buffer object (generated if 0)
+* \param _tex : pointer to id of the buffer texture (generated if 0)
+* \param _format : internal format of the texels (e.g. GL_RGBA32F, GL_R32UI)
+* \param _data : data to upload
+* \param _size : size of the data, in bytes
+*/
+void updateTextureBuffer(GLuint *_buffer, GLuint *_tex, GLenum _format, const void* _data, size_t _size)
+{
+    if(*_buffer == 0)
+        glGenBuffers(1, _buffer);
+    if(*_tex == 0)
+        glGenTextures(1, _tex);
+
+    // orphan the previous storage (no sync with the draws still reading it); never empty, so that the texture stays complete
+    glBindBuffer(GL_TEXTURE_BUFFER, *_buffer);
+    glBufferData(GL_TEXTURE_BUFFER, std::max(_size, (size_t)16), nullptr, GL_STREAM_DRAW);
+    if(_size > 0)
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, _size, _data);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    glBindTexture(GL_TEXTURE_BUFFER, *_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, _format, *_buffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+}
+
+
+/*!
+* \fn deleteTextureBuffer
+* \brief Delete a buffer texture and its buffer object
+* \param _buffer : pointer to id of the buffer object (set to 0)
+* \param _tex : pointer to id of the buffer texture (set to 0)
+*/
+void deleteTextureBuffer(GLuint *_buffer, GLuint *_tex)
+{
+    if(*_tex != 0)
+        glDeleteTextures(1, _tex);
+    if(*_buffer != 0)
+        glDeleteBuffers(1, _buffer);
+    *_tex = 0;
+    *_buffer = 0;
+}
+
+
 /*!
 * \fn buildTsdFBOandTex
 * \brief Generate a FBO and attach texture to its color outputs (TSD texture generation)
@@ -533,4 +665,98 @@ void buildKernelRot(GLuint *_noiseTex)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);  
 }
 
+
+
+/*!
+* \fn readFramebuffer
+* \brief Read back the color buffer of a FBO
+* \param _fbo : FBO to read (0 for default framebuffer)
+* \param _width : image width
+* \param _height : image height
+* \param _pixels : RGBA8 pixels, bottom row first
+*/
+void readFramebuffer(GLuint _fbo, int _width, int _height, std::vector<unsigned char>& _pixels)
+{
+    _pixels.resize(_width * _height * 4);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, _fbo);
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, _width, _height, GL_RGBA, GL_UNSIGNED_BYTE, _pixels.data());
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+}
+
+
+
+/*!
+* \fn saveImagePNG
+* \brief Write RGBA8 pixels to an opaque PNG file
+* \param _pixels : RGBA8 pixels, bottom row first (GL order)
+* \param _width : image width
+* \param _height : image height
+* \param _filename : output file name
+* \return true if the file was written
+*/
+bool saveImagePNG(std::vector<unsigned char> _pixels, int _width, int _height, const std::string& _filename)
+{
+    // force opaque image (alpha is used as a mask by some passes)
+    for(int i = 0; i < _width * _height; i++)
+        _pixels[i * 4 + 3] = 255;
+
+    // GL origin is the bottom-left corner
+    stbi_flip_vertically_on_write(1);
+    int res = stbi_write_png(_filename.c_str(), _width, _height, 4, _pixels.data(), _width * 4);
+    stbi_flip_vertically_on_write(0);
+
+    if(!res)
+    {
+        errorLog() << "saveImagePNG(): cannot write " << _filename;
+        return false;
+    }
+    return true;
+}
+
+
+
+/*!
+* \fn saveImageHDR
+* \brief Write linear RGB pixels to a Radiance HDR file
+* \param _pixels : RGB float pixels, bottom row first (GL order)
+* \param _width : image width
+* \param _height : image height
+* \param _filename : output file name
+* \return true if the file was written
+*/
+bool saveImageHDR(const std::vector<float>& _pixels, int _width, int _height, const std::string& _filename)
+{
+    // GL origin is the bottom-left corner
+    stbi_flip_vertically_on_write(1);
+    int res = stbi_write_hdr(_filename.c_str(), _width, _height, 3, _pixels.data());
+    stbi_flip_vertically_on_write(0);
+
+    if(!res)
+    {
+        errorLog() << "saveImageHDR(): cannot write " << _filename;
+        return false;
+    }
+    return true;
+}
+
+
+
+/*!
+* \fn saveFramebufferPNG
+* \brief Read back the color buffer of a FBO and write it to a PNG file
+* \param _fbo : FBO to read (0 for default framebuffer)
+* \param _width : image width
+* \param _height : image height
+* \param _filename : output file name
+* \return true if the file was written
+*/
+bool saveFramebufferPNG(GLuint _fbo, int _width, int _height, const std::string& _filename)
+{
+    std::vector<unsigned char> pixels;
+    readFramebuffer(_fbo, _width, _height, pixels);
+    return saveImagePNG(pixels, _width, _height, _filename);
+}
+
 #endif // UTILS_H
\ No newline at end of file
@@ -0,0 +1,261 @@
+/*********************************************************************************************************************
+ *
+ * test_bvh.cpp
+ *
+ * Unit tests of the ray queries and the refit of BVH, against a brute-force loop over the triangles
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "bvh.h"
+
+#include <iostream>
+#include <random>
+#include <limits>
+#include <cmath>
+#include <algorithm>
+
+
+static int s_numFailures = 0;
+
+#define CHECK(_cond) \
+    do { if(!(_cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #_cond << std::endl; s_numFailures++; } } while(0)
+
+
+// rays closer than this to a triangle edge (in barycentric coords) may go either way, and are skipped
+static const float EDGE_EPSILON = 1e-4f;
+static const int NUM_RAYS = 2000;
+
+
+/*!
+* \struct Mesh
+* \brief Small test mesh: a bumpy grid with random triangles floating above it
+*/
+struct Mesh
+{
+    std::vector<glm::vec3> vertices;
+    std::vector<uint32_t> indices;
+};
+
+static Mesh testMesh(std::mt19937& _rng)
+{
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    Mesh mesh;
+
+    const int gridSize = 16;
+    for(int y = 0; y <= gridSize; y++)
+        for(int x = 0; x <= gridSize; x++)
+        {
+            glm::vec2 pos = glm::vec2(x, y) / (float)gridSize * 2.0f - 1.0f;
+            mesh.vertices.push_back(glm::vec3(pos.x, 0.2f * std::sin(3.0f * pos.x) * std::cos(2.0f * pos.y), pos.y));
+        }
+    for(int y = 0; y < gridSize; y++)
+        for(int x = 0; x < gridSize; x++)
+        {
+            uint32_t i = y * (gridSize + 1) + x;
+            mesh.indices.insert(mesh.indices.end(), { i, i + 1, i + gridSize + 2, i + gridSize + 2, i + gridSize + 1, i });
+        }
+
+    for(int t = 0; t < 200; t++)
+    {
+        glm::vec3 center(uniform(_rng), 0.5f + 0.5f * uniform(_rng), uniform(_rng));
+        for(int v = 0; v < 3; v++)
+        {
+            mesh.indices.push_back((uint32_t)mesh.vertices.size());
+            mesh.vertices.push_back(center + 0.2f * glm::vec3(uniform(_rng), uniform(_rng), uniform(_rng)));
+        }
+    }
+    return mesh;
+}
+
+
+/*!
+* \struct Ray
+* \brief Test ray with its query interval
+*/
+struct Ray
+{
+    glm::vec3 origin;
+    glm::vec3 dir;
+    float tMin;
+    float tMax;
+};
+
+// rays from a sphere around the mesh towards random points of its box, some of them with a short interval
+static std::vector<Ray> testRays(std::mt19937& _rng)
+{
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<Ray> rays;
+    for(int r = 0; r < NUM_RAYS; r++)
+    {
+        glm::vec3 origin;
+        do
+            origin = glm::vec3(uniform(_rng), uniform(_rng), uniform(_rng));
+        while(glm::dot(origin, origin) > 1.0f || glm::dot(origin, origin) < 1e-4f);
+        origin = 3.0f * glm::normalize(origin);
+        glm::vec3 target(uniform(_rng), 0.5f * uniform(_rng) + 0.3f, uniform(_rng));
+        bool isShort = (r % 4 == 0);
+        float tMax = isShort ? 1.5f + 2.0f * (uniform(_rng) * 0.5f + 0.5f) : std::numeric_limits<float>::infinity();
+        rays.push_back({ origin, target - origin, isShort ? 0.5f : 0.0f, tMax });
+    }
+    return rays;
+}
+
+
+// Moller-Trumbore intersection of all the triangles, returns false if the result is ambiguous (ray close to an edge)
+static bool bruteForce(const Mesh& _mesh, const Ray& _ray, bool& _isHit, BVH::Hit& _hit)
+{
+    _isHit = false;
+    _hit.t = _ray.tMax;
+    bool isAmbiguous = false;
+    for(uint32_t t = 0; t < _mesh.indices.size() / 3; t++)
+    {
+        glm::vec3 v0 = _mesh.vertices[_mesh.indices[3 * t]];
+        glm::vec3 e1 = _mesh.vertices[_mesh.indices[3 * t + 1]] - v0;
+        glm::vec3 e2 = _mesh.vertices[_mesh.indices[3 * t + 2]] - v0;
+        glm::vec3 pvec = glm::cross(_ray.dir, e2);
+        float det = glm::dot(e1, pvec);
+        if(det == 0.0f)
+            continue;
+        glm::vec3 tvec = _ray.origin - v0;
+        float u = glm::dot(tvec, pvec) / det;
+        glm::vec3 qvec = glm::cross(tvec, e1);
+        float v = glm::dot(_ray.dir, qvec) / det;
+        float dist = glm::dot(e2, qvec) / det;
+
+        float edgeDist = std::min(std::min(u, v), 1.0f - u - v);
+        if(edgeDist < -EDGE_EPSILON || dist <= _ray.tMin || dist >= _ray.tMax)
+            continue;
+        if(edgeDist < EDGE_EPSILON)
+            isAmbiguous = true;
+        if(edgeDist >= 0.0f && dist < _hit.t)
+        {
+            _isHit = true;
+            _hit.t = dist;
+            _hit.triangle = t;
+            _hit.bary = glm::vec2(u, v);
+        }
+    }
+    return !isAmbiguous;
+}
+
+// closest-hit and any-hit queries of the BVH agree with the brute-force loop
+static void checkQueries(const BVH& _bvh, const Mesh& _mesh, const std::vector<Ray>& _rays)
+{
+    int numChecked = 0, numHits = 0, numWrongHit = 0, numWrongTriangle = 0, numWrongDist = 0, numWrongOcclusion = 0;
+    for(const Ray& ray : _rays)
+    {
+        bool isHitRef;
+        BVH::Hit hitRef;
+        if(!bruteForce(_mesh, ray, isHitRef, hitRef))
+            continue;
+        numChecked++;
+        numHits += isHitRef ? 1 : 0;
+
+        BVH::Hit hit;
+        bool isHit = _bvh.intersect(ray.origin, ray.dir, ray.tMin, ray.tMax, hit);
+        if(isHit != isHitRef)
+            numWrongHit++;
+        else if(isHit)
+        {
+            float tolerance = 1e-4f * std::max(1.0f, hitRef.t);
+            if(std::abs(hit.t - hitRef.t) > tolerance || std::abs(hit.bary.x - hitRef.bary.x) > 1e-3f ||
+               std::abs(hit.bary.y - hitRef.bary.y) > 1e-3f)
+                numWrongDist++;
+            // two triangles at the same distance can be returned in any order
+            if(hit.triangle != hitRef.triangle && std::abs(hit.t - hitRef.t) > tolerance)
+                numWrongTriangle++;
+        }
+
+        if(_bvh.isOccluded(ray.origin, ray.dir, ray.tMin, ray.tMax) != isHitRef)
+            numWrongOcclusion++;
+    }
+
+    // the rays must actually exercise the queries: most are checked, and both hits and misses occur
+    CHECK(numChecked > NUM_RAYS * 9 / 10);
+    CHECK(numHits > numChecked / 4 && numHits < numChecked);
+    CHECK(numWrongHit == 0);
+    CHECK(numWrongTriangle == 0);
+    CHECK(numWrongDist == 0);
+    CHECK(numWrongOcclusion == 0);
+}
+
+// root bounds of the BVH are the bounds of the triangles
+static void checkBounds(const BVH& _bvh, const Mesh& _mesh)
+{
+    glm::vec3 bBoxMin(std::numeric_limits<float>::infinity());
+    glm::vec3 bBoxMax(-std::numeric_limits<float>::infinity());
+    for(uint32_t index : _mesh.indices)
+    {
+        bBoxMin = glm::min(bBoxMin, _mesh.vertices[index]);
+        bBoxMax = glm::max(bBoxMax, _mesh.vertices[index]);
+    }
+    CHECK(_bvh.getBBoxMin() == bBoxMin);
+    CHECK(_bvh.getBBoxMax() == bBoxMax);
+}
+
+
+// an empty BVH hits nothing
+static void testEmpty()
+{
+    BVH bvh;
+    bvh.build({}, {});
+    BVH::Hit hit;
+    CHECK(bvh.isEmpty());
+    CHECK(!bvh.intersect(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 1e30f, hit));
+    CHECK(!bvh.isOccluded(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, 1.0f), 0.0f, 1e30f));
+}
+
+// closest-hit and any-hit queries of a freshly built BVH
+static void testBuild()
+{
+    std::mt19937 rng(11);
+    Mesh mesh = testMesh(rng);
+    BVH bvh;
+    bvh.build(mesh.vertices, mesh.indices);
+
+    CHECK(!bvh.isEmpty());
+    CHECK(bvh.getNumTriangles() == mesh.indices.size() / 3);
+    // the mesh needs more than one level
+    CHECK(bvh.getNumNodes() > 1);
+    checkBounds(bvh, mesh);
+    checkQueries(bvh, mesh, testRays(rng));
+}
+
+// after the vertices moved, refit() gives the same answers as the brute-force loop on the new positions
+static void testRefit()
+{
+    std::mt19937 rng(23);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    Mesh mesh = testMesh(rng);
+    BVH bvh;
+    bvh.build(mesh.vertices, mesh.indices);
+    size_t numNodes = bvh.getNumNodes();
+
+    // large motion (out of the original bounds), so stale boxes would miss hits
+    for(glm::vec3& vertex : mesh.vertices)
+        vertex = 1.5f * vertex + 0.3f * glm::vec3(uniform(rng), uniform(rng), uniform(rng)) + glm::vec3(0.0f, 0.2f, 0.0f);
+    bvh.refit(mesh.vertices);
+
+    CHECK(bvh.getNumNodes() == numNodes);
+    checkBounds(bvh, mesh);
+    checkQueries(bvh, mesh, testRays(rng));
+}
+
+
+int main()
+{
+    testEmpty();
+    testBuild();
+    testRefit();
+
+    if(s_numFailures > 0)
+    {
+        std::cerr << s_numFailures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All BVH tests passed" << std::endl;
+    return 0;
+}
@@ -0,0 +1,193 @@
+/*********************************************************************************************************************
+ *
+ * test_lightclusters.cpp
+ *
+ * Unit tests of the light-to-cluster assignment of LightClusters (CPU only, no GL context needed)
+ *
+ * RT_lite
+ * Ludovic Blache
+ *
+ *********************************************************************************************************************/
+
+#include "lightclusters.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <iostream>
+#include <random>
+#include <algorithm>
+
+
+static int s_numFailures = 0;
+
+#define CHECK(_cond) \
+    do { if(!(_cond)) { std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " #_cond << std::endl; s_numFailures++; } } while(0)
+
+
+// camera at the origin looking down -z (the lights are given in view space)
+static const glm::mat4 VIEW = glm::mat4(1.0f);
+static const glm::mat4 PROJ = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, 100.0f);
+static const glm::vec3 SCENE_MIN(-20.0f, -20.0f, -60.0f);
+static const glm::vec3 SCENE_MAX(20.0f, 20.0f, -1.0f);
+
+
+static LocalLight pointLight(const glm::vec3& _position, float _range)
+{
+    return { _position, _range, glm::vec3(1.0f), glm::vec3(0.0f, 0.0f, -1.0f), -1.0f, -1.0f };
+}
+
+// cluster of a view space point
+static int clusterOf(LightClusters& _clusters, const glm::vec3& _pos)
+{
+    glm::vec4 clip = PROJ * glm::vec4(_pos, 1.0f);
+    return _clusters.getCluster(glm::vec2(clip) / clip.w, -_pos.z);
+}
+
+// check if a cluster lists a light
+static bool hasLight(LightClusters& _clusters, int _cluster, uint32_t _light)
+{
+    const std::vector<uint32_t>& clusters = _clusters.getClusters();
+    const std::vector<uint32_t>& indices = _clusters.getLightIndices();
+    uint32_t offset = clusters[2 * _cluster], count = clusters[2 * _cluster + 1];
+    return std::find(indices.begin() + offset, indices.begin() + offset + count, _light) != indices.begin() + offset + count;
+}
+
+// number of clusters listing a light
+static int numClustersOf(LightClusters& _clusters, uint32_t _light)
+{
+    int num = 0;
+    for(int c = 0; c < _clusters.getNumClusters(); c++)
+        num += hasLight(_clusters, c, _light) ? 1 : 0;
+    return num;
+}
+
+
+// a small light only lands in the clusters around its position
+static void testSmallLight()
+{
+    LightClusters clusters;
+    glm::vec3 position(1.0f, 0.5f, -10.0f);
+    clusters.setLights({ pointLight(position, 0.05f) });
+    clusters.build(VIEW, PROJ, SCENE_MIN, SCENE_MAX);
+
+    CHECK(hasLight(clusters, clusterOf(clusters, position), 0));
+    // the sphere is much smaller than a cluster: at most 2 clusters along each axis
+    int num = numClustersOf(clusters, 0);
+    CHECK(num >= 1 && num <= 8);
+    CHECK(!hasLight(clusters, clusterOf(clusters, glm::vec3(-5.0f, -2.0f, -40.0f)), 0));
+}
+
+// a light behind the camera is in no cluster, a light covering the whole frustum is in all clusters
+static void testOutsideAndEverywhere()
+{
+    LightClusters clusters;
+    clusters.setLights({ pointLight(glm::vec3(0.0f, 0.0f, 5.0f), 1.0f), pointLight(glm::vec3(0.0f), 1000.0f) });
+    clusters.build(VIEW, PROJ, SCENE_MIN, SCENE_MAX);
+
+    CHECK(numClustersOf(clusters, 0) == 0);
+    CHECK(numClustersOf(clusters, 1) == clusters.getNumClusters());
+    CHECK(clusters.getMaxLightsPerCluster() == 1);
+}
+
+// a narrow spot light pointing away from the camera reaches the clusters along its axis, not those behind its apex
+static void testSpotLight()
+{
+    LightClusters clusters;
+    LocalLight spot = pointLight(glm::vec3(0.0f, 0.0f, -5.0f), 20.0f);
+    spot.cosOuter = std::cos(glm::radians(10.0f));
+    spot.cosInner = std::cos(glm::radians(5.0f));
+    clusters.setLights({ spot });
+    clusters.build(VIEW, PROJ, SCENE_MIN, SCENE_MAX);
+
+    CHECK(hasLight(clusters, clusterOf(clusters, glm::vec3(0.0f, 0.0f, -15.0f)), 0));
+    CHECK(hasLight(clusters, clusterOf(clusters, glm::vec3(0.0f, 0.0f, -24.0f)), 0));
+    CHECK(!hasLight(clusters, clusterOf(clusters, glm::vec3(0.0f, 0.0f, -2.0f)), 0));
+    CHECK(!hasLight(clusters, clusterOf(clusters, glm::vec3(0.0f, 0.0f, -40.0f)), 0));
+}
+
+// the assignment is conservative: any point lit by a light belongs to a cluster listing this light
+static void testConservative()
+{
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    std::vector<LocalLight> lights;
+    for(int l = 0; l < 64; l++)
+    {
+        float depth = 2.0f + 40.0f * (uniform(rng) * 0.5f + 0.5f);
+        glm::vec3 position(uniform(rng) * depth * 0.5f, uniform(rng) * depth * 0.3f, -depth);
+        lights.push_back(pointLight(position, 0.5f + 2.0f * (uniform(rng) * 0.5f + 0.5f)));
+    }
+    LightClusters clusters;
+    clusters.setLights(lights);
+    clusters.build(VIEW, PROJ, SCENE_MIN, SCENE_MAX);
+
+    int numMissed = 0;
+    for(uint32_t l = 0; l < lights.size(); l++)
+    {
+        for(int s = 0; s < 200; s++)
+        {
+            glm::vec3 offset(uniform(rng), uniform(rng), uniform(rng));
+            if(glm::dot(offset, offset) > 1.0f)
+                continue;
+            glm::vec3 pos = lights[l].position + offset * lights[l].range;
+            glm::vec4 clip = PROJ * glm::vec4(pos, 1.0f);
+            // only the points inside the view frustum are shaded
+            if(clip.w <= 0.0f || std::abs(clip.x) > clip.w || std::abs(clip.y) > clip.w || std::abs(clip.z) > clip.w)
+                continue;
+            if(!hasLight(clusters, clusterOf(clusters, pos), l))
+                numMissed++;
+        }
+    }
+    CHECK(numMissed == 0);
+}
+
+// the clusters are packed one after the other in the index list
+static void testPacking()
+{
+    std::vector<LocalLight> lights;
+    for(int l = 0; l < 16; l++)
+        lights.push_back(pointLight(glm::vec3((float)l - 8.0f, 0.0f, -3.0f - 2.0f * (float)l), 3.0f));
+    LightClusters clusters;
+    clusters.setLights(lights);
+    clusters.build(VIEW, PROJ, SCENE_MIN, SCENE_MAX);
+
+    const std::vector<float>& data = clusters.getLightData();
+    CHECK(data.size() == lights.size() * 12);
+    CHECK(data[5 * 12 + 0] == lights[5].position.x && data[5 * 12 + 2] == lights[5].position.z && data[5 * 12 + 3] == lights[5].range);
+    CHECK(data[5 * 12 + 7] == -1.0f);
+
+    const std::vector<uint32_t>& cells = clusters.getClusters();
+    CHECK((int)cells.size() == 2 * clusters.getNumClusters());
+    uint32_t offset = 0, maxCount = 0;
+    bool isContiguous = true, isInRange = true;
+    for(int c = 0; c < clusters.getNumClusters(); c++)
+    {
+        isContiguous = isContiguous && (cells[2 * c] == offset);
+        offset += cells[2 * c + 1];
+        maxCount = std::max(maxCount, cells[2 * c + 1]);
+    }
+    for(uint32_t index : clusters.getLightIndices())
+        isInRange = isInRange && (index < lights.size());
+    CHECK(isContiguous);
+    CHECK(isInRange);
+    CHECK(offset == clusters.getLightIndices().size());
+    CHECK((int)maxCount == clusters.getMaxLightsPerCluster());
+}
+
+
+int main()
+{
+    testSmallLight();
+    testOutsideAndEverywhere();
+    testSpotLight();
+    testConservative();
+    testPacking();
+
+    if(s_numFailures > 0)
+    {
+        std::cerr << s_numFailures << " check(s) failed" << std::endl;
+        return 1;
+    }
+    std::cout << "All light cluster tests passed" << std::endl;
+    return 0;
+}